@@ -10,12 +10,26 @@
 #!/usr/bin/env python3
 
 import os
+import re
+import subprocess
 from os.path import join, abspath
 
-project_name = "osshs-bootloader"
+profile = ARGUMENTS.get("profile", "debug")
+target = ARGUMENTS.get("target", "stm32")
+# Log records on CAN, see include/osshs/log/can_log_sink.hpp
+can_log = ARGUMENTS.get("can_log", "0")
+# Decryption of encrypted images, see include/osshs/key_store.hpp
+decrypt = ARGUMENTS.get("decrypt", "0")
+
+# The benchmark firmware replaces the bootloader's main(), see benchmark/
+project_name = "osshs-benchmark" if target == "benchmark" else "osshs-bootloader"
 
 build_path = "./build/" + project_name
-profile = ARGUMENTS.get("profile", "debug")
+
+# Host simulation of the bootloader, see sim/
+if target == "host":
+    SConscript("sim/SConscript", exports="profile can_log decrypt")
+    Return()
 
 generated_paths = [
     'modm'
@@ -37,12 +51,54 @@ sources = []
 
 sources += env.FindSourceFiles('./src', ignorePaths=ignored)
 
+if target == "benchmark":
+    sources = [source for source in sources if os.path.normpath(str(source)) != os.path.normpath("src/main.cpp")]
+    sources += env.FindSourceFiles('./benchmark', ignorePaths=ignored)
+
 env.Append(CPPPATH = [
     "./ext/magic_enum/include/"
 ])
 
 env.Append(CCFLAGS = [
-    "-fno-exceptions"
+    "-fno-exceptions",
+    "-DOSSHS_CAN_LOG=" + can_log,
+    "-DOSSHS_BOOTLOADER_DECRYPT=" + decrypt
+])
+
+# Flash and RAM sizes in KiB of STM32F1 devices by line and flash size code, see include/osshs/memory_map.hpp
+flash_sizes = {"4": 16, "6": 32, "8": 64, "b": 128, "c": 256, "d": 384, "e": 512, "f": 768, "g": 1024}
+ram_sizes = {
+    "100": {"4": 4, "6": 4, "8": 8, "b": 8, "c": 24, "d": 32, "e": 32},
+    "101": {"4": 4, "6": 6, "8": 10, "b": 16, "c": 32, "d": 48, "e": 48, "f": 80, "g": 80},
+    "102": {"4": 4, "6": 6, "8": 10, "b": 16},
+    "103": {"4": 6, "6": 10, "8": 20, "b": 20, "c": 48, "d": 64, "e": 64, "f": 96, "g": 96},
+    "105": {"8": 64, "b": 64, "c": 64},
+    "107": {"b": 64, "c": 64},
+}
+
+def target_geometry(device):
+    match = re.match(r"stm32f(10[0-7])[a-z]([0-9a-z])", device)
+    if not match or match.group(2) not in ram_sizes.get(match.group(1), {}):
+        print("Unsupported target for the memory map: " + device)
+        Exit(1)
+
+    line, code = match.groups()
+    flash = flash_sizes[code] * 1024
+    # Connectivity line devices have 2 KiB pages regardless of their flash size
+    page = 0x800 if flash > 0x20000 or line in ("105", "107") else 0x400
+    return {"flash": flash, "ram": ram_sizes[line][code] * 1024, "page": page}
+
+with open("project.xml") as project:
+    device = re.search(r'<option name="modm:target">([a-z0-9]+)</option>', project.read()).group(1)
+
+geometry = target_geometry(device)
+geometry["bootloader"] = 0x2000 if profile == "minimal" else 0x4000
+
+env.Append(CCFLAGS = [
+    "-DOSSHS_TARGET_FLASH_SIZE=" + hex(geometry["flash"]),
+    "-DOSSHS_TARGET_FLASH_PAGE_SIZE=" + hex(geometry["page"]),
+    "-DOSSHS_TARGET_RAM_SIZE=" + hex(geometry["ram"]),
+    "-DOSSHS_BOOTLOADER_SIZE=" + hex(geometry["bootloader"])
 ])
 
 if profile == "debug":
@@ -55,4 +111,164 @@ if profile == "release":
         "-DDISABLE_LOGGING"
     ])
 
-env.BuildTarget(sources)
+# Same boot behaviour as release, but small enough to move the application down to 0x08002000. The update links,
+# which came after the budget, are left out, the application is written with a debugger or the ROM bootloader.
+if profile == "minimal":
+    if decrypt == "1" or can_log == "1":
+        print("The minimal profile has no update links, it takes neither decrypt=1 nor can_log=1.")
+        Exit(1)
+
+    env.Append(CCFLAGS = [
+        "-Os",
+        "-ffunction-sections",
+        "-fdata-sections",
+        "-DDISABLE_LOGGING",
+        "-DOSSHS_BOOTLOADER_UPDATE=0"
+    ])
+    env.Append(LINKFLAGS = [
+        "-Wl,--gc-sections"
+    ])
+
+# RAM at the top kept for the application by length, see include/osshs/bootloader.hpp
+reserved_ram = [("trace", 0x120), ("handoff", 0x40)]
+reserved_length = sum(length for _, length in reserved_ram)
+reserved_origin = 0x20000000 + geometry["ram"] - reserved_length
+
+env.Append(CCFLAGS = [
+    "-DOSSHS_BOOTLOADER_RESERVED_RAM_LENGTH=" + hex(reserved_length)
+])
+
+def memory_length(value):
+    """Length of a MEMORY region in bytes, as given in a linker script with an optional K or M suffix."""
+    multipliers = {"K": 1024, "M": 1024 * 1024}
+    if value[-1].upper() in multipliers:
+        return int(value[:-1], 0) * multipliers[value[-1].upper()]
+    return int(value, 0)
+
+def reserve_ram(env):
+    """
+    Links against a copy of modm's linker script with every RAM region ending at the top of RAM shortened by the
+    reserved length, so that neither .data, .bss, the heap nor the stack reach the reserved RAM.
+    """
+    flags = [flag for flag in env["LINKFLAGS"] if str(flag).startswith("-T")]
+    if len(flags) != 1:
+        print("No linker script in LINKFLAGS to reserve RAM in.")
+        Exit(1)
+
+    name = str(flags[0])[2:].strip()
+    paths = [name] + [join(str(path), name) for path in env.get("LIBPATH", [])]
+    paths += [join(str(flag)[2:], name) for flag in env["LINKFLAGS"] if str(flag).startswith("-L")]
+    path = next((path for path in paths if os.path.isfile(path)), None)
+    if path is None:
+        print("Linker script {} not found.".format(name))
+        Exit(1)
+
+    shortened = []
+    def shorten(match):
+        origin, length = int(match.group(2), 0), memory_length(match.group(4))
+        if origin + length != 0x20000000 + geometry["ram"]:
+            return match.group(0)
+        shortened.append(match.group(1))
+        return "{}{}{}{}".format(match.group(1), match.group(2), match.group(3), hex(length - reserved_length))
+
+    with open(path) as file:
+        script = re.sub(r"^(\s*\w+\s*\([^)]*\)\s*:\s*ORIGIN\s*=\s*)(0x[0-9a-fA-F]+|\d+)(\s*,\s*LENGTH\s*=\s*)(\w+)",
+            shorten, file.read(), flags=re.M)
+    if not shortened:
+        print("No RAM region in {} ends at the top of RAM.".format(path))
+        Exit(1)
+
+    reserved_path = abspath(join(build_path, "link", "linkerscript.ld"))
+    os.makedirs(os.path.dirname(reserved_path), exist_ok=True)
+    with open(reserved_path, "w") as file:
+        file.write(script)
+    env["LINKFLAGS"] = [flag if flag is not flags[0] else "-T" + reserved_path for flag in env["LINKFLAGS"]]
+
+reserve_ram(env)
+
+# Budgets in bytes. Flash is everything below the application origin, less the key page when
+# decryption is enabled. RAM excludes the reserved RAM.
+flash_budget = geometry["bootloader"] - (geometry["page"] if decrypt == "1" else 0)
+ram_budget = geometry["ram"] - reserved_length
+budgets = {
+    "debug":   {"flash": flash_budget, "ram": ram_budget, "enforce": False},
+    "release": {"flash": flash_budget, "ram": ram_budget, "enforce": True},
+    "minimal": {"flash": flash_budget, "ram": ram_budget, "enforce": True},
+}
+
+# Static RAM by subsystem, matched in order against the demangled names of the symbols in RAM.
+# The main stack is reported on its own, its high-water mark at runtime comes from osshs::StackMonitor.
+ram_subsystems = [
+    ("flash buffers", r"osshs::(Flash|ImageWriter|ContainerWriter|WearJournal|VerificationCache)\b"),
+    ("protocol", r"osshs::(UpdateProtocol|transport::)"),
+    ("can", r"osshs::CanBus|modm::platform::Can"),
+    ("logger", r"osshs::log::|LogDevice|modm::log::|\blogger\b"),
+    ("crypto", r"osshs::crypto::"),
+    ("event loop", r"osshs::(EventLoop|StatusLedController|TokenBucket)"),
+]
+
+def report_ram(target, env, budget):
+    nm = re.sub(r"size$", "nm", env.subst("$SIZE") or "arm-none-eabi-size")
+    output = subprocess.check_output([nm, "--print-size", "--demangle", str(target[0])])
+
+    usage = dict((name, 0) for name, _ in ram_subsystems)
+    usage["other"] = 0
+    addresses = {}
+    top = 0x20000000
+    for line in output.decode().splitlines():
+        # Symbols of the linker script have no size
+        match = re.match(r"([0-9a-f]+) (?:([0-9a-f]+) )?(\w) (.*)", line)
+        if not match:
+            continue
+        address, size, _, name = match.groups()
+        addresses[name] = int(address, 16)
+        # The ends of the stack and heap sections are symbols of the linker script
+        if 0 <= addresses[name] - 0x20000000 <= geometry["ram"]:
+            top = max(top, addresses[name] + int(size or "0", 16))
+        # Static members of templates are weak symbols, so the address tells data from code
+        if size and 0 <= addresses[name] - 0x20000000 < geometry["ram"]:
+            subsystem = next((subsystem for subsystem, pattern in ram_subsystems if re.search(pattern, name)), "other")
+            usage[subsystem] += int(size, 16)
+
+    usage["main stack"] = addresses.get("__main_stack_top", 0) - addresses.get("__main_stack_bottom", 0)
+    for subsystem in [name for name, _ in ram_subsystems] + ["other", "main stack"]:
+        print("  {:<14}{:>8} bytes ({:5.1f}%)".format(subsystem, usage[subsystem], 100.0 * usage[subsystem] / budget["ram"]))
+
+    return top
+
+def check_size(target, source, env):
+    # The benchmark firmware is flashed on its own and has no budget
+    budget = budgets.get(profile) if project_name == "osshs-bootloader" else None
+    if budget is None:
+        return 0
+
+    output = subprocess.check_output([env.subst("$SIZE") or "arm-none-eabi-size", "-B", str(target[0])])
+    text, data, bss = (int(value) for value in output.decode().splitlines()[1].split()[:3])
+    usage = {"flash": text + data, "ram": data + bss}
+
+    failed = False
+    for section in ("flash", "ram"):
+        over = usage[section] > budget[section]
+        failed |= over
+        print("{:<6}{:>8} / {:>8} bytes ({:5.1f}%){}".format(section, usage[section], budget[section],
+            100.0 * usage[section] / budget[section], "  OVER BUDGET" if over else ""))
+
+    # Checked whatever the profile, the application relies on the reserved RAM to survive the bootloader
+    top = report_ram(target, env, budget)
+    if top > reserved_origin:
+        print("RAM up to 0x{:08x} overlaps the reserved RAM at 0x{:08x}".format(top, reserved_origin))
+        return 1
+
+    # Whatever the profile, code beyond the flash budget of a decrypting build would overlap the key page
+    if decrypt == "1" and usage["flash"] > budget["flash"]:
+        print("Flash up to 0x{:08x} overlaps the key page at 0x{:08x}".format(0x08000000 + usage["flash"],
+            0x08000000 + flash_budget))
+        return 1
+
+    return 1 if failed and budget["enforce"] else 0
+
+program = env.BuildTarget(sources)
+
+env.AddPostAction(program, check_size)
+env.Alias("size-report", program, check_size)
+env.AlwaysBuild("size-report")
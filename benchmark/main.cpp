@@ -0,0 +1,260 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <board.hpp>
+#include <osshs/bootloader.hpp>
+#include <osshs/can_bus.hpp>
+#include <osshs/cycle_counter.hpp>
+#include <osshs/event_loop.hpp>
+#include <osshs/flash.hpp>
+#include <osshs/stack_monitor.hpp>
+#include <osshs/status_led_controller.hpp>
+#include <osshs/crypto/aes128_ctr.hpp>
+#include <osshs/crypto/ed25519.hpp>
+#include <osshs/crypto/sha256.hpp>
+#include <osshs/log/logger.hpp>
+#include <modm/io/iostream.hpp>
+#include <cstring>
+#include <memory>
+
+/**
+ * Benchmark firmware.
+ *
+ * Runs the bootloader's kernels on real silicon and reports the cycles they take, measured with the DWT cycle
+ * counter, and the stack they use, measured by painting the unused stack. Flash kernels operate on the scratch
+ * pages at the end of the application region, whose contents are destroyed. The report is printed on USART1 as JSON Lines: a
+ * "begin" object, one object per kernel and an "end" object. Decryption is also reported in bytes per second next to
+ * the payload rates of the links it has to keep up with.
+ */
+
+#define OSSHS_BENCHMARK_SCRATCH_PAGES  4
+#define OSSHS_BENCHMARK_SCRATCH_ORIGIN (osshs::TargetMemoryMap::configOrigin - \
+	OSSHS_BENCHMARK_SCRATCH_PAGES * osshs::TargetMemoryMap::pageSize)
+
+// Payload of the links: 7 bytes per CAN frame at the default rate limit, USART1 at 115200 baud with 8N1 framing
+#define OSSHS_BENCHMARK_CAN_BYTES_PER_SECOND  (OSSHS_CAN_RATE_LIMIT * 7)
+#define OSSHS_BENCHMARK_UART_BYTES_PER_SECOND 11520
+
+using StatusIndicator = osshs::StatusLedController<modm::platform::Timer2, osshs::board::StatusLed, osshs::board::SystemClock>;
+
+// Log messages are formatted as usual, but not sent anywhere
+struct NullDevice
+{
+	static bool
+	write(uint8_t)
+	{
+		return true;
+	}
+
+	static bool
+	read(uint8_t &)
+	{
+		return false;
+	}
+
+	static void
+	flushWriteBuffer()
+	{
+	}
+};
+
+OSSHS_ENABLE_LOGGER(NullDevice, modm::IOBuffer::DiscardIfFull);
+
+modm::IODeviceWrapper<modm::platform::Usart1, modm::IOBuffer::BlockIfFull> reportDevice;
+modm::IOStream report(reportDevice);
+
+namespace
+{
+	uint32_t overhead = 0;
+
+	/**
+	 * Run a kernel a number of times and report its cycles and stack usage.
+	 * @return Mean cycles of the kernel.
+	 */
+	template<typename KERNEL>
+	uint32_t
+	measure(const char *name, uint32_t iterations, KERNEL kernel)
+	{
+		uint32_t minimum = UINT32_MAX;
+		uint32_t maximum = 0;
+		uint64_t total = 0;
+		uint32_t stack = 0;
+
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			osshs::StackMonitor::paint();
+			uint32_t base = osshs::StackMonitor::getHighWaterMark();
+
+			uint32_t cycles = osshs::CycleCounter::now();
+			kernel(i);
+			cycles = osshs::CycleCounter::now() - cycles;
+
+			cycles = cycles > overhead ? cycles - overhead : 0;
+			minimum = cycles < minimum ? cycles : minimum;
+			maximum = cycles > maximum ? cycles : maximum;
+			total += cycles;
+
+			uint32_t usage = osshs::StackMonitor::getHighWaterMark() - base;
+			stack = usage > stack ? usage : stack;
+		}
+
+		report.printf("{\"kernel\": \"%s\", \"iterations\": %lu, \"min\": %lu, \"mean\": %lu, \"max\": %lu, \"stack\": %lu}\r\n",
+			name, iterations, minimum, static_cast<uint32_t>(total / iterations), maximum, stack);
+		return total / iterations;
+	}
+
+	// FIPS 197, appendix C.1
+	const uint8_t aesKey[OSSHS_AES128_KEY_SIZE] = {
+		0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+	};
+
+	const uint8_t aesPlaintext[OSSHS_AES128_BLOCK_SIZE] = {
+		0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff
+	};
+
+	const uint8_t aesCiphertext[OSSHS_AES128_BLOCK_SIZE] = {
+		0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a
+	};
+
+	// RFC 8032, section 7.1, test 1
+	const uint8_t publicKey[OSSHS_ED25519_PUBLIC_KEY_SIZE] = {
+		0xd7, 0x5a, 0x98, 0x01, 0x82, 0xb1, 0x0a, 0xb7, 0xd5, 0x4b, 0xfe, 0xd3, 0xc9, 0x64, 0x07, 0x3a,
+		0x0e, 0xe1, 0x72, 0xf3, 0xda, 0xa6, 0x23, 0x25, 0xaf, 0x02, 0x1a, 0x68, 0xf7, 0x07, 0x51, 0x1a
+	};
+
+	const uint8_t signature[OSSHS_ED25519_SIGNATURE_SIZE] = {
+		0xe5, 0x56, 0x43, 0x00, 0xc3, 0x60, 0xac, 0x72, 0x90, 0x86, 0xe2, 0xcc, 0x80, 0x6e, 0x82, 0x8a,
+		0x84, 0x87, 0x7f, 0x1e, 0xb8, 0xe5, 0xd9, 0x74, 0xd8, 0x73, 0xe0, 0x65, 0x22, 0x49, 0x01, 0x55,
+		0x5f, 0xb8, 0x82, 0x15, 0x90, 0xa3, 0x3b, 0xac, 0xc6, 0x1e, 0x39, 0x70, 0x1c, 0xf9, 0xb4, 0x6b,
+		0xd2, 0x5b, 0xf5, 0xf0, 0x59, 0x5b, 0xbe, 0x24, 0x65, 0x51, 0x41, 0x43, 0x8e, 0x7a, 0x10, 0x0b
+	};
+}
+
+int
+main()
+{
+	osshs::CycleCounter::initialize();
+	osshs::board::initialize();
+	osshs::Bootloader::initialize();
+	osshs::Flash::initialize();
+
+	// Kernels are measured without the cost of their log messages
+	OSSHS_LOG_SET_LEVEL(osshs::log::Level::DISABLED);
+
+	std::unique_ptr<uint8_t[]> page = std::make_unique<uint8_t[]>(osshs::Flash::pageSize);
+	std::unique_ptr<uint32_t> crc = std::make_unique<uint32_t>();
+	for (uint32_t i = 0; i < osshs::Flash::pageSize; i++)
+		page[i] = i * 7;
+
+	// Cycles of an empty measurement, subtracted from all results
+	overhead = UINT32_MAX;
+	for (uint8_t i = 0; i < 16; i++)
+	{
+		uint32_t cycles = osshs::CycleCounter::now();
+		cycles = osshs::CycleCounter::now() - cycles;
+		overhead = cycles < overhead ? cycles : overhead;
+	}
+
+	report.printf("{\"benchmark\": \"begin\", \"frequency\": %lu, \"overhead\": %lu, \"scratch\": %lu, \"pageSize\": %lu}\r\n",
+		modm::clock::fcpu, overhead, static_cast<uint32_t>(OSSHS_BENCHMARK_SCRATCH_ORIGIN), static_cast<uint32_t>(osshs::Flash::pageSize));
+
+	measure("Flash::erasePage", OSSHS_BENCHMARK_SCRATCH_PAGES, [](uint32_t i) {
+		osshs::Flash::erasePage(OSSHS_BENCHMARK_SCRATCH_ORIGIN + i * osshs::Flash::pageSize);
+	});
+
+	measure("Flash::writePage", OSSHS_BENCHMARK_SCRATCH_PAGES, [&page](uint32_t i) {
+		osshs::Flash::writePage(OSSHS_BENCHMARK_SCRATCH_ORIGIN + i * osshs::Flash::pageSize, page);
+	});
+
+	measure("Flash::readPage", 16, [&page](uint32_t i) {
+		osshs::Flash::readPage(OSSHS_BENCHMARK_SCRATCH_ORIGIN + (i % OSSHS_BENCHMARK_SCRATCH_PAGES) * osshs::Flash::pageSize, page);
+	});
+
+	measure("Flash::calculatePageCRC", 16, [&crc](uint32_t i) {
+		osshs::Flash::calculatePageCRC(OSSHS_BENCHMARK_SCRATCH_ORIGIN + (i % OSSHS_BENCHMARK_SCRATCH_PAGES) * osshs::Flash::pageSize, crc);
+	});
+
+	measure("Flash::reflectWord", 256, [](uint32_t i) {
+		volatile uint32_t value = osshs::Flash::reflectWord(i * 0x9e3779b9);
+		(void) value;
+	});
+
+	OSSHS_LOG_SET_LEVEL(osshs::log::Level::DEBUG);
+	measure("Logger::log", 64, [](uint32_t i) {
+		OSSHS_LOG_INFO("Benchmarking logger(iteration = `%lu`, address = `0x%08x`).", i, OSSHS_BENCHMARK_SCRATCH_ORIGIN);
+	});
+	OSSHS_LOG_SET_LEVEL(osshs::log::Level::DISABLED);
+
+	StatusIndicator::setStatus(StatusIndicator::Status::APPLICATION_ERROR);
+	measure("StatusLedController::update", 256, [](uint32_t) {
+		StatusIndicator::update();
+	});
+
+	// Post and dispatch of an empty task, the overhead the event loop adds to every interrupt
+	static uint8_t emptyTask = osshs::EventLoop::addTask("empty", []() {});
+	measure("EventLoop::poll", 256, [](uint32_t) {
+		osshs::EventLoop::post(emptyTask);
+		osshs::EventLoop::poll();
+	});
+
+	measure("Sha256::update(page)", 16, [](uint32_t i) {
+		osshs::crypto::Sha256 sha256;
+		sha256.reset();
+		sha256.update(reinterpret_cast<const uint8_t *>(OSSHS_BENCHMARK_SCRATCH_ORIGIN +
+			(i % OSSHS_BENCHMARK_SCRATCH_PAGES) * osshs::Flash::pageSize), osshs::Flash::pageSize);
+	});
+
+	// The counter block of block 0 is the plaintext of the test vector, so the keystream is its ciphertext
+	static osshs::crypto::Aes128Ctr cipher;
+	measure("Aes128Ctr::begin", 16, [](uint32_t) {
+		cipher.begin(aesKey, aesPlaintext);
+	});
+
+	uint8_t keystream[OSSHS_AES128_BLOCK_SIZE] = {};
+	cipher.apply(keystream, sizeof(keystream), 0);
+	bool aesValid = !std::memcmp(keystream, aesCiphertext, sizeof(keystream));
+
+	// In place on a page buffer, as WRITE data is decrypted in the message buffer
+	uint32_t decryptCycles = measure("Aes128Ctr::apply(page)", 16, [&page](uint32_t i) {
+		cipher.apply(page.get(), osshs::Flash::pageSize, i * osshs::Flash::pageSize);
+	});
+
+	report.printf("{\"throughput\": \"Aes128Ctr::apply(page)\", \"bytesPerSecond\": %lu, \"can\": %lu, \"uart\": %lu}\r\n",
+		static_cast<uint32_t>(static_cast<uint64_t>(osshs::Flash::pageSize) * modm::clock::fcpu / (decryptCycles ? decryptCycles : 1)),
+		static_cast<uint32_t>(OSSHS_BENCHMARK_CAN_BYTES_PER_SECOND), static_cast<uint32_t>(OSSHS_BENCHMARK_UART_BYTES_PER_SECOND));
+
+	bool valid = false;
+	measure("Ed25519::verify", 2, [&valid](uint32_t) {
+		valid = osshs::crypto::Ed25519::verify(signature, publicKey, nullptr, 0);
+	});
+
+	report.printf("{\"benchmark\": \"end\", \"ed25519Valid\": %s, \"aesValid\": %s}\r\n", valid ? "true" : "false",
+		aesValid ? "true" : "false");
+
+	osshs::Flash::lock();
+
+	while (true);
+
+	return 0;
+}
@@ -26,6 +26,7 @@
 #define OSSHS_BOARD_HPP
 
 #include <modm/platform.hpp>
+#include <osshs/can_bus.hpp>
 
 namespace osshs
 {
@@ -76,7 +77,8 @@ namespace osshs
 			modm::platform::Rcc::setApb2Prescaler(modm::platform::Rcc::Apb2Prescaler::Div1);
 			modm::platform::Rcc::updateCoreFrequency<SystemClock::Frequency>();
 
-			modm::platform::Usart1::connect<modm::platform::GpioA9::Tx>();
+			// Shared by the log and the UART update transport
+			modm::platform::Usart1::connect<modm::platform::GpioA9::Tx, modm::platform::GpioA10::Rx>();
 			modm::platform::Usart1::initialize<osshs::board::SystemClock, 115200_Bd>();
 
 			modm::platform::SysTickTimer::initialize<SystemClock>();
@@ -84,11 +86,26 @@ namespace osshs
 			StatusLed::setOutput(modm::Gpio::Low);
 		}
 
+		/**
+		 * @brief Connect CAN1 to PA11/PA12 and set its bit timing.
+		 * @note Needed for the listen window at boot and while the bootloader stays active, see CanBus.
+		 */
+		void
+		initializeCan()
+		{
+			modm::platform::Can1::connect<modm::platform::GpioA11::Rx, modm::platform::GpioA12::Tx>(
+				modm::platform::Gpio::InputType::PullUp);
+			modm::platform::Can1::initialize<SystemClock, 125_kbps>(OSSHS_CAN_INTERRUPT_PRIORITY);
+		}
+
 		void
 		deinitialize()
 		{
 			modm::platform::UsartHal1::disable();
 			modm::platform::SysTickTimer::disable();
+
+			// CAN1 was only opened for the listen window, CanBus::deinitialize() already reset it
+			RCC->APB1ENR &= ~RCC_APB1ENR_CAN1EN;
 		}
 	}
 }
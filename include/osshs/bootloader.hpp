@@ -25,17 +25,80 @@
 #ifndef OSSHS_BOOTLOADER_HPP
 #define OSSHS_BOOTLOADER_HPP
 
-#define OSSHS_BOOTLOADER_APPLICATION_ORIGIN 0x08004000
-#define OSSHS_BOOTLOADER_APPLICATION_LENGTH 0x00020000
+#include <cstdint>
+#include <osshs/memory_map.hpp>
 
-#define OSSHS_BOOTLOADER_RAM_ORIGIN 0x20000000
-#define OSSHS_BOOTLOADER_RAM_LENGTH 0x00005000
+// Derived from the memory map, see memory_map.hpp
+#define OSSHS_BOOTLOADER_APPLICATION_ORIGIN (osshs::TargetMemoryMap::applicationOrigin)
+#define OSSHS_BOOTLOADER_APPLICATION_LENGTH (osshs::TargetMemoryMap::applicationLength)
+
+#define OSSHS_BOOTLOADER_RAM_ORIGIN (osshs::TargetMemoryMap::ramOrigin)
+#define OSSHS_BOOTLOADER_RAM_LENGTH (osshs::TargetMemoryMap::ramSize)
+
+#define OSSHS_BOOTLOADER_NODE_ID 0x01
+
+// Update over CAN and UART, with the update protocol, its crypto and the wear journal. The minimal profile leaves it out
+// and only boots the application.
+#ifndef OSSHS_BOOTLOADER_UPDATE
+#define OSSHS_BOOTLOADER_UPDATE 1
+#endif
+
+// Time after reset in which a STAY request keeps a node with a valid application in the bootloader, 0 disables it
+#ifndef OSSHS_BOOTLOADER_LISTEN_WINDOW_MS
+#define OSSHS_BOOTLOADER_LISTEN_WINDOW_MS 5
+#endif
+
+// Require an Ed25519 signature behind the image, as appended by tools/osshs-pack.py --sign, which also prints the key
+#ifndef OSSHS_BOOTLOADER_VERIFY_SIGNATURE
+#define OSSHS_BOOTLOADER_VERIFY_SIGNATURE false
+#endif
+
+#ifndef OSSHS_BOOTLOADER_PUBLIC_KEY
+#define OSSHS_BOOTLOADER_PUBLIC_KEY { \
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00  \
+}
+#endif
+
+// Accept images encrypted with AES-128-CTR under the key in the key page, see key_store.hpp. Passed by SConstruct.py.
+#ifndef OSSHS_BOOTLOADER_DECRYPT
+#define OSSHS_BOOTLOADER_DECRYPT 0
+#endif
+
+#define OSSHS_BOOTLOADER_TRACE_LENGTH 0x00000120
+#define OSSHS_BOOTLOADER_TRACE_ORIGIN (OSSHS_BOOTLOADER_RAM_ORIGIN + OSSHS_BOOTLOADER_RAM_LENGTH - OSSHS_BOOTLOADER_TRACE_LENGTH)
+
+#define OSSHS_BOOTLOADER_HANDOFF_LENGTH 0x00000040
+#define OSSHS_BOOTLOADER_HANDOFF_ORIGIN (OSSHS_BOOTLOADER_TRACE_ORIGIN - OSSHS_BOOTLOADER_HANDOFF_LENGTH)
+
+static_assert(OSSHS_BOOTLOADER_UPDATE || !OSSHS_BOOTLOADER_DECRYPT, "Decryption requires the update links.");
+
+static_assert(OSSHS_BOOTLOADER_TRACE_LENGTH + OSSHS_BOOTLOADER_HANDOFF_LENGTH < OSSHS_BOOTLOADER_RAM_LENGTH / 4,
+	"The trace and the handoff record leave too little RAM.");
+
+// Top of RAM left out of the linker script by SConstruct.py, so that neither the heap nor the stack reach the trace or
+// the handoff record
+#ifdef OSSHS_BOOTLOADER_RESERVED_RAM_LENGTH
+static_assert(OSSHS_BOOTLOADER_RESERVED_RAM_LENGTH == OSSHS_BOOTLOADER_TRACE_LENGTH + OSSHS_BOOTLOADER_HANDOFF_LENGTH,
+	"The reserved RAM of SConstruct.py does not match the trace and the handoff record.");
+#endif
 
 namespace osshs
 {
 	class Bootloader
 	{
 	public:
+		enum class ApplicationCheck : uint8_t
+		{
+			VALID,
+			INVALID_STACK_POINTER,
+			INVALID_MANIFEST,
+			INVALID_LENGTH,
+			INVALID_ENTRY_POINT,
+			INVALID_CRC,
+			INVALID_SIGNATURE
+		};
+
 		/**
 		 * @brief Initialize the bootloader.
 		 */
@@ -47,6 +110,14 @@ namespace osshs
 		 */
 		static void
 		deinitialize();
+
+		/**
+		 * @brief Get the reset flags of the current boot.
+		 * @note The flags are cleared in RCC_CSR by initialize(), so the next boot sees only its own reset cause.
+		 * @return Value of RCC_CSR before initialize() cleared it.
+		 */
+		static uint32_t
+		getResetFlags();
 		
 		/**
 		 * @brief Check whether or not the bootloader should load the application.
@@ -63,18 +134,52 @@ namespace osshs
 		setLoadApplication(bool loadApplication = true);
 
 		/**
-		 * @brief Check if the application has a valid stack pointer.
-		 * @return Whether or not the applicaion has a valid stack pointer.
+		 * @brief Check if the application is valid.
+		 * @note The application must have a valid stack pointer and manifest, and the CRC of the bytes in use
+		 *       (as given by the manifest) must match. If OSSHS_BOOTLOADER_VERIFY_SIGNATURE is enabled, the
+		 *       image must also be followed by an Ed25519 signature of those bytes made with the key matching
+		 *       OSSHS_BOOTLOADER_PUBLIC_KEY. On warm boots VerificationCache may skip the CRC, never the signature.
+		 * @return Whether or not the applicaion is valid.
 		 */
 		static bool
 		checkApplication();
 
+		/**
+		 * @brief Poll the links for a request to stay in the bootloader until the listen window has passed.
+		 * @note The window counts from reset, so the time spent checking the application is part of it and boot
+		 *       latency rises by at most OSSHS_BOOTLOADER_LISTEN_WINDOW_MS. The links are polled at least once.
+		 * @param poll Polls every link once without logging, returns whether or not a STAY request was answered.
+		 * @return Whether or not the bootloader should stay active.
+		 */
+		static bool
+		listen(bool (*poll)());
+
 		/**
 		 * @brief Load the application.
-		 * @note deinitialize() should be called before loading the application.
+		 * @note deinitialize() should be called before loading the application. A BootHandoff record describing
+		 *       this boot is written right before the jump.
 		 */
 		static void
 		loadApplication();
+
+	private:
+		/**
+		 * @brief Validate the application image against its manifest.
+		 * @return Result of the validation.
+		 */
+		static ApplicationCheck
+		validateApplication();
+
+		/**
+		 * @brief Write the handoff record for the application.
+		 */
+		static void
+		writeHandoff();
+
+		static uint32_t resetFlags;
+		static uint32_t validationCycles;
+		static uint32_t listenCycles;
+		static uint8_t verification;
 	};
 }
 
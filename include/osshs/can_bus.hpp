@@ -0,0 +1,288 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_CAN_BUS_HPP
+#define OSSHS_CAN_BUS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <osshs/spsc_queue.hpp>
+#include <osshs/token_bucket.hpp>
+
+// Standard identifiers of update frames, node 0 addresses all nodes
+#define OSSHS_CAN_BROADCAST_NODE_ID 0x00
+#define OSSHS_CAN_REQUEST_ID(node)  (0x600 + (node))
+#define OSSHS_CAN_RESPONSE_ID(node) (0x580 + (node))
+// Log records of a node, below all update frames in priority, see log::CanLogSink
+#define OSSHS_CAN_LOG_ID(node)      (0x680 + (node))
+
+#define OSSHS_CAN_QUEUE_SIZE         32
+#define OSSHS_CAN_INTERRUPT_PRIORITY 5
+
+// Rate limit of update frames until the host requests another one, about 25% of a 125 kbps bus
+#ifndef OSSHS_CAN_RATE_LIMIT
+#define OSSHS_CAN_RATE_LIMIT 250
+#endif
+#ifndef OSSHS_CAN_RATE_BURST
+#define OSSHS_CAN_RATE_BURST 16
+#endif
+
+// The adaptive rate is evaluated every period and never drops below the limit divided by 2^shift
+#define OSSHS_CAN_RATE_ADAPT_PERIOD_MS 100
+#define OSSHS_CAN_RATE_MINIMUM_SHIFT   3
+
+// Rate limit request, (command, rate[2], burst, mode), answered by a report to the response identifier
+#define OSSHS_CAN_COMMAND_RATE_LIMIT 0xc1
+// Rate limit report, (command, limit[2], burst, mode, rate[2], events), multi-byte values little endian
+#define OSSHS_CAN_REPORT_RATE_LIMIT  0xc2
+
+namespace osshs
+{
+	struct CanFrame
+	{
+		uint16_t id;      ///< Standard identifier
+		uint8_t length;
+		uint8_t fifo;     ///< Receive FIFO, 0 for frames addressed to this node and 1 for broadcasts
+		uint8_t data[8];
+	};
+
+	enum class CanRateMode : uint8_t
+	{
+		FIXED = 0,    ///< Update frames are limited to the requested rate
+		ADAPTIVE = 1  ///< Halve the rate on bus errors or lost arbitration, raise it back towards the limit otherwise
+	};
+
+	struct CanRateLimit
+	{
+		uint16_t rate;     ///< Update frames per second, 0 disables the limit
+		uint8_t burst;     ///< Update frames that may follow each other without delay
+		CanRateMode mode;
+	};
+
+	/**
+	 * Receives update frames on CAN1 and ignores all other traffic in hardware.
+	 *
+	 * Two filter banks in 16 bit identifier list mode only accept data frames with the request identifier of this
+	 * node (into FIFO0) and of the broadcast node (into FIFO1), so background traffic never reaches the CPU.
+	 * Both FIFOs are drained from their interrupts into a lock-free queue, which the event loop consumes.
+	 *
+	 * Update traffic is paced by a token bucket, configured per session by a rate limit request of the host. Each
+	 * received update frame must acquire a token first, and the host is told the current rate in a report frame
+	 * so it can pace itself. Frames sent by the bootloader answer requests that were already paced. Frames the host sends too fast are taken late, so an ignored limit shows
+	 * as a slow session instead of a busy bus. In adaptive mode, bus errors counted by the status change
+	 * interrupt and lost arbitration of own frames halve the rate, every quiet period raises it by 1/16th of the
+	 * limit. Background frames (e.g. log records) are paced by their sender and never count.
+	 */
+	class CanBus
+	{
+	public:
+		/**
+		 * @brief Configure the acceptance filters and enable the receive interrupts.
+		 * @note CAN1 must already be initialized, see board::initializeCan().
+		 * @param nodeId Node id of this node, between 1 and 127.
+		 * @param task Event loop task to post when frames were received.
+		 */
+		static void
+		initialize(uint8_t nodeId, uint8_t task);
+
+		/**
+		 * @brief Configure the acceptance filters without interrupts, received frames stay in the FIFOs until poll().
+		 * @note For the listen window at boot, before the event loop runs. CAN1 must already be initialized, see
+		 *       board::initializeCan(). initialize() takes over later and keeps the frames still in the FIFOs.
+		 * @param nodeId Node id of this node, between 1 and 127.
+		 */
+		static void
+		initializePolling(uint8_t nodeId);
+
+		/**
+		 * @brief Disable the receive interrupts and reset CAN1, so the application finds it in its reset state.
+		 */
+		static void
+		deinitialize();
+
+		/**
+		 * @brief Get the node id set by initialize().
+		 * @return Node id of this node.
+		 */
+		static uint8_t
+		getNodeId();
+
+		/**
+		 * @brief Check if received frames are queued.
+		 * @return Whether or not receive() returns a frame.
+		 */
+		static bool
+		isPending();
+
+		/**
+		 * @brief Take the oldest received frame.
+		 * @note Must only be called from the event loop.
+		 * @param frame Frame that will contain the received frame.
+		 * @return Whether or not a frame was received.
+		 */
+		static bool
+		receive(CanFrame &frame);
+
+		/**
+		 * @brief Take the oldest frame straight from the receive FIFOs, FIFO0 first.
+		 * @note Only while the receive interrupts are disabled, see initializePolling().
+		 * @param frame Frame that will contain the received frame.
+		 * @return Whether or not a frame was received.
+		 */
+		static bool
+		poll(CanFrame &frame);
+
+		/**
+		 * @brief Queue a frame in a free transmit mailbox.
+		 * @note Frames are transmitted in the order they were queued.
+		 * @param frame Frame to send.
+		 * @return Whether or not a transmit mailbox was free.
+		 */
+		static bool
+		send(const CanFrame &frame);
+
+		/**
+		 * @brief Queue a frame that must not delay update frames, e.g. a log record.
+		 * @note Only succeeds while all transmit mailboxes are empty, so update frames queued later wait for at
+		 *       most this frame. Arbitration it loses does not lower the adaptive rate.
+		 * @param frame Frame to send, with a lower priority identifier than update frames.
+		 * @return Whether or not the frame was queued.
+		 */
+		static bool
+		sendBackground(const CanFrame &frame);
+
+		/**
+		 * @brief Set the rate limit of update frames for the current session and report it to the host.
+		 * @param limit Rate limit, a burst of 0 is raised to 1.
+		 */
+		static void
+		setRateLimit(const CanRateLimit &limit);
+
+		/**
+		 * @brief Get the rate limit of the current session.
+		 * @return Rate limit as requested.
+		 */
+		static const CanRateLimit &
+		getRateLimit();
+
+		/**
+		 * @brief Get the current rate of update frames, below the limit while adaptive mode backs off.
+		 * @return Update frames per second, 0 if unlimited.
+		 */
+		static uint16_t
+		getRate();
+
+		/**
+		 * @brief Take tokens for update frames and, in adaptive mode, adjust the rate to the bus conditions.
+		 * @note Must only be called from the event loop.
+		 * @param frames Number of update frames, at most the burst of the limit.
+		 * @return Whether or not the frames may be received or sent now.
+		 */
+		static bool
+		acquire(uint8_t frames = 1);
+
+		/**
+		 * @brief Get the time until acquire() succeeds, e.g. for EventLoop::postAfter().
+		 * @param frames Number of update frames, at most the burst of the limit.
+		 * @return Core cycles until the tokens are available.
+		 */
+		static uint32_t
+		getAcquireDelay(uint8_t frames = 1);
+
+		/**
+		 * @brief Apply a rate limit request.
+		 * @param frame Received frame.
+		 * @return Whether or not the frame was a rate limit request.
+		 */
+		static bool
+		handleRateLimitRequest(const CanFrame &frame);
+
+		/**
+		 * @brief Send the rate limit and the current rate to the host.
+		 * @note Not rate limited itself.
+		 * @return Whether or not a transmit mailbox was free.
+		 */
+		static bool
+		reportRateLimit();
+
+		/**
+		 * @brief Get the number of frames lost because a FIFO or the queue was full.
+		 * @return Number of lost frames.
+		 */
+		static uint32_t
+		getOverruns();
+
+		/**
+		 * @brief Move all frames of a receive FIFO to the queue.
+		 * @note Should be called from the USB_LP_CAN1_RX0 (FIFO0) and CAN1_RX1 (FIFO1) interrupts, which must
+		 *       have the same priority.
+		 * @param fifo Receive FIFO, 0 or 1.
+		 */
+		static void
+		handleInterrupt(uint8_t fifo);
+
+		/**
+		 * @brief Count a bus error.
+		 * @note Should be called from the CAN1_SCE interrupt.
+		 */
+		static void
+		handleErrorInterrupt();
+
+	private:
+		/**
+		 * @brief Accept the request identifiers of this node into FIFO0 and of the broadcast node into FIFO1.
+		 */
+		static void
+		configureFilters();
+
+		/**
+		 * @brief Copy the output mailbox of a receive FIFO and release it.
+		 * @note The FIFO must hold a frame.
+		 * @param fifo Receive FIFO, 0 or 1.
+		 * @param frame Frame that will contain the received frame.
+		 */
+		static void
+		read(uint8_t fifo, CanFrame &frame);
+
+		/**
+		 * @brief Halve or raise the adaptive rate once per period, depending on the events of the period.
+		 */
+		static void
+		adapt();
+
+		static SpscQueue<CanFrame, OSSHS_CAN_QUEUE_SIZE> queue;
+		static uint32_t overruns;
+		static uint8_t nodeId;
+		static uint8_t task;
+
+		static TokenBucket bucket;
+		static CanRateLimit limit;
+		static std::atomic<uint32_t> errors;  ///< Bus errors since the start of the period
+		static uint32_t period;               ///< Cycle counter at the start of the period
+		static uint8_t events;                ///< Bus errors and lost arbitrations of the last period
+		static uint32_t background;           ///< CAN_TSR_ALSTx of mailboxes holding background frames
+	};
+}
+
+#endif  // OSSHS_CAN_BUS_HPP
@@ -0,0 +1,119 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef OSSHS_CONTAINER_HPP
+#define OSSHS_CONTAINER_HPP
+
+#include <cstdint>
+
+#define OSSHS_CONTAINER_MAGIC   0x4e4f434f
+#define OSSHS_CONTAINER_VERSION 1
+
+#define OSSHS_ENVELOPE_MAGIC 0x434e454f
+
+// Flags of a page record
+#define OSSHS_CONTAINER_FLAG_BLANK      0x0001
+#define OSSHS_CONTAINER_FLAG_COMPRESSED 0x0002
+
+namespace osshs
+{
+	/**
+	 * Firmware container header, followed by recordCount page records. Packed by tools/osshs-pack.py, all values
+	 * are little endian:
+	 *
+	 *   offset  size  field
+	 *   0x00    4     magic         OSSHS_CONTAINER_MAGIC ("OCON")
+	 *   0x04    2     version       OSSHS_CONTAINER_VERSION
+	 *   0x06    2     size          sizeof(ContainerHeader)
+	 *   0x08    2     pageSize      Flash page size the container was packed for
+	 *   0x0a    2     recordCount   Number of page records
+	 *   0x0c    4     origin        Address of the first page, a page origin
+	 *   0x10    4     imageLength   Number of bytes in use from the origin, a multiple of 4
+	 *   0x14    4     imageVersion  Version number from the application manifest, 0 without one
+	 *   0x18    4     imageCrc      CRC-32 (as calculated by Flash) of the first imageLength bytes
+	 *   0x1c    4     dataLength    Number of bytes of records and payload behind the header
+	 *
+	 * The CRC as calculated by Flash, with reflected input and result and the final XOR, is the common CRC-32 of
+	 * zlib and Ethernet over the bytes in memory order.
+	 */
+	struct ContainerHeader
+	{
+		uint32_t magic;
+		uint16_t version;
+		uint16_t size;
+		uint16_t pageSize;
+		uint16_t recordCount;
+		uint32_t origin;
+		uint32_t imageLength;
+		uint32_t imageVersion;
+		uint32_t imageCrc;
+		uint32_t dataLength;
+	};
+
+	/**
+	 * Page record, followed by length bytes of payload. Records are sorted by address and cover every page from
+	 * the origin up to the end of the image:
+	 *
+	 *   offset  size  field
+	 *   0x00    4     address  Origin address of the page
+	 *   0x04    4     crc      CRC of the whole page as calculated by Flash::calculatePageCRC(), the remainder of
+	 *                          the last page is 0xff
+	 *   0x08    2     flags    OSSHS_CONTAINER_FLAG_*
+	 *   0x0a    2     length   Bytes of payload: 0 for blank pages, pageSize for plain pages and less than
+	 *                          pageSize for compressed pages
+	 *
+	 * Compressed payload is PackBits: a control byte n below 0x80 is followed by n + 1 literal bytes, a control byte
+	 * above 0x80 by one byte repeated 257 - n times. 0x80 is not used.
+	 */
+	struct ContainerRecord
+	{
+		uint32_t address;
+		uint32_t crc;
+		uint16_t flags;
+		uint16_t length;
+	};
+
+	/**
+	 * Envelope of an encrypted container, as written by tools/osshs-pack.py --key. The host does not send it, it
+	 * holds what BEGIN needs for a container whose header it cannot read:
+	 *
+	 *   offset  size  field
+	 *   0x00    4     magic    OSSHS_ENVELOPE_MAGIC ("OENC")
+	 *   0x04    4     origin   Origin of the image, the address of BEGIN
+	 *   0x08    16    counter  Initial counter block of AES-128-CTR, the counter of BEGIN
+	 *
+	 * The container follows encrypted as a whole, the length of BEGIN is the rest of the file.
+	 */
+	struct ContainerEnvelope
+	{
+		uint32_t magic;
+		uint32_t origin;
+		uint8_t counter[16];
+	};
+
+	static_assert(sizeof(ContainerHeader) == 32, "ContainerHeader layout must not change.");
+	static_assert(sizeof(ContainerRecord) == 12, "ContainerRecord layout must not change.");
+	static_assert(sizeof(ContainerEnvelope) == 24, "ContainerEnvelope layout must not change.");
+}
+
+#endif  // OSSHS_CONTAINER_HPP
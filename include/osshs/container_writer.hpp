@@ -0,0 +1,162 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef OSSHS_CONTAINER_WRITER_HPP
+#define OSSHS_CONTAINER_WRITER_HPP
+
+#include <osshs/container.hpp>
+#include <osshs/crypto/sha256.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace osshs
+{
+	/**
+	 * Writes a firmware container (see container.hpp) to flash record by record while computing the SHA-256 digest
+	 * of the container.
+	 *
+	 * The header announces every page before its data arrives. Pages whose CRC in flash already matches their
+	 * record are neither erased nor written, blank pages are only erased and every page written is checked against
+	 * its CRC right away, so a bad page fails the update before the next one is touched.
+	 */
+	class ContainerWriter
+	{
+	public:
+		/**
+		 * @brief Start writing a container.
+		 * @param address Origin address of the image in the container, must be page aligned.
+		 * @param length Length of the container in bytes.
+		 * @return Whether or not starting succeeded.
+		 */
+		static bool
+		begin(uint32_t address, uint32_t length);
+
+		/**
+		 * @brief Write the next chunk of the container.
+		 * @note Chunks may be of any size. A page is committed to flash as soon as its record is complete.
+		 * @param data Data to write.
+		 * @param length Length of the data in bytes.
+		 * @return Whether or not writing succeeded.
+		 */
+		static bool
+		write(const uint8_t *data, std::size_t length);
+
+		/**
+		 * @brief Check the whole image and finish the digest.
+		 * @param digest Buffer of OSSHS_SHA256_DIGEST_SIZE bytes that will contain the digest of the container.
+		 * @return Whether or not all records were written and the image matches the CRC of the header.
+		 */
+		static bool
+		finish(uint8_t *digest);
+
+		/**
+		 * @brief Abort writing a container.
+		 * @note Pages already committed stay in flash.
+		 */
+		static void
+		abort();
+
+		/**
+		 * @brief Get the number of container bytes written so far.
+		 * @return Number of bytes written.
+		 */
+		static uint32_t
+		getWritten();
+
+	private:
+		enum class State : uint8_t
+		{
+			HEADER,
+			RECORD,
+			PAYLOAD,
+			DONE
+		};
+
+		/**
+		 * @brief Check the header collected in the staging buffer.
+		 * @return Whether or not the header is valid for this device.
+		 */
+		static bool
+		parseHeader();
+
+		/**
+		 * @brief Check the record collected in the staging buffer.
+		 * @return Whether or not the record is the next one expected.
+		 */
+		static bool
+		parseRecord();
+
+		/**
+		 * @brief Decode one byte of compressed payload into the page buffer.
+		 * @param data Byte of payload.
+		 * @return Whether or not the payload still fits the page.
+		 */
+		static bool
+		decode(uint8_t data);
+
+		/**
+		 * @brief Skip, erase or write the page of the current record and check its CRC.
+		 * @return Whether or not the page in flash matches the record.
+		 */
+		static bool
+		commitRecord();
+
+		/**
+		 * @brief Calculate the CRC of a page as Flash::calculatePageCRC() does.
+		 * @param address Origin address of the page.
+		 * @return Calculated CRC.
+		 */
+		static uint32_t
+		getPageCrc(uint32_t address);
+
+		static std::unique_ptr<uint8_t[]> page;
+		static crypto::Sha256 digest;
+		static State state;
+
+		static ContainerHeader header;
+		static ContainerRecord record;
+
+		// Header and records are collected here when they are split across chunks
+		static uint8_t staging[sizeof(ContainerHeader)];
+		static uint8_t staged;
+
+		static uint32_t origin;
+		static uint32_t length;
+		static uint32_t written;
+		static uint16_t records;
+		static uint16_t remaining;
+		static uint16_t filled;
+
+		// PackBits state, count bytes are still due from the current control byte
+		static uint8_t count;
+		static bool repeat;
+
+		static uint16_t skipped;
+		static uint16_t erased;
+		static uint16_t programmed;
+		static uint32_t flashCycles;
+	};
+}
+
+#endif  // OSSHS_CONTAINER_WRITER_HPP
@@ -0,0 +1,106 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef OSSHS_CRYPTO_AES128_CTR_HPP
+#define OSSHS_CRYPTO_AES128_CTR_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#define OSSHS_AES128_KEY_SIZE   16
+#define OSSHS_AES128_BLOCK_SIZE 16
+
+namespace osshs
+{
+	namespace crypto
+	{
+		/**
+		 * AES-128 in counter mode (NIST SP 800-38A), which only needs the forward cipher.
+		 *
+		 * The counter block is the initial counter block with its last 4 bytes incremented as a big endian number
+		 * for every block of the stream, so any byte of the stream is decrypted without those before it.
+		 *
+		 * Rounds use one table of 256 words that combines SubBytes and MixColumns, the other three tables are its
+		 * rotations, which the Cortex-M3 applies for free to the operand of an EOR. The table is built in RAM on
+		 * first use: the Cortex-M3 has no data cache and SRAM answers every load in the same time, so neither the
+		 * lookups nor the code, which has no branches on data, depend on key or data in their timing. Flash would
+		 * add wait states depending on the prefetch buffer.
+		 */
+		class Aes128Ctr
+		{
+		public:
+			/**
+			 * @brief Set the key and the initial counter block of a stream.
+			 * @param key OSSHS_AES128_KEY_SIZE bytes of key.
+			 * @param counter OSSHS_AES128_BLOCK_SIZE bytes of initial counter block.
+			 */
+			void
+			begin(const uint8_t *key, const uint8_t *counter);
+
+			/**
+			 * @brief Encrypt or decrypt data in place.
+			 * @note Data may be applied in chunks of any size and order, a block split across chunks is only
+			 *       encrypted once if its chunks follow each other.
+			 * @param data Data to encrypt or decrypt.
+			 * @param length Length of the data in bytes.
+			 * @param offset Position of the data in the stream in bytes.
+			 */
+			void
+			apply(uint8_t *data, std::size_t length, uint32_t offset);
+
+			/**
+			 * @brief Overwrite the key schedule and the keystream.
+			 * @note begin() must be called before the object is used again.
+			 */
+			void
+			clear();
+
+		private:
+			/**
+			 * @brief Build the round table in RAM, once.
+			 */
+			static void
+			initializeTable();
+
+			/**
+			 * @brief Encrypt the counter block of a block of the stream into the keystream buffer.
+			 * @param block Block number within the stream.
+			 */
+			void
+			encryptCounter(uint32_t block);
+
+			static uint32_t table[256];
+			static bool tableReady;
+
+			uint32_t roundKeys[44];
+			uint32_t counter[4];
+			uint32_t keystream[4];
+			uint32_t keystreamBlock;
+			bool keystreamValid;
+		};
+	}
+}
+
+#endif  // OSSHS_CRYPTO_AES128_CTR_HPP
@@ -0,0 +1,57 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_CRYPTO_ED25519_HPP
+#define OSSHS_CRYPTO_ED25519_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#define OSSHS_ED25519_PUBLIC_KEY_SIZE 32
+#define OSSHS_ED25519_SIGNATURE_SIZE  64
+
+namespace osshs
+{
+	namespace crypto
+	{
+		class Ed25519
+		{
+		public:
+			/**
+			 * @brief Verify an Ed25519 signature as specified by RFC 8032.
+			 * @note Uses no heap, no recursion and no precomputed tables, so its stack usage is fixed. Runs in
+			 *       variable time, which is fine since everything involved is public.
+			 * @param signature OSSHS_ED25519_SIGNATURE_SIZE bytes of signature.
+			 * @param publicKey OSSHS_ED25519_PUBLIC_KEY_SIZE bytes of public key.
+			 * @param message Signed message, may reside in flash.
+			 * @param length Length of the message in bytes.
+			 * @return Whether or not the signature is valid.
+			 */
+			static bool
+			verify(const uint8_t *signature, const uint8_t *publicKey, const uint8_t *message, std::size_t length);
+		};
+	}
+}
+
+#endif  // OSSHS_CRYPTO_ED25519_HPP
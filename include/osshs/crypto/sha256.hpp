@@ -0,0 +1,79 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_CRYPTO_SHA256_HPP
+#define OSSHS_CRYPTO_SHA256_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#define OSSHS_SHA256_BLOCK_SIZE  64
+#define OSSHS_SHA256_DIGEST_SIZE 32
+
+namespace osshs
+{
+	namespace crypto
+	{
+		class Sha256
+		{
+		public:
+			/**
+			 * @brief Start a new digest.
+			 */
+			void
+			reset();
+
+			/**
+			 * @brief Feed data into the digest.
+			 * @note Data may be fed in chunks of any size, the result is the same as for one contiguous chunk.
+			 * @param data Data to hash.
+			 * @param length Length of the data in bytes.
+			 */
+			void
+			update(const uint8_t *data, std::size_t length);
+
+			/**
+			 * @brief Finish the digest.
+			 * @note reset() must be called before the object is used again.
+			 * @param digest Buffer of OSSHS_SHA256_DIGEST_SIZE bytes that will contain the digest.
+			 */
+			void
+			finish(uint8_t *digest);
+
+		private:
+			/**
+			 * @brief Process one block of input.
+			 * @param block OSSHS_SHA256_BLOCK_SIZE bytes of input.
+			 */
+			void
+			compress(const uint8_t *block);
+
+			uint32_t state[8];
+			uint64_t length;
+			uint8_t buffer[OSSHS_SHA256_BLOCK_SIZE];
+		};
+	}
+}
+
+#endif  // OSSHS_CRYPTO_SHA256_HPP
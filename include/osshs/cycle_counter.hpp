@@ -0,0 +1,55 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_CYCLE_COUNTER_HPP
+#define OSSHS_CYCLE_COUNTER_HPP
+
+#include <cstdint>
+#include <modm/platform.hpp>
+
+namespace osshs
+{
+	class CycleCounter
+	{
+	public:
+		/**
+		 * @brief Enable and reset the DWT cycle counter.
+		 */
+		static void
+		initialize();
+
+		/**
+		 * @brief Get the number of core cycles since initialize() was called.
+		 * @note Wraps around after 2^32 cycles.
+		 * @return Current value of the cycle counter.
+		 */
+		static inline uint32_t
+		now()
+		{
+			return DWT->CYCCNT;
+		}
+	};
+}
+
+#endif  // OSSHS_CYCLE_COUNTER_HPP
@@ -0,0 +1,138 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_EVENT_LOOP_HPP
+#define OSSHS_EVENT_LOOP_HPP
+
+#include <atomic>
+#include <cstdint>
+
+#define OSSHS_EVENT_LOOP_MAX_TASKS    8
+#define OSSHS_EVENT_LOOP_INVALID_TASK 0xff
+
+namespace osshs
+{
+	using EventHandler = void (*)();
+
+	struct EventTaskStatistics
+	{
+		uint32_t runs;
+		uint32_t maxCycles;  ///< Longest run in core cycles
+	};
+
+	static_assert(OSSHS_EVENT_LOOP_MAX_TASKS <= 32, "Pending tasks are kept in a 32 bit mask.");
+
+	/**
+	 * Runs cooperative tasks posted by interrupts and sleeps with WFI while nothing is pending.
+	 *
+	 * Tasks run to completion in the order they were added, every pending task runs once per pass. A task
+	 * posted again while it is pending runs only once, so interrupts must keep their own data (e.g. in a queue).
+	 * The latency of a task is bounded by the sum of the longest runs of all tasks.
+	 *
+	 * Tasks can also be posted after a delay. The loop checks for due tasks whenever it wakes up, so the SysTick
+	 * interrupt, which wakes it every millisecond, bounds their lateness.
+	 */
+	class EventLoop
+	{
+	public:
+		/**
+		 * @brief Add a task.
+		 * @note Tasks added first run first.
+		 * @param name Name of the task, used for logging.
+		 * @param handler Function that does the work of the task.
+		 * @return Task id to post, OSSHS_EVENT_LOOP_INVALID_TASK if there are too many tasks.
+		 */
+		static uint8_t
+		addTask(const char *name, EventHandler handler);
+
+		/**
+		 * @brief Mark a task as pending.
+		 * @note Safe to call from interrupts.
+		 * @param task Task id returned by addTask().
+		 */
+		static inline void
+		post(uint8_t task)
+		{
+			pending.fetch_or(1ul << task, std::memory_order_release);
+		}
+
+		/**
+		 * @brief Mark a task as pending once a number of core cycles passed.
+		 * @note Must only be called from tasks. Replaces an earlier delayed post of the same task.
+		 * @param task Task id returned by addTask().
+		 * @param cycles Delay in core cycles, less than 2^31.
+		 */
+		static void
+		postAfter(uint8_t task, uint32_t cycles);
+
+		/**
+		 * @brief Run every pending task once.
+		 * @return Whether or not any task was pending.
+		 */
+		static bool
+		poll();
+
+		/**
+		 * @brief Run pending tasks forever and sleep until the next interrupt whenever none are pending.
+		 */
+		[[noreturn]] static void
+		run();
+
+		/**
+		 * @brief Get the statistics of a task.
+		 * @param task Task id returned by addTask().
+		 * @return Statistics of the task.
+		 */
+		static const EventTaskStatistics &
+		getStatistics(uint8_t task);
+
+	private:
+		struct Task
+		{
+			const char *name;
+			EventHandler handler;
+			EventTaskStatistics statistics;
+		};
+
+		/**
+		 * @brief Sleep until the next interrupt unless a task is pending.
+		 */
+		static void
+		sleep();
+
+		/**
+		 * @brief Mark delayed tasks whose deadline passed as pending.
+		 */
+		static void
+		releaseDelayed();
+
+		static std::atomic<uint32_t> pending;
+		static uint32_t delayed;
+		static uint32_t deadlines[OSSHS_EVENT_LOOP_MAX_TASKS];
+		static Task tasks[OSSHS_EVENT_LOOP_MAX_TASKS];
+		static uint8_t taskCount;
+	};
+}
+
+#endif  // OSSHS_EVENT_LOOP_HPP
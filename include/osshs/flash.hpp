@@ -27,23 +27,29 @@
 
 #include <cstdint>
 #include <memory>
+#include <osshs/memory_map.hpp>
 
 #define OSSHS_FLASH_KEY_RDPRT 0x00a5
 #define OSSHS_FLASH_KEY1 			0x45670123
 #define OSSHS_FLASH_KEY2 			0xcdef89ab
 
-#define OSSHS_FLASH_ORIGIN    0x08000000
-#define OSSHS_FLASH_PAGE_SIZE 0x0400
-
 #define OSSHS_FLASH_CRC_REFLECT_INPUT  true
 #define OSSHS_FLASH_CRC_REFLECT_RESULT true
 #define OSSHS_FLASH_CRC_FINAL_XOR      0xffffffff
 
 namespace osshs
 {
-	class Flash
+	/**
+	 * Flash interface of an STM32F1 device with the geometry of MEMORY_MAP.
+	 */
+	template<typename MEMORY_MAP>
+	class BasicFlash
 	{
 	public:
+		using MemoryMap = MEMORY_MAP;
+
+		static constexpr uint32_t pageSize = MEMORY_MAP::pageSize;
+
 		/**
 		 * @brief Initialize the flash.
 		 * @note This methods also tries to unlock the flash.
@@ -82,6 +88,25 @@ namespace osshs
 		static void
 		lock();
 
+		/**
+		 * @brief Check if flash is read protected.
+		 * @note Read protection is loaded from the option bytes at reset. It blocks reading flash through the debug
+		 *       interface and from code in RAM or system memory, code in flash reads it as usual.
+		 * @return Whether or not the RDP option byte was anything but OSSHS_FLASH_KEY_RDPRT at the last reset.
+		 */
+		static bool
+		isReadProtected();
+
+		/**
+		 * @brief Enable read protection from the next reset on.
+		 * @note Flash must be unlocked. The option bytes are erased, which leaves RDP at 0xff, and the user, data and
+		 *       write protection bytes are programmed back as they were loaded. Programming OSSHS_FLASH_KEY_RDPRT into
+		 *       RDP removes the protection again and mass erases flash, which is left to a debugger.
+		 * @return Whether or not the option bytes were programmed.
+		 */
+		static bool
+		enableReadProtection();
+
 		/**
 		 * @brief Read a value from flash.
 		 * @param address Address where the value should be read from.
@@ -109,9 +134,18 @@ namespace osshs
 		static bool
 		erasePage(uint32_t address);
 
+		/**
+		 * @brief Check if a page is erased.
+		 * @note Cheaper than an erase, which costs about 20ms and part of the endurance of the page.
+		 * @param address Origin address of any page.
+		 * @return Whether or not every half word of the page reads 0xffff.
+		 */
+		static bool
+		isPageErased(uint32_t address);
+
 		/**
 		 * @brief Read a whole page from flash.
-		 * @note The size of the buffer provided must be OSSHS_FLASH_PAGE_SIZE.
+		 * @note The size of the buffer provided must be pageSize.
 		 * @param address Origin address of any page.
 		 * @param buffer A std::unique_ptr<uint8_t[]> to a buffer that will contain the page read. 
 		 * @return Whether or not reading succeeded.
@@ -121,7 +155,7 @@ namespace osshs
 
 		/**
 		 * @brief Erase and write a whole page to flash.
-		 * @note The size of the buffer provided must be OSSHS_FLASH_PAGE_SIZE.
+		 * @note The size of the buffer provided must be pageSize. Half words of 0xffff are left erased and not programmed.
 		 * @param address Origin address of any page.
 		 * @param buffer A std::unique_ptr<uint8_t[]> to a buffer that contains the page to be written.
 		 * @return Whether or not writing succeeded.
@@ -138,7 +172,31 @@ namespace osshs
 		static bool
 		calculatePageCRC(uint32_t address, std::unique_ptr<uint32_t> &crc);
 
-	private:
+		/**
+		 * @brief Start a new CRC calculation.
+		 * @note The CRC peripheral clock must be enabled.
+		 */
+		static void
+		resetCRC();
+
+		/**
+		 * @brief Feed a range of memory into the current CRC calculation.
+		 * @note Ranges may be fed in several calls, the result is the same as for one contiguous range.
+		 * @param address Origin address of the range, must be word aligned.
+		 * @param length Length of the range in bytes, must be a multiple of 4.
+		 * @return Whether or not updating CRC succeeded.
+		 */
+		static bool
+		updateCRC(uint32_t address, uint32_t length);
+
+		/**
+		 * @brief Get the result of the current CRC calculation.
+		 * @note Reflection and final XOR are applied as for calculatePageCRC().
+		 * @return Calculated CRC.
+		 */
+		static uint32_t
+		getCRC();
+
 		/**
 		 * @brief Reverse the order of bits of a word.
 		 * @param value Original value.
@@ -147,6 +205,10 @@ namespace osshs
 		static uint32_t
 		reflectWord(uint32_t value);
 	};
+
+	using Flash = BasicFlash<TargetMemoryMap>;
 }
 
+#include <osshs/flash_impl.hpp>
+
 #endif  // OSSHS_FLASH_HPP
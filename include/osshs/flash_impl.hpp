@@ -0,0 +1,484 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_FLASH_HPP
+	#error "Don't include this file directly, use 'flash.hpp' instead!"
+#endif
+
+#include <osshs/log/logger.hpp>
+#include <osshs/trace.hpp>
+#include <osshs/verification_cache.hpp>
+#include <osshs/wear_journal.hpp>
+#include <modm/platform.hpp>
+
+namespace osshs
+{
+	template<typename MEMORY_MAP>
+	bool
+	BasicFlash<MEMORY_MAP>::initialize()
+	{
+		// Enable CRC peripheral clock
+		RCC->AHBENR |= RCC_AHBENR_CRCEN;
+
+		// Unlock flash if locked
+		if (isLocked() && !unlock())
+		{
+			OSSHS_LOG_ERROR("Initializing flash failed. Could not unlock flash.");
+			return false;
+		}
+
+		OSSHS_LOG_INFO("Initializing flash succeeded.");
+		return true;
+	}
+
+	template<typename MEMORY_MAP>
+	void
+	BasicFlash<MEMORY_MAP>::deinitialize()
+	{
+		// Flash is still unlocked, the counts of this session go to the journal
+		WearJournal::flush();
+
+		// Disable CRC peripheral clock
+		RCC->AHBENR &= ~RCC_AHBENR_CRCEN;
+
+		OSSHS_LOG_INFO("Deinitializing flash succeeded.");
+	}
+
+	template<typename MEMORY_MAP>
+	bool
+	BasicFlash<MEMORY_MAP>::isLocked()
+	{
+		return FLASH->CR & FLASH_CR_LOCK;
+	}
+
+	template<typename MEMORY_MAP>
+	bool
+	BasicFlash<MEMORY_MAP>::unlock()
+	{
+		// Unlock flash
+		FLASH->KEYR = OSSHS_FLASH_KEY1;
+		FLASH->KEYR = OSSHS_FLASH_KEY2;
+
+		// Verify that flash was unlocked
+		if (isLocked())
+		{
+			OSSHS_LOG_ERROR("Unlocking flash failed.");
+			return false;
+		}
+
+		OSSHS_LOG_INFO("Unlocking flash succeeded.");
+		return true;
+	}
+
+	template<typename MEMORY_MAP>
+	void
+	BasicFlash<MEMORY_MAP>::lock()
+	{
+		// Lock flash
+		FLASH->CR |= FLASH_CR_LOCK;
+
+		OSSHS_LOG_INFO("Locking flash succeeded.");
+	}
+
+	template<typename MEMORY_MAP>
+	bool
+	BasicFlash<MEMORY_MAP>::isReadProtected()
+	{
+		return FLASH->OBR & FLASH_OBR_RDPRT;
+	}
+
+	template<typename MEMORY_MAP>
+	bool
+	BasicFlash<MEMORY_MAP>::enableReadProtection()
+	{
+		// Loaded values, erasing the option bytes sets all of them to 0xff
+		uint32_t options = FLASH->OBR;
+		uint32_t writeProtection = FLASH->WRPR;
+
+		// Wait until flash is not busy
+		while(FLASH->SR & FLASH_SR_BSY);
+
+		// Unlock the option bytes
+		FLASH->OPTKEYR = OSSHS_FLASH_KEY1;
+		FLASH->OPTKEYR = OSSHS_FLASH_KEY2;
+
+		if (!(FLASH->CR & FLASH_CR_OPTWRE))
+		{
+			OSSHS_LOG_ERROR("Enabling read protection failed. Could not unlock the option bytes.");
+			return false;
+		}
+
+		// Erase the option bytes, RDP reads 0xff afterwards
+		FLASH->CR |= FLASH_CR_OPTER;
+		FLASH->CR |= FLASH_CR_STRT;
+		while(FLASH->SR & FLASH_SR_BSY);
+		FLASH->CR &= ~FLASH_CR_OPTER;
+
+		// User bits 2 to 4 and the data bytes at 10 and 18 of OBR, one write protection byte per 8 bits of WRPR
+		const uint8_t values[] = {static_cast<uint8_t>(options >> 2 | 0xf8), static_cast<uint8_t>(options >> 10),
+			static_cast<uint8_t>(options >> 18), static_cast<uint8_t>(writeProtection),
+			static_cast<uint8_t>(writeProtection >> 8), static_cast<uint8_t>(writeProtection >> 16),
+			static_cast<uint8_t>(writeProtection >> 24)};
+		decltype(OB->USER) *bytes[] = {&OB->USER, &OB->Data0, &OB->Data1, &OB->WRP0, &OB->WRP1, &OB->WRP2, &OB->WRP3};
+
+		// Enable option byte programming, erased bytes are left as they are
+		FLASH->CR |= FLASH_CR_OPTPG;
+		for (uint8_t i = 0; i < sizeof(values); i++)
+		{
+			if (values[i] == 0xff)
+				continue;
+
+			*bytes[i] = values[i];
+			while(FLASH->SR & FLASH_SR_BSY);
+		}
+
+		// Disable option byte programming and lock the option bytes
+		FLASH->CR &= ~(FLASH_CR_OPTPG | FLASH_CR_OPTWRE);
+
+		if ((OB->RDP & 0xff) == OSSHS_FLASH_KEY_RDPRT)
+		{
+			OSSHS_LOG_ERROR("Enabling read protection failed. RDP still holds the RDPRT key.");
+			return false;
+		}
+
+		OSSHS_LOG_INFO("Enabling read protection succeeded, effective from the next reset(options = `0x%08x`, writeProtection = `0x%08x`).",
+			options, writeProtection);
+		return true;
+	}
+
+	template<typename MEMORY_MAP>
+	uint16_t
+	BasicFlash<MEMORY_MAP>::readHalfWord(uint32_t address)
+	{
+		if (address & 0b1)
+		{
+			OSSHS_LOG_ERROR("Reading half word from flash failed. Address not half word aligned(address = `0x%08x`).", address);
+			return false;
+		}
+
+		// Read from flash
+		uint16_t value = *reinterpret_cast<uint16_t *>(address);
+
+		OSSHS_LOG_DEBUG("Reading half word from flash succeeded(address = `0x%08x`, value = `0x%04x`).", address, value);
+		return value;
+	}
+
+	template<typename MEMORY_MAP>
+	bool
+	BasicFlash<MEMORY_MAP>::writeHalfWord(uint32_t address, uint16_t value)
+	{
+		if (address & 0b1)
+		{
+			OSSHS_LOG_ERROR("Writing half word to flash failed. Address not half word aligned(address = `0x%08x`, value = `0x%04x`).",
+				address, value);
+			return false;
+		}
+
+		// The verified image is about to change
+		VerificationCache::invalidate();
+
+		// Wait until flash is not busy
+		while(FLASH->SR & FLASH_SR_BSY);
+
+		// Enable flash programming
+		FLASH->CR |= FLASH_CR_PG;
+
+		// Write to flash
+		*reinterpret_cast<volatile uint16_t *>(address) = value;
+
+		// Wait until flash is not busy
+		while(FLASH->SR & FLASH_SR_BSY);
+
+		// Disable flash programming
+		FLASH->CR &= ~FLASH_CR_PG;
+
+		// Verify written value
+		if (*reinterpret_cast<volatile uint16_t *>(address) == value)
+		{
+			OSSHS_LOG_DEBUG("Writing half word to flash succeeded(address = `0x%08x`, value = `0x%04x`).", address, value);
+			return true;
+		}
+
+		OSSHS_LOG_ERROR("Writing half word to flash failed(address = `0x%08x`, value = `0x%04x`).", address, value);
+		return false;
+	}
+
+	template<typename MEMORY_MAP>
+	bool
+	BasicFlash<MEMORY_MAP>::erasePage(uint32_t address)
+	{
+		if (MEMORY_MAP::getPageOffset(address))
+		{
+			OSSHS_LOG_ERROR("Erasing flash page failed. Address not page aligned(address = `0x%08x`, page = `%d`).",
+				address, MEMORY_MAP::getPage(address));
+			return false;
+		}
+
+		// The verified image is about to change
+		VerificationCache::invalidate();
+
+		// Wait until flash is not busy
+		while(FLASH->SR & FLASH_SR_BSY);
+
+		// Enable page erasing
+		FLASH->CR |= FLASH_CR_PER;
+
+		// Specify which address to erase
+		FLASH->AR = address;
+
+		// Start erasing
+		FLASH->CR |= FLASH_CR_STRT;
+
+		// Wait until flash is not busy
+		while(FLASH->SR & FLASH_SR_BSY);
+
+		// Disable page erasing
+		FLASH->CR &= ~FLASH_CR_PER;
+
+		// A failed erase wears the page as well
+		WearJournal::record(MEMORY_MAP::getPage(address));
+
+		// Verify that the page was erased
+		if (!isPageErased(address))
+		{
+			Trace::record(TraceEvent::FLASH_ERASE, 1, MEMORY_MAP::getPage(address));
+
+			OSSHS_LOG_ERROR("Erasing flash page failed(address = `0x%08x`, page = `%d`).",
+				address, MEMORY_MAP::getPage(address));
+			return false;
+		}
+
+		Trace::record(TraceEvent::FLASH_ERASE, 0, MEMORY_MAP::getPage(address));
+
+		OSSHS_LOG_DEBUG("Erasing flash page succeeded(address = `0x%08x`, page = `%d`).",
+			address, MEMORY_MAP::getPage(address));
+		return true;
+	}
+
+	template<typename MEMORY_MAP>
+	bool
+	BasicFlash<MEMORY_MAP>::isPageErased(uint32_t address)
+	{
+		// Whole words, the flash interface reads them as fast as half words
+		for (uint32_t i = address; i < address + pageSize; i += 4)
+			if (*reinterpret_cast<volatile uint32_t *>(i) != 0xffffffff)
+				return false;
+
+		return true;
+	}
+
+	template<typename MEMORY_MAP>
+	bool
+	BasicFlash<MEMORY_MAP>::readPage(uint32_t address, std::unique_ptr<uint8_t[]> &buffer)
+	{
+		if (MEMORY_MAP::getPageOffset(address))
+		{
+			OSSHS_LOG_ERROR("Reading flash page failed. Address not page aligned(address = `0x%08x`, page = `%d`).",
+				address, MEMORY_MAP::getPage(address));
+			return false;
+		}
+
+		// Read a whole page from flash
+		for (uint32_t i = 0; i < pageSize; i += 2)
+		{
+			// Read a value from flash
+			uint16_t value = *reinterpret_cast<uint16_t *>(address + i);
+
+			// Little endian is the default memory format for ARM processors
+			buffer[i + 0] = value & 0xff;
+			buffer[i + 1] = value >> 8;
+		}
+
+		OSSHS_LOG_DEBUG("Reading flash page succeeded(address = `0x%08x`, page = `%d`).",
+			address, MEMORY_MAP::getPage(address));
+		return true;
+	}
+
+	template<typename MEMORY_MAP>
+	bool
+	BasicFlash<MEMORY_MAP>::writePage(uint32_t address, std::unique_ptr<uint8_t[]> &buffer)
+	{
+		if (MEMORY_MAP::getPageOffset(address))
+		{
+			OSSHS_LOG_ERROR("Writing flash page failed. Address not page aligned(address = `0x%08x`, page = `%d`).",
+				address, MEMORY_MAP::getPage(address));
+			return false;
+		}
+
+		if (!erasePage(address))
+		{
+			OSSHS_LOG_ERROR("Writing flash page failed. Page was not erased(address = `0x%08x`, page = `%d`).",
+				address, MEMORY_MAP::getPage(address));
+			return false;
+		}
+
+		// Enable flash programming
+		FLASH->CR |= FLASH_CR_PG;
+
+		// Wait until flash is not busy
+		while(FLASH->SR & FLASH_SR_BSY);
+
+		// Write a whole page to flash
+		for (uint32_t i = 0; i < pageSize; i += 2)
+		{
+			// Little endian is the default memory format for ARM processors
+			uint16_t value = buffer[i] | (buffer[i + 1] << 8);
+
+			// The page was just erased, programming 0xffff would only cost time
+			if (value == 0xffff)
+				continue;
+
+			// Write to flash
+			*reinterpret_cast<volatile uint16_t *>(address + i) = value;
+
+			// Wait until flash is not busy
+			while(FLASH->SR & FLASH_SR_BSY);
+
+			// Verify written value
+			if (*reinterpret_cast<volatile uint16_t *>(address + i) != value)
+			{
+				// Disable flash programming
+				FLASH->CR &= ~FLASH_CR_PG;
+
+				Trace::record(TraceEvent::FLASH_WRITE, 1, MEMORY_MAP::getPage(address));
+
+				OSSHS_LOG_ERROR("Writing flash page failed. Value could not be written(address = `0x%08x`, value = `0x%04x`).",
+					address + i, value);
+				return false;
+			}
+		}
+		
+		// Disable flash programming
+		FLASH->CR &= ~FLASH_CR_PG;
+
+		Trace::record(TraceEvent::FLASH_WRITE, 0, MEMORY_MAP::getPage(address));
+
+		OSSHS_LOG_DEBUG("Writing flash page succeeded(address = `0x%08x`, page = `%d`).",
+			address, MEMORY_MAP::getPage(address));
+		return true;
+	}
+
+	template<typename MEMORY_MAP>
+	bool
+	BasicFlash<MEMORY_MAP>::calculatePageCRC(uint32_t address, std::unique_ptr<uint32_t> &crc)
+	{
+		if (MEMORY_MAP::getPageOffset(address))
+		{
+			OSSHS_LOG_ERROR("Calculating flash page CRC failed. Address not page aligned(address = `0x%08x`, page = `%d`).",
+				address, MEMORY_MAP::getPage(address));
+			return false;
+		}
+
+		// Calculate CRC of a flash page
+		resetCRC();
+		updateCRC(address, pageSize);
+		*crc = getCRC();
+
+		OSSHS_LOG_DEBUG("Calculating flash page CRC succeeded(address = `0x%08x`, page = `%d`, crc = `0x%08x`).",
+			address, MEMORY_MAP::getPage(address), *crc);
+		return true;
+	}
+
+	template<typename MEMORY_MAP>
+	void
+	BasicFlash<MEMORY_MAP>::resetCRC()
+	{
+		// Reset CRC peripheral
+		CRC->CR |= CRC_CR_RESET;
+	}
+
+	template<typename MEMORY_MAP>
+	bool
+	BasicFlash<MEMORY_MAP>::updateCRC(uint32_t address, uint32_t length)
+	{
+		if ((address | length) & 0b11)
+		{
+			OSSHS_LOG_ERROR("Updating CRC failed. Range not word aligned(address = `0x%08x`, length = `0x%08x`).",
+				address, length);
+			return false;
+		}
+
+		for (uint32_t i = 0; i < length; i += 4)
+		{
+#if OSSHS_FLASH_CRC_REFLECT_INPUT
+			// Read a full word from flash
+			uint16_t majorHalfWord = *reinterpret_cast<uint16_t *>(address + i + 0);
+			uint16_t minorHalfWord = *reinterpret_cast<uint16_t *>(address + i + 2);
+
+			// Little endian is the default memory format for ARM processors
+			uint32_t value = reflectWord(majorHalfWord | (minorHalfWord << 16));
+#else
+			// Read a full word from flash
+			uint16_t majorHalfWord = *reinterpret_cast<uint16_t *>(address + i + 0);
+			uint16_t minorHalfWord = *reinterpret_cast<uint16_t *>(address + i + 2);
+
+			// Swap order of bytes in both half words
+			majorHalfWord = ((majorHalfWord & 0x00ff) << 8) |
+											((majorHalfWord & 0xff00) >> 8);
+
+			minorHalfWord = ((minorHalfWord & 0x00ff) << 8) |
+											((minorHalfWord & 0xff00) >> 8);
+
+			// Little endian is the default memory format for ARM processors
+			uint32_t value = minorHalfWord | (majorHalfWord << 16);
+#endif
+
+			// Calculate CRC of the full word
+			CRC->DR = value;
+		}
+
+		return true;
+	}
+
+	template<typename MEMORY_MAP>
+	uint32_t
+	BasicFlash<MEMORY_MAP>::getCRC()
+	{
+		// Retrieve calculated CRC from peripheral
+#if OSSHS_FLASH_CRC_REFLECT_RESULT
+		uint32_t crc = reflectWord(CRC->DR);
+#else
+		uint32_t crc = CRC->DR;
+#endif
+
+		// Apply final XOR value to CRC
+#if OSSHS_FLASH_CRC_FINAL_XOR != 0
+		crc ^= OSSHS_FLASH_CRC_FINAL_XOR;
+#endif
+
+		return crc;
+	}
+	
+	template<typename MEMORY_MAP>
+	uint32_t
+	BasicFlash<MEMORY_MAP>::reflectWord(uint32_t value)
+	{
+		value = ((value >>  1) & 0x55555555) | ((value <<  1) & 0xaaaaaaaa);
+		value = ((value >>  2) & 0x33333333) | ((value <<  2) & 0xcccccccc);
+		value = ((value >>  4) & 0x0f0f0f0f) | ((value <<  4) & 0xf0f0f0f0);
+		value = ((value >>  8) & 0x00ff00ff) | ((value <<  8) & 0xff00ff00);
+		value = ((value >> 16) & 0x0000ffff) | ((value << 16) & 0xffff0000);
+		return value;
+	}
+}
@@ -0,0 +1,90 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_HANDOFF_HPP
+#define OSSHS_HANDOFF_HPP
+
+#include <cstdint>
+#include <osshs/bootloader.hpp>
+
+#define OSSHS_HANDOFF_MAGIC   0x46464f48
+#define OSSHS_HANDOFF_VERSION 2
+
+#define OSSHS_HANDOFF_VERIFIED_CACHED    0x01
+#define OSSHS_HANDOFF_VERIFIED_SIGNATURE 0x02
+
+namespace osshs
+{
+	/**
+	 * Boot handoff record, located at OSSHS_BOOTLOADER_HANDOFF_ORIGIN (directly below the trace).
+	 *
+	 * The bootloader writes the record right before jumping to the application and invalidates it on every
+	 * start, so a valid record always describes the current boot. The clock configuration is left as is by
+	 * the bootloader, so the application may skip its own clock setup if it matches. Like the trace, the record
+	 * lies in the RAM that SConstruct.py leaves out of the bootloader's linker script, out of reach of the heap
+	 * and the stack. The application must not use this memory region and may parse it as follows:
+	 *
+	 *   offset  size  field
+	 *   0x00    4     magic             OSSHS_HANDOFF_MAGIC ("HOFF"), anything else means the record is invalid
+	 *   0x04    2     version           OSSHS_HANDOFF_VERSION
+	 *   0x06    2     size              sizeof(BootHandoff)
+	 *   0x08    4     coreFrequency     Core clock in Hz
+	 *   0x0c    4     rccCr             RCC_CR in effect (clock sources and PLL)
+	 *   0x10    4     rccCfgr           RCC_CFGR in effect (system clock source and bus prescalers)
+	 *   0x14    4     resetFlags        RCC_CSR of this boot, the flags are already cleared in RCC_CSR
+	 *   0x18    4     bootCycles        Core cycles from the bootloader start to the jump
+	 *   0x1c    4     validationCycles  Core cycles spent validating the application
+	 *   0x20    4     nodeId            OSSHS_BOOTLOADER_NODE_ID
+	 *   0x24    4     imageVersion      Version of the verified image, as given by its manifest
+	 *   0x28    4     imageLength       Length of the verified image, as given by its manifest
+	 *   0x2c    4     imageCrc          CRC of the verified image, as given by its manifest
+	 *   0x30    1     verification      OSSHS_HANDOFF_VERIFIED_* flags describing how the image was verified
+	 *   0x31    3     reserved          Always 0
+	 *   0x34    4     listenCycles      Core cycles spent listening for STAY requests after the validation (version 2)
+	 */
+	struct BootHandoff
+	{
+		uint32_t magic;
+		uint16_t version;
+		uint16_t size;
+		uint32_t coreFrequency;
+		uint32_t rccCr;
+		uint32_t rccCfgr;
+		uint32_t resetFlags;
+		uint32_t bootCycles;
+		uint32_t validationCycles;
+		uint32_t nodeId;
+		uint32_t imageVersion;
+		uint32_t imageLength;
+		uint32_t imageCrc;
+		uint8_t verification;
+		uint8_t reserved[3];
+		uint32_t listenCycles;
+	};
+
+	static_assert(sizeof(BootHandoff) == 0x38, "BootHandoff layout must only grow.");
+	static_assert(sizeof(BootHandoff) <= OSSHS_BOOTLOADER_HANDOFF_LENGTH, "BootHandoff does not fit its memory region.");
+}
+
+#endif  // OSSHS_HANDOFF_HPP
@@ -0,0 +1,132 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_IMAGE_WRITER_HPP
+#define OSSHS_IMAGE_WRITER_HPP
+
+#include <osshs/crypto/sha256.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace osshs
+{
+	enum class ImageWriterMode : uint8_t
+	{
+		STREAM,    ///< Hash data as it arrives, before it is committed to flash
+		READ_BACK  ///< Additionally hash flash after every commit and compare both digests when finishing
+	};
+
+	/**
+	 * Writes an image to flash page by page while computing its SHA-256 digest.
+	 *
+	 * Data is hashed as it arrives, so the digest is ready as soon as the last byte is written and no
+	 * extra pass over flash is needed. Sparse images are written as extents with skip() over the erased gaps
+	 * between them.
+	 */
+	class ImageWriter
+	{
+	public:
+		/**
+		 * @brief Start writing an image.
+		 * @param address Origin address of the image, must be page aligned.
+		 * @param length Maximum length of the image in bytes.
+		 * @param mode Whether or not to read back and hash flash after every commit.
+		 * @return Whether or not starting succeeded.
+		 */
+		static bool
+		begin(uint32_t address, uint32_t length, ImageWriterMode mode = ImageWriterMode::STREAM);
+
+		/**
+		 * @brief Write the next chunk of the image.
+		 * @note Chunks may be of any size. A page is committed to flash as soon as it is complete.
+		 * @param data Data to write.
+		 * @param length Length of the data in bytes.
+		 * @return Whether or not writing succeeded.
+		 */
+		static bool
+		write(const uint8_t *data, std::size_t length);
+
+		/**
+		 * @brief Leave the next bytes of the image erased.
+		 * @note The gap is part of the digest as 0xff bytes. Pages entirely within the gap are only erased, and only if
+		 *       they are not erased already, the gap is never programmed.
+		 * @param length Length of the gap in bytes.
+		 * @return Whether or not skipping succeeded.
+		 */
+		static bool
+		skip(uint32_t length);
+
+		/**
+		 * @brief Commit the last page and finish the digest.
+		 * @note The remainder of the last page is filled with 0xff, which is not part of the digest.
+		 * @param digest Buffer of OSSHS_SHA256_DIGEST_SIZE bytes that will contain the digest of the bytes written.
+		 * @return Whether or not all pages were committed and, in read back mode, flash matches the digest.
+		 */
+		static bool
+		finish(uint8_t *digest);
+
+		/**
+		 * @brief Abort writing an image.
+		 * @note Pages already committed stay in flash.
+		 */
+		static void
+		abort();
+
+		/**
+		 * @brief Get the number of bytes written so far.
+		 * @return Number of bytes written.
+		 */
+		static uint32_t
+		getWritten();
+
+	private:
+		/**
+		 * @brief Commit the buffered page to flash.
+		 * @return Whether or not committing succeeded.
+		 */
+		static bool
+		commitPage();
+
+		/**
+		 * @brief Leave the next whole page erased, without going through the page buffer.
+		 * @return Whether or not the page is erased.
+		 */
+		static bool
+		skipPage();
+
+		static std::unique_ptr<uint8_t[]> page;
+		static crypto::Sha256 digest;
+		static crypto::Sha256 readBackDigest;
+		static ImageWriterMode mode;
+
+		static uint32_t origin;
+		static uint32_t length;
+		static uint32_t written;
+		static uint32_t hashCycles;
+		static uint32_t flashCycles;
+	};
+}
+
+#endif  // OSSHS_IMAGE_WRITER_HPP
@@ -0,0 +1,96 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef OSSHS_KEY_STORE_HPP
+#define OSSHS_KEY_STORE_HPP
+
+#include <cstdint>
+#include <osshs/bootloader.hpp>
+#include <osshs/memory_map.hpp>
+
+#define OSSHS_KEY_STORE_MAGIC   0x594b
+#define OSSHS_KEY_STORE_VERSION 1
+
+#define OSSHS_KEY_STORE_KEY_OFFSET 0x04
+#define OSSHS_KEY_STORE_CRC_OFFSET 0x14
+
+// Enable read protection once a key is found, 0 leaves development boards open to the debugger
+#ifndef OSSHS_KEY_STORE_PROTECT
+#define OSSHS_KEY_STORE_PROTECT 1
+#endif
+
+namespace osshs
+{
+	/**
+	 * Key of encrypted images, kept in the last page of the bootloader region:
+	 *
+	 *   offset  size  field
+	 *   0x00    2     magic    OSSHS_KEY_STORE_MAGIC ("KY")
+	 *   0x02    2     version  OSSHS_KEY_STORE_VERSION
+	 *   0x04    16    key      AES-128 key
+	 *   0x14    4     crc      CRC-32 (as calculated by Flash) of the bytes before it
+	 *
+	 * The page is flashed next to the bootloader, e.g. as written by tools/osshs-pack.py --key-page, and never
+	 * written by the bootloader. READ and HASH refuse it. STM32F1 devices only read protect flash as a whole, so
+	 * once a key is found initialize() enables read protection through the option bytes and the key can no longer
+	 * be read through the debug interface from the next reset on. Code in flash, the application included, still
+	 * reads it.
+	 */
+	class KeyStore
+	{
+	public:
+		/**
+		 * @brief Check the key page and enable read protection if it holds a key.
+		 * @note Read protection is only enabled with OSSHS_KEY_STORE_PROTECT and only if it is not already active.
+		 */
+		static void
+		initialize();
+
+		/**
+		 * @brief Get the key.
+		 * @return OSSHS_AES128_KEY_SIZE bytes of key in flash, nullptr if the key page holds no valid key.
+		 */
+		static const uint8_t *
+		getKey();
+
+		/**
+		 * @brief Check if a range of flash touches the key page.
+		 * @param address Origin address of the range.
+		 * @param end Address behind the range.
+		 * @return Whether or not the range must not be read back, always false without OSSHS_BOOTLOADER_DECRYPT.
+		 */
+		static constexpr bool
+		overlaps(uint32_t address, uint32_t end)
+		{
+			return OSSHS_BOOTLOADER_DECRYPT && address < TargetMemoryMap::keyOrigin + TargetMemoryMap::keySize &&
+				end > TargetMemoryMap::keyOrigin;
+		}
+
+	private:
+		static bool valid;
+	};
+}
+
+#endif  // OSSHS_KEY_STORE_HPP
@@ -0,0 +1,173 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef OSSHS_CAN_LOG_SINK_HPP
+#define OSSHS_CAN_LOG_SINK_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <osshs/spsc_queue.hpp>
+#include <osshs/token_bucket.hpp>
+#include <osshs/log/level.hpp>
+
+// Log records on CAN, also without text output (DISABLE_LOGGING), see CanLogSink
+#ifndef OSSHS_CAN_LOG
+#define OSSHS_CAN_LOG 0
+#endif
+
+// Messages above this level are not sent
+#ifndef OSSHS_CAN_LOG_LEVEL
+#define OSSHS_CAN_LOG_LEVEL osshs::log::Level::INFO
+#endif
+
+// Log frames per second and in a burst, 20 frames/s are about 2% of a 125 kbps bus
+#ifndef OSSHS_CAN_LOG_RATE
+#define OSSHS_CAN_LOG_RATE 20
+#endif
+#ifndef OSSHS_CAN_LOG_BURST
+#define OSSHS_CAN_LOG_BURST 4
+#endif
+
+#define OSSHS_CAN_LOG_BUFFER_SIZE 256
+#define OSSHS_CAN_LOG_RECORD_SIZE 64
+#define OSSHS_CAN_LOG_HEADER_SIZE 14
+#define OSSHS_CAN_LOG_STRING_MAX  24
+
+// First frame of a record, (0x80 | sequence, length, record...), other frames (sequence, record...)
+#define OSSHS_CAN_LOG_FIRST 0x80
+
+namespace osshs
+{
+	namespace log
+	{
+		/**
+		 * Sends log messages as compact binary records in frames of OSSHS_CAN_LOG_ID(node), for nodes without
+		 * a serial connection.
+		 *
+		 * Records are little endian and hold addresses of the strings in flash instead of the strings, which
+		 * the host collector (tools/osshs-logcat.py) looks up in the ELF file of the bootloader:
+		 *
+		 *   offset  size  field
+		 *   0x00    4     time    Milliseconds since boot
+		 *   0x04    2     line    Level << 13 | line
+		 *   0x06    4     file    Address of the file name
+		 *   0x0a    4     format  Address of the format string, 0 for a report of dropped records (count[4])
+		 *   0x0e    ...   args    Integers and pointers in 4 bytes (8 if 64 bit), strings up to
+		 *                         OSSHS_CAN_LOG_STRING_MAX characters and their terminating 0
+		 *
+		 * A record is split into a first frame (0x80 | sequence, length, 6 bytes) and frames of (sequence, 7 bytes).
+		 * The sequence counts frames modulo 128, so the collector can drop records with lost frames.
+		 *
+		 * Log frames have lower priority than all update frames and are paced by a token bucket of
+		 * OSSHS_CAN_LOG_RATE. They are only queued while all transmit mailboxes are empty, so update frames wait
+		 * behind at most one of them, see CanBus::sendBackground(). Records that do not fit the buffer are dropped
+		 * and reported. Records still buffered when the bootloader resets or loads the application are lost.
+		 */
+		class CanLogSink
+		{
+		public:
+			/**
+			 * @brief Start sending the buffered records.
+			 * @note CAN1 must already be initialized, see CanBus::initialize().
+			 * @param task Event loop task that calls update().
+			 */
+			static void
+			initialize(uint8_t task);
+
+			/**
+			 * @brief Buffer a log message as a record.
+			 * @note Should not be called directly, instead use the OSSHS_LOG_* macros. Must only be called from
+			 *       the same context as update().
+			 * @param level Level of the message, messages above OSSHS_CAN_LOG_LEVEL are ignored.
+			 * @param file File from which the message was logged, must be a string literal.
+			 * @param line Line from which the message was logged.
+			 * @param format Log message format, must be a string literal.
+			 * @param args Integers, enums, pointers and strings.
+			 */
+			template<typename... ARGS>
+			static void
+			log(Level level, const char *file, uint32_t line, const char *format, ARGS... args);
+
+			/**
+			 * @brief Send the next frame if the rate limit and the transmitter allow it.
+			 * @note Must only be called from the event loop, reposts its task until the buffer is empty.
+			 */
+			static void
+			update();
+
+			/**
+			 * @brief Get the number of records dropped because the buffer was full.
+			 * @return Number of dropped records.
+			 */
+			static uint32_t
+			getDroppedRecords();
+
+		private:
+			template<typename T>
+			static void
+			encode(uint8_t *record, std::size_t &length, T value);
+
+			static void
+			encodeInteger(uint8_t *record, std::size_t &length, uint64_t value, std::size_t size);
+
+			static void
+			encodeString(uint8_t *record, std::size_t &length, const char *string);
+
+			/**
+			 * @brief Write the header of a record.
+			 * @return Length of the header.
+			 */
+			static std::size_t
+			encodeHeader(uint8_t *record, Level level, const char *file, uint32_t line, const char *format);
+
+			/**
+			 * @brief Buffer a record whole, or drop it if it does not fit.
+			 */
+			static void
+			enqueue(const uint8_t *record, std::size_t length);
+
+			/**
+			 * @brief Take the bytes of the next frame from the buffer.
+			 * @return Whether or not there was a frame to send.
+			 */
+			static bool
+			fill();
+
+			static SpscQueue<uint8_t, OSSHS_CAN_LOG_BUFFER_SIZE> buffer;
+			static TokenBucket bucket;
+			static uint8_t frame[8];
+			static uint8_t frameLength;
+			static uint8_t remaining;  ///< Bytes of the current record not yet in a frame
+			static uint8_t sequence;
+			static uint8_t task;
+			static uint32_t dropped;
+			static uint32_t reported;
+		};
+	}
+}
+
+#include <osshs/log/can_log_sink_impl.hpp>
+
+#endif  // OSSHS_CAN_LOG_SINK_HPP
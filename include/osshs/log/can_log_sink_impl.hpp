@@ -0,0 +1,70 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef OSSHS_CAN_LOG_SINK_HPP
+	#error "Don't include this file directly, use 'can_log_sink.hpp' instead!"
+#endif
+
+#include <type_traits>
+
+namespace osshs
+{
+	namespace log
+	{
+		template<typename... ARGS>
+		void
+		CanLogSink::log(Level level, const char *file, uint32_t line, const char *format, ARGS... args)
+		{
+			if (level > OSSHS_CAN_LOG_LEVEL)
+				return;
+
+			uint8_t record[OSSHS_CAN_LOG_RECORD_SIZE];
+			std::size_t length = encodeHeader(record, level, file, line, format);
+			(encode(record, length, args), ...);
+
+			enqueue(record, length);
+		}
+
+		template<typename T>
+		void
+		CanLogSink::encode(uint8_t *record, std::size_t &length, T value)
+		{
+			if constexpr (std::is_same<T, const char *>::value || std::is_same<T, char *>::value)
+			{
+				encodeString(record, length, value);
+			}
+			else if constexpr (std::is_pointer<T>::value)
+			{
+				encodeInteger(record, length, reinterpret_cast<uintptr_t>(value), 4);
+			}
+			else
+			{
+				static_assert(std::is_integral<T>::value || std::is_enum<T>::value,
+					"Only integers, enums, pointers and strings can be logged.");
+				encodeInteger(record, length, static_cast<uint64_t>(value), sizeof(T) > 4 ? 8 : 4);
+			}
+		}
+	}
+}
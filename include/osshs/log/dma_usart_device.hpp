@@ -0,0 +1,195 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_DMA_USART_DEVICE_HPP
+#define OSSHS_DMA_USART_DEVICE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#define OSSHS_DMA_USART_DEVICE_TRANSFER_SIZE 64
+#define OSSHS_DMA_USART_DEVICE_INTERRUPT_PRIORITY 12
+
+namespace osshs
+{
+	namespace log
+	{
+		enum class OverflowPolicy : uint8_t
+		{
+			DROP_NEWEST,
+			DROP_OLDEST
+		};
+
+		/**
+		 * @brief Non-blocking USART1 transmitter backed by a lock-free ring buffer.
+		 * @note Bytes are drained by DMA1 channel 4. There must be a single producer, i.e. all writes must come
+		 *       from the same execution context. When the buffer is full whole messages (terminated by '\n') are
+		 *       dropped according to POLICY and the number of dropped messages is reported in the output stream
+		 *       at the start of the next message that fits.
+		 * @tparam BUFFER_SIZE Size of the ring buffer. Must be a power of two.
+		 * @tparam POLICY Which message to drop when the ring buffer is full.
+		 */
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		class DmaUsartDevice
+		{
+			static_assert(BUFFER_SIZE && !(BUFFER_SIZE & (BUFFER_SIZE - 1)), "BUFFER_SIZE must be a power of two.");
+
+		public:
+			/**
+			 * @brief Initialize the DMA channel.
+			 * @note USART1 must already be initialized.
+			 */
+			static void
+			initialize();
+
+			/**
+			 * @brief Wait until all buffered data is transmitted and deinitialize the DMA channel.
+			 */
+			static void
+			deinitialize();
+
+			/**
+			 * @brief Queue a single byte for transmission.
+			 * @note Never blocks. If the byte does not fit, a message is dropped according to POLICY.
+			 * @param data Byte to queue.
+			 * @return Always true, dropped bytes are accounted for by getDroppedMessages().
+			 */
+			static bool
+			write(uint8_t data);
+
+			/**
+			 * @brief Queue a block of bytes for transmission.
+			 * @note The block is either queued whole or not at all, regardless of POLICY. Leading bytes that belong
+			 *       to a message being dropped are discarded first, as by write(uint8_t).
+			 * @param data Bytes to queue.
+			 * @param length Number of bytes to queue.
+			 * @return Whether or not the block was queued.
+			 */
+			static bool
+			write(const uint8_t *data, std::size_t length);
+
+			/**
+			 * @brief Get the number of bytes that can currently be queued.
+			 * @return Free space in the ring buffer.
+			 */
+			static std::size_t
+			getFreeSpace();
+
+			/**
+			 * @brief Block until all queued data is transmitted.
+			 */
+			static void
+			flushWriteBuffer();
+
+			/**
+			 * @brief Check if all queued data was transmitted.
+			 * @return Whether or not the ring buffer is empty and no transfer is in progress.
+			 */
+			static bool
+			isWriteFinished();
+
+			/**
+			 * @brief Stop transmitting where the DMA is, without waiting for queued data.
+			 * @note For a transport that shares USART1 and must send a frame in one piece. Writes are still
+			 *       queued. The byte in the data register may still be sent.
+			 */
+			static void
+			pause();
+
+			/**
+			 * @brief Continue transmitting where pause() stopped.
+			 */
+			static void
+			resume();
+
+			/**
+			 * @brief Reading is not supported.
+			 * @return Always false.
+			 */
+			static bool
+			read(uint8_t &data);
+
+			/**
+			 * @brief Get the total number of messages dropped because the ring buffer was full.
+			 * @return Number of dropped messages.
+			 */
+			static uint32_t
+			getDroppedMessages();
+
+			/**
+			 * @brief Handle DMA transfer completion.
+			 * @note Should be called from the DMA1_Channel4 interrupt.
+			 */
+			static void
+			handleInterrupt();
+
+		private:
+			/**
+			 * @brief Copy the next chunk of the ring buffer to the transfer buffer and start a DMA transfer.
+			 * @note Must only be called when no transfer is in progress. Does nothing while paused.
+			 */
+			static void
+			startTransfer();
+
+			/**
+			 * @brief Drop the oldest queued message.
+			 * @return Whether or not a whole message could be dropped.
+			 */
+			static bool
+			dropOldest();
+
+			/**
+			 * @brief Queue a byte if there is space for it.
+			 * @return Whether or not the byte was queued.
+			 */
+			static bool
+			push(uint8_t data);
+
+			/**
+			 * @brief Queue a report of messages dropped since the last report.
+			 */
+			static void
+			reportDropped();
+
+			static uint8_t buffer[BUFFER_SIZE];
+			static uint8_t transfer[OSSHS_DMA_USART_DEVICE_TRANSFER_SIZE];
+
+			static std::atomic<uint32_t> head;
+			static std::atomic<uint32_t> tail;
+			static std::atomic<bool> transferring;
+			static std::atomic<bool> paused;
+			static uint32_t transferLength;  ///< Bytes of the transfer from CMAR on, resume() moves CMAR forward
+
+			static uint32_t dropped;
+			static uint32_t reported;
+			static bool discarding;
+			static bool lineStart;
+		};
+	}
+}
+
+#include <osshs/log/dma_usart_device_impl.hpp>
+
+#endif  // OSSHS_DMA_USART_DEVICE_HPP
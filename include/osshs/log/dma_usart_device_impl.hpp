@@ -0,0 +1,368 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_DMA_USART_DEVICE_HPP
+	#error "Don't include this file directly, use 'dma_usart_device.hpp' instead!"
+#endif
+
+#include <modm/platform.hpp>
+
+namespace osshs
+{
+	namespace log
+	{
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		uint8_t DmaUsartDevice<BUFFER_SIZE, POLICY>::buffer[BUFFER_SIZE];
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		uint8_t DmaUsartDevice<BUFFER_SIZE, POLICY>::transfer[OSSHS_DMA_USART_DEVICE_TRANSFER_SIZE];
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		std::atomic<uint32_t> DmaUsartDevice<BUFFER_SIZE, POLICY>::head{0};
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		std::atomic<uint32_t> DmaUsartDevice<BUFFER_SIZE, POLICY>::tail{0};
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		std::atomic<bool> DmaUsartDevice<BUFFER_SIZE, POLICY>::transferring{false};
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		std::atomic<bool> DmaUsartDevice<BUFFER_SIZE, POLICY>::paused{false};
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		uint32_t DmaUsartDevice<BUFFER_SIZE, POLICY>::transferLength = 0;
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		uint32_t DmaUsartDevice<BUFFER_SIZE, POLICY>::dropped = 0;
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		uint32_t DmaUsartDevice<BUFFER_SIZE, POLICY>::reported = 0;
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		bool DmaUsartDevice<BUFFER_SIZE, POLICY>::discarding = false;
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		bool DmaUsartDevice<BUFFER_SIZE, POLICY>::lineStart = true;
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		void
+		DmaUsartDevice<BUFFER_SIZE, POLICY>::initialize()
+		{
+			// Enable DMA1 peripheral clock
+			RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+
+			// Transfer bytes from memory to the USART1 data register
+			DMA1_Channel4->CCR = 0;
+			DMA1_Channel4->CPAR = reinterpret_cast<uintptr_t>(&USART1->DR);
+			DMA1_Channel4->CCR = DMA_CCR_MINC | DMA_CCR_DIR | DMA_CCR_TCIE;
+
+			// Let USART1 request data from DMA
+			USART1->CR3 |= USART_CR3_DMAT;
+
+			NVIC_SetPriority(DMA1_Channel4_IRQn, OSSHS_DMA_USART_DEVICE_INTERRUPT_PRIORITY);
+			NVIC_EnableIRQ(DMA1_Channel4_IRQn);
+		}
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		void
+		DmaUsartDevice<BUFFER_SIZE, POLICY>::deinitialize()
+		{
+			flushWriteBuffer();
+
+			NVIC_DisableIRQ(DMA1_Channel4_IRQn);
+
+			USART1->CR3 &= ~USART_CR3_DMAT;
+			DMA1_Channel4->CCR = 0;
+
+			// Disable DMA1 peripheral clock
+			RCC->AHBENR &= ~RCC_AHBENR_DMA1EN;
+		}
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		bool
+		DmaUsartDevice<BUFFER_SIZE, POLICY>::write(uint8_t data)
+		{
+			// The rest of a dropped message is discarded, but its terminator is kept if possible
+			if (discarding)
+			{
+				if (data == '\n')
+				{
+					discarding = false;
+					lineStart = true;
+
+					if (push(data) && !transferring.exchange(true, std::memory_order_acq_rel))
+						startTransfer();
+				}
+
+				return true;
+			}
+
+			if (lineStart && dropped != reported)
+				reportDropped();
+
+			while (!push(data))
+			{
+				if (POLICY == OverflowPolicy::DROP_OLDEST && dropOldest())
+				{
+					dropped++;
+					continue;
+				}
+
+				// Drop the message currently being written
+				dropped++;
+				discarding = data != '\n';
+				lineStart = !discarding;
+				return true;
+			}
+
+			lineStart = data == '\n';
+
+			// Start a transfer unless one is already in progress
+			if (!transferring.exchange(true, std::memory_order_acq_rel))
+				startTransfer();
+
+			return true;
+		}
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		bool
+		DmaUsartDevice<BUFFER_SIZE, POLICY>::write(const uint8_t *data, std::size_t length)
+		{
+			// The rest of a dropped message is discarded byte by byte, the block starts behind it
+			while (discarding && length)
+			{
+				write(*data++);
+				length--;
+			}
+
+			if (!length)
+				return true;
+
+			if (lineStart && dropped != reported)
+				reportDropped();
+
+			// There is a single producer and the interrupt only frees space, so the block fits once it fits now
+			if (getFreeSpace() < length)
+				return false;
+
+			for (std::size_t i = 0; i < length; i++)
+				push(data[i]);
+
+			lineStart = data[length - 1] == '\n';
+
+			// Start a transfer unless one is already in progress
+			if (!transferring.exchange(true, std::memory_order_acq_rel))
+				startTransfer();
+
+			return true;
+		}
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		std::size_t
+		DmaUsartDevice<BUFFER_SIZE, POLICY>::getFreeSpace()
+		{
+			return BUFFER_SIZE - (head.load(std::memory_order_relaxed) - tail.load(std::memory_order_acquire));
+		}
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		void
+		DmaUsartDevice<BUFFER_SIZE, POLICY>::flushWriteBuffer()
+		{
+			while (!isWriteFinished());
+
+			// Wait until the last byte leaves the shift register
+			while (!(USART1->SR & USART_SR_TC));
+		}
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		bool
+		DmaUsartDevice<BUFFER_SIZE, POLICY>::isWriteFinished()
+		{
+			return !transferring.load(std::memory_order_acquire) &&
+				head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+		}
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		void
+		DmaUsartDevice<BUFFER_SIZE, POLICY>::pause()
+		{
+			paused.store(true, std::memory_order_release);
+
+			// CNDTR keeps the bytes left of the chunk, a chunk that just completed is left to the interrupt
+			DMA1_Channel4->CCR &= ~DMA_CCR_EN;
+		}
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		void
+		DmaUsartDevice<BUFFER_SIZE, POLICY>::resume()
+		{
+			paused.store(false, std::memory_order_release);
+
+			if (!transferring.load(std::memory_order_acquire))
+				return;
+
+			uint32_t remaining = DMA1_Channel4->CNDTR;
+			if (!remaining)
+			{
+				startTransfer();
+				return;
+			}
+
+			// The channel starts over at CMAR once enabled, so CMAR is moved behind the bytes sent since it was set.
+			// transferLength counts from CMAR, not from the start of the chunk, as a chunk may be paused repeatedly.
+			DMA1_Channel4->CMAR += transferLength - remaining;
+			DMA1_Channel4->CNDTR = remaining;
+			transferLength = remaining;
+			DMA1_Channel4->CCR |= DMA_CCR_EN;
+		}
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		bool
+		DmaUsartDevice<BUFFER_SIZE, POLICY>::read(uint8_t &)
+		{
+			return false;
+		}
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		uint32_t
+		DmaUsartDevice<BUFFER_SIZE, POLICY>::getDroppedMessages()
+		{
+			return dropped;
+		}
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		void
+		DmaUsartDevice<BUFFER_SIZE, POLICY>::handleInterrupt()
+		{
+			// Acknowledge transfer completion
+			DMA1->IFCR = DMA_IFCR_CGIF4;
+			DMA1_Channel4->CCR &= ~DMA_CCR_EN;
+
+			startTransfer();
+		}
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		void
+		DmaUsartDevice<BUFFER_SIZE, POLICY>::startTransfer()
+		{
+			// Stays transferring, resume() starts it
+			if (paused.load(std::memory_order_acquire))
+				return;
+
+			uint32_t t = tail.load(std::memory_order_acquire);
+			uint32_t length = head.load(std::memory_order_acquire) - t;
+
+			if (length == 0)
+			{
+				transferring.store(false, std::memory_order_release);
+				return;
+			}
+
+			if (length > OSSHS_DMA_USART_DEVICE_TRANSFER_SIZE)
+				length = OSSHS_DMA_USART_DEVICE_TRANSFER_SIZE;
+
+			// Copy the chunk out, so the producer can drop old messages without racing the DMA
+			for (uint32_t i = 0; i < length; i++)
+				transfer[i] = buffer[(t + i) & (BUFFER_SIZE - 1)];
+
+			tail.store(t + length, std::memory_order_release);
+			transferLength = length;
+
+			DMA1_Channel4->CMAR = reinterpret_cast<uintptr_t>(transfer);
+			DMA1_Channel4->CNDTR = length;
+			DMA1_Channel4->CCR |= DMA_CCR_EN;
+		}
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		bool
+		DmaUsartDevice<BUFFER_SIZE, POLICY>::dropOldest()
+		{
+			uint32_t t = tail.load(std::memory_order_acquire);
+			uint32_t h = head.load(std::memory_order_relaxed);
+
+			while (true)
+			{
+				// Find the end of the oldest queued message
+				uint32_t i = t;
+				while (i != h && buffer[i & (BUFFER_SIZE - 1)] != '\n')
+					i++;
+
+				if (i == h)
+					return false;
+
+				// Fails if the interrupt consumed data in the meantime, in which case t is reloaded
+				if (tail.compare_exchange_weak(t, i + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+					return true;
+			}
+		}
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		bool
+		DmaUsartDevice<BUFFER_SIZE, POLICY>::push(uint8_t data)
+		{
+			uint32_t h = head.load(std::memory_order_relaxed);
+
+			if (h - tail.load(std::memory_order_acquire) >= BUFFER_SIZE)
+				return false;
+
+			buffer[h & (BUFFER_SIZE - 1)] = data;
+			head.store(h + 1, std::memory_order_release);
+			return true;
+		}
+
+		template<std::size_t BUFFER_SIZE, OverflowPolicy POLICY>
+		void
+		DmaUsartDevice<BUFFER_SIZE, POLICY>::reportDropped()
+		{
+			static constexpr char prefix[] = "[WARNING] Dropped ";
+			static constexpr char suffix[] = " log messages.\r\n";
+
+			uint32_t count = dropped - reported;
+
+			// Format the count in reverse order
+			char digits[10];
+			uint8_t digitCount = 0;
+			do
+			{
+				digits[digitCount++] = '0' + count % 10;
+				count /= 10;
+			}
+			while (count);
+
+			// Only report once the whole report fits, otherwise try again at the next message
+			uint32_t length = sizeof(prefix) - 1 + digitCount + sizeof(suffix) - 1;
+			if (getFreeSpace() < length)
+				return;
+
+			for (uint32_t i = 0; i < sizeof(prefix) - 1; i++)
+				push(prefix[i]);
+			while (digitCount)
+				push(digits[--digitCount]);
+			for (uint32_t i = 0; i < sizeof(suffix) - 1; i++)
+				push(suffix[i]);
+
+			reported = dropped;
+		}
+	}
+}
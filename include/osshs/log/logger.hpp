@@ -26,10 +26,12 @@
 #define OSSHS_LOGGER_HPP
 
 #include <modm/debug/logger.hpp>
+#include <osshs/log/level.hpp>
+#include <osshs/log/can_log_sink.hpp>
 
-#ifndef DISABLE_LOGGING
-	#define __FILENAME__ (__builtin_strrchr(__FILE__, '/') ? __builtin_strrchr(__FILE__, '/') + 1 : __FILE__)
+#define __FILENAME__ (__builtin_strrchr(__FILE__, '/') ? __builtin_strrchr(__FILE__, '/') + 1 : __FILE__)
 
+#ifndef DISABLE_LOGGING
 	#define OSSHS_ENABLE_LOGGER(device, behavior) \
 		modm::IODeviceWrapper<device, behavior> loggerDevice; \
 		modm::log::Logger osshs::log::logger(loggerDevice);
@@ -48,15 +50,6 @@
 		{
 			extern modm::log::Logger logger;
 
-			enum class Level : uint8_t
-			{
-				DISABLED,
-				ERROR,
-				WARNING,
-				INFO,
-				DEBUG
-			};
-
 			class Logger
 			{
 				public:
@@ -87,11 +80,23 @@
 					flush();
 				private:
 					static Level level;
+					static const char *const levelNames[];
 			};
 		}
 	}
 
 	#include <osshs/log/logger_impl.hpp>
+#elif OSSHS_CAN_LOG
+	// Without text output, messages still go to CAN as binary records
+	#define OSSHS_ENABLE_LOGGER(device, behavior)
+
+	#define OSSHS_LOG_ERROR(format, args...)   osshs::log::CanLogSink::log(osshs::log::Level::ERROR  , __FILENAME__, __LINE__, format, ##args);
+	#define OSSHS_LOG_WARNING(format, args...) osshs::log::CanLogSink::log(osshs::log::Level::WARNING, __FILENAME__, __LINE__, format, ##args);
+	#define OSSHS_LOG_INFO(format, args...)    osshs::log::CanLogSink::log(osshs::log::Level::INFO   , __FILENAME__, __LINE__, format, ##args);
+	#define OSSHS_LOG_DEBUG(format, args...)   osshs::log::CanLogSink::log(osshs::log::Level::DEBUG  , __FILENAME__, __LINE__, format, ##args);
+
+	#define OSSHS_LOG_FLUSH()
+	#define OSSHS_LOG_SET_LEVEL(level)
 #else  // DISABLE_LOGGING
 	#define OSSHS_ENABLE_LOGGER(device, behavior)
 
@@ -27,7 +27,6 @@
 #endif
 
 #include <modm/platform.hpp>
-#include <magic_enum.hpp>
 
 namespace osshs
 {
@@ -37,13 +36,21 @@ namespace osshs
 		void
 		Logger::log(Level level, const char *filename, uint32_t line, const char *format, ARGS... args)
 		{
+#if OSSHS_CAN_LOG
+			CanLogSink::log(level, filename, line, format, args...);
+#endif
+
 			if (level > Logger::level)
 				return;
 
+			// Integer formatting only, so neither floating point nor string support is pulled in
+			uint32_t time = modm::Clock::now().getTime();
+
 			logger.printf(
-				"[%.3f][%s][%s:%lu] ",
-				static_cast<double>(modm::Clock::now().getTime() / 1000.0),
-				std::string(magic_enum::enum_name(level)).c_str(),
+				"[%lu.%03lu][%s][%s:%lu] ",
+				time / 1000,
+				time % 1000,
+				levelNames[static_cast<uint8_t>(level)],
 				filename,
 				line
 			);
@@ -0,0 +1,67 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_MANIFEST_HPP
+#define OSSHS_MANIFEST_HPP
+
+#include <cstdint>
+
+#define OSSHS_MANIFEST_MAGIC   0x4e414d4f
+#define OSSHS_MANIFEST_VERSION 1
+#define OSSHS_MANIFEST_OFFSET  0x00000200
+
+namespace osshs
+{
+	/**
+	 * Application image manifest, located at OSSHS_BOOTLOADER_APPLICATION_ORIGIN + OSSHS_MANIFEST_OFFSET.
+	 *
+	 * The offset leaves room for the vector table of any STM32F1 device. The application places a manifest
+	 * there with magic, version, size and imageVersion filled in; tools/osshs-pack.py fills in imageLength, crc
+	 * and entryPoint, if it is 0, after linking, see README.md:
+	 *
+	 *   offset  size  field
+	 *   0x00    4     magic         OSSHS_MANIFEST_MAGIC ("OMAN")
+	 *   0x04    2     version       OSSHS_MANIFEST_VERSION
+	 *   0x06    2     size          sizeof(ApplicationManifest)
+	 *   0x08    4     imageVersion  Application defined version number
+	 *   0x0c    4     imageLength   Number of bytes in use from the application origin, a multiple of 4
+	 *   0x10    4     entryPoint    Address of the reset handler, must match the vector table
+	 *   0x14    4     crc           CRC-32 (as calculated by Flash) of the first imageLength bytes of the
+	 *                               image, excluding the crc field itself
+	 */
+	struct ApplicationManifest
+	{
+		uint32_t magic;
+		uint16_t version;
+		uint16_t size;
+		uint32_t imageVersion;
+		uint32_t imageLength;
+		uint32_t entryPoint;
+		uint32_t crc;
+	};
+
+	static_assert(sizeof(ApplicationManifest) == 24, "ApplicationManifest layout must not change.");
+}
+
+#endif  // OSSHS_MANIFEST_HPP
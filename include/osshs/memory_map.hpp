@@ -0,0 +1,155 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_MEMORY_MAP_HPP
+#define OSSHS_MEMORY_MAP_HPP
+
+#include <cstdint>
+
+// Geometry of the target, passed by SConstruct.py as derived from the modm target. Defaults match the stm32f103cbt6.
+#ifndef OSSHS_TARGET_FLASH_SIZE
+	#define OSSHS_TARGET_FLASH_SIZE 0x00020000
+#endif
+
+#ifndef OSSHS_TARGET_RAM_SIZE
+	#define OSSHS_TARGET_RAM_SIZE 0x00005000
+#endif
+
+// 2 KiB pages on high-density, XL-density and connectivity line devices
+#ifndef OSSHS_TARGET_FLASH_PAGE_SIZE
+	#define OSSHS_TARGET_FLASH_PAGE_SIZE (OSSHS_TARGET_FLASH_SIZE > 0x00020000 ? 0x0800 : 0x0400)
+#endif
+
+// Flash reserved for the bootloader, the application starts right after it. The minimal profile halves it.
+#ifndef OSSHS_BOOTLOADER_SIZE
+	#define OSSHS_BOOTLOADER_SIZE 0x00004000
+#endif
+
+namespace osshs
+{
+	/**
+	 * Flash geometry and memory regions of an STM32F1 device.
+	 *
+	 * Everything is a compile time constant and checked by static_asserts, so page arithmetic compiles to shifts
+	 * and masks and no geometry is checked at runtime.
+	 */
+	template<uint32_t FLASH_ORIGIN, uint32_t FLASH_SIZE, uint32_t PAGE_SIZE, uint32_t RAM_ORIGIN, uint32_t RAM_SIZE, uint32_t BOOTLOADER_SIZE>
+	struct MemoryMap
+	{
+		static_assert(PAGE_SIZE == 0x0400 || PAGE_SIZE == 0x0800, "STM32F1 flash pages are 1 KiB or 2 KiB.");
+		static_assert(!(FLASH_ORIGIN & (PAGE_SIZE - 1)), "Flash must start at a page boundary.");
+		static_assert(FLASH_SIZE && !(FLASH_SIZE & (PAGE_SIZE - 1)), "Flash must consist of whole pages.");
+		static_assert(BOOTLOADER_SIZE && !(BOOTLOADER_SIZE & (PAGE_SIZE - 1)), "The bootloader must occupy whole pages.");
+		static_assert(BOOTLOADER_SIZE + PAGE_SIZE < FLASH_SIZE, "The bootloader leaves no flash for the application.");
+		static_assert(RAM_SIZE && !(RAM_SIZE & 0b11), "RAM must consist of whole words.");
+
+		static constexpr uint32_t flashOrigin = FLASH_ORIGIN;
+		static constexpr uint32_t flashSize = FLASH_SIZE;
+		static constexpr uint32_t pageSize = PAGE_SIZE;
+		static constexpr uint32_t pageShift = PAGE_SIZE == 0x0800 ? 11 : 10;
+		static constexpr uint32_t pageCount = FLASH_SIZE >> pageShift;
+
+		static constexpr uint32_t ramOrigin = RAM_ORIGIN;
+		static constexpr uint32_t ramSize = RAM_SIZE;
+
+		static constexpr uint32_t bootloaderOrigin = FLASH_ORIGIN;
+		static constexpr uint32_t bootloaderSize = BOOTLOADER_SIZE;
+
+		// The last page of the bootloader holds the firmware key when decryption is enabled, see key_store.hpp
+		static constexpr uint32_t keyOrigin = FLASH_ORIGIN + BOOTLOADER_SIZE - PAGE_SIZE;
+		static constexpr uint32_t keySize = PAGE_SIZE;
+
+		// The last page of flash belongs to the bootloader's configuration, see wear_journal.hpp
+		static constexpr uint32_t configOrigin = FLASH_ORIGIN + FLASH_SIZE - PAGE_SIZE;
+		static constexpr uint32_t configSize = PAGE_SIZE;
+
+		static constexpr uint32_t applicationOrigin = FLASH_ORIGIN + BOOTLOADER_SIZE;
+		static constexpr uint32_t applicationLength = FLASH_SIZE - BOOTLOADER_SIZE - PAGE_SIZE;
+
+		static_assert(pageSize == 1u << pageShift, "pageShift does not match pageSize.");
+
+		/**
+		 * @brief Get the page an address resides in.
+		 * @param address Flash address.
+		 * @return Page number, counted from the origin of flash.
+		 */
+		static constexpr uint32_t
+		getPage(uint32_t address)
+		{
+			return (address - FLASH_ORIGIN) >> pageShift;
+		}
+
+		/**
+		 * @brief Get the origin address of a page.
+		 * @param page Page number, counted from the origin of flash.
+		 * @return Origin address of the page.
+		 */
+		static constexpr uint32_t
+		getPageAddress(uint32_t page)
+		{
+			return FLASH_ORIGIN + (page << pageShift);
+		}
+
+		/**
+		 * @brief Get the offset of an address within its page.
+		 * @param address Flash address.
+		 * @return Offset in bytes.
+		 */
+		static constexpr uint32_t
+		getPageOffset(uint32_t address)
+		{
+			return address & (PAGE_SIZE - 1);
+		}
+
+		/**
+		 * @brief Check if an address is the origin of a page within flash.
+		 * @param address Address to check.
+		 * @return Whether or not the address is a page origin within flash.
+		 */
+		static constexpr bool
+		isPageOrigin(uint32_t address)
+		{
+			return !getPageOffset(address) && address - FLASH_ORIGIN < FLASH_SIZE;
+		}
+	};
+
+	/**
+	 * Memory map of an STM32F1 device, with the page size given by its flash size.
+	 * @note Connectivity line devices (STM32F105/107) always have 2 KiB pages and need MemoryMap directly.
+	 */
+	template<uint32_t FLASH_SIZE, uint32_t RAM_SIZE, uint32_t BOOTLOADER_SIZE = OSSHS_BOOTLOADER_SIZE>
+	using Stm32f1MemoryMap = MemoryMap<0x08000000, FLASH_SIZE, (FLASH_SIZE > 0x00020000 ? 0x0800 : 0x0400), 0x20000000,
+		RAM_SIZE, BOOTLOADER_SIZE>;
+
+	using TargetMemoryMap = MemoryMap<0x08000000, OSSHS_TARGET_FLASH_SIZE, OSSHS_TARGET_FLASH_PAGE_SIZE, 0x20000000,
+		OSSHS_TARGET_RAM_SIZE, OSSHS_BOOTLOADER_SIZE>;
+
+	// Known densities, instantiated so their regions are checked on every build
+	static_assert(Stm32f1MemoryMap<0x00008000, 0x00002800>::pageCount == 32, "Low-density STM32F103x6 has 32 pages.");
+	static_assert(Stm32f1MemoryMap<0x00020000, 0x00005000>::pageCount == 128, "Medium-density STM32F103xB has 128 pages.");
+	static_assert(Stm32f1MemoryMap<0x00080000, 0x00010000>::pageCount == 256, "High-density STM32F103xE has 256 pages.");
+	static_assert(Stm32f1MemoryMap<0x00100000, 0x00018000>::pageCount == 512, "XL-density STM32F103xG has 512 pages.");
+}
+
+#endif  // OSSHS_MEMORY_MAP_HPP
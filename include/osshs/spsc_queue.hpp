@@ -0,0 +1,90 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_SPSC_QUEUE_HPP
+#define OSSHS_SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace osshs
+{
+	/**
+	 * @brief Lock-free queue for a single producer and a single consumer, e.g. an interrupt and the event loop.
+	 * @note Several interrupts may share the producer side if they run at the same priority, since they can not
+	 *       preempt each other.
+	 * @tparam T Type of the elements, copied in and out.
+	 * @tparam SIZE Capacity of the queue. Must be a power of two.
+	 */
+	template<typename T, std::size_t SIZE>
+	class SpscQueue
+	{
+		static_assert(SIZE && !(SIZE & (SIZE - 1)), "SIZE must be a power of two.");
+
+	public:
+		/**
+		 * @brief Append an element.
+		 * @note Must only be called by the producer.
+		 * @param element Element to append.
+		 * @return Whether or not there was space for the element.
+		 */
+		bool
+		push(const T &element);
+
+		/**
+		 * @brief Remove the oldest element.
+		 * @note Must only be called by the consumer.
+		 * @param element Element that will contain the removed element.
+		 * @return Whether or not there was an element.
+		 */
+		bool
+		pop(T &element);
+
+		/**
+		 * @brief Check if the queue is empty.
+		 * @return Whether or not the queue is empty.
+		 */
+		bool
+		isEmpty() const;
+
+		/**
+		 * @brief Get the number of queued elements.
+		 * @return Number of queued elements.
+		 */
+		std::size_t
+		getSize() const;
+
+	private:
+		T buffer[SIZE];
+
+		// Free running indices, only the producer writes head and only the consumer writes tail
+		std::atomic<uint32_t> head{0};
+		std::atomic<uint32_t> tail{0};
+	};
+}
+
+#include <osshs/spsc_queue_impl.hpp>
+
+#endif  // OSSHS_SPSC_QUEUE_HPP
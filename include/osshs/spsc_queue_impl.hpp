@@ -0,0 +1,74 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_SPSC_QUEUE_HPP
+	#error "Don't include this file directly, use 'spsc_queue.hpp' instead!"
+#endif
+
+namespace osshs
+{
+	template<typename T, std::size_t SIZE>
+	bool
+	SpscQueue<T, SIZE>::push(const T &element)
+	{
+		uint32_t currentHead = head.load(std::memory_order_relaxed);
+		if (currentHead - tail.load(std::memory_order_acquire) >= SIZE)
+			return false;
+
+		buffer[currentHead & (SIZE - 1)] = element;
+
+		// Publish the element after it was written
+		head.store(currentHead + 1, std::memory_order_release);
+		return true;
+	}
+
+	template<typename T, std::size_t SIZE>
+	bool
+	SpscQueue<T, SIZE>::pop(T &element)
+	{
+		uint32_t currentTail = tail.load(std::memory_order_relaxed);
+		if (currentTail == head.load(std::memory_order_acquire))
+			return false;
+
+		element = buffer[currentTail & (SIZE - 1)];
+
+		// Free the slot after it was read
+		tail.store(currentTail + 1, std::memory_order_release);
+		return true;
+	}
+
+	template<typename T, std::size_t SIZE>
+	bool
+	SpscQueue<T, SIZE>::isEmpty() const
+	{
+		return tail.load(std::memory_order_relaxed) == head.load(std::memory_order_acquire);
+	}
+
+	template<typename T, std::size_t SIZE>
+	std::size_t
+	SpscQueue<T, SIZE>::getSize() const
+	{
+		return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+	}
+}
@@ -0,0 +1,72 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef OSSHS_STACK_MONITOR_HPP
+#define OSSHS_STACK_MONITOR_HPP
+
+#include <cstdint>
+
+#define OSSHS_STACK_MONITOR_PAINT  0xdeadbeef
+// Bytes below the frame of paint() that are left alone
+#define OSSHS_STACK_MONITOR_MARGIN 64
+
+namespace osshs
+{
+	/**
+	 * High-water mark of the main stack, found by painting its unused part.
+	 *
+	 * The bootloader never switches to the process stack, so interrupts run on the main stack as well and the mark
+	 * covers them. The bounds come from the linker script (__main_stack_bottom and __main_stack_top). Static RAM is
+	 * reported by the build, see SConstruct.py.
+	 */
+	class StackMonitor
+	{
+	public:
+		/**
+		 * @brief Paint the main stack below the frame of the caller.
+		 * @note Should be called first thing in main(), before interrupts are enabled.
+		 */
+		static void
+		paint();
+
+		/**
+		 * @brief Get the deepest the main stack has been since paint().
+		 * @note Scans from the bottom of the stack up to the first overwritten word, so it costs a few cycles per
+		 *       unused byte.
+		 * @return Number of bytes used, counted from the top of the stack.
+		 */
+		static uint32_t
+		getHighWaterMark();
+
+		/**
+		 * @brief Get the size of the main stack.
+		 * @return Size of the main stack in bytes.
+		 */
+		static uint32_t
+		getSize();
+	};
+}
+
+#endif  // OSSHS_STACK_MONITOR_HPP
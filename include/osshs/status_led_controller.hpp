@@ -25,11 +25,71 @@
 #ifndef OSSHS_STATUS_LED_CONTROLLER_HPP
 #define OSSHS_STATUS_LED_CONTROLLER_HPP
 
+#include <cstddef>
+#include <cstdint>
 #include <modm/platform.hpp>
 
+#define OSSHS_STATUS_LED_CONTROLLER_TICK_FREQUENCY     1000
+#define OSSHS_STATUS_LED_CONTROLLER_INTERRUPT_PRIORITY 10
+
 namespace osshs
 {
-	template<typename TIMER, typename STATUS_LED, typename SYSTEM_CLOCK>
+	struct StatusLedStep
+	{
+		bool on;
+		uint16_t duration;  ///< Milliseconds, 0 holds the step until the status changes
+	};
+
+	struct StatusLedPattern
+	{
+		const StatusLedStep *steps;
+		uint8_t length;
+	};
+
+	/**
+	 * @brief Create a pattern from a table of steps.
+	 * @param steps Steps of the pattern, repeated in order.
+	 * @return Pattern of all steps.
+	 */
+	template<std::size_t LENGTH>
+	constexpr StatusLedPattern
+	makeStatusLedPattern(const StatusLedStep (&steps)[LENGTH])
+	{
+		static_assert(LENGTH > 0 && LENGTH <= UINT8_MAX, "A pattern must have between 1 and 255 steps.");
+		return {steps, LENGTH};
+	}
+
+	namespace status_led_patterns
+	{
+		// 3 long blinks
+		constexpr StatusLedStep bootloaderActive[] = {
+			{true, 1000}, {false, 500}, {true, 1000}, {false, 500}, {true, 1000}, {false, 1500}
+		};
+
+		// 1 long and 2 short blinks
+		constexpr StatusLedStep applicationError[] = {
+			{true, 1000}, {false, 500}, {true, 200}, {false, 500}, {true, 200}, {false, 1500}
+		};
+
+		// 1 short and 2 long blinks
+		constexpr StatusLedStep bootloaderError[] = {
+			{true, 200}, {false, 500}, {true, 1000}, {false, 500}, {true, 1000}, {false, 1500}
+		};
+
+		// Fast blinking
+		constexpr StatusLedStep updateInProgress[] = {
+			{true, 100}, {false, 100}
+		};
+	}
+
+	/**
+	 * Plays a blink pattern per status on the status LED.
+	 *
+	 * Patterns are tables of steps. The timer runs at OSSHS_STATUS_LED_CONTROLLER_TICK_FREQUENCY and only
+	 * interrupts at the edges between steps, so a pattern costs one interrupt per step. A new pattern only
+	 * needs a table and an entry in patterns.
+	 */
+	template<typename TIMER, typename STATUS_LED, typename SYSTEM_CLOCK, uint32_t TIMER_FREQUENCY = SYSTEM_CLOCK::Timer2>
 	class StatusLedController
 	{
 	public:
@@ -37,7 +97,8 @@ namespace osshs
 		{
 			BOOTLOADER_ACTIVE,
 			APPLICATION_ERROR,
-			BOOTLOADER_ERROR
+			BOOTLOADER_ERROR,
+			UPDATE_IN_PROGRESS
 		};
 
 		/**
@@ -54,21 +115,51 @@ namespace osshs
 
 		/**
 		 * @brief Set current status.
+		 * @note Restarts the pattern of the status from its first step.
 		 * @param status Status to set.
 		 */
 		static void
 		setStatus(Status status);
 
 		/**
-		 * @brief Update status animations.
-		 * @note Should be called from the timer interrupt setup by enable().
+		 * @brief Advance to the next step of the pattern.
+		 * @note Should be called from the update interrupt of the timer setup by enable().
 		 */
 		static void
 		update();
+
 	private:
+		static constexpr uint32_t prescaler = TIMER_FREQUENCY / OSSHS_STATUS_LED_CONTROLLER_TICK_FREQUENCY;
+
+		static_assert(TIMER_FREQUENCY % OSSHS_STATUS_LED_CONTROLLER_TICK_FREQUENCY == 0 && prescaler >= 1 && prescaler <= UINT16_MAX,
+			"The timer frequency must be a multiple of OSSHS_STATUS_LED_CONTROLLER_TICK_FREQUENCY within the prescaler range.");
+
+		// In order of Status
+		static constexpr StatusLedPattern patterns[] = {
+			makeStatusLedPattern(status_led_patterns::bootloaderActive),
+			makeStatusLedPattern(status_led_patterns::applicationError),
+			makeStatusLedPattern(status_led_patterns::bootloaderError),
+			makeStatusLedPattern(status_led_patterns::updateInProgress)
+		};
+
+		/**
+		 * @brief Get the timer overflow value for a step.
+		 * @param step Step of the current pattern.
+		 * @return Overflow value, so the update interrupt fires after the duration of the step.
+		 */
+		static uint16_t
+		getOverflow(uint8_t step);
+
+		/**
+		 * @brief Play the current pattern from its first step.
+		 */
+		static void
+		restart();
+
 		static Status status;
-		static uint16_t counter;
-  };
+		static uint8_t step;
+		static bool enabled;
+	};
 }
 
 #include <osshs/status_led_controller_impl.hpp>
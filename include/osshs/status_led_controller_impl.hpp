@@ -31,135 +31,117 @@
 
 namespace osshs
 {
-	template<typename TIMER, typename STATUS_LED, typename SYSTEM_CLOCK>
-	typename StatusLedController<TIMER, STATUS_LED, SYSTEM_CLOCK>::Status StatusLedController<TIMER, STATUS_LED, SYSTEM_CLOCK>::status;
+	template<typename TIMER, typename STATUS_LED, typename SYSTEM_CLOCK, uint32_t TIMER_FREQUENCY>
+	typename StatusLedController<TIMER, STATUS_LED, SYSTEM_CLOCK, TIMER_FREQUENCY>::Status
+		StatusLedController<TIMER, STATUS_LED, SYSTEM_CLOCK, TIMER_FREQUENCY>::status;
 
-	template<typename TIMER, typename STATUS_LED, typename SYSTEM_CLOCK>
-	uint16_t StatusLedController<TIMER, STATUS_LED, SYSTEM_CLOCK>::counter = 0;
+	template<typename TIMER, typename STATUS_LED, typename SYSTEM_CLOCK, uint32_t TIMER_FREQUENCY>
+	uint8_t StatusLedController<TIMER, STATUS_LED, SYSTEM_CLOCK, TIMER_FREQUENCY>::step = 0;
 
-	template<typename TIMER, typename STATUS_LED, typename SYSTEM_CLOCK>
+	template<typename TIMER, typename STATUS_LED, typename SYSTEM_CLOCK, uint32_t TIMER_FREQUENCY>
+	bool StatusLedController<TIMER, STATUS_LED, SYSTEM_CLOCK, TIMER_FREQUENCY>::enabled = false;
+
+	template<typename TIMER, typename STATUS_LED, typename SYSTEM_CLOCK, uint32_t TIMER_FREQUENCY>
 	void
-	StatusLedController<TIMER, STATUS_LED, SYSTEM_CLOCK>::enable()
+	StatusLedController<TIMER, STATUS_LED, SYSTEM_CLOCK, TIMER_FREQUENCY>::enable()
 	{
 		OSSHS_LOG_INFO("Enabling status led controller.");
-		
+
 		TIMER::enable();
 
-		// Interrupt every 100ms
-		TIMER::template setPeriod<SYSTEM_CLOCK>(100000);
+		// Count milliseconds, the overflow is set per step
 		TIMER::setMode(TIMER::Mode::UpCounter);
+		TIMER::setPrescaler(prescaler);
 
-		TIMER::enableInterruptVector(true, 10);
+		TIMER::enableInterruptVector(true, OSSHS_STATUS_LED_CONTROLLER_INTERRUPT_PRIORITY);
 		TIMER::enableInterrupt(TIMER::Interrupt::Update);
 
-		TIMER::applyAndReset();
-		TIMER::start();
+		enabled = true;
+		restart();
 	}
 
-	template<typename TIMER, typename STATUS_LED, typename SYSTEM_CLOCK>
+	template<typename TIMER, typename STATUS_LED, typename SYSTEM_CLOCK, uint32_t TIMER_FREQUENCY>
 	void
-	StatusLedController<TIMER, STATUS_LED, SYSTEM_CLOCK>::disable()
+	StatusLedController<TIMER, STATUS_LED, SYSTEM_CLOCK, TIMER_FREQUENCY>::disable()
 	{
 		OSSHS_LOG_INFO("Disabling status led controller.");
 
+		enabled = false;
+
 		TIMER::pause();
 
 		TIMER::disableInterrupt(TIMER::Interrupt::Update);
-		TIMER::enableInterruptVector(false, 10);
+		TIMER::enableInterruptVector(false, OSSHS_STATUS_LED_CONTROLLER_INTERRUPT_PRIORITY);
 
 		TIMER::disable();
 	}
 
-	template<typename TIMER, typename STATUS_LED, typename SYSTEM_CLOCK>
+	template<typename TIMER, typename STATUS_LED, typename SYSTEM_CLOCK, uint32_t TIMER_FREQUENCY>
 	void
-	StatusLedController<TIMER, STATUS_LED, SYSTEM_CLOCK>::setStatus(Status status)
+	StatusLedController<TIMER, STATUS_LED, SYSTEM_CLOCK, TIMER_FREQUENCY>::setStatus(Status status)
 	{
+		static_assert(sizeof(patterns) / sizeof(patterns[0]) == magic_enum::enum_count<Status>(),
+			"Every status needs a pattern.");
+
 		OSSHS_LOG_INFO("Changing status(status = `%s`).", std::string(magic_enum::enum_name(status)).c_str());
 
 		StatusLedController::status = status;
+		restart();
 	}
 
-	template<typename TIMER, typename STATUS_LED, typename SYSTEM_CLOCK>
+	template<typename TIMER, typename STATUS_LED, typename SYSTEM_CLOCK, uint32_t TIMER_FREQUENCY>
 	void
-	StatusLedController<TIMER, STATUS_LED, SYSTEM_CLOCK>::update()
+	StatusLedController<TIMER, STATUS_LED, SYSTEM_CLOCK, TIMER_FREQUENCY>::update()
 	{
-		switch(status)
+		const StatusLedPattern &pattern = patterns[static_cast<uint32_t>(status)];
+
+		// The timer already runs for the duration of the new step, which was preloaded one interrupt ago
+		step = step + 1 < pattern.length ? step + 1 : 0;
+		STATUS_LED::set(pattern.steps[step].on);
+
+		if (!pattern.steps[step].duration)
 		{
-			// 3 long blinks
-			case Status::BOOTLOADER_ACTIVE:
-				counter = counter % 55;
-				
-				// Long blink
-				if (counter == 0)
-					STATUS_LED::set();
-				if (counter == 10)
-					STATUS_LED::reset();
-				
-				// Long blink
-				if (counter == 15)
-					STATUS_LED::set();
-				if (counter == 25)
-					STATUS_LED::reset();
-				
-				// Long blink
-				if (counter == 30)
-					STATUS_LED::set();
-				if (counter == 40)
-					STATUS_LED::reset();
-				break;
-
-			// 1 long and 2 short blinks
-			case Status::APPLICATION_ERROR:
-				counter = counter % 39;
-				
-				// Long blink
-				if (counter == 0)
-					STATUS_LED::set();
-				if (counter == 10)
-					STATUS_LED::reset();
-
-				// Short blink
-				if (counter == 15)
-					STATUS_LED::set();
-				if (counter == 17)
-					STATUS_LED::reset();
-
-				// Short blink
-				if (counter == 22)
-					STATUS_LED::set();
-				if (counter == 24)
-					STATUS_LED::reset();
-				break;
-			
-			// 1 short and 2 long blinks
-			case Status::BOOTLOADER_ERROR:
-				counter = counter % 47;
-				
-				// Short blink
-				if (counter == 0)
-					STATUS_LED::set();
-				if (counter == 2)
-					STATUS_LED::reset();
-				
-				// Long blink
-				if (counter == 7)
-					STATUS_LED::set();
-				if (counter == 17)
-					STATUS_LED::reset();
-				
-				// Long blink
-				if (counter == 22)
-					STATUS_LED::set();
-				if (counter == 32)
-					STATUS_LED::reset();
-				break;
-			
-			// Always on
-			default:
-				STATUS_LED::set();
-				break;
+			TIMER::pause();
+			return;
 		}
 
-		counter++;
+		// Preload the duration of the following step, the auto-reload register is buffered
+		TIMER::setOverflow(getOverflow(step + 1 < pattern.length ? step + 1 : 0));
+	}
+
+	template<typename TIMER, typename STATUS_LED, typename SYSTEM_CLOCK, uint32_t TIMER_FREQUENCY>
+	uint16_t
+	StatusLedController<TIMER, STATUS_LED, SYSTEM_CLOCK, TIMER_FREQUENCY>::getOverflow(uint8_t step)
+	{
+		uint32_t ticks = static_cast<uint32_t>(patterns[static_cast<uint32_t>(status)].steps[step].duration) *
+			OSSHS_STATUS_LED_CONTROLLER_TICK_FREQUENCY / 1000;
+
+		// A step held forever never reaches its overflow
+		return ticks ? ticks - 1 : UINT16_MAX;
+	}
+
+	template<typename TIMER, typename STATUS_LED, typename SYSTEM_CLOCK, uint32_t TIMER_FREQUENCY>
+	void
+	StatusLedController<TIMER, STATUS_LED, SYSTEM_CLOCK, TIMER_FREQUENCY>::restart()
+	{
+		const StatusLedPattern &pattern = patterns[static_cast<uint32_t>(status)];
+
+		step = 0;
+		STATUS_LED::set(pattern.steps[0].on);
+
+		if (!enabled)
+			return;
+
+		TIMER::pause();
+
+		if (!pattern.steps[0].duration)
+			return;
+
+		// Load the first step and restart counting, then preload the second step
+		TIMER::setOverflow(getOverflow(0));
+		TIMER::applyAndReset();
+		TIMER::setOverflow(getOverflow(pattern.length > 1 ? 1 : 0));
+
+		TIMER::start();
 	}
 }
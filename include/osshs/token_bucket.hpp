@@ -0,0 +1,99 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_TOKEN_BUCKET_HPP
+#define OSSHS_TOKEN_BUCKET_HPP
+
+#include <cstdint>
+
+namespace osshs
+{
+	/**
+	 * Limits a rate of events, e.g. frames per second, while allowing short bursts.
+	 *
+	 * The bucket holds up to burst tokens and refills at rate tokens per second, measured with the cycle counter.
+	 * Tokens are kept in 1/fcpu fractions, so slow rates do not lose precision between refills.
+	 */
+	class TokenBucket
+	{
+	public:
+		/**
+		 * @brief Set the rate and the size of the bucket and fill it.
+		 * @param rate Tokens per second, 0 disables the limit.
+		 * @param burst Size of the bucket in tokens, at least 1.
+		 */
+		void
+		configure(uint16_t rate, uint8_t burst);
+
+		/**
+		 * @brief Change the rate and keep the tokens in the bucket.
+		 * @param rate Tokens per second, 0 disables the limit.
+		 */
+		void
+		setRate(uint16_t rate);
+
+		/**
+		 * @brief Take tokens if the bucket holds enough.
+		 * @param tokens Number of tokens to take, at most the size of the bucket.
+		 * @return Whether or not the tokens were taken.
+		 */
+		bool
+		take(uint8_t tokens);
+
+		/**
+		 * @brief Get the time until the bucket holds enough tokens.
+		 * @param tokens Number of tokens, at most the size of the bucket.
+		 * @return Core cycles until take() succeeds, 0 if it already does.
+		 */
+		uint32_t
+		getDelay(uint8_t tokens);
+
+		uint16_t
+		getRate() const
+		{
+			return rate;
+		}
+
+		uint8_t
+		getBurst() const
+		{
+			return burst;
+		}
+
+	private:
+		/**
+		 * @brief Add the tokens earned since the last refill.
+		 * @note The cycle counter wraps after 2^32 cycles, a longer pause refills less than the full bucket.
+		 */
+		void
+		refill();
+
+		uint64_t credit = 0;  ///< Tokens times fcpu
+		uint32_t last = 0;
+		uint16_t rate = 0;
+		uint8_t burst = 1;
+	};
+}
+
+#endif  // OSSHS_TOKEN_BUCKET_HPP
@@ -0,0 +1,132 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_TRACE_HPP
+#define OSSHS_TRACE_HPP
+
+#include <cstdint>
+#include <osshs/bootloader.hpp>
+#include <osshs/cycle_counter.hpp>
+
+#define OSSHS_TRACE_MAGIC    0x45435254
+#define OSSHS_TRACE_VERSION  1
+#define OSSHS_TRACE_CAPACITY 32
+
+namespace osshs
+{
+	/**
+	 * Boot trace layout, located at OSSHS_BOOTLOADER_TRACE_ORIGIN (top of RAM).
+	 *
+	 * SConstruct.py shortens the RAM region of the bootloader's linker script by the trace and fails the build if
+	 * any section, the heap or the stack reach it. The trace is thus never touched by the bootloader's startup code,
+	 * so it survives soft resets and the jump to the application. The application must not use this memory region
+	 * and may parse it as follows:
+	 *
+	 *   offset  size  field
+	 *   0x00    4     magic         OSSHS_TRACE_MAGIC ("TRCE"), anything else means the trace is invalid
+	 *   0x04    2     version       OSSHS_TRACE_VERSION
+	 *   0x06    2     capacity      Number of record slots, always a power of two
+	 *   0x08    4     head          Total number of records ever written, the next record goes to head % capacity
+	 *   0x0c    4     bootCount     Number of boots since the trace was (re)initialized
+	 *   0x10    4     resetFlags    RCC_CSR of the latest boot
+	 *   0x14    4     frequency     Core clock in Hz, to convert timestamps to seconds
+	 *   0x18    8*n   records       Ring of records, the oldest valid one is at (head - min(head, capacity)) % capacity
+	 *
+	 * Each record is 8 bytes:
+	 *
+	 *   0x00    4     timestamp     Core cycles since the bootloader started
+	 *   0x04    1     event         TraceEvent
+	 *   0x05    1     status        0 on success, otherwise an event specific error code
+	 *   0x06    2     value         Event specific value (e.g. page number)
+	 */
+	enum class TraceEvent : uint8_t
+	{
+		BOOT = 1,           ///< value: RCC_CSR >> 16
+		APPLICATION_CHECK,  ///< status: Bootloader::ApplicationCheck
+		APPLICATION_JUMP,   ///< value: stack high-water mark in bytes, see StackMonitor
+		FLASH_ERASE,        ///< value: page number
+		FLASH_WRITE,        ///< value: page number
+		VERIFICATION_CACHE, ///< status: 1 if the image had to be verified fully
+		SIGNATURE_CHECK,    ///< status: 1 if the signature is invalid, value: cycles / 1024
+		LISTEN_WINDOW       ///< status: 1 if a STAY request was answered, value: microseconds spent listening
+	};
+
+	struct TraceRecord
+	{
+		uint32_t timestamp;
+		uint8_t event;
+		uint8_t status;
+		uint16_t value;
+	};
+
+	struct TraceBuffer
+	{
+		uint32_t magic;
+		uint16_t version;
+		uint16_t capacity;
+		uint32_t head;
+		uint32_t bootCount;
+		uint32_t resetFlags;
+		uint32_t frequency;
+		TraceRecord records[OSSHS_TRACE_CAPACITY];
+	};
+
+	static_assert(!(OSSHS_TRACE_CAPACITY & (OSSHS_TRACE_CAPACITY - 1)), "OSSHS_TRACE_CAPACITY must be a power of two.");
+	static_assert(sizeof(TraceRecord) == 8, "TraceRecord layout must not change.");
+	static_assert(sizeof(TraceBuffer) <= OSSHS_BOOTLOADER_TRACE_LENGTH, "TraceBuffer does not fit its memory region.");
+
+	class Trace
+	{
+	public:
+		/**
+		 * @brief Initialize the trace.
+		 * @note Records from previous boots are kept if the trace is still valid.
+		 * @param resetFlags Value of RCC_CSR before the reset flags were cleared.
+		 * @param frequency Core clock in Hz.
+		 */
+		static void
+		initialize(uint32_t resetFlags, uint32_t frequency);
+
+		/**
+		 * @brief Append a record to the trace.
+		 * @note Only costs a few cycles, so it can be used on hot paths.
+		 * @param event Event to record.
+		 * @param status 0 on success, otherwise an event specific error code.
+		 * @param value Event specific value.
+		 */
+		static inline void
+		record(TraceEvent event, uint8_t status = 0, uint16_t value = 0)
+		{
+			TraceBuffer *trace = reinterpret_cast<TraceBuffer *>(OSSHS_BOOTLOADER_TRACE_ORIGIN);
+			TraceRecord &record = trace->records[trace->head++ & (OSSHS_TRACE_CAPACITY - 1)];
+
+			record.timestamp = CycleCounter::now();
+			record.event = static_cast<uint8_t>(event);
+			record.status = status;
+			record.value = value;
+		}
+	};
+}
+
+#endif  // OSSHS_TRACE_HPP
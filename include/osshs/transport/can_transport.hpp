@@ -0,0 +1,133 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_CAN_TRANSPORT_HPP
+#define OSSHS_CAN_TRANSPORT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <osshs/can_bus.hpp>
+
+// First byte of a frame, control frames (0xc0 to 0xcf) are handled by CanBus itself
+#define OSSHS_CAN_TRANSPORT_SINGLE      0x00  ///< Length 1 to 7 in the low nibble, data follows
+#define OSSHS_CAN_TRANSPORT_FIRST       0x10  ///< Length bits 11:8 in the low nibble, bits 7:0 and 6 bytes follow
+#define OSSHS_CAN_TRANSPORT_CONSECUTIVE 0x20  ///< Index modulo 16 in the low nibble, 7 bytes follow
+
+// A first frame and 36 consecutive frames
+#define OSSHS_CAN_TRANSPORT_MTU 258
+
+#define OSSHS_CAN_TRANSPORT_SEND_TIMEOUT_MS 20
+
+namespace osshs
+{
+	namespace transport
+	{
+		/**
+		 * Transport that segments messages into CAN frames, see CanBus for the identifiers.
+		 *
+		 * Messages of up to 7 bytes travel in a single frame, longer ones in a first frame followed by
+		 * consecutive frames, like ISO-TP but without its flow control frames: the rate limit of CanBus paces
+		 * the host instead. Frames are reassembled in place in the message buffer of the protocol, so the
+		 * transport needs no buffer of its own. Responses go to the response identifier of the node in order,
+		 * which the transmit FIFO priority of CanBus guarantees.
+		 * @tparam MTU Longest message in bytes, at most 4095.
+		 */
+		template<std::size_t MTU>
+		class CanTransport
+		{
+			static_assert(MTU > 7 && MTU <= 0xfff, "MTU must fit the 12 bit length of a first frame.");
+
+		public:
+			static constexpr std::size_t mtu = MTU;
+			static constexpr std::size_t frameSize = 8;
+
+			/**
+			 * @brief Take the next complete message.
+			 * @note message must be the same buffer on every call, partial messages are kept in it.
+			 * @param message Buffer of MTU bytes that will contain the message.
+			 * @param length Length of the message.
+			 * @return Whether or not a message is complete.
+			 */
+			static bool
+			receive(uint8_t *message, std::size_t &length);
+
+			/**
+			 * @brief Take the next single frame message straight from the receive FIFOs, without logging.
+			 * @note For the listen window at boot, see CanBus::initializePolling(). Other frames are dropped.
+			 * @param message Buffer of MTU bytes that will contain the message.
+			 * @param length Length of the message.
+			 * @return Whether or not a message was received.
+			 */
+			static bool
+			poll(uint8_t *message, std::size_t &length);
+
+			/**
+			 * @brief Send a message to the response identifier of this node.
+			 * @note Blocks until every frame got a transmit mailbox.
+			 * @param message Message to send.
+			 * @param length Length of the message, at most MTU.
+			 * @return Whether or not every frame got a transmit mailbox in time.
+			 */
+			static bool
+			send(const uint8_t *message, std::size_t length);
+
+			/**
+			 * @brief Get the time until the rate limit lets receive() take the next frame.
+			 * @return Core cycles, 0 if receive() was not held back.
+			 */
+			static uint32_t
+			getDelay();
+
+			/**
+			 * @brief Wait until the frames of the last message left the transmit mailboxes.
+			 * @return Whether or not the mailboxes emptied in time.
+			 */
+			static bool
+			flush();
+
+		private:
+			/**
+			 * @brief Queue a frame, waiting for a free transmit mailbox.
+			 */
+			static bool
+			sendFrame(const CanFrame &frame);
+
+			/**
+			 * @brief Forget a partial message.
+			 */
+			static void
+			drop(const CanFrame &frame);
+
+			static std::size_t expected;  ///< Length of the partial message, 0 if none
+			static std::size_t received;
+			static uint8_t index;         ///< Index of the next consecutive frame
+			static uint8_t fifo;          ///< FIFO of the first frame, broadcasts never continue a node's message
+			static uint32_t delay;
+		};
+	}
+}
+
+#include <osshs/transport/can_transport_impl.hpp>
+
+#endif  // OSSHS_CAN_TRANSPORT_HPP
@@ -0,0 +1,247 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_CAN_TRANSPORT_HPP
+	#error "Don't include this file directly, use 'can_transport.hpp' instead!"
+#endif
+
+#include <osshs/log/logger.hpp>
+#include <osshs/cycle_counter.hpp>
+#include <modm/platform.hpp>
+#include <cstring>
+
+namespace osshs
+{
+	namespace transport
+	{
+		template<std::size_t MTU>
+		std::size_t CanTransport<MTU>::expected = 0;
+
+		template<std::size_t MTU>
+		std::size_t CanTransport<MTU>::received = 0;
+
+		template<std::size_t MTU>
+		uint8_t CanTransport<MTU>::index = 0;
+
+		template<std::size_t MTU>
+		uint8_t CanTransport<MTU>::fifo = 0;
+
+		template<std::size_t MTU>
+		uint32_t CanTransport<MTU>::delay = 0;
+
+		template<std::size_t MTU>
+		bool
+		CanTransport<MTU>::receive(uint8_t *message, std::size_t &length)
+		{
+			delay = 0;
+
+			CanFrame frame;
+			while (CanBus::isPending())
+			{
+				// Frames beyond the rate limit stay queued until the bucket refilled
+				if (!CanBus::acquire())
+				{
+					delay = CanBus::getAcquireDelay();
+					return false;
+				}
+
+				CanBus::receive(frame);
+				if (!frame.length || CanBus::handleRateLimitRequest(frame))
+					continue;
+
+				uint8_t header = frame.data[0];
+				uint8_t count = header & 0x0f;
+
+				switch (header & 0xf0)
+				{
+					case OSSHS_CAN_TRANSPORT_SINGLE:
+						if (!count || count > 7 || count >= frame.length)
+						{
+							drop(frame);
+							break;
+						}
+
+						std::memcpy(message, frame.data + 1, count);
+						length = count;
+						expected = 0;
+						return true;
+
+					case OSSHS_CAN_TRANSPORT_FIRST:
+						expected = count << 8 | frame.data[1];
+						if (frame.length != 8 || expected <= 7 || expected > MTU)
+						{
+							drop(frame);
+							break;
+						}
+
+						std::memcpy(message, frame.data + 2, 6);
+						received = 6;
+						index = 1;
+						fifo = frame.fifo;
+						break;
+
+					case OSSHS_CAN_TRANSPORT_CONSECUTIVE:
+					{
+						std::size_t remaining = expected - received;
+						if (!expected || count != index || frame.fifo != fifo ||
+							frame.length < 1 + (remaining < 7 ? remaining : 7))
+						{
+							drop(frame);
+							break;
+						}
+
+						count = remaining < 7 ? remaining : 7;
+						std::memcpy(message + received, frame.data + 1, count);
+						received += count;
+						index = (index + 1) & 0x0f;
+
+						if (received == expected)
+						{
+							length = expected;
+							expected = 0;
+							return true;
+						}
+						break;
+					}
+
+					default:
+						drop(frame);
+						break;
+				}
+			}
+
+			return false;
+		}
+
+		template<std::size_t MTU>
+		bool
+		CanTransport<MTU>::poll(uint8_t *message, std::size_t &length)
+		{
+			// Requests that fit a single frame are all the window waits for
+			CanFrame frame;
+			while (CanBus::poll(frame))
+			{
+				uint8_t count = frame.data[0] & 0x0f;
+				if ((frame.data[0] & 0xf0) != OSSHS_CAN_TRANSPORT_SINGLE || !count || count > 7 || count >= frame.length)
+					continue;
+
+				std::memcpy(message, frame.data + 1, count);
+				length = count;
+				return true;
+			}
+
+			return false;
+		}
+
+		template<std::size_t MTU>
+		bool
+		CanTransport<MTU>::send(const uint8_t *message, std::size_t length)
+		{
+			if (length > MTU)
+				return false;
+
+			CanFrame frame;
+			frame.id = OSSHS_CAN_RESPONSE_ID(CanBus::getNodeId());
+			frame.fifo = 0;
+
+			if (length <= 7)
+			{
+				frame.length = 1 + length;
+				frame.data[0] = OSSHS_CAN_TRANSPORT_SINGLE | length;
+				std::memcpy(frame.data + 1, message, length);
+				return sendFrame(frame);
+			}
+
+			frame.length = 8;
+			frame.data[0] = OSSHS_CAN_TRANSPORT_FIRST | length >> 8;
+			frame.data[1] = length;
+			std::memcpy(frame.data + 2, message, 6);
+			if (!sendFrame(frame))
+				return false;
+
+			std::size_t sent = 6;
+			for (uint8_t i = 1; sent < length; i = (i + 1) & 0x0f)
+			{
+				std::size_t count = length - sent < 7 ? length - sent : 7;
+
+				frame.length = 1 + count;
+				frame.data[0] = OSSHS_CAN_TRANSPORT_CONSECUTIVE | i;
+				std::memcpy(frame.data + 1, message + sent, count);
+				if (!sendFrame(frame))
+					return false;
+
+				sent += count;
+			}
+
+			return true;
+		}
+
+		template<std::size_t MTU>
+		uint32_t
+		CanTransport<MTU>::getDelay()
+		{
+			return delay;
+		}
+
+		template<std::size_t MTU>
+		bool
+		CanTransport<MTU>::flush()
+		{
+			uint32_t start = CycleCounter::now();
+			uint32_t timeout = modm::clock::fcpu / 1000 * OSSHS_CAN_TRANSPORT_SEND_TIMEOUT_MS;
+
+			while ((CAN1->TSR & (CAN_TSR_TME0 | CAN_TSR_TME1 | CAN_TSR_TME2)) !=
+				(CAN_TSR_TME0 | CAN_TSR_TME1 | CAN_TSR_TME2))
+				if (CycleCounter::now() - start > timeout)
+					return false;
+
+			return true;
+		}
+
+		template<std::size_t MTU>
+		bool
+		CanTransport<MTU>::sendFrame(const CanFrame &frame)
+		{
+			uint32_t start = CycleCounter::now();
+			uint32_t timeout = modm::clock::fcpu / 1000 * OSSHS_CAN_TRANSPORT_SEND_TIMEOUT_MS;
+
+			// Without an acknowledging node on the bus the mailboxes never empty
+			while (!CanBus::send(frame))
+				if (CycleCounter::now() - start > timeout)
+					return false;
+
+			return true;
+		}
+
+		template<std::size_t MTU>
+		void
+		CanTransport<MTU>::drop(const CanFrame &frame)
+		{
+			OSSHS_LOG_WARNING("Receiving CAN message failed. Unexpected frame(header = `0x%02x`, length = `%u`, expected = `%u`).",
+				frame.data[0], frame.length, expected);
+
+			expected = 0;
+		}
+	}
+}
@@ -0,0 +1,92 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_LOOPBACK_TRANSPORT_HPP
+#define OSSHS_LOOPBACK_TRANSPORT_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace osshs
+{
+	namespace transport
+	{
+		/**
+		 * Transport that hands whole messages between the update protocol and a host in the same program,
+		 * e.g. the simulator, without any link in between.
+		 *
+		 * Holds one request and one response, which is all a host waiting for every response needs.
+		 * @tparam MTU Longest message in bytes.
+		 */
+		template<std::size_t MTU>
+		class LoopbackTransport
+		{
+		public:
+			static constexpr std::size_t mtu = MTU;
+			static constexpr std::size_t frameSize = MTU;
+
+			/**
+			 * @brief Hand a request to the protocol.
+			 * @note Called by the host.
+			 * @param message Request.
+			 * @param length Length of the request, at most MTU.
+			 * @return Whether or not the request was taken, false if the last one is still pending.
+			 */
+			static bool
+			deliver(const uint8_t *message, std::size_t length);
+
+			/**
+			 * @brief Take the response to the last request.
+			 * @note Called by the host.
+			 * @param message Buffer of MTU bytes that will contain the response.
+			 * @param length Length of the response.
+			 * @return Whether or not a response was sent.
+			 */
+			static bool
+			takeResponse(uint8_t *message, std::size_t &length);
+
+			static bool
+			receive(uint8_t *message, std::size_t &length);
+
+			static bool
+			send(const uint8_t *message, std::size_t length);
+
+			static uint32_t
+			getDelay()
+			{
+				return 0;
+			}
+
+		private:
+			static uint8_t request[MTU];
+			static std::size_t requestLength;
+			static uint8_t response[MTU];
+			static std::size_t responseLength;
+		};
+	}
+}
+
+#include <osshs/transport/loopback_transport_impl.hpp>
+
+#endif  // OSSHS_LOOPBACK_TRANSPORT_HPP
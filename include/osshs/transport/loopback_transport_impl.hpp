@@ -0,0 +1,97 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_LOOPBACK_TRANSPORT_HPP
+	#error "Don't include this file directly, use 'loopback_transport.hpp' instead!"
+#endif
+
+#include <cstring>
+
+namespace osshs
+{
+	namespace transport
+	{
+		template<std::size_t MTU>
+		uint8_t LoopbackTransport<MTU>::request[MTU];
+
+		template<std::size_t MTU>
+		std::size_t LoopbackTransport<MTU>::requestLength = 0;
+
+		template<std::size_t MTU>
+		uint8_t LoopbackTransport<MTU>::response[MTU];
+
+		template<std::size_t MTU>
+		std::size_t LoopbackTransport<MTU>::responseLength = 0;
+
+		template<std::size_t MTU>
+		bool
+		LoopbackTransport<MTU>::deliver(const uint8_t *message, std::size_t length)
+		{
+			if (requestLength || !length || length > MTU)
+				return false;
+
+			std::memcpy(request, message, length);
+			requestLength = length;
+			return true;
+		}
+
+		template<std::size_t MTU>
+		bool
+		LoopbackTransport<MTU>::takeResponse(uint8_t *message, std::size_t &length)
+		{
+			if (!responseLength)
+				return false;
+
+			std::memcpy(message, response, responseLength);
+			length = responseLength;
+			responseLength = 0;
+			return true;
+		}
+
+		template<std::size_t MTU>
+		bool
+		LoopbackTransport<MTU>::receive(uint8_t *message, std::size_t &length)
+		{
+			if (!requestLength)
+				return false;
+
+			std::memcpy(message, request, requestLength);
+			length = requestLength;
+			requestLength = 0;
+			return true;
+		}
+
+		template<std::size_t MTU>
+		bool
+		LoopbackTransport<MTU>::send(const uint8_t *message, std::size_t length)
+		{
+			if (length > MTU)
+				return false;
+
+			std::memcpy(response, message, length);
+			responseLength = length;
+			return true;
+		}
+	}
+}
@@ -0,0 +1,199 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_UART_TRANSPORT_HPP
+#define OSSHS_UART_TRANSPORT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <osshs/spsc_queue.hpp>
+
+// Frames are COBS encoded and start and end with the delimiter, which never occurs inside a frame
+#define OSSHS_UART_TRANSPORT_DELIMITER 0x00
+
+// Header, offset and 256 bytes of a WRITE request
+#define OSSHS_UART_TRANSPORT_MTU 262
+
+#define OSSHS_UART_TRANSPORT_QUEUE_SIZE         512
+#define OSSHS_UART_TRANSPORT_INTERRUPT_PRIORITY 6
+
+namespace osshs
+{
+	namespace transport
+	{
+		/**
+		 * Output that does not share USART1 with the transport.
+		 */
+		struct NoSharedOutput
+		{
+			static void
+			pause()
+			{
+			}
+
+			static void
+			resume()
+			{
+			}
+		};
+
+		/**
+		 * Transport that frames messages on USART1 with COBS and a CRC-16.
+		 *
+		 * The frame holds the message and its CRC-16/CCITT-FALSE (big endian), COBS encoded so that the
+		 * delimiter only marks frame boundaries. Log records share USART1, but are plain text without the
+		 * delimiter: the host takes what is between two delimiters as a frame and drops it if its CRC does not
+		 * match. The log device is paused while a frame is sent, so records never end up inside a frame and
+		 * responses never wait for the log to drain. The receive interrupt queues bytes and only posts the task
+		 * on a delimiter, so a frame costs one task run instead of one per byte.
+		 * @tparam MTU Longest message in bytes.
+		 * @tparam SHARED_OUTPUT Other output on USART1 with static pause() and resume(), e.g. log::DmaUsartDevice.
+		 */
+		template<std::size_t MTU, typename SHARED_OUTPUT = NoSharedOutput>
+		class UartTransport
+		{
+		public:
+			static constexpr std::size_t mtu = MTU;
+			/// Longest frame on the wire, with both delimiters, the CRC and one COBS code per 254 bytes
+			static constexpr std::size_t frameSize = 2 + (MTU + 2) + (MTU + 2) / 254 + 1;
+
+			/**
+			 * @brief Enable the receive interrupt.
+			 * @note USART1 must already be initialized, see board::initialize().
+			 * @param task Event loop task to post when a frame ended.
+			 */
+			static void
+			initialize(uint8_t task);
+
+			/**
+			 * @brief Disable the receive interrupt.
+			 */
+			static void
+			deinitialize();
+
+			/**
+			 * @brief Take the next complete message.
+			 * @note message must be the same buffer on every call, partial messages are kept in it.
+			 * @param message Buffer of MTU bytes that will contain the message.
+			 * @param length Length of the message.
+			 * @return Whether or not a message is complete.
+			 */
+			static bool
+			receive(uint8_t *message, std::size_t &length);
+
+			/**
+			 * @brief Take a byte straight from the data register and the next complete message, without logging.
+			 * @note For the listen window at boot, the receive interrupt must be disabled. Invalid frames are dropped.
+			 * @param message Buffer of MTU bytes that will contain the message, the same one on every call.
+			 * @param length Length of the message.
+			 * @return Whether or not a message is complete.
+			 */
+			static bool
+			poll(uint8_t *message, std::size_t &length);
+
+			/**
+			 * @brief Send a message.
+			 * @note Pauses SHARED_OUTPUT while the frame is written and blocks until its last byte is in the
+			 *       data register.
+			 * @param message Message to send.
+			 * @param length Length of the message, at most MTU.
+			 * @return Whether or not the message was sent.
+			 */
+			static bool
+			send(const uint8_t *message, std::size_t length);
+
+			static uint32_t
+			getDelay()
+			{
+				return 0;
+			}
+
+			/**
+			 * @brief Wait until the last byte left the shift register.
+			 * @return Always true.
+			 */
+			static bool
+			flush();
+
+			/**
+			 * @brief Get the number of bytes lost because the data register or the queue overflowed.
+			 * @return Number of lost bytes.
+			 */
+			static uint32_t
+			getOverruns();
+
+			/**
+			 * @brief Move a received byte to the queue.
+			 * @note Should be called from the USART1 interrupt.
+			 */
+			static void
+			handleInterrupt();
+
+		private:
+			/**
+			 * @brief Decode queued bytes up to the end of the next frame.
+			 * @param message Buffer of MTU bytes that will contain the message.
+			 * @param length Length of the message.
+			 * @param valid Whether or not the frame was valid.
+			 * @return Whether or not a frame ended.
+			 */
+			static bool
+			decode(uint8_t *message, std::size_t &length, bool &valid);
+
+			/**
+			 * @brief Feed a byte into the CRC-16/CCITT-FALSE, four bits at a time.
+			 */
+			static uint16_t
+			updateCrc(uint16_t crc, uint8_t data);
+
+			/**
+			 * @brief Append a decoded byte to the message and the CRC.
+			 */
+			static void
+			append(uint8_t *message, uint8_t data);
+
+			/**
+			 * @brief Forget the partial frame.
+			 */
+			static void
+			reset();
+
+			static void
+			writeByte(uint8_t data);
+
+			static SpscQueue<uint8_t, OSSHS_UART_TRANSPORT_QUEUE_SIZE> queue;
+			static uint32_t overruns;
+			static uint8_t task;
+
+			static std::size_t received;  ///< Decoded bytes including the CRC, only the first MTU are stored
+			static uint16_t crc;
+			static uint8_t code;          ///< COBS code of the current block, 0 before the first one
+			static uint8_t remaining;     ///< Bytes left in the current block
+		};
+	}
+}
+
+#include <osshs/transport/uart_transport_impl.hpp>
+
+#endif  // OSSHS_UART_TRANSPORT_HPP
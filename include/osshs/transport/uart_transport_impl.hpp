@@ -0,0 +1,278 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_UART_TRANSPORT_HPP
+	#error "Don't include this file directly, use 'uart_transport.hpp' instead!"
+#endif
+
+#include <osshs/log/logger.hpp>
+#include <osshs/event_loop.hpp>
+#include <modm/platform.hpp>
+
+namespace osshs
+{
+	namespace transport
+	{
+		template<std::size_t MTU, typename SHARED_OUTPUT>
+		SpscQueue<uint8_t, OSSHS_UART_TRANSPORT_QUEUE_SIZE> UartTransport<MTU, SHARED_OUTPUT>::queue;
+
+		template<std::size_t MTU, typename SHARED_OUTPUT>
+		uint32_t UartTransport<MTU, SHARED_OUTPUT>::overruns = 0;
+
+		template<std::size_t MTU, typename SHARED_OUTPUT>
+		uint8_t UartTransport<MTU, SHARED_OUTPUT>::task = OSSHS_EVENT_LOOP_INVALID_TASK;
+
+		template<std::size_t MTU, typename SHARED_OUTPUT>
+		std::size_t UartTransport<MTU, SHARED_OUTPUT>::received = 0;
+
+		template<std::size_t MTU, typename SHARED_OUTPUT>
+		uint16_t UartTransport<MTU, SHARED_OUTPUT>::crc = 0xffff;
+
+		template<std::size_t MTU, typename SHARED_OUTPUT>
+		uint8_t UartTransport<MTU, SHARED_OUTPUT>::code = 0;
+
+		template<std::size_t MTU, typename SHARED_OUTPUT>
+		uint8_t UartTransport<MTU, SHARED_OUTPUT>::remaining = 0;
+
+		template<std::size_t MTU, typename SHARED_OUTPUT>
+		void
+		UartTransport<MTU, SHARED_OUTPUT>::initialize(uint8_t task)
+		{
+			UartTransport<MTU, SHARED_OUTPUT>::task = task;
+			overruns = 0;
+			reset();
+
+			USART1->CR1 |= USART_CR1_RXNEIE;
+
+			NVIC_SetPriority(USART1_IRQn, OSSHS_UART_TRANSPORT_INTERRUPT_PRIORITY);
+			NVIC_EnableIRQ(USART1_IRQn);
+		}
+
+		template<std::size_t MTU, typename SHARED_OUTPUT>
+		void
+		UartTransport<MTU, SHARED_OUTPUT>::deinitialize()
+		{
+			NVIC_DisableIRQ(USART1_IRQn);
+			USART1->CR1 &= ~USART_CR1_RXNEIE;
+
+			task = OSSHS_EVENT_LOOP_INVALID_TASK;
+		}
+
+		template<std::size_t MTU, typename SHARED_OUTPUT>
+		bool
+		UartTransport<MTU, SHARED_OUTPUT>::receive(uint8_t *message, std::size_t &length)
+		{
+			bool valid;
+			while (decode(message, length, valid))
+			{
+				if (valid)
+					return true;
+
+				OSSHS_LOG_WARNING("Receiving UART message failed. Invalid frame(length = `%u`).", length + 2);
+			}
+
+			return false;
+		}
+
+		template<std::size_t MTU, typename SHARED_OUTPUT>
+		bool
+		UartTransport<MTU, SHARED_OUTPUT>::poll(uint8_t *message, std::size_t &length)
+		{
+			// Does nothing unless a byte arrived, the queue takes it as the interrupt would
+			handleInterrupt();
+
+			bool valid;
+			while (decode(message, length, valid))
+				if (valid)
+					return true;
+
+			return false;
+		}
+
+		template<std::size_t MTU, typename SHARED_OUTPUT>
+		bool
+		UartTransport<MTU, SHARED_OUTPUT>::decode(uint8_t *message, std::size_t &length, bool &valid)
+		{
+			uint8_t data;
+			while (queue.pop(data))
+			{
+				if (data == OSSHS_UART_TRANSPORT_DELIMITER)
+				{
+					// Empty frames are the leading delimiters of frames
+					if (!code)
+						continue;
+
+					// The CRC over the message and its own big endian value leaves no remainder
+					valid = !remaining && received >= 2 && received - 2 <= MTU && !crc;
+					length = received - 2;
+					reset();
+					return true;
+				}
+
+				if (remaining)
+				{
+					append(message, data);
+					remaining--;
+					continue;
+				}
+
+				// Every block but the last and those of 254 bytes ends in an encoded zero
+				if (code && code != 0xff)
+					append(message, 0);
+
+				code = data;
+				remaining = data - 1;
+			}
+
+			return false;
+		}
+
+		template<std::size_t MTU, typename SHARED_OUTPUT>
+		bool
+		UartTransport<MTU, SHARED_OUTPUT>::send(const uint8_t *message, std::size_t length)
+		{
+			if (length > MTU)
+				return false;
+
+			uint16_t checksum = 0xffff;
+			for (std::size_t i = 0; i < length; i++)
+				checksum = updateCrc(checksum, message[i]);
+
+			const uint8_t trailer[2] = {static_cast<uint8_t>(checksum >> 8), static_cast<uint8_t>(checksum)};
+			std::size_t total = length + 2;
+			auto at = [&](std::size_t i) { return i < length ? message[i] : trailer[i - length]; };
+
+			// The log continues where it stopped once the frame is out, a partial record only delays it
+			SHARED_OUTPUT::pause();
+
+			writeByte(OSSHS_UART_TRANSPORT_DELIMITER);
+
+			std::size_t start = 0;
+			while (true)
+			{
+				std::size_t end = start;
+				while (end < total && at(end) && end - start < 254)
+					end++;
+
+				writeByte(end - start + 1);
+				for (std::size_t i = start; i < end; i++)
+					writeByte(at(i));
+
+				if (end == total)
+					break;
+
+				// A full block has no encoded zero behind it
+				start = end - start == 254 ? end : end + 1;
+			}
+
+			writeByte(OSSHS_UART_TRANSPORT_DELIMITER);
+
+			SHARED_OUTPUT::resume();
+			return true;
+		}
+
+		template<std::size_t MTU, typename SHARED_OUTPUT>
+		bool
+		UartTransport<MTU, SHARED_OUTPUT>::flush()
+		{
+			while (!(USART1->SR & USART_SR_TC));
+			return true;
+		}
+
+		template<std::size_t MTU, typename SHARED_OUTPUT>
+		uint32_t
+		UartTransport<MTU, SHARED_OUTPUT>::getOverruns()
+		{
+			return overruns;
+		}
+
+		template<std::size_t MTU, typename SHARED_OUTPUT>
+		void
+		UartTransport<MTU, SHARED_OUTPUT>::handleInterrupt()
+		{
+			uint32_t status = USART1->SR;
+			if (!(status & (USART_SR_RXNE | USART_SR_ORE)))
+				return;
+
+			// Reading DR after SR clears RXNE and ORE
+			uint8_t data = USART1->DR;
+
+			if (status & USART_SR_ORE)
+				overruns++;
+
+			if (!queue.push(data))
+				overruns++;
+
+			if (data == OSSHS_UART_TRANSPORT_DELIMITER && task != OSSHS_EVENT_LOOP_INVALID_TASK)
+				EventLoop::post(task);
+		}
+
+		template<std::size_t MTU, typename SHARED_OUTPUT>
+		uint16_t
+		UartTransport<MTU, SHARED_OUTPUT>::updateCrc(uint16_t crc, uint8_t data)
+		{
+			// Polynomial 0x1021, one entry per value of the top four bits
+			static constexpr uint16_t table[16] = {
+				0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+				0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef
+			};
+
+			crc = crc << 4 ^ table[(crc >> 12) ^ (data >> 4)];
+			crc = crc << 4 ^ table[(crc >> 12) ^ (data & 0x0f)];
+			return crc;
+		}
+
+		template<std::size_t MTU, typename SHARED_OUTPUT>
+		void
+		UartTransport<MTU, SHARED_OUTPUT>::append(uint8_t *message, uint8_t data)
+		{
+			// The CRC needs no storage, it only has to leave no remainder
+			if (received < MTU)
+				message[received] = data;
+
+			if (received <= MTU + 2)
+				received++;
+
+			crc = updateCrc(crc, data);
+		}
+
+		template<std::size_t MTU, typename SHARED_OUTPUT>
+		void
+		UartTransport<MTU, SHARED_OUTPUT>::reset()
+		{
+			received = 0;
+			crc = 0xffff;
+			code = 0;
+			remaining = 0;
+		}
+
+		template<std::size_t MTU, typename SHARED_OUTPUT>
+		void
+		UartTransport<MTU, SHARED_OUTPUT>::writeByte(uint8_t data)
+		{
+			while (!(USART1->SR & USART_SR_TXE));
+			USART1->DR = data;
+		}
+	}
+}
@@ -0,0 +1,292 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_UPDATE_PROTOCOL_HPP
+#define OSSHS_UPDATE_PROTOCOL_HPP
+
+#include <osshs/crypto/aes128_ctr.hpp>
+#include <osshs/crypto/sha256.hpp>
+#include <cstddef>
+#include <cstdint>
+
+#define OSSHS_UPDATE_PROTOCOL_VERSION 6
+
+// Requests start with (command, sequence), responses with (command | 0x80, sequence, status)
+#define OSSHS_UPDATE_REQUEST_HEADER_SIZE  2
+#define OSSHS_UPDATE_RESPONSE_HEADER_SIZE 3
+#define OSSHS_UPDATE_RESPONSE_FLAG        0x80
+
+// Smallest MTU a transport may have, the FINISH response carries a SHA-256 digest
+#define OSSHS_UPDATE_MINIMUM_MTU (OSSHS_UPDATE_RESPONSE_HEADER_SIZE + OSSHS_SHA256_DIGEST_SIZE)
+
+// READ data is a sequence of literal blocks (n - 1, n bytes) and erased runs (0x80 | (n - 1) >> 8, (n - 1) & 0xff)
+#define OSSHS_UPDATE_READ_BLANK_FLAG  0x80
+#define OSSHS_UPDATE_READ_LITERAL_MAX 0x0080
+#define OSSHS_UPDATE_READ_BLANK_MIN   3
+#define OSSHS_UPDATE_READ_BLANK_MAX   0x8000
+
+// Flag of the BEGIN mode: WRITE data is encrypted with AES-128-CTR and BEGIN carries the initial counter block
+#define OSSHS_UPDATE_MODE_ENCRYPTED 0x80
+
+namespace osshs
+{
+	enum class UpdateCommand : uint8_t
+	{
+		INFO = 0x01,    ///< () -> (version, mtu[2], frameSize[2], pageSize[2], origin[4], length[4])
+		BEGIN = 0x02,   ///< (address[4], length[4], UpdateMode[, counter[16]]) -> (), counter with OSSHS_UPDATE_MODE_ENCRYPTED
+		WRITE = 0x03,   ///< (offset[4], data...) -> (written[4]), bytes between written and offset are left erased
+		FINISH = 0x04,  ///< () -> (digest[32])
+		ABORT = 0x05,   ///< () -> ()
+		BOOT = 0x06,    ///< () -> (), the application is loaded once the response is sent
+		READ = 0x07,    ///< (address[4], length[4]) -> (read[4], data...), as much of the range as fits the MTU
+		HASH = 0x08,    ///< (address[4], length[4], UpdateHashMode) -> (crc[4]...)
+		WEAR = 0x09,    ///< (page[2]) -> (erases[2]...), erase counts from page on, as many pages as fit the MTU
+		STAY = 0x0a,    ///< (node) -> (), keeps the bootloader active if it arrives in the listen window at boot
+		STACK = 0x0b    ///< () -> (highWaterMark[4], size[4]), main stack usage in bytes, see StackMonitor
+	};
+
+	enum class UpdateMode : uint8_t
+	{
+		STREAM = 0x00,     ///< Raw image, see ImageWriterMode::STREAM
+		READ_BACK = 0x01,  ///< Raw image, see ImageWriterMode::READ_BACK
+		CONTAINER = 0x02   ///< Firmware container, address is the origin of its image and length that of the container
+	};
+
+	enum class UpdateHashMode : uint8_t
+	{
+		RANGE = 0x00,  ///< One CRC of the whole range, which must be word aligned
+		PAGES = 0x01   ///< One CRC per page from a page origin, as many pages as fit the MTU
+	};
+
+	enum class UpdateStatus : uint8_t
+	{
+		OK = 0x00,
+		UNKNOWN_COMMAND = 0x01,
+		INVALID_LENGTH = 0x02,
+		INVALID_STATE = 0x03,
+		INVALID_ARGUMENT = 0x04,
+		FLASH_ERROR = 0x05,
+		VERIFY_ERROR = 0x06
+	};
+
+	/**
+	 * Update protocol engine, written once and instantiated per transport.
+	 *
+	 * The host sends one request and waits for its response, multi-byte values are little endian. A request
+	 * that is repeated because its response was lost is answered again without side effects, e.g. a WRITE at an
+	 * offset that was already written only reports the number of bytes written.
+	 *
+	 * Raw images may be sent sparse: runs of 0xff are not sent, the next WRITE simply starts behind them. The gap
+	 * counts as 0xff for the digest and its pages are erased but never programmed.
+	 *
+	 * READ and HASH audit any range of flash. READ compresses erased runs, so a mostly empty region takes a few
+	 * requests, and the host continues at address + read. HASH returns CRCs as calculated by Flash, so the host
+	 * compares a node against an image without transferring it. WEAR reports how often each page was erased, see
+	 * WearJournal.
+	 *
+	 * With OSSHS_BOOTLOADER_DECRYPT, BEGIN requires the mode flag OSSHS_UPDATE_MODE_ENCRYPTED, plain images are
+	 * refused. The data of every WRITE is decrypted in place in the message buffer, at its offset in the keystream,
+	 * before it reaches the writers, so raw images and containers are decrypted alike and the digest of FINISH is
+	 * that of the plain data. Gaps of sparse images are not encrypted, they stay erased. READ and HASH refuse the
+	 * key page.
+	 *
+	 * READ refuses everything from the key page on, the application and configuration included, and HASH only
+	 * accepts whole pages, whose CRCs only tell whether a page matches an image the host already has. This keeps
+	 * requests from reading out what was decrypted, it does not make the key or the image secret: CTR mode is not
+	 * authenticated, so anyone with an encrypted image can flip bits of its plaintext, e.g. patch it into code that
+	 * sends the key page, and install it. Only OSSHS_BOOTLOADER_VERIFY_SIGNATURE refuses such images.
+	 *
+	 * Every transport has its own UpdateProtocol, but the writers and Flash are shared, so UpdateSession lets only
+	 * the link that answered BEGIN write until its session ends. The other links get INVALID_STATE for BEGIN,
+	 * WRITE, FINISH, ABORT and BOOT meanwhile.
+	 *
+	 * A node with a valid application only listens for a moment after reset, see Bootloader::listen(). To reach
+	 * it, the host repeats STAY with the node id until it is answered, and then resets the node, e.g. by power.
+	 *
+	 * The transport is a static policy class, so every call is resolved and inlined at compile time:
+	 * @code
+	 * struct Transport
+	 * {
+	 *     static constexpr std::size_t mtu;        // Longest message in bytes, sizes the message buffer
+	 *     static constexpr std::size_t frameSize;  // Bytes per frame on the link, reported to the host
+	 *
+	 *     static bool receive(uint8_t *message, std::size_t &length);     // Take the next complete message
+	 *     static bool send(const uint8_t *message, std::size_t length);  // Send a message, blocking
+	 *     static uint32_t getDelay();  // Cycles until receive() may succeed again if flow control held it back,
+	 *                                  // 0 if the transport posts the task itself when data arrives
+	 *     static bool poll(uint8_t *message, std::size_t &length);  // Optional, receive() without interrupts
+	 *                                                              // or logging, only needed by poll()
+	 * };
+	 * @endcode
+	 * @tparam TRANSPORT Transport policy.
+	 */
+	template<typename TRANSPORT>
+	class UpdateProtocol
+	{
+		static_assert(TRANSPORT::mtu >= OSSHS_UPDATE_MINIMUM_MTU, "The MTU of the transport is too small.");
+
+	public:
+		/**
+		 * @brief Set the event loop task that handles this protocol.
+		 * @param task Task id, posted again when the transport asks for a delay.
+		 */
+		static void
+		initialize(uint8_t task);
+
+		/**
+		 * @brief Handle all complete requests.
+		 * @note Event loop task of this protocol.
+		 */
+		static void
+		handle();
+
+		/**
+		 * @brief Answer a STAY request addressed to this node, if one was received.
+		 * @note For the listen window at boot, before initialize(). Other requests are dropped without a response.
+		 * @return Whether or not a STAY request was answered.
+		 */
+		static bool
+		poll();
+
+		/**
+		 * @brief Check if the host asked to load the application.
+		 * @return Whether or not a BOOT request was answered.
+		 */
+		static bool
+		isBootRequested();
+
+		/**
+		 * @brief Check if an image is being written.
+		 * @return Whether or not a BEGIN was answered and neither FINISH nor ABORT ended it yet.
+		 */
+		static bool
+		isUpdateInProgress();
+
+	private:
+		/**
+		 * @brief Handle a request in the message buffer and send its response.
+		 * @param length Length of the request in bytes.
+		 */
+		static void
+		process(std::size_t length);
+
+		static UpdateStatus
+		handleInfo(std::size_t length, std::size_t &responseLength);
+
+		static UpdateStatus
+		handleBegin(std::size_t length, std::size_t &responseLength);
+
+		static UpdateStatus
+		handleWrite(std::size_t length, std::size_t &responseLength);
+
+		static UpdateStatus
+		handleFinish(std::size_t length, std::size_t &responseLength);
+
+		static UpdateStatus
+		handleAbort(std::size_t length, std::size_t &responseLength);
+
+		static UpdateStatus
+		handleBoot(std::size_t length, std::size_t &responseLength);
+
+		static UpdateStatus
+		handleRead(std::size_t length, std::size_t &responseLength);
+
+		static UpdateStatus
+		handleHash(std::size_t length, std::size_t &responseLength);
+
+		static UpdateStatus
+		handleWear(std::size_t length, std::size_t &responseLength);
+
+		static UpdateStatus
+		handleStay(std::size_t length, std::size_t &responseLength);
+
+		static UpdateStatus
+		handleStack(std::size_t length, std::size_t &responseLength);
+
+		/**
+		 * @brief Count erased bytes.
+		 * @param address Address to start at.
+		 * @param end Address to stop at.
+		 * @return Number of consecutive bytes of 0xff at address, at most OSSHS_UPDATE_READ_BLANK_MAX.
+		 */
+		static uint32_t
+		countBlank(uint32_t address, uint32_t end);
+
+		/**
+		 * @brief Decrypt data of the current session in place, if BEGIN announced it encrypted.
+		 * @param data Data to decrypt.
+		 * @param length Length of the data in bytes.
+		 * @param offset Offset of the data in the image.
+		 */
+		static void
+		decryptImage(uint8_t *data, std::size_t length, uint32_t offset);
+
+		/**
+		 * @brief Write data of the current session with the writer BEGIN chose.
+		 * @param data Data to write.
+		 * @param length Length of the data in bytes.
+		 * @return Whether or not writing succeeded.
+		 */
+		static bool
+		writeImage(const uint8_t *data, std::size_t length);
+
+		static bool
+		finishImage(uint8_t *digest);
+
+		static void
+		abortImage();
+
+		static uint32_t
+		getWritten();
+
+		static uint16_t
+		getUint16(const uint8_t *data);
+
+		static uint32_t
+		getUint32(const uint8_t *data);
+
+		static void
+		setUint16(uint8_t *data, uint16_t value);
+
+		static void
+		setUint32(uint8_t *data, uint32_t value);
+
+		// Requests are parsed and answered in place
+		static uint8_t message[TRANSPORT::mtu];
+		static uint8_t task;
+		static bool writing;
+		static bool container;
+		static bool finished;
+		static uint8_t digest[OSSHS_SHA256_DIGEST_SIZE];
+		static bool bootRequested;
+
+		// Only instantiated with OSSHS_BOOTLOADER_DECRYPT
+		static crypto::Aes128Ctr cipher;
+		static bool encrypted;
+	};
+}
+
+#include <osshs/update_protocol_impl.hpp>
+
+#endif  // OSSHS_UPDATE_PROTOCOL_HPP
@@ -0,0 +1,684 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_UPDATE_PROTOCOL_HPP
+	#error "Don't include this file directly, use 'update_protocol.hpp' instead!"
+#endif
+
+#include <osshs/log/logger.hpp>
+#include <osshs/bootloader.hpp>
+#include <osshs/container_writer.hpp>
+#include <osshs/event_loop.hpp>
+#include <osshs/flash.hpp>
+#include <osshs/image_writer.hpp>
+#include <osshs/key_store.hpp>
+#include <osshs/stack_monitor.hpp>
+#include <osshs/update_session.hpp>
+#include <osshs/wear_journal.hpp>
+#include <cstring>
+
+namespace osshs
+{
+	template<typename TRANSPORT>
+	uint8_t UpdateProtocol<TRANSPORT>::message[TRANSPORT::mtu];
+
+	template<typename TRANSPORT>
+	uint8_t UpdateProtocol<TRANSPORT>::task = OSSHS_EVENT_LOOP_INVALID_TASK;
+
+	template<typename TRANSPORT>
+	bool UpdateProtocol<TRANSPORT>::writing = false;
+
+	template<typename TRANSPORT>
+	bool UpdateProtocol<TRANSPORT>::container = false;
+
+	template<typename TRANSPORT>
+	bool UpdateProtocol<TRANSPORT>::finished = false;
+
+	template<typename TRANSPORT>
+	uint8_t UpdateProtocol<TRANSPORT>::digest[OSSHS_SHA256_DIGEST_SIZE];
+
+	template<typename TRANSPORT>
+	bool UpdateProtocol<TRANSPORT>::bootRequested = false;
+
+	template<typename TRANSPORT>
+	crypto::Aes128Ctr UpdateProtocol<TRANSPORT>::cipher;
+
+	template<typename TRANSPORT>
+	bool UpdateProtocol<TRANSPORT>::encrypted = false;
+
+	template<typename TRANSPORT>
+	void
+	UpdateProtocol<TRANSPORT>::initialize(uint8_t task)
+	{
+		UpdateProtocol<TRANSPORT>::task = task;
+		writing = false;
+		finished = false;
+		bootRequested = false;
+	}
+
+	template<typename TRANSPORT>
+	void
+	UpdateProtocol<TRANSPORT>::handle()
+	{
+		std::size_t length;
+		while (!bootRequested && TRANSPORT::receive(message, length))
+			process(length);
+
+		// Flow control held a request back, nothing else would post the task again
+		uint32_t delay = TRANSPORT::getDelay();
+		if (delay && task != OSSHS_EVENT_LOOP_INVALID_TASK)
+			EventLoop::postAfter(task, delay);
+	}
+
+	template<typename TRANSPORT>
+	bool
+	UpdateProtocol<TRANSPORT>::poll()
+	{
+		std::size_t length;
+		while (TRANSPORT::poll(message, length))
+		{
+			if (length != OSSHS_UPDATE_REQUEST_HEADER_SIZE + 1 || message[0] != static_cast<uint8_t>(UpdateCommand::STAY) ||
+				message[OSSHS_UPDATE_REQUEST_HEADER_SIZE] != OSSHS_BOOTLOADER_NODE_ID)
+				continue;
+
+			process(length);
+			return true;
+		}
+
+		return false;
+	}
+
+	template<typename TRANSPORT>
+	bool
+	UpdateProtocol<TRANSPORT>::isBootRequested()
+	{
+		return bootRequested;
+	}
+
+	template<typename TRANSPORT>
+	bool
+	UpdateProtocol<TRANSPORT>::isUpdateInProgress()
+	{
+		return writing;
+	}
+
+	template<typename TRANSPORT>
+	void
+	UpdateProtocol<TRANSPORT>::process(std::size_t length)
+	{
+		if (length < OSSHS_UPDATE_REQUEST_HEADER_SIZE)
+		{
+			OSSHS_LOG_ERROR("Handling update request failed. Request too short(length = `%u`).", length);
+			return;
+		}
+
+		uint8_t command = message[0];
+		uint8_t sequence = message[1];
+		std::size_t responseLength = 0;
+		UpdateStatus status;
+
+		OSSHS_LOG_DEBUG("Handling update request(command = `0x%02x`, sequence = `%u`, length = `%u`).",
+			command, sequence, length);
+
+		switch (static_cast<UpdateCommand>(command))
+		{
+			case UpdateCommand::INFO:
+				status = handleInfo(length, responseLength);
+				break;
+			case UpdateCommand::BEGIN:
+				status = handleBegin(length, responseLength);
+				break;
+			case UpdateCommand::WRITE:
+				status = handleWrite(length, responseLength);
+				break;
+			case UpdateCommand::FINISH:
+				status = handleFinish(length, responseLength);
+				break;
+			case UpdateCommand::ABORT:
+				status = handleAbort(length, responseLength);
+				break;
+			case UpdateCommand::BOOT:
+				status = handleBoot(length, responseLength);
+				break;
+			case UpdateCommand::READ:
+				status = handleRead(length, responseLength);
+				break;
+			case UpdateCommand::HASH:
+				status = handleHash(length, responseLength);
+				break;
+			case UpdateCommand::WEAR:
+				status = handleWear(length, responseLength);
+				break;
+			case UpdateCommand::STAY:
+				status = handleStay(length, responseLength);
+				break;
+			case UpdateCommand::STACK:
+				status = handleStack(length, responseLength);
+				break;
+			default:
+				OSSHS_LOG_ERROR("Handling update request failed. Unknown command(command = `0x%02x`).", command);
+				status = UpdateStatus::UNKNOWN_COMMAND;
+				break;
+		}
+
+		// Handlers have read the request and put their payload behind the response header
+		message[0] = command | OSSHS_UPDATE_RESPONSE_FLAG;
+		message[1] = sequence;
+		message[2] = static_cast<uint8_t>(status);
+
+		if (!TRANSPORT::send(message, OSSHS_UPDATE_RESPONSE_HEADER_SIZE + responseLength))
+			OSSHS_LOG_ERROR("Sending update response failed(command = `0x%02x`, sequence = `%u`).", command, sequence);
+	}
+
+	template<typename TRANSPORT>
+	UpdateStatus
+	UpdateProtocol<TRANSPORT>::handleInfo(std::size_t length, std::size_t &responseLength)
+	{
+		if (length != OSSHS_UPDATE_REQUEST_HEADER_SIZE)
+			return UpdateStatus::INVALID_LENGTH;
+
+		uint8_t *response = message + OSSHS_UPDATE_RESPONSE_HEADER_SIZE;
+		response[0] = OSSHS_UPDATE_PROTOCOL_VERSION;
+		setUint16(response + 1, TRANSPORT::mtu);
+		setUint16(response + 3, TRANSPORT::frameSize);
+		setUint16(response + 5, Flash::pageSize);
+		setUint32(response + 7, OSSHS_BOOTLOADER_APPLICATION_ORIGIN);
+		setUint32(response + 11, OSSHS_BOOTLOADER_APPLICATION_LENGTH);
+
+		responseLength = 15;
+		return UpdateStatus::OK;
+	}
+
+	template<typename TRANSPORT>
+	UpdateStatus
+	UpdateProtocol<TRANSPORT>::handleBegin(std::size_t length, std::size_t &)
+	{
+		if (length < OSSHS_UPDATE_REQUEST_HEADER_SIZE + 9)
+			return UpdateStatus::INVALID_LENGTH;
+
+		if (UpdateSession::isOwnedByOther(message))
+		{
+			OSSHS_LOG_ERROR("Beginning update failed. Another link is writing.");
+			return UpdateStatus::INVALID_STATE;
+		}
+
+		const uint8_t *request = message + OSSHS_UPDATE_REQUEST_HEADER_SIZE;
+		uint32_t address = getUint32(request);
+		uint32_t imageLength = getUint32(request + 4);
+		uint8_t mode = request[8] & ~OSSHS_UPDATE_MODE_ENCRYPTED;
+		bool encrypting = request[8] & OSSHS_UPDATE_MODE_ENCRYPTED;
+
+		// The initial counter block follows the mode of encrypted images only
+		if (length != OSSHS_UPDATE_REQUEST_HEADER_SIZE + 9 + (encrypting ? OSSHS_AES128_BLOCK_SIZE : 0))
+			return UpdateStatus::INVALID_LENGTH;
+
+		// Only the application region may be written, a container checks the length of its image itself
+		if (address < OSSHS_BOOTLOADER_APPLICATION_ORIGIN || !imageLength ||
+			mode > static_cast<uint8_t>(UpdateMode::CONTAINER) || (mode != static_cast<uint8_t>(UpdateMode::CONTAINER) &&
+			imageLength > OSSHS_BOOTLOADER_APPLICATION_ORIGIN + OSSHS_BOOTLOADER_APPLICATION_LENGTH - address))
+		{
+			OSSHS_LOG_ERROR("Beginning update failed. Invalid image(address = `0x%08x`, length = `0x%08x`, mode = `%u`).",
+				address, imageLength, request[8]);
+			return UpdateStatus::INVALID_ARGUMENT;
+		}
+
+		// Without a key, or without decryption, encrypted images are refused before anything is erased
+		if (encrypting && (!OSSHS_BOOTLOADER_DECRYPT || !KeyStore::getKey()))
+		{
+			OSSHS_LOG_ERROR("Beginning update failed. Encrypted images are not supported(decrypt = `%d`).",
+				OSSHS_BOOTLOADER_DECRYPT);
+			return UpdateStatus::INVALID_ARGUMENT;
+		}
+
+		// A plain application could read out the key page, so a decrypting bootloader only installs encrypted ones
+		if (OSSHS_BOOTLOADER_DECRYPT && !encrypting)
+		{
+			OSSHS_LOG_ERROR("Beginning update failed. Image not encrypted(mode = `%u`).", request[8]);
+			return UpdateStatus::INVALID_ARGUMENT;
+		}
+
+		// A new BEGIN restarts the session, e.g. when its first response was lost
+		if (writing)
+			abortImage();
+		else if (!Flash::initialize())
+			return UpdateStatus::FLASH_ERROR;
+
+		UpdateSession::open(message);
+
+		container = mode == static_cast<uint8_t>(UpdateMode::CONTAINER);
+		writing = container ? ContainerWriter::begin(address, imageLength) :
+			ImageWriter::begin(address, imageLength, static_cast<ImageWriterMode>(mode));
+		finished = false;
+
+#if OSSHS_BOOTLOADER_DECRYPT
+		encrypted = encrypting;
+		if (encrypted)
+			cipher.begin(KeyStore::getKey(), request + 9);
+#endif
+
+		if (!writing)
+		{
+			Flash::deinitialize();
+			UpdateSession::close(message);
+			return UpdateStatus::INVALID_ARGUMENT;
+		}
+
+		return UpdateStatus::OK;
+	}
+
+	template<typename TRANSPORT>
+	UpdateStatus
+	UpdateProtocol<TRANSPORT>::handleWrite(std::size_t length, std::size_t &responseLength)
+	{
+		if (length < OSSHS_UPDATE_REQUEST_HEADER_SIZE + 4)
+			return UpdateStatus::INVALID_LENGTH;
+
+		if (!writing || UpdateSession::isOwnedByOther(message))
+			return UpdateStatus::INVALID_STATE;
+
+		uint8_t *request = message + OSSHS_UPDATE_REQUEST_HEADER_SIZE;
+		uint32_t offset = getUint32(request);
+		std::size_t count = length - OSSHS_UPDATE_REQUEST_HEADER_SIZE - 4;
+		uint32_t written = getWritten();
+		UpdateStatus status = UpdateStatus::OK;
+
+		if (offset < written)
+		{
+			// A repeated request was already written, the host only missed the response
+			if (offset + count > written)
+				status = UpdateStatus::INVALID_ARGUMENT;
+		}
+		else if (offset > written && container)
+		{
+			// Containers describe their blank pages themselves
+			status = UpdateStatus::INVALID_ARGUMENT;
+		}
+		else
+		{
+			// Decrypted where it was received, the writers only see plain data
+			decryptImage(request + 4, count, offset);
+
+			if ((offset > written && !ImageWriter::skip(offset - written)) || !writeImage(request + 4, count))
+			{
+				abortImage();
+				Flash::deinitialize();
+				writing = false;
+				UpdateSession::close(message);
+				status = UpdateStatus::FLASH_ERROR;
+			}
+		}
+
+		// The host resumes from the number of bytes written
+		setUint32(message + OSSHS_UPDATE_RESPONSE_HEADER_SIZE, getWritten());
+		responseLength = 4;
+		return status;
+	}
+
+	template<typename TRANSPORT>
+	UpdateStatus
+	UpdateProtocol<TRANSPORT>::handleFinish(std::size_t length, std::size_t &responseLength)
+	{
+		if (length != OSSHS_UPDATE_REQUEST_HEADER_SIZE)
+			return UpdateStatus::INVALID_LENGTH;
+
+		if (UpdateSession::isOwnedByOther(message))
+			return UpdateStatus::INVALID_STATE;
+
+		if (writing)
+		{
+			finished = finishImage(digest);
+			if (!finished)
+				abortImage();
+
+			Flash::deinitialize();
+			writing = false;
+			UpdateSession::close(message);
+
+			if (!finished)
+				return UpdateStatus::VERIFY_ERROR;
+		}
+		else if (!finished)
+		{
+			return UpdateStatus::INVALID_STATE;
+		}
+
+		// A repeated FINISH gets the same digest
+		std::memcpy(message + OSSHS_UPDATE_RESPONSE_HEADER_SIZE, digest, OSSHS_SHA256_DIGEST_SIZE);
+		responseLength = OSSHS_SHA256_DIGEST_SIZE;
+		return UpdateStatus::OK;
+	}
+
+	template<typename TRANSPORT>
+	UpdateStatus
+	UpdateProtocol<TRANSPORT>::handleAbort(std::size_t length, std::size_t &)
+	{
+		if (length != OSSHS_UPDATE_REQUEST_HEADER_SIZE)
+			return UpdateStatus::INVALID_LENGTH;
+
+		if (UpdateSession::isOwnedByOther(message))
+			return UpdateStatus::INVALID_STATE;
+
+		if (writing)
+		{
+			abortImage();
+			Flash::deinitialize();
+			writing = false;
+			UpdateSession::close(message);
+		}
+
+		finished = false;
+		return UpdateStatus::OK;
+	}
+
+	template<typename TRANSPORT>
+	UpdateStatus
+	UpdateProtocol<TRANSPORT>::handleBoot(std::size_t length, std::size_t &)
+	{
+		if (length != OSSHS_UPDATE_REQUEST_HEADER_SIZE)
+			return UpdateStatus::INVALID_LENGTH;
+
+		// Not in the middle of a write on any link
+		if (UpdateSession::isOpen())
+			return UpdateStatus::INVALID_STATE;
+
+		Bootloader::setLoadApplication(true);
+		bootRequested = true;
+		return UpdateStatus::OK;
+	}
+
+	template<typename TRANSPORT>
+	UpdateStatus
+	UpdateProtocol<TRANSPORT>::handleRead(std::size_t length, std::size_t &responseLength)
+	{
+		if (length != OSSHS_UPDATE_REQUEST_HEADER_SIZE + 8)
+			return UpdateStatus::INVALID_LENGTH;
+
+		const uint8_t *request = message + OSSHS_UPDATE_REQUEST_HEADER_SIZE;
+		uint32_t address = getUint32(request);
+		uint32_t end = address + getUint32(request + 4);
+
+		if (address < Flash::MemoryMap::flashOrigin || end < address ||
+			end > Flash::MemoryMap::flashOrigin + Flash::MemoryMap::flashSize || KeyStore::overlaps(address, end))
+			return UpdateStatus::INVALID_ARGUMENT;
+
+		// Decrypted images must not be read back, only the bootloader below the key page stays readable
+		if (OSSHS_BOOTLOADER_DECRYPT && end > Flash::MemoryMap::keyOrigin)
+			return UpdateStatus::INVALID_ARGUMENT;
+
+		// Flash is memory mapped, it is encoded straight into the response without a page buffer
+		uint8_t *data = message + OSSHS_UPDATE_RESPONSE_HEADER_SIZE + 4;
+		const std::size_t space = TRANSPORT::mtu - OSSHS_UPDATE_RESPONSE_HEADER_SIZE - 4;
+		std::size_t used = 0;
+		uint32_t position = address;
+
+		while (position < end && space - used >= 2)
+		{
+			uint32_t blank = countBlank(position, end);
+			if (blank >= OSSHS_UPDATE_READ_BLANK_MIN || position + blank == end)
+			{
+				data[used++] = OSSHS_UPDATE_READ_BLANK_FLAG | (blank - 1) >> 8;
+				data[used++] = blank - 1;
+				position += blank;
+				continue;
+			}
+
+			// Literal bytes up to the next erased run
+			std::size_t limit = space - used - 1;
+			if (limit > OSSHS_UPDATE_READ_LITERAL_MAX)
+				limit = OSSHS_UPDATE_READ_LITERAL_MAX;
+			if (limit > end - position)
+				limit = end - position;
+
+			// Erased runs shorter than OSSHS_UPDATE_READ_BLANK_MIN are cheaper as literals
+			std::size_t count = 1;
+			while (count < limit && countBlank(position + count, end - position - count > OSSHS_UPDATE_READ_BLANK_MIN ?
+				position + count + OSSHS_UPDATE_READ_BLANK_MIN : end) < OSSHS_UPDATE_READ_BLANK_MIN)
+				count++;
+
+			data[used++] = count - 1;
+			std::memcpy(data + used, reinterpret_cast<const uint8_t *>(position), count);
+			used += count;
+			position += count;
+		}
+
+		setUint32(message + OSSHS_UPDATE_RESPONSE_HEADER_SIZE, position - address);
+		responseLength = 4 + used;
+		return UpdateStatus::OK;
+	}
+
+	template<typename TRANSPORT>
+	UpdateStatus
+	UpdateProtocol<TRANSPORT>::handleHash(std::size_t length, std::size_t &responseLength)
+	{
+		if (length != OSSHS_UPDATE_REQUEST_HEADER_SIZE + 9)
+			return UpdateStatus::INVALID_LENGTH;
+
+		const uint8_t *request = message + OSSHS_UPDATE_REQUEST_HEADER_SIZE;
+		uint32_t address = getUint32(request);
+		uint32_t rangeLength = getUint32(request + 4);
+		uint8_t mode = request[8];
+
+		if (address < Flash::MemoryMap::flashOrigin || !rangeLength || (address | rangeLength) & 0b11 ||
+			rangeLength > Flash::MemoryMap::flashOrigin + Flash::MemoryMap::flashSize - address ||
+			mode > static_cast<uint8_t>(UpdateHashMode::PAGES) ||
+			(mode == static_cast<uint8_t>(UpdateHashMode::PAGES) && !Flash::MemoryMap::isPageOrigin(address)) ||
+			KeyStore::overlaps(address, address + rangeLength))
+			return UpdateStatus::INVALID_ARGUMENT;
+
+		// The CRC of a few bytes gives them away, with decryption only whole pages are hashed
+		if (OSSHS_BOOTLOADER_DECRYPT && (Flash::MemoryMap::getPageOffset(address) ||
+			Flash::MemoryMap::getPageOffset(rangeLength)))
+			return UpdateStatus::INVALID_ARGUMENT;
+
+		// Flash turns the CRC peripheral off when a session ends
+		RCC->AHBENR |= RCC_AHBENR_CRCEN;
+
+		uint8_t *response = message + OSSHS_UPDATE_RESPONSE_HEADER_SIZE;
+		if (mode == static_cast<uint8_t>(UpdateHashMode::RANGE))
+		{
+			Flash::resetCRC();
+			Flash::updateCRC(address, rangeLength);
+			setUint32(response, Flash::getCRC());
+			responseLength = 4;
+			return UpdateStatus::OK;
+		}
+
+		// The last page of the range may be partial, its CRC covers the whole page
+		responseLength = 0;
+		for (uint32_t page = address; page - address < rangeLength &&
+			responseLength + 4 <= TRANSPORT::mtu - OSSHS_UPDATE_RESPONSE_HEADER_SIZE; page += Flash::pageSize)
+		{
+			Flash::resetCRC();
+			Flash::updateCRC(page, Flash::pageSize);
+			setUint32(response + responseLength, Flash::getCRC());
+			responseLength += 4;
+		}
+
+		return UpdateStatus::OK;
+	}
+
+	template<typename TRANSPORT>
+	UpdateStatus
+	UpdateProtocol<TRANSPORT>::handleWear(std::size_t length, std::size_t &responseLength)
+	{
+		if (length != OSSHS_UPDATE_REQUEST_HEADER_SIZE + 2)
+			return UpdateStatus::INVALID_LENGTH;
+
+		uint32_t first = getUint16(message + OSSHS_UPDATE_REQUEST_HEADER_SIZE);
+		if (first >= Flash::MemoryMap::pageCount)
+			return UpdateStatus::INVALID_ARGUMENT;
+
+		// Pages the bootloader never erases report 0
+		uint8_t *response = message + OSSHS_UPDATE_RESPONSE_HEADER_SIZE;
+		responseLength = 0;
+		for (uint32_t page = first; page < Flash::MemoryMap::pageCount &&
+			responseLength + 2 <= TRANSPORT::mtu - OSSHS_UPDATE_RESPONSE_HEADER_SIZE; page++)
+		{
+			uint32_t erases = WearJournal::getEraseCount(page);
+			setUint16(response + responseLength, erases < 0xffff ? erases : 0xffff);
+			responseLength += 2;
+		}
+
+		return UpdateStatus::OK;
+	}
+
+	template<typename TRANSPORT>
+	UpdateStatus
+	UpdateProtocol<TRANSPORT>::handleStay(std::size_t length, std::size_t &)
+	{
+		if (length != OSSHS_UPDATE_REQUEST_HEADER_SIZE + 1)
+			return UpdateStatus::INVALID_LENGTH;
+
+		// Repeated requests of a host that missed the first answer are answered as well
+		if (message[OSSHS_UPDATE_REQUEST_HEADER_SIZE] != OSSHS_BOOTLOADER_NODE_ID)
+			return UpdateStatus::INVALID_ARGUMENT;
+
+		return UpdateStatus::OK;
+	}
+
+	template<typename TRANSPORT>
+	UpdateStatus
+	UpdateProtocol<TRANSPORT>::handleStack(std::size_t length, std::size_t &responseLength)
+	{
+		if (length != OSSHS_UPDATE_REQUEST_HEADER_SIZE)
+			return UpdateStatus::INVALID_LENGTH;
+
+		uint8_t *response = message + OSSHS_UPDATE_RESPONSE_HEADER_SIZE;
+		setUint32(response, StackMonitor::getHighWaterMark());
+		setUint32(response + 4, StackMonitor::getSize());
+		responseLength = 8;
+
+		return UpdateStatus::OK;
+	}
+
+	template<typename TRANSPORT>
+	uint32_t
+	UpdateProtocol<TRANSPORT>::countBlank(uint32_t address, uint32_t end)
+	{
+		if (end - address > OSSHS_UPDATE_READ_BLANK_MAX)
+			end = address + OSSHS_UPDATE_READ_BLANK_MAX;
+
+		uint32_t position = address;
+		while (position < end && position & 0b11 && *reinterpret_cast<const uint8_t *>(position) == 0xff)
+			position++;
+
+		// Erased flash is mostly checked a word at a time
+		if (!(position & 0b11))
+			while (end - position >= 4 && *reinterpret_cast<const uint32_t *>(position) == 0xffffffff)
+				position += 4;
+
+		while (position < end && *reinterpret_cast<const uint8_t *>(position) == 0xff)
+			position++;
+
+		return position - address;
+	}
+
+	template<typename TRANSPORT>
+	void
+	UpdateProtocol<TRANSPORT>::decryptImage(uint8_t *data, std::size_t length, uint32_t offset)
+	{
+#if OSSHS_BOOTLOADER_DECRYPT
+		if (encrypted)
+			cipher.apply(data, length, offset);
+#else
+		(void) data;
+		(void) length;
+		(void) offset;
+#endif
+	}
+
+	template<typename TRANSPORT>
+	bool
+	UpdateProtocol<TRANSPORT>::writeImage(const uint8_t *data, std::size_t length)
+	{
+		return container ? ContainerWriter::write(data, length) : ImageWriter::write(data, length);
+	}
+
+	template<typename TRANSPORT>
+	bool
+	UpdateProtocol<TRANSPORT>::finishImage(uint8_t *digest)
+	{
+		bool succeeded = container ? ContainerWriter::finish(digest) : ImageWriter::finish(digest);
+
+#if OSSHS_BOOTLOADER_DECRYPT
+		cipher.clear();
+		encrypted = false;
+#endif
+		return succeeded;
+	}
+
+	template<typename TRANSPORT>
+	void
+	UpdateProtocol<TRANSPORT>::abortImage()
+	{
+		if (container)
+			ContainerWriter::abort();
+		else
+			ImageWriter::abort();
+
+#if OSSHS_BOOTLOADER_DECRYPT
+		cipher.clear();
+		encrypted = false;
+#endif
+	}
+
+	template<typename TRANSPORT>
+	uint32_t
+	UpdateProtocol<TRANSPORT>::getWritten()
+	{
+		return container ? ContainerWriter::getWritten() : ImageWriter::getWritten();
+	}
+
+	template<typename TRANSPORT>
+	uint16_t
+	UpdateProtocol<TRANSPORT>::getUint16(const uint8_t *data)
+	{
+		return data[0] | data[1] << 8;
+	}
+
+	template<typename TRANSPORT>
+	uint32_t
+	UpdateProtocol<TRANSPORT>::getUint32(const uint8_t *data)
+	{
+		return data[0] | data[1] << 8 | data[2] << 16 | static_cast<uint32_t>(data[3]) << 24;
+	}
+
+	template<typename TRANSPORT>
+	void
+	UpdateProtocol<TRANSPORT>::setUint16(uint8_t *data, uint16_t value)
+	{
+		data[0] = value;
+		data[1] = value >> 8;
+	}
+
+	template<typename TRANSPORT>
+	void
+	UpdateProtocol<TRANSPORT>::setUint32(uint8_t *data, uint32_t value)
+	{
+		data[0] = value;
+		data[1] = value >> 8;
+		data[2] = value >> 16;
+		data[3] = value >> 24;
+	}
+}
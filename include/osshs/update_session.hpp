@@ -0,0 +1,76 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_UPDATE_SESSION_HPP
+#define OSSHS_UPDATE_SESSION_HPP
+
+namespace osshs
+{
+	/**
+	 * Owner of the update session, shared by the UpdateProtocol of every transport.
+	 *
+	 * ImageWriter, ContainerWriter and Flash exist once, so only one link may write at a time. The link that
+	 * answered BEGIN owns the session until FINISH, ABORT or a failed WRITE ends it. Meanwhile the other links get
+	 * INVALID_STATE for BEGIN, WRITE, FINISH, ABORT and BOOT, while INFO, READ, HASH, WEAR and STACK stay open to
+	 * them. A link is identified by the address of any object of its own, e.g. its message buffer.
+	 */
+	class UpdateSession
+	{
+	public:
+		/**
+		 * @brief Open the session for a link.
+		 * @param link Link that begins writing.
+		 * @return Whether or not the session was free or already owned by link.
+		 */
+		static bool
+		open(const void *link);
+
+		/**
+		 * @brief Close the session if link owns it.
+		 * @param link Link that stopped writing.
+		 */
+		static void
+		close(const void *link);
+
+		/**
+		 * @brief Check if a link other than link owns the session.
+		 * @param link Link asking.
+		 * @return Whether or not the session is open for another link.
+		 */
+		static bool
+		isOwnedByOther(const void *link);
+
+		/**
+		 * @brief Check if any link owns the session.
+		 * @return Whether or not an image is being written.
+		 */
+		static bool
+		isOpen();
+
+	private:
+		static const void *owner;
+	};
+}
+
+#endif  // OSSHS_UPDATE_SESSION_HPP
@@ -0,0 +1,78 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_VERIFICATION_CACHE_HPP
+#define OSSHS_VERIFICATION_CACHE_HPP
+
+#include <cstdint>
+
+#define OSSHS_VERIFICATION_CACHE_MAX_WARM_BOOTS 16
+
+namespace osshs
+{
+	/**
+	 * Verification token stored in the backup registers:
+	 *
+	 *   BKP_DR1 bit 1  Token valid
+	 *   BKP_DR2        CRC of the verified image, bits 0-15
+	 *   BKP_DR3        CRC of the verified image, bits 16-31
+	 *   BKP_DR4        Flash generation, incremented whenever the application region may have changed
+	 *   BKP_DR5        Flash generation at the time of verification
+	 *   BKP_DR6        Warm boots since the last full verification
+	 *
+	 * Only writes through Flash invalidate the token. An application that writes to its own flash region, or
+	 * any other code that does, must increment BKP_DR4 itself. The token is only a CRC in registers the
+	 * application can write, so with OSSHS_BOOTLOADER_VERIFY_SIGNATURE a match only skips the CRC pass and the
+	 * signature is still verified on every boot.
+	 */
+	class VerificationCache
+	{
+	public:
+		/**
+		 * @brief Check if the image was already verified and full verification can be skipped.
+		 * @note Always fails on a power-on reset and after OSSHS_VERIFICATION_CACHE_MAX_WARM_BOOTS warm boots.
+		 *       Counts a warm boot on success.
+		 * @param crc CRC of the image as given by its manifest.
+		 * @return Whether or not the token matches the image.
+		 */
+		static bool
+		check(uint32_t crc);
+
+		/**
+		 * @brief Store a token for a fully verified image.
+		 * @param crc CRC of the image as given by its manifest.
+		 */
+		static void
+		store(uint32_t crc);
+
+		/**
+		 * @brief Invalidate the token.
+		 * @note Called by Flash before anything is erased or written. Cheap if the token is already invalid.
+		 */
+		static void
+		invalidate();
+	};
+}
+
+#endif  // OSSHS_VERIFICATION_CACHE_HPP
@@ -0,0 +1,122 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef OSSHS_WEAR_JOURNAL_HPP
+#define OSSHS_WEAR_JOURNAL_HPP
+
+#include <cstdint>
+#include <osshs/memory_map.hpp>
+
+#define OSSHS_WEAR_JOURNAL_MAGIC   0x5745
+#define OSSHS_WEAR_JOURNAL_VERSION 1
+
+// Pages the bootloader erases: the application region and the configuration page
+#define OSSHS_WEAR_JOURNAL_FIRST_PAGE (osshs::TargetMemoryMap::getPage(osshs::TargetMemoryMap::applicationOrigin))
+#define OSSHS_WEAR_JOURNAL_PAGES      (osshs::TargetMemoryMap::pageCount - OSSHS_WEAR_JOURNAL_FIRST_PAGE)
+
+namespace osshs
+{
+	/**
+	 * Erase counters per page, kept in an append-only journal in the configuration page:
+	 *
+	 *   offset  size  field
+	 *   0x00    2     magic    OSSHS_WEAR_JOURNAL_MAGIC ("EW")
+	 *   0x02    2     version  OSSHS_WEAR_JOURNAL_VERSION
+	 *   0x04    4     entry    (page[2], erases[2]), repeated up to the first erased entry
+	 *
+	 * The count of a page is the sum of its entries, entries with erased erases are ignored. Erases are counted in
+	 * RAM and appended with flush() at the end of an update session, which only programs erased half words and
+	 * appends one entry per page the session erased. Only a full journal is erased, and then rewritten with one
+	 * entry per page. On a 128 KiB device that leaves room for about 140 entries, so the journal costs its page one
+	 * erase every session that rewrites the whole application region and one every seven sessions that erase 20
+	 * pages. Counts of a session that ends in a reset without flush() are lost, as are all counts while the
+	 * configuration page holds anything but a journal or erased flash.
+	 */
+	class WearJournal
+	{
+	public:
+		/**
+		 * @brief Find the end of the journal and log the wear of the pages.
+		 */
+		static void
+		initialize();
+
+		/**
+		 * @brief Count an erase.
+		 * @note Called by Flash for every page erase. Pages before OSSHS_WEAR_JOURNAL_FIRST_PAGE are not counted.
+		 * @param page Page number, counted from the origin of flash.
+		 */
+		static void
+		record(uint32_t page);
+
+		/**
+		 * @brief Append the erases counted since the last flush to the journal.
+		 * @note Flash must be unlocked.
+		 * @return Whether or not the journal holds all counts.
+		 */
+		static bool
+		flush();
+
+		/**
+		 * @brief Get the number of erases of a page, including those not flushed yet.
+		 * @param page Page number, counted from the origin of flash.
+		 * @return Number of erases.
+		 */
+		static uint32_t
+		getEraseCount(uint32_t page);
+
+	private:
+		/**
+		 * @brief Write the header of an empty journal to the configuration page.
+		 * @note The configuration page must be erased.
+		 * @return Whether or not starting succeeded.
+		 */
+		static bool
+		start();
+
+		/**
+		 * @brief Erase the journal and rewrite it with the total of every page.
+		 * @return Whether or not compacting succeeded.
+		 */
+		static bool
+		compact();
+
+		/**
+		 * @brief Append an entry.
+		 * @param page Page number, counted from the origin of flash.
+		 * @param erases Number of erases, at most 0xfffe.
+		 * @return Whether or not appending succeeded.
+		 */
+		static bool
+		append(uint32_t page, uint32_t erases);
+
+		// Erases not flushed yet, per page from OSSHS_WEAR_JOURNAL_FIRST_PAGE
+		static uint8_t pending[OSSHS_WEAR_JOURNAL_PAGES];
+		static bool dirty;
+
+		// Address of the first erased entry, 0 if the journal is not valid
+		static uint32_t end;
+	};
+}
+
+#endif  // OSSHS_WEAR_JOURNAL_HPP
@@ -0,0 +1,95 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_SIM_LOGGER_HPP
+#define OSSHS_SIM_LOGGER_HPP
+
+#include <cstdint>
+
+namespace modm
+{
+	enum class IOBuffer
+	{
+		DiscardIfFull,
+		BlockIfFull
+	};
+
+	class IODevice
+	{
+	public:
+		virtual ~IODevice() = default;
+
+		virtual void
+		write(char c) = 0;
+
+		virtual void
+		flush() = 0;
+	};
+
+	template<typename DEVICE, IOBuffer BEHAVIOR>
+	class IODeviceWrapper : public IODevice
+	{
+	public:
+		void
+		write(char c) override
+		{
+			DEVICE::write(c);
+		}
+
+		void
+		flush() override
+		{
+			DEVICE::flushWriteBuffer();
+		}
+	};
+
+	namespace log
+	{
+		/**
+		 * Formats like the modm logger, where long is 32 bits wide.
+		 */
+		class Logger
+		{
+		public:
+			Logger(IODevice &device) :
+				device(device)
+			{
+			}
+
+			void
+			printf(const char *format, ...);
+
+			void
+			flush()
+			{
+				device.flush();
+			}
+
+		private:
+			IODevice &device;
+		};
+	}
+}
+
+#endif  // OSSHS_SIM_LOGGER_HPP
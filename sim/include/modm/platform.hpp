@@ -0,0 +1,497 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_SIM_PLATFORM_HPP
+#define OSSHS_SIM_PLATFORM_HPP
+
+/**
+ * Host replacement for the parts of <modm/platform.hpp> used by the bootloader.
+ *
+ * Peripherals are sim::Register stand-ins driven by the models in sim/src, named and laid out like their
+ * CMSIS counterparts. Only the registers and bits the bootloader uses are provided.
+ */
+
+#include <cstdint>
+#include <sim/register.hpp>
+
+typedef struct
+{
+	osshs::sim::Register ACR, KEYR, OPTKEYR, SR, CR, AR, RESERVED, OBR, WRPR;
+} FLASH_TypeDef;
+
+typedef struct
+{
+	osshs::sim::Register RDP, USER, Data0, Data1, WRP0, WRP1, WRP2, WRP3;
+} OB_TypeDef;
+
+typedef struct
+{
+	osshs::sim::Register DR, IDR, CR;
+} CRC_TypeDef;
+
+typedef struct
+{
+	osshs::sim::Register DR1, DR2, DR3, DR4, DR5, DR6, DR7, DR8, DR9, DR10, RTCCR, CR, CSR;
+} BKP_TypeDef;
+
+typedef struct
+{
+	osshs::sim::Register CR, CSR;
+} PWR_TypeDef;
+
+typedef struct
+{
+	osshs::sim::Register CR, CFGR, CIR, APB2RSTR, APB1RSTR, AHBENR, APB2ENR, APB1ENR, BDCR, CSR;
+} RCC_TypeDef;
+
+typedef struct
+{
+	osshs::sim::Register TIR, TDTR, TDLR, TDHR;
+} CAN_TxMailBox_TypeDef;
+
+typedef struct
+{
+	osshs::sim::Register RIR, RDTR, RDLR, RDHR;
+} CAN_FIFOMailBox_TypeDef;
+
+typedef struct
+{
+	osshs::sim::Register FR1, FR2;
+} CAN_FilterRegister_TypeDef;
+
+typedef struct
+{
+	osshs::sim::Register MCR, MSR, TSR, RF0R, RF1R, IER, ESR, BTR;
+	CAN_TxMailBox_TypeDef sTxMailBox[3];
+	CAN_FIFOMailBox_TypeDef sFIFOMailBox[2];
+	osshs::sim::Register FMR, FM1R, FS1R, FFA1R, FA1R;
+	CAN_FilterRegister_TypeDef sFilterRegister[14];
+} CAN_TypeDef;
+
+typedef struct
+{
+	osshs::sim::Register ISR, IFCR;
+} DMA_TypeDef;
+
+typedef struct
+{
+	osshs::sim::Register CCR, CNDTR, CPAR, CMAR;
+} DMA_Channel_TypeDef;
+
+typedef struct
+{
+	osshs::sim::Register SR, DR, BRR, CR1, CR2, CR3, GTPR;
+} USART_TypeDef;
+
+typedef struct
+{
+	osshs::sim::Register CPUID, ICSR, VTOR, AIRCR, SCR, CCR;
+} SCB_Type;
+
+typedef struct
+{
+	osshs::sim::Register CTRL, CYCCNT;
+} DWT_Type;
+
+typedef struct
+{
+	osshs::sim::Register DHCSR, DCRSR, DCRDR, DEMCR;
+} CoreDebug_Type;
+
+namespace osshs
+{
+	namespace sim
+	{
+		extern FLASH_TypeDef flashRegisters;
+		extern OB_TypeDef optionBytes;
+		extern CRC_TypeDef crcRegisters;
+		extern BKP_TypeDef bkpRegisters;
+		extern PWR_TypeDef pwrRegisters;
+		extern RCC_TypeDef rccRegisters;
+		extern SCB_Type scbRegisters;
+		extern DWT_Type dwtRegisters;
+		extern CoreDebug_Type coreDebugRegisters;
+		extern CAN_TypeDef canRegisters;
+		extern DMA_TypeDef dmaRegisters;
+		extern DMA_Channel_TypeDef dmaChannel4Registers;
+		extern USART_TypeDef usartRegisters;
+
+		extern uint32_t mainStackPointer;
+	}
+}
+
+#define FLASH     (&osshs::sim::flashRegisters)
+#define OB        (&osshs::sim::optionBytes)
+#define CRC       (&osshs::sim::crcRegisters)
+#define BKP       (&osshs::sim::bkpRegisters)
+#define PWR       (&osshs::sim::pwrRegisters)
+#define RCC       (&osshs::sim::rccRegisters)
+#define SCB       (&osshs::sim::scbRegisters)
+#define DWT       (&osshs::sim::dwtRegisters)
+#define CoreDebug (&osshs::sim::coreDebugRegisters)
+#define CAN1      (&osshs::sim::canRegisters)
+
+#define DMA1          (&osshs::sim::dmaRegisters)
+#define DMA1_Channel4 (&osshs::sim::dmaChannel4Registers)
+#define USART1        (&osshs::sim::usartRegisters)
+
+#define FLASH_SR_BSY      0x00000001
+#define FLASH_SR_PGERR    0x00000004
+#define FLASH_SR_WRPRTERR 0x00000010
+#define FLASH_SR_EOP      0x00000020
+
+#define FLASH_CR_PG     0x00000001
+#define FLASH_CR_PER    0x00000002
+#define FLASH_CR_MER    0x00000004
+#define FLASH_CR_OPTPG  0x00000010
+#define FLASH_CR_OPTER  0x00000020
+#define FLASH_CR_STRT   0x00000040
+#define FLASH_CR_LOCK   0x00000080
+#define FLASH_CR_OPTWRE 0x00000200
+
+#define FLASH_OBR_RDPRT 0x00000002
+
+#define CRC_CR_RESET 0x00000001
+
+#define PWR_CR_DBP 0x00000100
+
+#define RCC_CR_HSION  0x00000001
+#define RCC_CR_HSIRDY 0x00000002
+
+#define DMA_CCR_EN   0x00000001
+#define DMA_CCR_TCIE 0x00000002
+#define DMA_CCR_DIR  0x00000010
+#define DMA_CCR_MINC 0x00000080
+
+#define DMA_IFCR_CGIF4 0x00001000
+
+#define USART_SR_TC    0x00000040
+#define USART_CR3_DMAT 0x00000080
+
+#define RCC_AHBENR_DMA1EN 0x00000001
+#define RCC_AHBENR_CRCEN  0x00000040
+
+#define RCC_APB1ENR_CAN1EN 0x02000000
+#define RCC_APB1ENR_BKPEN 0x08000000
+#define RCC_APB1ENR_PWREN 0x10000000
+
+#define RCC_CSR_RMVF     0x01000000
+#define RCC_CSR_PINRSTF  0x04000000
+#define RCC_CSR_PORRSTF  0x08000000
+#define RCC_CSR_SFTRSTF  0x10000000
+#define RCC_CSR_IWDGRSTF 0x20000000
+#define RCC_CSR_WWDGRSTF 0x40000000
+#define RCC_CSR_LPWRRSTF 0x80000000
+
+#define RCC_APB1RSTR_CAN1RST 0x02000000
+
+#define CAN_MCR_TXFP 0x00000004
+
+#define CAN_MSR_ERRI 0x00000004
+
+#define CAN_TSR_RQCP0 0x00000001
+#define CAN_TSR_TXOK0 0x00000002
+#define CAN_TSR_ALST0 0x00000004
+#define CAN_TSR_RQCP1 0x00000100
+#define CAN_TSR_TXOK1 0x00000200
+#define CAN_TSR_ALST1 0x00000400
+#define CAN_TSR_RQCP2 0x00010000
+#define CAN_TSR_TXOK2 0x00020000
+#define CAN_TSR_ALST2 0x00040000
+#define CAN_TSR_TME0 0x04000000
+#define CAN_TSR_TME1 0x08000000
+#define CAN_TSR_TME2 0x10000000
+
+#define CAN_RF0R_FMP0  0x00000003
+#define CAN_RF0R_FULL0 0x00000008
+#define CAN_RF0R_FOVR0 0x00000010
+#define CAN_RF0R_RFOM0 0x00000020
+
+#define CAN_IER_FMPIE0 0x00000002
+#define CAN_IER_FOVIE0 0x00000008
+#define CAN_IER_FMPIE1 0x00000010
+#define CAN_IER_FOVIE1 0x00000040
+#define CAN_IER_LECIE  0x00000800
+#define CAN_IER_ERRIE  0x00008000
+
+#define CAN_ESR_LEC 0x00000070
+
+#define CAN_TI0R_TXRQ 0x00000001
+
+#define CAN_FMR_FINIT 0x00000001
+
+#define CoreDebug_DEMCR_TRCENA_Msk 0x01000000
+#define DWT_CTRL_CYCCNTENA_Msk     0x00000001
+
+inline void
+__set_MSP(uint32_t topOfMainStack)
+{
+	osshs::sim::mainStackPointer = topOfMainStack;
+}
+
+// Interrupts are called directly by the simulation, so there is nothing to mask or wait for
+inline void __disable_irq() {}
+inline void __enable_irq() {}
+inline void __DSB() {}
+inline void __WFI() {}
+
+typedef enum
+{
+	DMA1_Channel4_IRQn = 14,
+	USB_LP_CAN1_RX0_IRQn = 20,
+	CAN1_RX1_IRQn = 21,
+	CAN1_SCE_IRQn = 22
+} IRQn_Type;
+
+inline void NVIC_EnableIRQ(IRQn_Type) {}
+inline void NVIC_DisableIRQ(IRQn_Type) {}
+inline void NVIC_SetPriority(IRQn_Type, uint32_t) {}
+
+namespace modm
+{
+	namespace clock
+	{
+		extern uint32_t fcpu;
+	}
+
+	namespace literals
+	{
+		constexpr uint32_t operator""_MHz(unsigned long long value) { return value * 1000000; }
+		constexpr uint32_t operator""_kHz(unsigned long long value) { return value * 1000; }
+		constexpr uint32_t operator""_Bd(unsigned long long value) { return value; }
+		constexpr uint32_t operator""_kbps(unsigned long long value) { return value * 1000; }
+	}
+
+	class Timestamp
+	{
+	public:
+		uint32_t
+		getTime() const
+		{
+			return time;
+		}
+
+		uint32_t time;
+	};
+
+	class Clock
+	{
+	public:
+		/**
+		 * @brief Milliseconds of simulated time.
+		 */
+		static Timestamp
+		now();
+	};
+
+	struct Gpio
+	{
+		enum Level
+		{
+			Low,
+			High
+		};
+	};
+
+	namespace platform
+	{
+		struct Rcc
+		{
+			enum class SystemClockSource { Hsi };
+			enum class AhbPrescaler { Div1 };
+			enum class Apb1Prescaler { Div1 };
+			enum class Apb2Prescaler { Div1 };
+
+			static void enableInternalClock() {}
+			static void enableSystemClock(SystemClockSource) {}
+			static void setAhbPrescaler(AhbPrescaler) {}
+			static void setApb1Prescaler(Apb1Prescaler) {}
+			static void setApb2Prescaler(Apb2Prescaler) {}
+
+			template<uint32_t FREQUENCY>
+			static void
+			updateCoreFrequency()
+			{
+				clock::fcpu = FREQUENCY;
+			}
+		};
+
+		struct GpioA9
+		{
+			struct Tx {};
+		};
+
+		struct GpioA10
+		{
+			struct Rx {};
+		};
+
+		struct Gpio : public modm::Gpio
+		{
+			enum class InputType
+			{
+				Floating,
+				PullUp,
+				PullDown
+			};
+		};
+
+		struct GpioA11
+		{
+			struct Rx {};
+		};
+
+		struct GpioA12
+		{
+			struct Tx {};
+		};
+
+		/**
+		 * Bit timing is not modelled, initialize() only enables the clock and leaves initialization mode.
+		 */
+		struct Can1
+		{
+			template<typename... SIGNALS> static void connect(Gpio::InputType) {}
+
+			template<typename SYSTEM_CLOCK, uint32_t BITRATE>
+			static bool
+			initialize(uint32_t)
+			{
+				RCC->APB1ENR |= RCC_APB1ENR_CAN1EN;
+				return true;
+			}
+		};
+
+		struct Usart1
+		{
+			template<typename... SIGNALS> static void connect() {}
+			template<typename SYSTEM_CLOCK, uint32_t BAUDRATE> static void initialize() {}
+		};
+
+		struct UsartHal1
+		{
+			static void disable() {}
+		};
+
+		struct SysTickTimer
+		{
+			template<typename SYSTEM_CLOCK> static void initialize() {}
+			static void disable() {}
+		};
+
+		/**
+		 * Records the pin level, so the LED pattern can be inspected.
+		 */
+		struct GpioOutputC13
+		{
+			static void set() { level = true; }
+			static void reset() { level = false; }
+			static void set(bool value) { level = value; }
+			static void toggle() { level = !level; }
+			static bool read() { return level; }
+			static void setOutput(Gpio::Level value) { level = value == Gpio::High; }
+
+			static inline bool level = false;
+		};
+
+		template<typename GPIO>
+		struct GpioInverted
+		{
+			static void set() { GPIO::reset(); }
+			static void reset() { GPIO::set(); }
+			static void set(bool value) { GPIO::set(!value); }
+			static void toggle() { GPIO::toggle(); }
+			static bool read() { return !GPIO::read(); }
+			static void setOutput(Gpio::Level value) { GPIO::setOutput(value == Gpio::High ? Gpio::Low : Gpio::High); }
+		};
+
+		struct GeneralPurposeTimer
+		{
+			enum class Mode { UpCounter, OneShotUpCounter };
+			enum class Interrupt : uint32_t { Update = 1 };
+			enum class InterruptFlag : uint32_t { Update = 1 };
+		};
+
+		/**
+		 * Timer model. The simulation calls the update handler at every update event in simulated time.
+		 */
+		struct Timer2 : public GeneralPurposeTimer
+		{
+			static void enable() { enabled = true; }
+			static void disable() { enabled = false; }
+			static void setMode(Mode) {}
+			static void start() { running = true; }
+			static void pause() { running = false; }
+			static void enableInterruptVector(bool enable, uint32_t) { vectorEnabled = enable; }
+			static void enableInterrupt(Interrupt) { interruptEnabled = true; }
+			static void disableInterrupt(Interrupt) { interruptEnabled = false; }
+			static void acknowledgeInterruptFlags(InterruptFlag) {}
+
+			// Prescaler and auto-reload are buffered, they take effect on the next update event
+			static void setPrescaler(uint16_t value) { prescaler = value; }
+			static void setOverflow(uint16_t value) { overflow = value; }
+			static void applyAndReset() { update(); }
+
+			/**
+			 * @brief Load the buffered prescaler and overflow, as done by an update event.
+			 */
+			static void
+			update()
+			{
+				activePrescaler = prescaler ? prescaler : 1;
+				activeOverflow = overflow;
+			}
+
+			/**
+			 * @brief Core cycles between the current and the next update event.
+			 * @note The timer runs at the core frequency.
+			 */
+			static uint64_t
+			getPeriod()
+			{
+				return static_cast<uint64_t>(activePrescaler) * (activeOverflow + 1);
+			}
+
+			/**
+			 * @brief Whether or not update interrupts are currently generated.
+			 */
+			static bool
+			isGeneratingInterrupts()
+			{
+				return enabled && running && vectorEnabled && interruptEnabled;
+			}
+
+			static inline bool enabled = false;
+			static inline bool running = false;
+			static inline bool vectorEnabled = false;
+			static inline bool interruptEnabled = false;
+			static inline uint16_t prescaler = 1;
+			static inline uint16_t overflow = 0;
+			static inline uint16_t activePrescaler = 1;
+			static inline uint16_t activeOverflow = 0;
+		};
+	}
+}
+
+#endif  // OSSHS_SIM_PLATFORM_HPP
@@ -0,0 +1,201 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_SIM_CAN_MODEL_HPP
+#define OSSHS_SIM_CAN_MODEL_HPP
+
+#include <cstdint>
+#include <vector>
+#include <sim/register.hpp>
+
+#define OSSHS_SIM_CAN_FIFO_DEPTH   3
+#define OSSHS_SIM_CAN_FILTER_BANKS 14
+
+namespace osshs
+{
+	namespace sim
+	{
+		struct CanStatistics
+		{
+			uint32_t frames;          ///< Frames on the bus
+			uint32_t accepted;        ///< Frames that passed the acceptance filters
+			uint32_t overruns;        ///< Accepted frames lost because their FIFO was full
+			uint32_t interrupts;      ///< Receive interrupts taken
+			uint32_t errors;          ///< Errors detected on the bus
+			uint64_t interruptCycles; ///< Core cycles spent in receive interrupts
+		};
+
+		struct CanTransmission
+		{
+			uint16_t id;
+			uint8_t length;
+			uint8_t data[8];
+		};
+
+		/**
+		 * Model of the receive path and transmit mailboxes of bxCAN on an STM32F103.
+		 *
+		 * Frames put on the bus run through the filter banks (16 and 32 bit scale, list and mask mode) as configured
+		 * outside of filter initialization mode. Accepted frames go to their 3 deep FIFO, a full FIFO sets FOVR and
+		 * drops the frame. The receive interrupts are called directly while their enable bits are set. Transmit
+		 * requests complete immediately and successfully. Bus errors set LEC, count in REC and call the status
+		 * change interrupt through ERRI.
+		 */
+		class CanModel
+		{
+		public:
+			using InterruptHandler = void (*)();
+
+			/**
+			 * @brief Attach the model to the CAN1 registers and to RCC_APB1RSTR.
+			 */
+			static void
+			initialize();
+
+			/**
+			 * @brief Reset CAN1, as on a system reset or CAN1RST.
+			 */
+			static void
+			reset();
+
+			/**
+			 * @brief Set the handler of the receive interrupt of a FIFO.
+			 * @param fifo Receive FIFO, 0 or 1.
+			 * @param handler Interrupt handler.
+			 */
+			static void
+			attachInterrupt(uint8_t fifo, InterruptHandler handler);
+
+			/**
+			 * @brief Set the handler of the status change and error interrupt.
+			 * @param handler Interrupt handler.
+			 */
+			static void
+			attachErrorInterrupt(InterruptHandler handler);
+
+			/**
+			 * @brief Let the receiver detect a CRC error, e.g. in a frame corrupted by noise.
+			 */
+			static void
+			raiseError();
+
+			/**
+			 * @brief Put a standard data frame on the bus.
+			 * @param id Standard identifier.
+			 * @param data Data of the frame.
+			 * @param length Length of the data, at most 8.
+			 * @return Whether or not the frame passed the acceptance filters.
+			 */
+			static bool
+			deliver(uint16_t id, const uint8_t *data, uint8_t length);
+
+			/**
+			 * @brief Let the host put a standard data frame on the bus periodically, e.g. a request it repeats until
+			 *        it is answered.
+			 * @note The frames that are due are put on the bus when the status of a receive FIFO is read, so
+			 *       firmware that polls sees them at the right time. The first one is due one period from now.
+			 * @param id Standard identifier.
+			 * @param data Data of the frame.
+			 * @param length Length of the data, at most 8.
+			 * @param period Core cycles between frames, 0 stops repeating.
+			 */
+			static void
+			repeat(uint16_t id, const uint8_t *data, uint8_t length, uint64_t period);
+
+			/**
+			 * @brief Get the frames transmitted since the last call.
+			 * @return Transmitted frames, oldest first.
+			 */
+			static std::vector<CanTransmission>
+			takeTransmissions();
+
+			/**
+			 * @brief Get the counters since the simulation started.
+			 * @return Statistics of the bus.
+			 */
+			static const CanStatistics &
+			getStatistics();
+
+		private:
+			/**
+			 * @brief Find the FIFO a frame is accepted into.
+			 * @return FIFO number, or -1 if the frame is rejected.
+			 */
+			static int
+			filter(uint16_t id);
+
+			/**
+			 * @brief Update the status register and the output mailbox of a FIFO.
+			 */
+			static void
+			update(uint8_t fifo);
+
+			static uint32_t
+			readFifoStatus(Register &reg);
+
+			static void
+			writeFifo0Status(Register &reg, uint32_t value);
+
+			static void
+			writeFifo1Status(Register &reg, uint32_t value);
+
+			static void
+			writeFifoStatus(uint8_t fifo, uint32_t value);
+
+			static void
+			writeTransmitIdentifier(Register &reg, uint32_t value);
+
+			static void
+			writeMasterStatus(Register &reg, uint32_t value);
+
+			static void
+			writeTransmitStatus(Register &reg, uint32_t value);
+
+			static void
+			writeApb1Reset(Register &reg, uint32_t value);
+
+			struct Mailbox
+			{
+				uint32_t rir;
+				uint32_t rdtr;
+				uint32_t rdlr;
+				uint32_t rdhr;
+			};
+
+			static Mailbox fifos[2][OSSHS_SIM_CAN_FIFO_DEPTH];
+			static uint8_t pending[2];
+			static bool overrun[2];
+			static InterruptHandler handlers[2];
+			static InterruptHandler errorHandler;
+			static std::vector<CanTransmission> transmissions;
+			static CanStatistics statistics;
+
+			static CanTransmission repeated;
+			static uint64_t repeatPeriod;
+			static uint64_t repeatNext;
+		};
+	}
+}
+
+#endif  // OSSHS_SIM_CAN_MODEL_HPP
@@ -0,0 +1,92 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_SIM_CLOCK_HPP
+#define OSSHS_SIM_CLOCK_HPP
+
+#include <cstdint>
+
+#define OSSHS_SIM_REGISTER_ACCESS_CYCLES 2
+
+namespace osshs
+{
+	namespace sim
+	{
+		/**
+		 * Simulated time in core cycles.
+		 *
+		 * Time is deterministic: it only advances with register accesses and with operations the peripheral
+		 * models know the duration of (flash programming and erasing, waiting for a busy peripheral). Code
+		 * running on the host CPU takes no simulated time, cycle counts of the code itself must be measured
+		 * on the target.
+		 */
+		class Clock
+		{
+		public:
+			/**
+			 * @brief Get the current simulated time.
+			 * @return Core cycles since the simulation started.
+			 */
+			static inline uint64_t
+			now()
+			{
+				return cycles;
+			}
+
+			/**
+			 * @brief Let simulated time pass.
+			 * @param duration Number of core cycles.
+			 */
+			static inline void
+			advance(uint64_t duration)
+			{
+				cycles += duration;
+			}
+
+			/**
+			 * @brief Let simulated time pass until a point in time, if it is in the future.
+			 * @param time Point in time in core cycles.
+			 */
+			static inline void
+			advanceTo(uint64_t time)
+			{
+				if (time > cycles)
+					cycles = time;
+			}
+
+			/**
+			 * @brief Convert a duration to core cycles at the current core clock.
+			 * @param nanoseconds Duration in nanoseconds.
+			 * @return Duration in core cycles.
+			 */
+			static uint64_t
+			fromNanoseconds(uint64_t nanoseconds);
+
+		private:
+			static inline uint64_t cycles = 0;
+		};
+	}
+}
+
+#endif  // OSSHS_SIM_CLOCK_HPP
@@ -0,0 +1,189 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_SIM_FLASH_MODEL_HPP
+#define OSSHS_SIM_FLASH_MODEL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <sim/memory.hpp>
+#include <sim/register.hpp>
+
+#define OSSHS_SIM_FLASH_PAGE_SIZE  (osshs::TargetMemoryMap::pageSize)
+#define OSSHS_SIM_FLASH_PAGE_COUNT (OSSHS_SIM_FLASH_LENGTH / OSSHS_SIM_FLASH_PAGE_SIZE)
+
+// Typical half word programming time and mid-range page erase time of the STM32F103 datasheet
+#define OSSHS_SIM_FLASH_PROGRAM_TIME_NS 52500
+#define OSSHS_SIM_FLASH_ERASE_TIME_NS   30000000
+
+namespace osshs
+{
+	namespace sim
+	{
+		struct FlashStatistics
+		{
+			uint32_t erases;            ///< Pages erased
+			uint32_t programs;          ///< Half words programmed
+			uint32_t programErrors;     ///< Half words not programmed because they were not erased (PGERR)
+			uint32_t protectionErrors;  ///< Accesses while locked or without PG/PER set
+			uint32_t busErrors;         ///< Accesses the hardware answers with a bus fault
+			uint64_t busyCycles;        ///< Core cycles the flash was busy
+		};
+
+		/**
+		 * Model of the flash memory interface (FPEC) of the STM32F1.
+		 *
+		 * Implements the unlock sequence, page erase and half word programming with their datasheet timing, and the
+		 * option bytes, which are erased and programmed the same way and loaded into OBR and WRPR at reset.
+		 * Programming only clears bits, and a half word that is not erased can only be programmed to 0x0000,
+		 * otherwise PGERR is set and the half word is left unchanged. Every page erase is counted as wear.
+		 */
+		class FlashModel
+		{
+		public:
+			/**
+			 * @brief Attach the model to the FLASH registers and erase the whole flash.
+			 */
+			static void
+			initialize();
+
+			/**
+			 * @brief Reset the flash interface, as on a system reset.
+			 * @note An operation in progress is completed first, flash contents and wear are kept.
+			 */
+			static void
+			reset();
+
+			/**
+			 * @brief Program a half word, called for every CPU store to flash.
+			 * @param address Address of the half word.
+			 * @param value Value stored by the CPU.
+			 */
+			static void
+			program(uint32_t address, uint16_t value);
+
+			/**
+			 * @brief Store data in flash as a programmer on the debug interface would, without timing or wear.
+			 * @param address Address to store the data at.
+			 * @param data Data to store.
+			 * @param length Length of the data in bytes.
+			 */
+			static void
+			store(uint32_t address, const uint8_t *data, std::size_t length);
+
+			/**
+			 * @brief Record a store to flash the hardware does not support (not half word sized or aligned).
+			 * @param address Address of the store.
+			 */
+			static void
+			busError(uint32_t address);
+
+			/**
+			 * @brief Load flash contents and wear from a file.
+			 * @note The file holds the flash image, optionally followed by one 32 bit erase counter per page.
+			 * @param path Path of the file.
+			 * @return Whether or not loading succeeded.
+			 */
+			static bool
+			load(const char *path);
+
+			/**
+			 * @brief Save flash contents and wear to a file.
+			 * @param path Path of the file.
+			 * @return Whether or not saving succeeded.
+			 */
+			static bool
+			save(const char *path);
+
+			/**
+			 * @brief Get the counters of all operations since the simulation started.
+			 * @return Statistics of the flash.
+			 */
+			static const FlashStatistics &
+			getStatistics();
+
+			/**
+			 * @brief Get the number of times a page was erased.
+			 * @param page Page number.
+			 * @return Erase count of the page, including counts loaded from file.
+			 */
+			static uint32_t
+			getWear(uint16_t page);
+
+		private:
+			static uint32_t
+			readStatus(Register &reg);
+
+			static void
+			writeStatus(Register &reg, uint32_t value);
+
+			static void
+			writeControl(Register &reg, uint32_t value);
+
+			static void
+			writeKey(Register &reg, uint32_t value);
+
+			static void
+			writeOptionKey(Register &reg, uint32_t value);
+
+			static uint32_t
+			readOption(Register &reg);
+
+			static void
+			writeOption(Register &reg, uint32_t value);
+
+			/**
+			 * @brief Stall until the operation in progress, if any, has finished.
+			 */
+			static void
+			waitUntilReady();
+
+			/**
+			 * @brief Start an operation taking the given time.
+			 * @param nanoseconds Duration of the operation.
+			 */
+			static void
+			startOperation(uint64_t nanoseconds);
+
+			/**
+			 * @brief Erase a page without timing it.
+			 * @param address Any address within the page.
+			 * @return Whether or not the address is within flash.
+			 */
+			static bool
+			erasePage(uint32_t address);
+
+			static bool busy;
+			static uint64_t busyUntil;
+			static uint8_t keyState;
+			static uint8_t optionKeyState;
+			static uint8_t options[8];
+			static bool keyLockout;
+			static uint32_t wear[OSSHS_SIM_FLASH_PAGE_COUNT];
+			static FlashStatistics statistics;
+		};
+	}
+}
+
+#endif  // OSSHS_SIM_FLASH_MODEL_HPP
@@ -0,0 +1,59 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_SIM_KNOWN_ANSWER_HPP
+#define OSSHS_SIM_KNOWN_ANSWER_HPP
+
+namespace osshs
+{
+	namespace sim
+	{
+		/**
+		 * Known answer tests of the crypto the bootloader verifies images with, run on the host.
+		 *
+		 * SHA-512 against the FIPS 180-2 examples, also fed byte by byte, and Ed25519 against the test vectors of
+		 * RFC 8032 section 7.1, along with signatures that must be rejected: a flipped bit in the signature or the
+		 * message, the wrong key and a non-canonical S.
+		 */
+		class KnownAnswer
+		{
+		public:
+			/**
+			 * @brief Run all tests and print one line per algorithm.
+			 * @return Whether or not every test passed.
+			 */
+			static bool
+			run();
+
+		private:
+			static bool
+			testSha512();
+
+			static bool
+			testEd25519();
+		};
+	}
+}
+
+#endif  // OSSHS_SIM_KNOWN_ANSWER_HPP
@@ -0,0 +1,94 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_SIM_LOG_DEVICE_TEST_HPP
+#define OSSHS_SIM_LOG_DEVICE_TEST_HPP
+
+#include <cstdint>
+#include <sim/register.hpp>
+#include <string>
+
+namespace osshs
+{
+	namespace sim
+	{
+		/**
+		 * Tests of log::DmaUsartDevice against a model of DMA1 channel 4, run on the host.
+		 *
+		 * The model sends bytes from CMAR on as the test steps it and restarts at CMAR whenever the channel is
+		 * enabled, as the DMA does. A frame written between pause() and resume() must appear in the output as a
+		 * whole, with every log byte sent exactly once and in order around it.
+		 */
+		class LogDeviceTest
+		{
+		public:
+			/**
+			 * @brief Run all tests and print one line.
+			 * @return Whether or not every test passed.
+			 */
+			static bool
+			run();
+
+		private:
+			/**
+			 * @brief Send up to count bytes, deliver a pending transfer complete interrupt first.
+			 */
+			static void
+			step(uint32_t count);
+
+			/**
+			 * @brief Step until the device is idle.
+			 */
+			static void
+			drain();
+
+			/**
+			 * @brief Pause the device, add a frame to the output, then resume.
+			 */
+			static void
+			sendFrame(const char *frame);
+
+			static void
+			writeControl(Register &reg, uint32_t value);
+
+			static bool
+			testPause();
+
+			static bool
+			testRepeatedPause();
+
+			static bool
+			testPauseAfterChunk();
+
+			static bool
+			testBlockWrite();
+
+			static const uint8_t *memory;
+			static bool interruptPending;
+			static std::string output;
+		};
+	}
+}
+
+#endif  // OSSHS_SIM_LOG_DEVICE_TEST_HPP
@@ -0,0 +1,86 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_SIM_MEMORY_HPP
+#define OSSHS_SIM_MEMORY_HPP
+
+#include <cstdint>
+#include <osshs/memory_map.hpp>
+
+// Same geometry as the target
+#define OSSHS_SIM_FLASH_ORIGIN (osshs::TargetMemoryMap::flashOrigin)
+#define OSSHS_SIM_FLASH_LENGTH (osshs::TargetMemoryMap::flashSize)
+
+#define OSSHS_SIM_RAM_ORIGIN (osshs::TargetMemoryMap::ramOrigin)
+#define OSSHS_SIM_RAM_LENGTH (osshs::TargetMemoryMap::ramSize)
+
+namespace osshs
+{
+	namespace sim
+	{
+		/**
+		 * Flash and RAM of the STM32F103CB, mapped at their real addresses.
+		 *
+		 * The bootloader accesses memory through plain pointers, so the regions are mapped into the host
+		 * process at the same addresses. Flash is mapped read-only: a store faults, is single-stepped and then
+		 * handed to FlashModel::program(), which applies the programming rules. An instruction fetch from flash
+		 * is the jump to the application and ends run().
+		 */
+		class Memory
+		{
+		public:
+			/**
+			 * @brief Map flash and RAM and install the fault handlers.
+			 * @return Whether or not mapping succeeded.
+			 */
+			static bool
+			initialize();
+
+			/**
+			 * @brief Allow or forbid writing to flash directly, for use by FlashModel.
+			 * @param writable Whether or not flash should be writable.
+			 */
+			static void
+			setFlashWritable(bool writable);
+
+			/**
+			 * @brief Fill RAM with pseudo random data, as after power-up.
+			 * @param seed Seed of the pseudo random data.
+			 */
+			static void
+			randomizeRam(uint32_t seed);
+
+			/**
+			 * @brief Run a function until it returns or jumps into flash.
+			 * @param function Function to run.
+			 * @param entryPoint Will contain the address jumped to.
+			 * @return Whether or not the function jumped into flash.
+			 */
+			static bool
+			run(void (*function)(), uint32_t &entryPoint);
+		};
+	}
+}
+
+#endif  // OSSHS_SIM_MEMORY_HPP
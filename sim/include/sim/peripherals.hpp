@@ -0,0 +1,92 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_SIM_PERIPHERALS_HPP
+#define OSSHS_SIM_PERIPHERALS_HPP
+
+#include <cstdint>
+#include <modm/platform.hpp>
+
+namespace osshs
+{
+	namespace sim
+	{
+		enum class ResetCause : uint8_t
+		{
+			POWER_ON,
+			PIN,
+			SOFTWARE,
+			WATCHDOG
+		};
+
+		/**
+		 * Models of the RCC, PWR, BKP, CRC and core debug (DWT) registers.
+		 *
+		 *   RCC    Reset flags according to the reset cause, RMVF clears them
+		 *   PWR    Backup domain write protection (DBP)
+		 *   BKP    16 bit data registers, only written with DBP set and the clocks enabled, cleared on power-on
+		 *   CRC    CRC-32 (polynomial 0x04c11db7) over 32 bit words, only clocked with CRCEN set
+		 *   DWT    Cycle counter counting simulated time while enabled
+		 */
+		class Peripherals
+		{
+		public:
+			/**
+			 * @brief Attach the models to their registers.
+			 */
+			static void
+			initialize();
+
+			/**
+			 * @brief Reset the peripherals.
+			 * @param cause Reset cause, the backup domain is only cleared on power-on.
+			 */
+			static void
+			reset(ResetCause cause);
+
+		private:
+			static void
+			writeResetFlags(Register &reg, uint32_t value);
+
+			static void
+			writeBackup(Register &reg, uint32_t value);
+
+			static void
+			writeCrcData(Register &reg, uint32_t value);
+
+			static void
+			writeCrcControl(Register &reg, uint32_t value);
+
+			static uint32_t
+			readCycleCounter(Register &reg);
+
+			static void
+			writeCycleCounter(Register &reg, uint32_t value);
+
+			static uint64_t cycleCounterBase;
+		};
+	}
+}
+
+#endif  // OSSHS_SIM_PERIPHERALS_HPP
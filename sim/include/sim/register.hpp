@@ -0,0 +1,117 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSSHS_SIM_REGISTER_HPP
+#define OSSHS_SIM_REGISTER_HPP
+
+#include <cstdint>
+#include <sim/clock.hpp>
+
+namespace osshs
+{
+	namespace sim
+	{
+		/**
+		 * Stand-in for a memory mapped peripheral register.
+		 *
+		 * Behaves like a volatile uint32_t for the operators used on CMSIS registers. A peripheral model can
+		 * attach handlers to react to accesses, otherwise the register simply stores the value written. Every
+		 * access costs OSSHS_SIM_REGISTER_ACCESS_CYCLES of simulated time.
+		 */
+		class Register
+		{
+		public:
+			using ReadHandler = uint32_t (*)(Register &reg);
+			using WriteHandler = void (*)(Register &reg, uint32_t value);
+
+			operator uint32_t()
+			{
+				Clock::advance(OSSHS_SIM_REGISTER_ACCESS_CYCLES);
+				return readHandler ? readHandler(*this) : value;
+			}
+
+			Register &
+			operator=(uint32_t value)
+			{
+				Clock::advance(OSSHS_SIM_REGISTER_ACCESS_CYCLES);
+				if (writeHandler)
+					writeHandler(*this, value);
+				else
+					this->value = value;
+				return *this;
+			}
+
+			Register &
+			operator=(Register &other)
+			{
+				return *this = static_cast<uint32_t>(other);
+			}
+
+			Register &
+			operator+=(uint32_t value)
+			{
+				return *this = static_cast<uint32_t>(*this) + value;
+			}
+
+			Register &
+			operator|=(uint32_t value)
+			{
+				return *this = static_cast<uint32_t>(*this) | value;
+			}
+
+			Register &
+			operator&=(uint32_t value)
+			{
+				return *this = static_cast<uint32_t>(*this) & value;
+			}
+
+			Register &
+			operator^=(uint32_t value)
+			{
+				return *this = static_cast<uint32_t>(*this) ^ value;
+			}
+
+			/**
+			 * @brief Attach handlers to the register.
+			 * @param read Called instead of reading the stored value, may be nullptr.
+			 * @param write Called instead of storing a written value, may be nullptr.
+			 */
+			void
+			attach(ReadHandler read, WriteHandler write)
+			{
+				readHandler = read;
+				writeHandler = write;
+			}
+
+			/// Stored value, handlers access it directly without triggering themselves
+			uint32_t value = 0;
+
+		private:
+			ReadHandler readHandler = nullptr;
+			WriteHandler writeHandler = nullptr;
+		};
+	}
+}
+
+#endif  // OSSHS_SIM_REGISTER_HPP
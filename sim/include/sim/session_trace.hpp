@@ -0,0 +1,124 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef OSSHS_SIM_SESSION_TRACE_HPP
+#define OSSHS_SIM_SESSION_TRACE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#define OSSHS_SIM_SESSION_MAGIC   0x5254534f
+#define OSSHS_SIM_SESSION_VERSION 1
+
+namespace osshs
+{
+	namespace sim
+	{
+		enum class SessionEvent : uint8_t
+		{
+			REQUEST = 0,        ///< Request the bootloader received
+			REQUEST_LOST = 1,   ///< Request the link lost, the bootloader never saw it
+			RESPONSE = 2,       ///< Response the host received
+			RESPONSE_LOST = 3   ///< Response the bootloader sent, but the link lost
+		};
+
+		struct SessionRecord
+		{
+			uint64_t time;         ///< Core cycles since the trace was opened
+			SessionEvent event;
+			uint8_t attempt;       ///< 0 for the first transmission of a request, counts retransmissions
+			uint32_t flashCycles;  ///< Responses: core cycles the flash was busy while the request was handled
+			uint16_t erases;       ///< Responses: pages erased while the request was handled
+			uint16_t programs;     ///< Responses: half words programmed while the request was handled
+			std::vector<uint8_t> message;
+		};
+
+		/**
+		 * Timestamped messages of update sessions as seen on the link between host and bootloader.
+		 *
+		 * The simulated host records what it sends and receives, including lost messages and retransmissions,
+		 * together with the flash operations each request caused. A replay delivers the requests at the same
+		 * times again, so changes to the protocol or the flash pipeline are compared on identical sessions.
+		 *
+		 *   offset  size  field
+		 *   0x00    4     magic      OSSHS_SIM_SESSION_MAGIC ("OSTR")
+		 *   0x04    2     version    OSSHS_SIM_SESSION_VERSION
+		 *   0x06    2     reserved   Always 0
+		 *   0x08    4     frequency  Core clock in Hz, times are in core cycles
+		 *   0x0c    4     flashCrc   CRC-32 of the flash when the trace was opened, a replay must start from it
+		 *   0x10    ...   records    (time[8], event, attempt, length[2], flashCycles[4], erases[2], programs[2],
+		 *                            message...), little endian
+		 */
+		class SessionTrace
+		{
+		public:
+			/**
+			 * @brief Start recording, the current time becomes time 0.
+			 * @param path Path of the trace file, overwritten.
+			 * @param flashCrc CRC-32 of the flash contents.
+			 * @return Whether or not the file could be created.
+			 */
+			static bool
+			open(const char *path, uint32_t flashCrc);
+
+			/**
+			 * @brief Append a record, if recording.
+			 * @param record Record, its time is set from the current time.
+			 */
+			static void
+			record(SessionRecord &record);
+
+			/**
+			 * @brief Stop recording.
+			 * @return Whether or not every record was written.
+			 */
+			static bool
+			close();
+
+			/**
+			 * @brief Read a trace.
+			 * @param path Path of the trace file.
+			 * @param flashCrc CRC-32 of the flash contents the trace started from.
+			 * @param records Records of the trace, oldest first.
+			 * @return Whether or not the file is a complete trace.
+			 */
+			static bool
+			load(const char *path, uint32_t &flashCrc, std::vector<SessionRecord> &records);
+
+		private:
+			static void
+			write(uint64_t value, std::size_t size);
+
+			static uint64_t
+			read(const uint8_t *&data, std::size_t size);
+
+			static std::FILE *file;
+			static uint64_t start;
+			static bool failed;
+		};
+	}
+}
+
+#endif  // OSSHS_SIM_SESSION_TRACE_HPP
@@ -0,0 +1,347 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <sim/can_model.hpp>
+#include <modm/platform.hpp>
+#include <cstring>
+
+namespace osshs
+{
+	namespace sim
+	{
+		CAN_TypeDef canRegisters;
+
+		CanModel::Mailbox CanModel::fifos[2][OSSHS_SIM_CAN_FIFO_DEPTH];
+		uint8_t CanModel::pending[2];
+		bool CanModel::overrun[2];
+		CanModel::InterruptHandler CanModel::handlers[2] = {nullptr, nullptr};
+		CanModel::InterruptHandler CanModel::errorHandler = nullptr;
+		std::vector<CanTransmission> CanModel::transmissions;
+		CanStatistics CanModel::statistics;
+
+		CanTransmission CanModel::repeated;
+		uint64_t CanModel::repeatPeriod = 0;
+		uint64_t CanModel::repeatNext = 0;
+
+		void
+		CanModel::initialize()
+		{
+			CAN1->MSR.attach(nullptr, writeMasterStatus);
+			CAN1->TSR.attach(nullptr, writeTransmitStatus);
+			CAN1->RF0R.attach(readFifoStatus, writeFifo0Status);
+			CAN1->RF1R.attach(readFifoStatus, writeFifo1Status);
+
+			for (CAN_TxMailBox_TypeDef &mailbox : CAN1->sTxMailBox)
+				mailbox.TIR.attach(nullptr, writeTransmitIdentifier);
+
+			RCC->APB1RSTR.attach(nullptr, writeApb1Reset);
+
+			reset();
+		}
+
+		void
+		CanModel::reset()
+		{
+			// Reset values of the reference manual, the filter registers are undefined
+			CAN1->MCR.value = 0x00010002;
+			CAN1->MSR.value = 0x00000c02;
+			CAN1->TSR.value = CAN_TSR_TME0 | CAN_TSR_TME1 | CAN_TSR_TME2;
+			CAN1->IER.value = 0;
+			CAN1->ESR.value = 0;
+			CAN1->BTR.value = 0x01230000;
+			CAN1->FMR.value = 0x2a1c0e01;
+			CAN1->FM1R.value = 0;
+			CAN1->FS1R.value = 0;
+			CAN1->FFA1R.value = 0;
+			CAN1->FA1R.value = 0;
+
+			for (CAN_FilterRegister_TypeDef &bank : CAN1->sFilterRegister)
+			{
+				bank.FR1.value = 0;
+				bank.FR2.value = 0;
+			}
+
+			for (uint8_t fifo = 0; fifo < 2; fifo++)
+			{
+				pending[fifo] = 0;
+				overrun[fifo] = false;
+				update(fifo);
+			}
+		}
+
+		void
+		CanModel::attachInterrupt(uint8_t fifo, InterruptHandler handler)
+		{
+			handlers[fifo] = handler;
+		}
+
+		void
+		CanModel::attachErrorInterrupt(InterruptHandler handler)
+		{
+			errorHandler = handler;
+		}
+
+		void
+		CanModel::raiseError()
+		{
+			statistics.errors++;
+
+			// CRC error in LEC, the receive error counter saturates here instead of going bus off
+			uint32_t esr = CAN1->ESR.value;
+			uint32_t rec = esr >> 24;
+			CAN1->ESR.value = (esr & 0x00ffff8f) | 6 << 4 | (rec < 0xff ? rec + 1 : rec) << 24;
+
+			if (CAN1->IER.value & CAN_IER_LECIE)
+				CAN1->MSR.value |= CAN_MSR_ERRI;
+
+			// Level triggered like the receive interrupts
+			for (uint8_t i = 0; i < 4 && errorHandler; i++)
+			{
+				if (!((CAN1->MSR.value & CAN_MSR_ERRI) && (CAN1->IER.value & CAN_IER_ERRIE)))
+					break;
+
+				errorHandler();
+			}
+		}
+
+		bool
+		CanModel::deliver(uint16_t id, const uint8_t *data, uint8_t length)
+		{
+			statistics.frames++;
+
+			// A frame received without error counts the receive error counter down
+			uint32_t rec = CAN1->ESR.value >> 24;
+			CAN1->ESR.value = (CAN1->ESR.value & 0x00ffff8f) | (rec ? rec - 1 : 0) << 24;
+
+			int fifo = filter(id);
+			if (fifo < 0)
+				return false;
+
+			statistics.accepted++;
+
+			if (pending[fifo] == OSSHS_SIM_CAN_FIFO_DEPTH)
+			{
+				overrun[fifo] = true;
+				statistics.overruns++;
+			}
+			else
+			{
+				uint8_t bytes[8] = {};
+				std::memcpy(bytes, data, length);
+
+				Mailbox &mailbox = fifos[fifo][pending[fifo]++];
+				mailbox.rir = static_cast<uint32_t>(id) << 21;
+				mailbox.rdtr = length;
+				mailbox.rdlr = bytes[0] | bytes[1] << 8 | bytes[2] << 16 | static_cast<uint32_t>(bytes[3]) << 24;
+				mailbox.rdhr = bytes[4] | bytes[5] << 8 | bytes[6] << 16 | static_cast<uint32_t>(bytes[7]) << 24;
+			}
+
+			update(fifo);
+
+			// Level triggered, the handler runs again as long as it leaves a condition set
+			uint32_t enable = fifo ? CAN_IER_FMPIE1 : CAN_IER_FMPIE0;
+			uint32_t overrunEnable = fifo ? CAN_IER_FOVIE1 : CAN_IER_FOVIE0;
+			for (uint8_t i = 0; i < 4 && handlers[fifo]; i++)
+			{
+				if (!(pending[fifo] && (CAN1->IER.value & enable)) && !(overrun[fifo] && (CAN1->IER.value & overrunEnable)))
+					break;
+
+				uint64_t start = Clock::now();
+				handlers[fifo]();
+				statistics.interrupts++;
+				statistics.interruptCycles += Clock::now() - start;
+			}
+
+			return true;
+		}
+
+		void
+		CanModel::repeat(uint16_t id, const uint8_t *data, uint8_t length, uint64_t period)
+		{
+			repeated.id = id;
+			repeated.length = length;
+			std::memcpy(repeated.data, data, length);
+			repeatPeriod = period;
+			repeatNext = Clock::now() + period;
+		}
+
+		std::vector<CanTransmission>
+		CanModel::takeTransmissions()
+		{
+			std::vector<CanTransmission> taken;
+			taken.swap(transmissions);
+			return taken;
+		}
+
+		const CanStatistics &
+		CanModel::getStatistics()
+		{
+			return statistics;
+		}
+
+		int
+		CanModel::filter(uint16_t id)
+		{
+			// Nothing is received in filter initialization mode
+			if (CAN1->FMR.value & CAN_FMR_FINIT)
+				return -1;
+
+			// Standard data frame, as compared by the filters
+			uint32_t value16 = static_cast<uint32_t>(id) << 5;
+			uint32_t value32 = static_cast<uint32_t>(id) << 21;
+
+			// The lowest matching bank wins, which is what the hardware does for banks of the same scale and mode
+			for (uint8_t bank = 0; bank < OSSHS_SIM_CAN_FILTER_BANKS; bank++)
+			{
+				if (!(CAN1->FA1R.value & (1u << bank)))
+					continue;
+
+				uint32_t fr1 = CAN1->sFilterRegister[bank].FR1.value;
+				uint32_t fr2 = CAN1->sFilterRegister[bank].FR2.value;
+				bool list = CAN1->FM1R.value & (1u << bank);
+				bool matched;
+
+				if (CAN1->FS1R.value & (1u << bank))
+					matched = list ? value32 == fr1 || value32 == fr2 : !((value32 ^ fr1) & fr2);
+				else if (list)
+					matched = value16 == (fr1 & 0xffff) || value16 == fr1 >> 16 || value16 == (fr2 & 0xffff) || value16 == fr2 >> 16;
+				else
+					matched = !((value16 ^ fr1) & fr1 >> 16 & 0xffff) || !((value16 ^ fr2) & fr2 >> 16 & 0xffff);
+
+				if (matched)
+					return CAN1->FFA1R.value & (1u << bank) ? 1 : 0;
+			}
+
+			return -1;
+		}
+
+		void
+		CanModel::update(uint8_t fifo)
+		{
+			Register &status = fifo ? CAN1->RF1R : CAN1->RF0R;
+			status.value = pending[fifo] | (pending[fifo] == OSSHS_SIM_CAN_FIFO_DEPTH ? CAN_RF0R_FULL0 : 0) |
+				(overrun[fifo] ? CAN_RF0R_FOVR0 : 0);
+
+			const Mailbox &mailbox = fifos[fifo][0];
+			CAN1->sFIFOMailBox[fifo].RIR.value = pending[fifo] ? mailbox.rir : 0;
+			CAN1->sFIFOMailBox[fifo].RDTR.value = pending[fifo] ? mailbox.rdtr : 0;
+			CAN1->sFIFOMailBox[fifo].RDLR.value = pending[fifo] ? mailbox.rdlr : 0;
+			CAN1->sFIFOMailBox[fifo].RDHR.value = pending[fifo] ? mailbox.rdhr : 0;
+		}
+
+		uint32_t
+		CanModel::readFifoStatus(Register &reg)
+		{
+			// Delivering updates the status register itself
+			while (repeatPeriod && Clock::now() >= repeatNext)
+			{
+				repeatNext += repeatPeriod;
+				deliver(repeated.id, repeated.data, repeated.length);
+			}
+
+			return reg.value;
+		}
+
+		void
+		CanModel::writeFifo0Status(Register &, uint32_t value)
+		{
+			writeFifoStatus(0, value);
+		}
+
+		void
+		CanModel::writeFifo1Status(Register &, uint32_t value)
+		{
+			writeFifoStatus(1, value);
+		}
+
+		void
+		CanModel::writeFifoStatus(uint8_t fifo, uint32_t value)
+		{
+			// Releasing the output mailbox completes immediately
+			if ((value & CAN_RF0R_RFOM0) && pending[fifo])
+			{
+				for (uint8_t i = 1; i < pending[fifo]; i++)
+					fifos[fifo][i - 1] = fifos[fifo][i];
+				pending[fifo]--;
+			}
+
+			// FULL and FOVR are cleared by writing 1
+			if (value & CAN_RF0R_FOVR0)
+				overrun[fifo] = false;
+
+			update(fifo);
+		}
+
+		void
+		CanModel::writeTransmitIdentifier(Register &reg, uint32_t value)
+		{
+			reg.value = value & ~CAN_TI0R_TXRQ;
+
+			if (!(value & CAN_TI0R_TXRQ))
+				return;
+
+			for (CAN_TxMailBox_TypeDef &mailbox : CAN1->sTxMailBox)
+				if (&mailbox.TIR == &reg)
+				{
+					CanTransmission transmission;
+					transmission.id = value >> 21;
+					transmission.length = mailbox.TDTR.value & 0xf;
+
+					for (uint8_t i = 0; i < 8; i++)
+						transmission.data[i] = (i < 4 ? mailbox.TDLR.value : mailbox.TDHR.value) >> (i % 4 * 8);
+
+					transmissions.push_back(transmission);
+
+					// Request completed and transmitted, the mailbox is empty again
+					uint8_t index = &mailbox - CAN1->sTxMailBox;
+					CAN1->TSR.value |= (CAN_TSR_RQCP0 | CAN_TSR_TXOK0) << (index * 8);
+				}
+		}
+
+		void
+		CanModel::writeMasterStatus(Register &reg, uint32_t value)
+		{
+			// ERRI, WKUI and SLAKI are cleared by writing 1, the rest is read only
+			reg.value &= ~(value & 0x1c);
+		}
+
+		void
+		CanModel::writeTransmitStatus(Register &reg, uint32_t value)
+		{
+			// Writing RQCP clears the status bits of its mailbox, aborting is not modelled
+			for (uint8_t index = 0; index < 3; index++)
+				if (value & CAN_TSR_RQCP0 << (index * 8))
+					reg.value &= ~(0xfu << (index * 8));
+		}
+
+		void
+		CanModel::writeApb1Reset(Register &reg, uint32_t value)
+		{
+			if (value & ~reg.value & RCC_APB1RSTR_CAN1RST)
+				reset();
+
+			reg.value = value;
+		}
+	}
+}
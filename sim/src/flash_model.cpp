@@ -0,0 +1,364 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <osshs/flash.hpp>
+#include <sim/flash_model.hpp>
+#include <modm/platform.hpp>
+#include <cstdio>
+#include <cstring>
+
+namespace osshs
+{
+	namespace sim
+	{
+		static uint8_t * const flash = reinterpret_cast<uint8_t *>(OSSHS_SIM_FLASH_ORIGIN);
+
+		bool FlashModel::busy = false;
+		uint64_t FlashModel::busyUntil = 0;
+		uint8_t FlashModel::keyState = 0;
+		uint8_t FlashModel::optionKeyState = 0;
+		uint8_t FlashModel::options[8];
+		bool FlashModel::keyLockout = false;
+		uint32_t FlashModel::wear[OSSHS_SIM_FLASH_PAGE_COUNT];
+		FlashStatistics FlashModel::statistics;
+
+		void
+		FlashModel::initialize()
+		{
+			FLASH->SR.attach(readStatus, writeStatus);
+			FLASH->CR.attach(nullptr, writeControl);
+			FLASH->KEYR.attach(nullptr, writeKey);
+			FLASH->OPTKEYR.attach(nullptr, writeOptionKey);
+
+			// RDP, USER, Data0, Data1 and WRP0 to WRP3 as shipped: unprotected and without write protection
+			Register *optionRegisters = &OB->RDP;
+			for (uint8_t i = 0; i < sizeof(options); i++)
+			{
+				optionRegisters[i].attach(readOption, writeOption);
+				options[i] = i ? 0xff : OSSHS_FLASH_KEY_RDPRT;
+			}
+
+			Memory::setFlashWritable(true);
+			std::memset(flash, 0xff, OSSHS_SIM_FLASH_LENGTH);
+			Memory::setFlashWritable(false);
+
+			reset();
+		}
+
+		void
+		FlashModel::reset()
+		{
+			waitUntilReady();
+
+			FLASH->CR.value = FLASH_CR_LOCK;
+			FLASH->SR.value = 0;
+			FLASH->AR.value = 0;
+			keyState = 0;
+			keyLockout = false;
+			optionKeyState = 0;
+
+			// The option bytes are loaded into OBR and WRPR at reset only
+			FLASH->OBR.value = (options[0] != OSSHS_FLASH_KEY_RDPRT ? FLASH_OBR_RDPRT : 0) | (options[1] & 0x07) << 2 |
+				options[2] << 10 | options[3] << 18;
+			FLASH->WRPR.value = options[4] | options[5] << 8 | options[6] << 16 | static_cast<uint32_t>(options[7]) << 24;
+		}
+
+		void
+		FlashModel::program(uint32_t address, uint16_t value)
+		{
+			if ((FLASH->CR.value & (FLASH_CR_LOCK | FLASH_CR_PG)) != FLASH_CR_PG)
+			{
+				statistics.protectionErrors++;
+				return;
+			}
+
+			// The bus stalls until the previous operation has finished
+			waitUntilReady();
+
+			uint16_t current;
+			std::memcpy(&current, flash + address - OSSHS_SIM_FLASH_ORIGIN, sizeof(current));
+
+			// Only erased half words can be programmed, except to zero
+			if (current != 0xffff && value != 0x0000)
+			{
+				FLASH->SR.value |= FLASH_SR_PGERR;
+				statistics.programErrors++;
+				return;
+			}
+
+			// Programming can only clear bits
+			current &= value;
+
+			Memory::setFlashWritable(true);
+			std::memcpy(flash + address - OSSHS_SIM_FLASH_ORIGIN, &current, sizeof(current));
+			Memory::setFlashWritable(false);
+
+			statistics.programs++;
+			startOperation(OSSHS_SIM_FLASH_PROGRAM_TIME_NS);
+		}
+
+		void
+		FlashModel::store(uint32_t address, const uint8_t *data, std::size_t length)
+		{
+			Memory::setFlashWritable(true);
+			std::memcpy(flash + address - OSSHS_SIM_FLASH_ORIGIN, data, length);
+			Memory::setFlashWritable(false);
+		}
+
+		void
+		FlashModel::busError(uint32_t address)
+		{
+			std::fprintf(stderr, "Flash bus error(address = `0x%08x`).\n", address);
+			statistics.busErrors++;
+		}
+
+		bool
+		FlashModel::load(const char *path)
+		{
+			FILE *file = std::fopen(path, "rb");
+			if (!file)
+				return false;
+
+			Memory::setFlashWritable(true);
+			bool succeeded = std::fread(flash, 1, OSSHS_SIM_FLASH_LENGTH, file) == OSSHS_SIM_FLASH_LENGTH;
+			Memory::setFlashWritable(false);
+
+			// The wear counters are optional
+			if (std::fread(wear, sizeof(wear), 1, file) != 1)
+				std::memset(wear, 0, sizeof(wear));
+
+			std::fclose(file);
+			return succeeded;
+		}
+
+		bool
+		FlashModel::save(const char *path)
+		{
+			FILE *file = std::fopen(path, "wb");
+			if (!file)
+				return false;
+
+			bool succeeded = std::fwrite(flash, 1, OSSHS_SIM_FLASH_LENGTH, file) == OSSHS_SIM_FLASH_LENGTH &&
+				std::fwrite(wear, sizeof(wear), 1, file) == 1;
+
+			return std::fclose(file) == 0 && succeeded;
+		}
+
+		const FlashStatistics &
+		FlashModel::getStatistics()
+		{
+			return statistics;
+		}
+
+		uint32_t
+		FlashModel::getWear(uint16_t page)
+		{
+			return page < OSSHS_SIM_FLASH_PAGE_COUNT ? wear[page] : 0;
+		}
+
+		uint32_t
+		FlashModel::readStatus(Register &reg)
+		{
+			if (busy && Clock::now() >= busyUntil)
+			{
+				busy = false;
+				reg.value |= FLASH_SR_EOP;
+			}
+
+			return reg.value | (busy ? FLASH_SR_BSY : 0);
+		}
+
+		void
+		FlashModel::writeStatus(Register &reg, uint32_t value)
+		{
+			// Error and end of operation flags are cleared by writing 1
+			reg.value &= ~(value & (FLASH_SR_PGERR | FLASH_SR_WRPRTERR | FLASH_SR_EOP));
+		}
+
+		void
+		FlashModel::writeControl(Register &reg, uint32_t value)
+		{
+			// The control register is write protected while locked
+			if (reg.value & FLASH_CR_LOCK)
+			{
+				statistics.protectionErrors++;
+				return;
+			}
+
+			waitUntilReady();
+
+			// STRT is cleared by hardware once the operation has started, OPTWRE is only ever set by the option key
+			reg.value = (value & ~(FLASH_CR_STRT | FLASH_CR_OPTWRE)) | (value & reg.value & FLASH_CR_OPTWRE);
+
+			if (value & FLASH_CR_STRT)
+			{
+				if ((value & FLASH_CR_OPTER) && (reg.value & FLASH_CR_OPTWRE))
+				{
+					std::memset(options, 0xff, sizeof(options));
+					startOperation(OSSHS_SIM_FLASH_ERASE_TIME_NS);
+				}
+				else if (value & FLASH_CR_MER)
+				{
+					for (uint32_t address = OSSHS_SIM_FLASH_ORIGIN; address < OSSHS_SIM_FLASH_ORIGIN + OSSHS_SIM_FLASH_LENGTH;
+						address += OSSHS_SIM_FLASH_PAGE_SIZE)
+						erasePage(address);
+
+					startOperation(OSSHS_SIM_FLASH_ERASE_TIME_NS);
+				}
+				else if (value & FLASH_CR_PER)
+				{
+					if (erasePage(FLASH->AR.value))
+						startOperation(OSSHS_SIM_FLASH_ERASE_TIME_NS);
+				}
+				else
+				{
+					statistics.protectionErrors++;
+				}
+			}
+		}
+
+		void
+		FlashModel::writeKey(Register &, uint32_t value)
+		{
+			if (keyLockout || !(FLASH->CR.value & FLASH_CR_LOCK))
+				return;
+
+			if (keyState == 0 && value == OSSHS_FLASH_KEY1)
+			{
+				keyState = 1;
+			}
+			else if (keyState == 1 && value == OSSHS_FLASH_KEY2)
+			{
+				keyState = 0;
+				FLASH->CR.value &= ~FLASH_CR_LOCK;
+			}
+			else
+			{
+				// A wrong sequence locks the interface until the next reset
+				keyLockout = true;
+				statistics.busErrors++;
+			}
+		}
+
+		void
+		FlashModel::writeOptionKey(Register &, uint32_t value)
+		{
+			// The option bytes unlock only while the flash interface is unlocked
+			if (FLASH->CR.value & FLASH_CR_LOCK)
+			{
+				statistics.protectionErrors++;
+				return;
+			}
+
+			if (optionKeyState == 0 && value == OSSHS_FLASH_KEY1)
+			{
+				optionKeyState = 1;
+			}
+			else if (optionKeyState == 1 && value == OSSHS_FLASH_KEY2)
+			{
+				optionKeyState = 0;
+				FLASH->CR.value |= FLASH_CR_OPTWRE;
+			}
+			else
+			{
+				optionKeyState = 0;
+				statistics.busErrors++;
+			}
+		}
+
+		uint32_t
+		FlashModel::readOption(Register &reg)
+		{
+			// Every byte is stored with its complement in the upper half
+			uint8_t value = options[&reg - &OB->RDP];
+			return value | static_cast<uint8_t>(~value) << 8;
+		}
+
+		void
+		FlashModel::writeOption(Register &reg, uint32_t value)
+		{
+			if ((FLASH->CR.value & (FLASH_CR_OPTPG | FLASH_CR_OPTWRE)) != (FLASH_CR_OPTPG | FLASH_CR_OPTWRE))
+			{
+				statistics.protectionErrors++;
+				return;
+			}
+
+			waitUntilReady();
+
+			// Option bytes are programmed like half words, only an erased byte takes a value
+			uint8_t &option = options[&reg - &OB->RDP];
+			if (option != 0xff)
+			{
+				FLASH->SR.value |= FLASH_SR_PGERR;
+				statistics.programErrors++;
+				return;
+			}
+
+			option = value;
+			statistics.programs++;
+			startOperation(OSSHS_SIM_FLASH_PROGRAM_TIME_NS);
+		}
+
+		void
+		FlashModel::waitUntilReady()
+		{
+			if (!busy)
+				return;
+
+			Clock::advanceTo(busyUntil);
+			busy = false;
+			FLASH->SR.value |= FLASH_SR_EOP;
+		}
+
+		void
+		FlashModel::startOperation(uint64_t nanoseconds)
+		{
+			uint64_t duration = Clock::fromNanoseconds(nanoseconds);
+
+			busy = true;
+			busyUntil = Clock::now() + duration;
+			statistics.busyCycles += duration;
+		}
+
+		bool
+		FlashModel::erasePage(uint32_t address)
+		{
+			uint32_t offset = (address - OSSHS_SIM_FLASH_ORIGIN) / OSSHS_SIM_FLASH_PAGE_SIZE * OSSHS_SIM_FLASH_PAGE_SIZE;
+			if (offset >= OSSHS_SIM_FLASH_LENGTH)
+			{
+				FLASH->SR.value |= FLASH_SR_WRPRTERR;
+				statistics.protectionErrors++;
+				return false;
+			}
+
+			Memory::setFlashWritable(true);
+			std::memset(flash + offset, 0xff, OSSHS_SIM_FLASH_PAGE_SIZE);
+			Memory::setFlashWritable(false);
+
+			wear[offset / OSSHS_SIM_FLASH_PAGE_SIZE]++;
+			statistics.erases++;
+			return true;
+		}
+	}
+}
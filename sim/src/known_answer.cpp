@@ -0,0 +1,199 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <osshs/crypto/ed25519.hpp>
+#include <osshs/crypto/sha512.hpp>
+#include <sim/known_answer.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace osshs
+{
+	namespace sim
+	{
+		namespace
+		{
+			struct Sha512Vector
+			{
+				const char *message;
+				const char *digest;
+			};
+
+			// FIPS 180-2, appendix C
+			const Sha512Vector sha512Vectors[] = {
+				{"",
+					"cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce"
+					"47d0d13c5d85f2b0ff8318d2877eec2f63b931bd47417a81a538327af927da3e"},
+				{"abc",
+					"ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+					"2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f"},
+				{"abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+					"8e959b75dae313da8cf4f72814fc143f8f7779c6eb9f7fa17299aeadb6889018"
+					"501d289e4900f7e4331b99dec4b5433ac7d329eeb6dd26545e96e55b874be909"}
+			};
+
+			struct Ed25519Vector
+			{
+				const char *publicKey;
+				const char *message;
+				const char *signature;
+			};
+
+			// RFC 8032, section 7.1, TEST 1, 2, 3 and SHA(abc)
+			const Ed25519Vector ed25519Vectors[] = {
+				{"d75a980182b10ab7d54bfed3c964073a0ee172f3daa62325af021a68f707511a",
+					"",
+					"e5564300c360ac729086e2cc806e828a84877f1eb8e5d974d873e06522490155"
+					"5fb8821590a33bacc61e39701cf9b46bd25bf5f0595bbe24655141438e7a100b"},
+				{"3d4017c3e843895a92b70aa74d1b7ebc9c982ccf2ec4968cc0cd55f12af4660c",
+					"72",
+					"92a009a9f0d4cab8720e820b5f642540a2b27b5416503f8fb3762223ebdb69da"
+					"085ac1e43e15996e458f3613d0f11d8c387b2eaeb4302aeeb00d291612bb0c00"},
+				{"fc51cd8e6218a1a38da47ed00230f0580816ed13ba3303ac5deb911548908025",
+					"af82",
+					"6291d657deec24024827e69c3abe01a30ce548a284743a445e3680d7db5ac3ac"
+					"18ff9b538d16f290ae67f760984dc6594a7c15e9716ed28dc027beceea1ec40a"},
+				{"ec172b93ad5e563bf4932c70e1245034c35467ef2efd4d64ebf819683467e2bf",
+					"ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+					"2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f",
+					"dc2a4459e7369633a52b1bf277839a00201009a3efbf3ecb69bea2186c26b589"
+					"09351fc9ac90b3ecfdfbc7c66431e0303dca179c138ac17ad9bef1177331a704"}
+			};
+
+			// Order of the base point, little endian, S + L verifies the same unless S >= L is refused
+			const uint8_t groupOrder[32] = {
+				0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+				0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10
+			};
+
+			std::vector<uint8_t>
+			parseHex(const char *hex)
+			{
+				std::vector<uint8_t> data;
+				for (std::size_t i = 0; hex[i] && hex[i + 1]; i += 2)
+				{
+					char byte[3] = {hex[i], hex[i + 1], 0};
+					data.push_back(std::strtoul(byte, nullptr, 16));
+				}
+
+				return data;
+			}
+
+			void
+			report(const char *name, uint32_t passed, uint32_t total)
+			{
+				std::printf("known answer: %s %s, %u of %u tests passed\n", name, passed == total ? "ok" : "failed",
+					passed, total);
+			}
+		}
+
+		bool
+		KnownAnswer::run()
+		{
+			bool sha512 = testSha512();
+			bool ed25519 = testEd25519();
+			return sha512 && ed25519;
+		}
+
+		bool
+		KnownAnswer::testSha512()
+		{
+			uint32_t passed = 0;
+			uint32_t total = 0;
+
+			for (const Sha512Vector &vector : sha512Vectors)
+			{
+				const uint8_t *message = reinterpret_cast<const uint8_t *>(vector.message);
+				std::size_t length = std::strlen(vector.message);
+				std::vector<uint8_t> expected = parseHex(vector.digest);
+				uint8_t digest[OSSHS_SHA512_DIGEST_SIZE];
+
+				// Whole, then byte by byte to cross every block boundary with a partial buffer
+				for (std::size_t chunk : {length, static_cast<std::size_t>(1)})
+				{
+					crypto::Sha512 sha512;
+					sha512.reset();
+					for (std::size_t offset = 0; offset < length; offset += chunk)
+						sha512.update(message + offset, chunk < length - offset ? chunk : length - offset);
+					sha512.finish(digest);
+
+					passed += !std::memcmp(digest, expected.data(), sizeof(digest));
+					total++;
+				}
+			}
+
+			report("Sha512", passed, total);
+			return passed == total;
+		}
+
+		bool
+		KnownAnswer::testEd25519()
+		{
+			uint32_t passed = 0;
+			uint32_t total = 0;
+
+			const std::size_t count = sizeof(ed25519Vectors) / sizeof(ed25519Vectors[0]);
+			for (std::size_t i = 0; i < count; i++)
+			{
+				std::vector<uint8_t> publicKey = parseHex(ed25519Vectors[i].publicKey);
+				std::vector<uint8_t> message = parseHex(ed25519Vectors[i].message);
+				std::vector<uint8_t> signature = parseHex(ed25519Vectors[i].signature);
+				std::vector<uint8_t> otherKey = parseHex(ed25519Vectors[(i + 1) % count].publicKey);
+
+				passed += crypto::Ed25519::verify(signature.data(), publicKey.data(), message.data(), message.size());
+				passed += !crypto::Ed25519::verify(signature.data(), otherKey.data(), message.data(), message.size());
+				total += 2;
+
+				std::vector<uint8_t> forged = signature;
+				forged[OSSHS_ED25519_SIGNATURE_SIZE / 2 + 3] ^= 0x10;
+				passed += !crypto::Ed25519::verify(forged.data(), publicKey.data(), message.data(), message.size());
+				total++;
+
+				if (!message.empty())
+				{
+					forged = message;
+					forged[0] ^= 0x01;
+					passed += !crypto::Ed25519::verify(signature.data(), publicKey.data(), forged.data(), forged.size());
+					total++;
+				}
+
+				// S + L, which RFC 8032 requires to be refused
+				forged = signature;
+				for (uint16_t byte = 0, carry = 0; byte < sizeof(groupOrder); byte++)
+				{
+					carry += forged[OSSHS_ED25519_SIGNATURE_SIZE / 2 + byte] + groupOrder[byte];
+					forged[OSSHS_ED25519_SIGNATURE_SIZE / 2 + byte] = carry;
+					carry >>= 8;
+				}
+				passed += !crypto::Ed25519::verify(forged.data(), publicKey.data(), message.data(), message.size());
+				total++;
+			}
+
+			report("Ed25519", passed, total);
+			return passed == total;
+		}
+	}
+}
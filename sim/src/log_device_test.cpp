@@ -0,0 +1,203 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <osshs/log/dma_usart_device.hpp>
+#include <sim/log_device_test.hpp>
+#include <cstdio>
+#include <cstring>
+
+namespace osshs
+{
+	namespace sim
+	{
+		namespace
+		{
+			using Device = log::DmaUsartDevice<256, log::OverflowPolicy::DROP_NEWEST>;
+
+			// Longer than a chunk, so a chunk ends within it
+			const char message[] =
+				"0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789abcdefghijklmnopqrstuv\n";
+
+			bool
+			check(bool passed, const char *name)
+			{
+				if (!passed)
+					std::printf("log device: %s failed\n", name);
+
+				return passed;
+			}
+		}
+
+		const uint8_t *LogDeviceTest::memory = nullptr;
+		bool LogDeviceTest::interruptPending = false;
+		std::string LogDeviceTest::output;
+
+		bool
+		LogDeviceTest::run()
+		{
+			DMA1_Channel4->CCR.attach(nullptr, writeControl);
+			USART1->SR.value = USART_SR_TC;
+			Device::initialize();
+
+			struct
+			{
+				const char *name;
+				bool (*test)();
+			} const tests[] = {
+				{"pause", testPause},
+				{"repeated pause", testRepeatedPause},
+				{"pause after chunk", testPauseAfterChunk},
+				{"block write", testBlockWrite}
+			};
+
+			uint32_t passed = 0;
+			uint32_t total = 0;
+			for (const auto &test : tests)
+			{
+				output.clear();
+				passed += check(test.test() && Device::isWriteFinished(), test.name);
+				total++;
+			}
+
+			Device::deinitialize();
+			DMA1_Channel4->CCR.attach(nullptr, nullptr);
+
+			std::printf("log device: DmaUsartDevice %s, %u of %u tests passed\n", passed == total ? "ok" : "failed",
+				passed, total);
+			return passed == total;
+		}
+
+		void
+		LogDeviceTest::step(uint32_t count)
+		{
+			if (interruptPending)
+			{
+				interruptPending = false;
+				Device::handleInterrupt();
+			}
+
+			for (; count && (DMA1_Channel4->CCR.value & DMA_CCR_EN) && DMA1_Channel4->CNDTR.value; count--)
+			{
+				output += static_cast<char>(*memory++);
+
+				// Completion is delivered by the next step, so a chunk can complete with its interrupt pending
+				if (!--DMA1_Channel4->CNDTR.value && (DMA1_Channel4->CCR.value & DMA_CCR_TCIE))
+					interruptPending = true;
+			}
+		}
+
+		void
+		LogDeviceTest::drain()
+		{
+			for (uint32_t i = 0; i < 1000 && !Device::isWriteFinished(); i++)
+				step(7);
+		}
+
+		void
+		LogDeviceTest::sendFrame(const char *frame)
+		{
+			Device::pause();
+			output += frame;
+			step(16);
+			Device::resume();
+		}
+
+		void
+		LogDeviceTest::writeControl(Register &reg, uint32_t value)
+		{
+			// Only the low 32 bits of a host address fit CMAR, the high ones are those of the static data
+			if ((value & DMA_CCR_EN) && !(reg.value & DMA_CCR_EN))
+				memory = reinterpret_cast<const uint8_t *>((reinterpret_cast<uintptr_t>(&memory) & ~0xffffffffull) |
+					DMA1_Channel4->CMAR.value);
+
+			reg.value = value;
+		}
+
+		bool
+		LogDeviceTest::testPause()
+		{
+			// Log bytes queued while paused follow the rest of the chunk
+			Device::write(reinterpret_cast<const uint8_t *>(message), sizeof(message) - 1);
+			step(10);
+			Device::pause();
+			output += "[frame]";
+			step(5);
+			Device::write(reinterpret_cast<const uint8_t *>("late\n"), 5);
+			Device::resume();
+			drain();
+
+			return output == std::string(message, 10) + "[frame]" + std::string(message + 10) + "late\n";
+		}
+
+		bool
+		LogDeviceTest::testRepeatedPause()
+		{
+			// Every pause moves CMAR, the next one must count from there and not from the start of the chunk
+			Device::write(reinterpret_cast<const uint8_t *>(message), sizeof(message) - 1);
+			step(5);
+			sendFrame("[1]");
+			step(7);
+			sendFrame("[2]");
+			sendFrame("[3]");
+			step(3);
+			sendFrame("[4]");
+			drain();
+
+			return output == std::string(message, 5) + "[1]" + std::string(message + 5, 7) + "[2][3]" +
+				std::string(message + 12, 3) + "[4]" + std::string(message + 15);
+		}
+
+		bool
+		LogDeviceTest::testPauseAfterChunk()
+		{
+			// The chunk is sent but its interrupt still pending when the frame starts, the interrupt must not start
+			// the next chunk while paused
+			Device::write(reinterpret_cast<const uint8_t *>("short\n"), 6);
+			step(6);
+			Device::pause();
+			step(0);
+			Device::write(reinterpret_cast<const uint8_t *>("next\n"), 5);
+			step(16);
+			output += "[frame]";
+			Device::resume();
+			drain();
+
+			return output == "short\n[frame]next\n";
+		}
+
+		bool
+		LogDeviceTest::testBlockWrite()
+		{
+			// A block is queued whole or not at all
+			Device::pause();
+			bool first = Device::write(reinterpret_cast<const uint8_t *>(message), sizeof(message) - 1);
+			bool second = Device::write(reinterpret_cast<const uint8_t *>(message), sizeof(message) - 1);
+			bool third = Device::write(reinterpret_cast<const uint8_t *>(message), sizeof(message) - 1);
+			Device::resume();
+			drain();
+
+			return first && second && !third && output == std::string(message) + message;
+		}
+	}
+}
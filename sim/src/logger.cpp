@@ -0,0 +1,68 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <modm/debug/logger.hpp>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#define OSSHS_SIM_LOGGER_BUFFER_SIZE 512
+
+namespace modm
+{
+	namespace log
+	{
+		void
+		Logger::printf(const char *format, ...)
+		{
+			// long is 32 bits wide on the target, so drop single `l` length modifiers
+			char hostFormat[OSSHS_SIM_LOGGER_BUFFER_SIZE];
+			std::size_t length = 0;
+			bool conversion = false;
+
+			for (const char *c = format; *c && length < sizeof(hostFormat) - 1; c++)
+			{
+				if (conversion && *c == 'l' && c[1] != 'l' && c[-1] != 'l')
+					continue;
+
+				if (*c == '%')
+					conversion = !conversion;
+				else if (conversion && std::strchr("diouxXcspfeEgG", *c))
+					conversion = false;
+
+				hostFormat[length++] = *c;
+			}
+			hostFormat[length] = '\0';
+
+			char buffer[OSSHS_SIM_LOGGER_BUFFER_SIZE];
+			va_list args;
+			va_start(args, format);
+			std::vsnprintf(buffer, sizeof(buffer), hostFormat, args);
+			va_end(args);
+
+			for (const char *c = buffer; *c; c++)
+				device.write(*c);
+		}
+	}
+}
@@ -0,0 +1,1166 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <board.hpp>
+#include <osshs/bootloader.hpp>
+#include <osshs/can_bus.hpp>
+#include <osshs/container.hpp>
+#include <osshs/cycle_counter.hpp>
+#include <osshs/event_loop.hpp>
+#include <osshs/flash.hpp>
+#include <osshs/handoff.hpp>
+#include <osshs/image_writer.hpp>
+#include <osshs/key_store.hpp>
+#include <osshs/status_led_controller.hpp>
+#include <osshs/trace.hpp>
+#include <osshs/update_protocol.hpp>
+#include <osshs/wear_journal.hpp>
+#include <osshs/log/logger.hpp>
+#include <osshs/transport/can_transport.hpp>
+#include <osshs/transport/loopback_transport.hpp>
+#include <sim/can_model.hpp>
+#include <sim/flash_model.hpp>
+#include <sim/known_answer.hpp>
+#include <sim/log_device_test.hpp>
+#include <sim/memory.hpp>
+#include <sim/peripherals.hpp>
+#include <sim/session_trace.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Bus timing of the simulated CAN traffic, a standard frame with 8 data bytes and stuffing is about 128 bits
+#define OSSHS_SIM_CAN_BITRATE     125000
+#define OSSHS_SIM_CAN_FRAME_BITS  128
+#define OSSHS_SIM_CAN_UPDATE_LOAD 20
+
+// Same as the UART transport, 256 bytes per WRITE request
+#define OSSHS_SIM_LOOPBACK_MTU 262
+
+// Shortest run of 0xff left out of raw images, a WRITE request costs 6 bytes on its own
+#define OSSHS_SIM_SPARSE_GAP 16
+
+// Bytes per second of a UART link at 115200 baud with 8N1 framing, used to estimate audit times
+#define OSSHS_SIM_UART_BYTES_PER_SECOND 11520
+
+// The host sends a request again if its response did not arrive in time, at most this many times
+#define OSSHS_SIM_RETRY_TIMEOUT_MS 50
+#define OSSHS_SIM_RETRIES          8
+
+using StatusIndicator = osshs::StatusLedController<modm::platform::Timer2, osshs::board::StatusLed, osshs::board::SystemClock>;
+
+using LoopbackTransport = osshs::transport::LoopbackTransport<OSSHS_SIM_LOOPBACK_MTU>;
+using LoopbackUpdate = osshs::UpdateProtocol<LoopbackTransport>;
+using CanUpdate = osshs::UpdateProtocol<osshs::transport::CanTransport<OSSHS_CAN_TRANSPORT_MTU>>;
+
+namespace
+{
+	struct ConsoleDevice
+	{
+		static void
+		write(char c)
+		{
+			std::fputc(c, stderr);
+		}
+
+		static void
+		flushWriteBuffer()
+		{
+			std::fflush(stderr);
+		}
+	};
+
+	const char *usage =
+		"Usage: osshs-sim [options]\n"
+		"  --flash FILE     Load flash contents and wear from FILE and save them on exit\n"
+		"  --write IMAGE    Write IMAGE to the application region before booting, raw or packed by osshs-pack.py\n"
+		"  --dump FILE      Read the application region into FILE with READ requests and check it with HASH,\n"
+		"                   a decrypt=1 build checks that READ is refused and reads the flash model instead\n"
+		"  --key HEX        Provision the key page with a 128 bit key and send --write encrypted, needs a decrypt=1 build,\n"
+		"                   which refuses --write without it\n"
+		"  --wear           Query the erase counts with WEAR requests and compare them with those of the flash model\n"
+		"  --loss N         Per mille of messages the loopback link loses in each direction, the host retransmits (default: 0)\n"
+		"  --record FILE    Record the messages of --write, --dump and --wear with their times and flash operations\n"
+		"  --replay FILE    Deliver the requests of a recorded session at the recorded times and compare the responses\n"
+		"  --reset CAUSE    Cause of the first reset: power, pin, software or watchdog (default: power)\n"
+		"  --boots N        Number of boots, the ones after the first are software resets (default: 1)\n"
+		"  --seconds N      Seconds to run the status LED and CAN bus if the bootloader stays active (default: 0)\n"
+		"  --can-load N     Percent of the CAN bus taken by background traffic, at most 80 (default: 0)\n"
+		"  --can-errors N   Per mille of CAN frames that are corrupted by noise (default: 0)\n"
+		"  --can-rate N     Update frames per second requested from the bootloader, 0 for unlimited (default: 250)\n"
+		"  --can-adaptive   Request the adaptive rate limit\n"
+		"  --can-log FILE   Save the log frames sent while running in candump -L format, needs a can_log=1 build\n"
+		"  --stay N         Repeat a STAY request on CAN every N microseconds from reset until it is answered\n"
+		"  --quiet          Only log errors\n"
+		"  --known-answers  Run the known answer tests of SHA-512 and Ed25519 and exit\n"
+		"  --log-device     Test pausing the DMA log device around frames against a DMA model and exit\n"
+		"Exits with 1 if any boot did not jump to the application.\n";
+
+	bool quiet = false;
+	uint32_t stayPeriod = 0;
+	uint32_t lossRate = 0;
+	uint32_t lossRandom = 1;
+	uint32_t retransmissions = 0;
+	uint32_t canLoad = 0;
+	uint32_t canErrors = 0;
+	uint16_t canRate = OSSHS_CAN_RATE_LIMIT;
+	osshs::CanRateMode canMode = osshs::CanRateMode::FIXED;
+	const char *canLogPath = nullptr;
+	uint8_t key[OSSHS_AES128_KEY_SIZE];
+	bool keyProvisioned = false;
+
+	/**
+	 * Same sequence as main() of the firmware, up to the jump.
+	 */
+	void
+	boot()
+	{
+		osshs::CycleCounter::initialize();
+		osshs::board::initialize();
+
+		OSSHS_LOG_SET_LEVEL(quiet ? osshs::log::Level::ERROR : osshs::log::Level::DEBUG);
+
+		osshs::Bootloader::initialize();
+		osshs::WearJournal::initialize();
+
+#if OSSHS_BOOTLOADER_LISTEN_WINDOW_MS
+		osshs::board::initializeCan();
+		osshs::CanBus::initializePolling(OSSHS_BOOTLOADER_NODE_ID);
+#endif
+
+		// USART1 is not modelled, CAN is the only link that listens
+		if (osshs::Bootloader::shouldLoadApplication() && osshs::Bootloader::checkApplication() &&
+			!osshs::Bootloader::listen(&CanUpdate::poll))
+		{
+			osshs::CanBus::deinitialize();
+			osshs::Bootloader::deinitialize();
+
+			OSSHS_LOG_FLUSH();
+
+			osshs::board::deinitialize();
+			osshs::Bootloader::loadApplication();
+		}
+
+#if OSSHS_BOOTLOADER_DECRYPT
+		osshs::KeyStore::initialize();
+#endif
+	}
+
+	/**
+	 * CRC-32 as calculated by Flash, which is the one of zlib.
+	 */
+	uint32_t
+	calculateCrc(const std::vector<uint8_t> &data)
+	{
+		uint32_t crc = 0xffffffff;
+		for (uint8_t byte : data)
+		{
+			crc ^= byte;
+			for (uint8_t i = 0; i < 8; i++)
+				crc = crc >> 1 ^ (crc & 1 ? 0xedb88320 : 0);
+		}
+
+		return ~crc;
+	}
+
+	/**
+	 * Parse a key of 32 hex digits.
+	 */
+	bool
+	parseKey(const char *value)
+	{
+		if (std::strlen(value) != OSSHS_AES128_KEY_SIZE * 2)
+			return false;
+
+		for (uint8_t i = 0; i < OSSHS_AES128_KEY_SIZE; i++)
+		{
+			char digits[3] = {value[i * 2], value[i * 2 + 1], 0};
+			char *end;
+			key[i] = std::strtoul(digits, &end, 16);
+			if (end != digits + 2)
+				return false;
+		}
+
+		return true;
+	}
+
+	/**
+	 * Store the key page as it is flashed next to the bootloader, see KeyStore.
+	 */
+	void
+	provisionKey()
+	{
+		std::vector<uint8_t> page(OSSHS_KEY_STORE_CRC_OFFSET + 4);
+		page[0] = OSSHS_KEY_STORE_MAGIC & 0xff;
+		page[1] = OSSHS_KEY_STORE_MAGIC >> 8;
+		page[2] = OSSHS_KEY_STORE_VERSION & 0xff;
+		page[3] = OSSHS_KEY_STORE_VERSION >> 8;
+		std::memcpy(page.data() + OSSHS_KEY_STORE_KEY_OFFSET, key, OSSHS_AES128_KEY_SIZE);
+
+		uint32_t crc = calculateCrc(std::vector<uint8_t>(page.begin(), page.begin() + OSSHS_KEY_STORE_CRC_OFFSET));
+		for (uint8_t i = 0; i < 4; i++)
+			page[OSSHS_KEY_STORE_CRC_OFFSET + i] = crc >> (i * 8);
+
+		osshs::sim::FlashModel::store(osshs::TargetMemoryMap::keyOrigin, page.data(), page.size());
+	}
+
+	/**
+	 * Decide whether the link loses a message, the same losses on every run.
+	 */
+	bool
+	isLost()
+	{
+		if (!lossRate)
+			return false;
+
+		lossRandom = lossRandom * 1103515245 + 12345;
+		return (lossRandom >> 16) % 1000 < lossRate;
+	}
+
+	/**
+	 * Record a message of the session with the flash operations since its request was sent.
+	 */
+	void
+	recordMessage(osshs::sim::SessionEvent event, uint8_t attempt, const uint8_t *message, std::size_t length,
+		const osshs::sim::FlashStatistics &before)
+	{
+		const osshs::sim::FlashStatistics &after = osshs::sim::FlashModel::getStatistics();
+
+		osshs::sim::SessionRecord record;
+		record.event = event;
+		record.attempt = attempt;
+		record.flashCycles = after.busyCycles - before.busyCycles;
+		record.erases = after.erases - before.erases;
+		record.programs = after.programs - before.programs;
+		record.message.assign(message, message + length);
+		osshs::sim::SessionTrace::record(record);
+	}
+
+	/**
+	 * Send a request through the loopback transport as the host tool would and check its response.
+	 * Succeeds if the response has the expected status, which is OK unless a refusal is checked.
+	 */
+	bool
+	request(osshs::UpdateCommand command, const uint8_t *payload, std::size_t length, uint8_t *response,
+		std::size_t &responseLength, osshs::UpdateStatus expected = osshs::UpdateStatus::OK)
+	{
+		static uint8_t sequence = 0;
+
+		uint8_t request[OSSHS_SIM_LOOPBACK_MTU];
+		request[0] = static_cast<uint8_t>(command);
+		request[1] = ++sequence;
+		std::memcpy(request + OSSHS_UPDATE_REQUEST_HEADER_SIZE, payload, length);
+		length += OSSHS_UPDATE_REQUEST_HEADER_SIZE;
+
+		// A lost message is sent again with the same sequence once the host timed out
+		uint8_t message[OSSHS_SIM_LOOPBACK_MTU];
+		uint8_t attempt = 0;
+		for (bool lost = false; ; lost = true, attempt++)
+		{
+			if (lost && attempt > OSSHS_SIM_RETRIES)
+			{
+				std::fprintf(stderr, "Requesting update command failed. Link lost every attempt(command = `0x%02x`).\n",
+					request[0]);
+				return false;
+			}
+
+			if (lost)
+			{
+				osshs::sim::Clock::advance(modm::clock::fcpu / 1000 * OSSHS_SIM_RETRY_TIMEOUT_MS);
+				retransmissions++;
+			}
+
+			osshs::sim::FlashStatistics before = osshs::sim::FlashModel::getStatistics();
+			if (isLost())
+			{
+				recordMessage(osshs::sim::SessionEvent::REQUEST_LOST, attempt, request, length, before);
+				continue;
+			}
+
+			recordMessage(osshs::sim::SessionEvent::REQUEST, attempt, request, length, before);
+			LoopbackTransport::deliver(request, length);
+			LoopbackUpdate::handle();
+
+			if (!LoopbackTransport::takeResponse(message, responseLength))
+				responseLength = 0;
+
+			if (!responseLength || !isLost())
+			{
+				recordMessage(osshs::sim::SessionEvent::RESPONSE, attempt, message, responseLength, before);
+				break;
+			}
+
+			recordMessage(osshs::sim::SessionEvent::RESPONSE_LOST, attempt, message, responseLength, before);
+		}
+
+		if (responseLength < OSSHS_UPDATE_RESPONSE_HEADER_SIZE ||
+			message[0] != (static_cast<uint8_t>(command) | OSSHS_UPDATE_RESPONSE_FLAG) || message[1] != sequence)
+		{
+			std::fprintf(stderr, "Requesting update command failed. No response(command = `0x%02x`).\n", request[0]);
+			return false;
+		}
+
+		if (message[2] != static_cast<uint8_t>(expected))
+		{
+			std::fprintf(stderr, "Requesting update command failed(command = `0x%02x`, status = `0x%02x`).\n",
+				static_cast<uint8_t>(command), message[2]);
+			return false;
+		}
+
+		responseLength -= OSSHS_UPDATE_RESPONSE_HEADER_SIZE;
+		std::memcpy(response, message + OSSHS_UPDATE_RESPONSE_HEADER_SIZE, responseLength);
+		return true;
+	}
+
+	void
+	setUint32(uint8_t *data, uint32_t value)
+	{
+		for (uint8_t i = 0; i < 4; i++)
+			data[i] = value >> (i * 8);
+	}
+
+	/**
+	 * Length of the run of 0xff at offset, if it is long enough to be worth a gap.
+	 */
+	std::size_t
+	countGap(const std::vector<uint8_t> &image, std::size_t offset)
+	{
+		std::size_t length = 0;
+		while (offset + length < image.size() && image[offset + length] == 0xff)
+			length++;
+
+		return length >= OSSHS_SIM_SPARSE_GAP || offset + length == image.size() ? length : 0;
+	}
+
+	bool
+	writeImage(const char *path)
+	{
+		FILE *file = std::fopen(path, "rb");
+		if (!file)
+		{
+			std::fprintf(stderr, "Opening image failed(path = `%s`).\n", path);
+			return false;
+		}
+
+		uint64_t start = osshs::sim::Clock::now();
+		osshs::sim::FlashStatistics before = osshs::sim::FlashModel::getStatistics();
+
+		osshs::CycleCounter::initialize();
+		osshs::WearJournal::initialize();
+#if OSSHS_BOOTLOADER_DECRYPT
+		osshs::KeyStore::initialize();
+#endif
+		LoopbackUpdate::initialize(OSSHS_EVENT_LOOP_INVALID_TASK);
+
+		uint8_t response[OSSHS_SIM_LOOPBACK_MTU];
+		std::size_t responseLength;
+		uint32_t requests = 2;
+
+		std::fseek(file, 0, SEEK_END);
+		std::vector<uint8_t> image(std::ftell(file));
+		std::rewind(file);
+		bool succeeded = std::fread(image.data(), 1, image.size(), file) == image.size();
+		std::fclose(file);
+
+		// Containers are sent whole and name the origin of their image, encrypted ones in their envelope
+		osshs::ContainerHeader header{};
+		osshs::ContainerEnvelope envelope{};
+		if (image.size() >= sizeof(header))
+			std::memcpy(&header, image.data(), sizeof(header));
+		if (image.size() >= sizeof(envelope))
+			std::memcpy(&envelope, image.data(), sizeof(envelope));
+
+		bool enveloped = envelope.magic == OSSHS_ENVELOPE_MAGIC;
+		bool container = header.magic == OSSHS_CONTAINER_MAGIC || enveloped;
+		if (enveloped)
+		{
+			header.origin = envelope.origin;
+			image.erase(image.begin(), image.begin() + sizeof(envelope));
+		}
+
+		// Anything else is encrypted here with a fixed counter block, a real host never reuses one with a key
+		bool encrypted = enveloped || keyProvisioned;
+		osshs::crypto::Aes128Ctr cipher;
+		if (!enveloped)
+			for (uint8_t i = 0; i < OSSHS_AES128_BLOCK_SIZE; i++)
+				envelope.counter[i] = i < 12 ? 0xa5 ^ i * 0x1f : 0;
+		if (encrypted && !enveloped)
+			cipher.begin(key, envelope.counter);
+
+		uint8_t begin[9 + OSSHS_AES128_BLOCK_SIZE];
+		setUint32(begin, container ? header.origin : OSSHS_BOOTLOADER_APPLICATION_ORIGIN);
+		setUint32(begin + 4, container ? image.size() : OSSHS_BOOTLOADER_APPLICATION_LENGTH);
+		begin[8] = static_cast<uint8_t>(container ? osshs::UpdateMode::CONTAINER : osshs::UpdateMode::READ_BACK) |
+			(encrypted ? OSSHS_UPDATE_MODE_ENCRYPTED : 0);
+		std::memcpy(begin + 9, envelope.counter, OSSHS_AES128_BLOCK_SIZE);
+
+		succeeded = succeeded && request(osshs::UpdateCommand::INFO, nullptr, 0, response, responseLength) &&
+			request(osshs::UpdateCommand::BEGIN, begin, encrypted ? sizeof(begin) : 9, response, responseLength);
+
+		// WRITE requests as long as the MTU allows, raw images leave out runs of 0xff
+		uint8_t chunk[OSSHS_SIM_LOOPBACK_MTU - OSSHS_UPDATE_REQUEST_HEADER_SIZE];
+		std::size_t offset = 0;
+		std::size_t sent = 0;
+		while (succeeded && offset < image.size())
+		{
+			if (!container)
+				offset += countGap(image, offset);
+
+			std::size_t length = 0;
+			while (offset + length < image.size() && length < sizeof(chunk) - 4 &&
+				(container || countGap(image, offset + length) < OSSHS_SIM_SPARSE_GAP))
+				length++;
+
+			// A final empty WRITE leaves the tail of the image erased
+			setUint32(chunk, offset);
+			std::memcpy(chunk + 4, image.data() + offset, length);
+			if (encrypted && !enveloped)
+				cipher.apply(chunk + 4, length, offset);
+			succeeded = request(osshs::UpdateCommand::WRITE, chunk, 4 + length, response, responseLength);
+			offset += length;
+			sent += length;
+			requests++;
+		}
+
+		uint8_t digest[OSSHS_SHA256_DIGEST_SIZE];
+		succeeded = succeeded && request(osshs::UpdateCommand::FINISH, nullptr, 0, digest, responseLength);
+		if (!succeeded)
+			request(osshs::UpdateCommand::ABORT, nullptr, 0, response, responseLength);
+		requests++;
+
+		const osshs::sim::FlashStatistics &after = osshs::sim::FlashModel::getStatistics();
+		std::printf("write: %s, %lu %s%s bytes (%lu sent) in %u requests, %lu erases, %lu programs, %.3f ms\n",
+			succeeded ? "ok" : "failed", static_cast<unsigned long>(image.size()), encrypted ? "encrypted " : "",
+			container ? "container" : "image",
+			static_cast<unsigned long>(sent), requests,
+			static_cast<unsigned long>(after.erases - before.erases),
+			static_cast<unsigned long>(after.programs - before.programs),
+			(osshs::sim::Clock::now() - start) * 1000.0 / modm::clock::fcpu);
+
+		if (succeeded)
+		{
+			std::printf("sha256: ");
+			for (uint8_t byte : digest)
+				std::printf("%02x", byte);
+			std::printf("\n");
+		}
+
+		return succeeded;
+	}
+
+	/**
+	 * Read the application region as an audit by the host tool would, with the bytes a link would carry.
+	 * A decrypt build refuses READ and HASH of less than a page there, which is checked instead, and the data is
+	 * taken from the flash model.
+	 */
+	bool
+	dumpFlash(const char *path)
+	{
+		LoopbackUpdate::initialize(OSSHS_EVENT_LOOP_INVALID_TASK);
+
+		const uint32_t origin = OSSHS_BOOTLOADER_APPLICATION_ORIGIN;
+		const uint32_t end = origin + OSSHS_BOOTLOADER_APPLICATION_LENGTH;
+		uint8_t payload[9];
+		uint8_t response[OSSHS_SIM_LOOPBACK_MTU];
+		std::size_t responseLength;
+		std::vector<uint8_t> data;
+		uint32_t requests = 0;
+		uint64_t wire = 0;
+
+#if OSSHS_BOOTLOADER_DECRYPT
+		setUint32(payload, origin);
+		setUint32(payload + 4, 4);
+		payload[8] = static_cast<uint8_t>(osshs::UpdateHashMode::RANGE);
+		if (!request(osshs::UpdateCommand::READ, payload, 8, response, responseLength,
+				osshs::UpdateStatus::INVALID_ARGUMENT) ||
+			!request(osshs::UpdateCommand::HASH, payload, 9, response, responseLength,
+				osshs::UpdateStatus::INVALID_ARGUMENT))
+		{
+			std::fprintf(stderr, "Dumping flash failed. READ or HASH of the application was answered.\n");
+			return false;
+		}
+
+		requests += 2;
+		wire += 2 * (OSSHS_UPDATE_REQUEST_HEADER_SIZE + OSSHS_UPDATE_RESPONSE_HEADER_SIZE) + 17;
+		data.assign(reinterpret_cast<const uint8_t *>(origin), reinterpret_cast<const uint8_t *>(end));
+#else
+		for (uint32_t address = origin; address < end; requests++)
+		{
+			setUint32(payload, address);
+			setUint32(payload + 4, end - address);
+			if (!request(osshs::UpdateCommand::READ, payload, 8, response, responseLength) || responseLength < 4)
+				return false;
+
+			wire += OSSHS_UPDATE_REQUEST_HEADER_SIZE + 8 + OSSHS_UPDATE_RESPONSE_HEADER_SIZE + responseLength;
+			address += response[0] | response[1] << 8 | response[2] << 16 | response[3] << 24;
+
+			for (std::size_t i = 4; i + 1 < responseLength; )
+			{
+				uint8_t control = response[i++];
+				if (control & OSSHS_UPDATE_READ_BLANK_FLAG)
+				{
+					data.insert(data.end(), ((control & ~OSSHS_UPDATE_READ_BLANK_FLAG) << 8 | response[i++]) + 1, 0xff);
+				}
+				else
+				{
+					data.insert(data.end(), response + i, response + i + control + 1);
+					i += control + 1;
+				}
+			}
+		}
+#endif
+
+		// One range CRC and the page CRCs, which are all a host needs to find the pages that differ from an image
+		setUint32(payload, origin);
+		setUint32(payload + 4, end - origin);
+		payload[8] = static_cast<uint8_t>(osshs::UpdateHashMode::RANGE);
+		if (!request(osshs::UpdateCommand::HASH, payload, 9, response, responseLength))
+			return false;
+
+		uint32_t crc = response[0] | response[1] << 8 | response[2] << 16 | response[3] << 24;
+		uint32_t hashRequests = 1;
+		uint64_t hashWire = OSSHS_UPDATE_REQUEST_HEADER_SIZE + 9 + OSSHS_UPDATE_RESPONSE_HEADER_SIZE + 4;
+
+		payload[8] = static_cast<uint8_t>(osshs::UpdateHashMode::PAGES);
+		for (uint32_t address = origin; address < end; hashRequests++)
+		{
+			setUint32(payload, address);
+			setUint32(payload + 4, end - address);
+			if (!request(osshs::UpdateCommand::HASH, payload, 9, response, responseLength) || !responseLength)
+				return false;
+
+			hashWire += OSSHS_UPDATE_REQUEST_HEADER_SIZE + 9 + OSSHS_UPDATE_RESPONSE_HEADER_SIZE + responseLength;
+			address += responseLength / 4 * osshs::Flash::pageSize;
+		}
+
+		bool matches = data.size() == end - origin && calculateCrc(data) == crc;
+		std::printf("dump: %s, %lu bytes in %u requests, %lu bytes on the wire, %.2f s at 115200 baud (%.2f s raw)\n",
+			matches ? "ok" : "crc mismatch", static_cast<unsigned long>(data.size()), requests,
+			static_cast<unsigned long>(wire), static_cast<double>(wire) / OSSHS_SIM_UART_BYTES_PER_SECOND,
+			static_cast<double>(end - origin) / OSSHS_SIM_UART_BYTES_PER_SECOND);
+		std::printf("hash: crc 0x%08x and %u page crcs in %u requests, %lu bytes on the wire\n", crc,
+			(end - origin) / osshs::Flash::pageSize, hashRequests, static_cast<unsigned long>(hashWire));
+
+		FILE *file = std::fopen(path, "wb");
+		if (!file || std::fwrite(data.data(), 1, data.size(), file) != data.size())
+		{
+			std::fprintf(stderr, "Saving dump failed(path = `%s`).\n", path);
+			if (file)
+				std::fclose(file);
+			return false;
+		}
+
+		std::fclose(file);
+		return matches;
+	}
+
+	/**
+	 * Query the erase counts the bootloader journaled, the model counts every erase since the flash file was created.
+	 */
+	bool
+	printWear()
+	{
+		osshs::WearJournal::initialize();
+		LoopbackUpdate::initialize(OSSHS_EVENT_LOOP_INVALID_TASK);
+
+		uint8_t payload[2];
+		uint8_t response[OSSHS_SIM_LOOPBACK_MTU];
+		std::size_t responseLength;
+		uint32_t requests = 0;
+		uint32_t mismatches = 0;
+		uint32_t worstPage = 0;
+		uint32_t worstErases = 0;
+
+		for (uint32_t page = OSSHS_WEAR_JOURNAL_FIRST_PAGE; page < OSSHS_SIM_FLASH_PAGE_COUNT; requests++)
+		{
+			payload[0] = page;
+			payload[1] = page >> 8;
+			if (!request(osshs::UpdateCommand::WEAR, payload, sizeof(payload), response, responseLength) || !responseLength)
+				return false;
+
+			for (std::size_t i = 0; i + 1 < responseLength; i += 2, page++)
+			{
+				uint32_t erases = response[i] | response[i + 1] << 8;
+				if (erases != osshs::sim::FlashModel::getWear(page))
+				{
+					std::printf("wear: page %u journaled %u, model %u\n", page, erases, osshs::sim::FlashModel::getWear(page));
+					mismatches++;
+				}
+
+				if (erases > worstErases)
+				{
+					worstPage = page;
+					worstErases = erases;
+				}
+			}
+		}
+
+		std::printf("wear: %s, %u pages in %u requests, max %u erases on page %u\n", mismatches ? "mismatch" : "ok",
+			OSSHS_SIM_FLASH_PAGE_COUNT - OSSHS_WEAR_JOURNAL_FIRST_PAGE, requests, worstErases, worstPage);
+		return !mismatches;
+	}
+
+	/**
+	 * CRC-32 of the whole flash, which identifies the state a session starts from.
+	 */
+	uint32_t
+	calculateFlashCrc()
+	{
+		const uint8_t *flash = reinterpret_cast<const uint8_t *>(OSSHS_SIM_FLASH_ORIGIN);
+		return calculateCrc(std::vector<uint8_t>(flash, flash + OSSHS_SIM_FLASH_LENGTH));
+	}
+
+	/**
+	 * Print minimum, percentiles and maximum of latencies in milliseconds.
+	 */
+	void
+	printLatencies(const char *name, std::vector<uint64_t> latencies)
+	{
+		if (latencies.empty())
+			return;
+
+		std::sort(latencies.begin(), latencies.end());
+		auto at = [&latencies](uint32_t permille) {
+			return latencies[(latencies.size() - 1) * permille / 1000] * 1000.0 / modm::clock::fcpu;
+		};
+
+		std::printf("%s: min %.3f, p50 %.3f, p90 %.3f, p99 %.3f, max %.3f ms\n", name, at(0), at(500), at(900),
+			at(990), at(1000));
+	}
+
+	/**
+	 * Deliver the requests of a recorded session when the host sent them and compare the responses with the
+	 * recorded ones. The host waited for every response, so the time between a response and the next request is
+	 * kept, not the absolute time: a slower bootloader delays the rest of the session.
+	 */
+	bool
+	replaySession(const char *path)
+	{
+		uint32_t flashCrc;
+		std::vector<osshs::sim::SessionRecord> records;
+		if (!osshs::sim::SessionTrace::load(path, flashCrc, records))
+		{
+			std::fprintf(stderr, "Loading session trace failed(path = `%s`).\n", path);
+			return false;
+		}
+
+		if (flashCrc != calculateFlashCrc())
+			std::printf("replay: flash differs from the recording (crc 0x%08x instead of 0x%08x), responses may differ\n",
+				calculateFlashCrc(), flashCrc);
+
+		osshs::CycleCounter::initialize();
+		osshs::WearJournal::initialize();
+		LoopbackUpdate::initialize(OSSHS_EVENT_LOOP_INVALID_TASK);
+
+		const uint64_t start = osshs::sim::Clock::now();
+		const osshs::sim::FlashStatistics before = osshs::sim::FlashModel::getStatistics();
+		int64_t shift = 0;
+		uint64_t sent = 0;
+		uint64_t recordedSent = 0;
+		uint64_t recordedEnd = 0;
+		uint64_t recordedFlashCycles = 0;
+		uint32_t recordedErases = 0;
+		uint32_t recordedPrograms = 0;
+		uint32_t requests = 0;
+		uint32_t retries = 0;
+		uint32_t lost = 0;
+		uint32_t differences = 0;
+		uint64_t written = 0;
+		std::vector<uint64_t> latencies;
+		std::vector<uint64_t> recordedLatencies;
+
+		uint8_t request[OSSHS_SIM_LOOPBACK_MTU];
+		uint8_t response[OSSHS_SIM_LOOPBACK_MTU];
+		std::size_t requestLength = 0;
+		std::size_t responseLength = 0;
+
+		for (const osshs::sim::SessionRecord &record : records)
+		{
+			recordedEnd = record.time;
+
+			if (record.event == osshs::sim::SessionEvent::REQUEST || record.event == osshs::sim::SessionEvent::REQUEST_LOST)
+			{
+				osshs::sim::Clock::advanceTo(start + record.time + shift);
+				if (record.attempt)
+					retries++;
+				else
+					requests++;
+
+				if (record.event == osshs::sim::SessionEvent::REQUEST_LOST || record.message.size() > sizeof(request))
+				{
+					lost++;
+					continue;
+				}
+
+				sent = osshs::sim::Clock::now();
+				recordedSent = record.time;
+				requestLength = record.message.size();
+				std::memcpy(request, record.message.data(), requestLength);
+
+				LoopbackTransport::deliver(request, requestLength);
+				LoopbackUpdate::handle();
+				if (!LoopbackTransport::takeResponse(response, responseLength))
+					responseLength = 0;
+
+				continue;
+			}
+
+			// Responses move the rest of the session by the difference to the recording
+			latencies.push_back(osshs::sim::Clock::now() - sent);
+			recordedLatencies.push_back(record.time - recordedSent);
+			shift = static_cast<int64_t>(osshs::sim::Clock::now() - start) - static_cast<int64_t>(record.time);
+			recordedFlashCycles += record.flashCycles;
+			recordedErases += record.erases;
+			recordedPrograms += record.programs;
+
+			if (responseLength != record.message.size() || std::memcmp(response, record.message.data(), responseLength))
+				differences++;
+
+			if (record.event == osshs::sim::SessionEvent::RESPONSE_LOST)
+			{
+				lost++;
+			}
+			else if (request[0] == static_cast<uint8_t>(osshs::UpdateCommand::WRITE) && responseLength >= OSSHS_UPDATE_RESPONSE_HEADER_SIZE &&
+				response[2] == static_cast<uint8_t>(osshs::UpdateStatus::OK) && requestLength >= OSSHS_UPDATE_REQUEST_HEADER_SIZE + 4)
+			{
+				written += requestLength - OSSHS_UPDATE_REQUEST_HEADER_SIZE - 4;
+			}
+		}
+
+		const osshs::sim::FlashStatistics &after = osshs::sim::FlashModel::getStatistics();
+		uint64_t duration = osshs::sim::Clock::now() - start;
+		auto throughput = [](uint64_t bytes, uint64_t cycles) {
+			return cycles ? bytes / 1024.0 * modm::clock::fcpu / cycles : 0.0;
+		};
+
+		std::printf("replay: %u requests, %u retransmissions, %u lost messages, %u responses differ\n", requests,
+			retries, lost, differences);
+		std::printf("replay: %lu bytes of WRITE data in %.3f ms, %.2f KiB/s (recorded %.3f ms, %.2f KiB/s)\n",
+			static_cast<unsigned long>(written), duration * 1000.0 / modm::clock::fcpu, throughput(written, duration),
+			recordedEnd * 1000.0 / modm::clock::fcpu, throughput(written, recordedEnd));
+		printLatencies("latency", latencies);
+		printLatencies("recorded latency", recordedLatencies);
+		std::printf("replay: %lu erases, %lu programs, %.3f ms flash busy (recorded %u erases, %u programs, %.3f ms)\n",
+			static_cast<unsigned long>(after.erases - before.erases), static_cast<unsigned long>(after.programs - before.programs),
+			(after.busyCycles - before.busyCycles) * 1000.0 / modm::clock::fcpu, recordedErases, recordedPrograms,
+			recordedFlashCycles * 1000.0 / modm::clock::fcpu);
+
+		return !differences;
+	}
+
+	void
+	printHandoff()
+	{
+		const osshs::BootHandoff *handoff = reinterpret_cast<const osshs::BootHandoff *>(OSSHS_BOOTLOADER_HANDOFF_ORIGIN);
+		if (handoff->magic != OSSHS_HANDOFF_MAGIC)
+		{
+			std::printf("handoff: invalid\n");
+			return;
+		}
+
+		std::printf("handoff: resetFlags 0x%08x, bootCycles %u, validationCycles %u, listenCycles %u, image 0x%08x/%u/0x%08x, "
+			"verification 0x%02x\n", handoff->resetFlags, handoff->bootCycles, handoff->validationCycles,
+			handoff->listenCycles, handoff->imageVersion, handoff->imageLength, handoff->imageCrc, handoff->verification);
+	}
+
+	/**
+	 * Report when the answer to the repeated STAY request left, as the host would see it.
+	 */
+	void
+	printStay(uint64_t start)
+	{
+		for (const osshs::sim::CanTransmission &frame : osshs::sim::CanModel::takeTransmissions())
+			if (frame.id == OSSHS_CAN_RESPONSE_ID(OSSHS_BOOTLOADER_NODE_ID) && frame.length >= 4 &&
+				frame.data[1] == (static_cast<uint8_t>(osshs::UpdateCommand::STAY) | OSSHS_UPDATE_RESPONSE_FLAG))
+			{
+				std::printf("stay: answered with status 0x%02x, bootloader active %.3f ms after reset\n", frame.data[3],
+					(osshs::sim::Clock::now() - start) * 1000.0 / modm::clock::fcpu);
+				return;
+			}
+
+		std::printf("stay: not answered\n");
+	}
+
+	uint8_t canTask = OSSHS_EVENT_LOOP_INVALID_TASK;
+
+	/**
+	 * Same tasks as the resident bootloader, driven by LED timer edges and CAN frames in simulated time.
+	 */
+	void
+	runResident(uint32_t seconds)
+	{
+		if (canTask == OSSHS_EVENT_LOOP_INVALID_TASK)
+			canTask = osshs::EventLoop::addTask("can", &CanUpdate::handle);
+		static uint8_t statusTask = osshs::EventLoop::addTask("status", &StatusIndicator::update);
+#if OSSHS_CAN_LOG
+		static uint8_t logTask = osshs::EventLoop::addTask("log", &osshs::log::CanLogSink::update);
+#endif
+
+		osshs::sim::CanModel::attachInterrupt(0, []() { osshs::CanBus::handleInterrupt(0); });
+		osshs::sim::CanModel::attachInterrupt(1, []() { osshs::CanBus::handleInterrupt(1); });
+		osshs::sim::CanModel::attachErrorInterrupt(&osshs::CanBus::handleErrorInterrupt);
+
+		osshs::board::initializeCan();
+		osshs::CanBus::initialize(OSSHS_BOOTLOADER_NODE_ID, canTask);
+		CanUpdate::initialize(canTask);
+#if OSSHS_CAN_LOG
+		osshs::log::CanLogSink::initialize(logTask);
+#endif
+
+		StatusIndicator::enable();
+		StatusIndicator::setStatus(osshs::Bootloader::shouldLoadApplication() ?
+			StatusIndicator::Status::APPLICATION_ERROR : StatusIndicator::Status::BOOTLOADER_ACTIVE);
+
+		using Timer = modm::platform::Timer2;
+		const uint64_t sample = modm::clock::fcpu / 10;
+		const uint64_t slot = static_cast<uint64_t>(OSSHS_SIM_CAN_FRAME_BITS) * modm::clock::fcpu / OSSHS_SIM_CAN_BITRATE;
+		uint64_t end = osshs::sim::Clock::now() + static_cast<uint64_t>(seconds) * modm::clock::fcpu;
+		uint64_t edge = osshs::sim::Clock::now() + Timer::getPeriod();
+		uint64_t frame = osshs::sim::Clock::now() + slot;
+		uint32_t interrupts = 0;
+		uint32_t sent = 0;
+		uint32_t random = 1;
+
+		// The simulated host paces update frames at the rate the bootloader reports
+		uint64_t nextUpdate = 0;
+		uint16_t hostRate = canRate;
+		uint32_t reports = 0;
+		uint32_t answered = 0;
+		uint32_t logFrames = 0;
+
+		FILE *canLog = canLogPath ? std::fopen(canLogPath, "w") : nullptr;
+		if (canLogPath && !canLog)
+			std::fprintf(stderr, "Creating CAN log failed(path = `%s`).\n", canLogPath);
+
+		osshs::sim::CanModel::takeTransmissions();
+		osshs::sim::CanStatistics before = osshs::sim::CanModel::getStatistics();
+
+		const uint8_t request[] = {OSSHS_CAN_COMMAND_RATE_LIMIT, static_cast<uint8_t>(canRate),
+			static_cast<uint8_t>(canRate >> 8), OSSHS_CAN_RATE_BURST, static_cast<uint8_t>(canMode)};
+		osshs::sim::CanModel::deliver(OSSHS_CAN_REQUEST_ID(OSSHS_BOOTLOADER_NODE_ID), request, sizeof(request));
+		osshs::EventLoop::poll();
+
+		// One character per 100ms of simulated time, `#` while the LED is lit
+		std::printf("led: ");
+		for (uint64_t time = osshs::sim::Clock::now() + sample; time <= end; time += sample)
+		{
+			while ((Timer::isGeneratingInterrupts() && edge <= time) || frame <= time)
+			{
+				if (Timer::isGeneratingInterrupts() && edge <= frame)
+				{
+					osshs::sim::Clock::advanceTo(edge);
+					Timer::update();
+					osshs::EventLoop::post(statusTask);
+					interrupts++;
+					edge += Timer::getPeriod();
+				}
+				else
+				{
+					// Update requests take OSSHS_SIM_CAN_UPDATE_LOAD percent of the slots, background traffic
+					// canLoad percent and the rest of the bus is idle. Requests are single frame INFO requests,
+					// every 8th one broadcast
+					osshs::sim::Clock::advanceTo(frame);
+					random = random * 1103515245 + 12345;
+					uint32_t roll = (random >> 16) % 100;
+					uint8_t data[8] = {0, static_cast<uint8_t>(sent), 0, 0, 0, 0, 0, 0};
+
+					if ((random >> 4) % 1000 < canErrors)
+					{
+						osshs::sim::CanModel::raiseError();
+					}
+					else if (roll < OSSHS_SIM_CAN_UPDATE_LOAD)
+					{
+						if (frame >= nextUpdate)
+						{
+							const uint8_t info[] = {OSSHS_CAN_TRANSPORT_SINGLE | OSSHS_UPDATE_REQUEST_HEADER_SIZE,
+								static_cast<uint8_t>(osshs::UpdateCommand::INFO), static_cast<uint8_t>(sent)};
+							osshs::sim::CanModel::deliver(OSSHS_CAN_REQUEST_ID(sent % 8 ? OSSHS_BOOTLOADER_NODE_ID :
+								OSSHS_CAN_BROADCAST_NODE_ID), info, sizeof(info));
+							nextUpdate = hostRate ? frame + modm::clock::fcpu / hostRate : 0;
+							sent++;
+						}
+					}
+					else if (roll < OSSHS_SIM_CAN_UPDATE_LOAD + canLoad)
+					{
+						uint16_t id = (random >> 5) & 0x7ff;
+						if (id != OSSHS_CAN_REQUEST_ID(OSSHS_BOOTLOADER_NODE_ID) &&
+							id != OSSHS_CAN_REQUEST_ID(OSSHS_CAN_BROADCAST_NODE_ID))
+							osshs::sim::CanModel::deliver(id, data, sizeof(data));
+					}
+
+					frame += slot;
+				}
+
+				osshs::EventLoop::poll();
+
+				for (const osshs::sim::CanTransmission &transmission : osshs::sim::CanModel::takeTransmissions())
+				{
+					if (transmission.id == OSSHS_CAN_LOG_ID(OSSHS_BOOTLOADER_NODE_ID))
+					{
+						logFrames++;
+						if (canLog)
+						{
+							std::fprintf(canLog, "(%.6f) can0 %03X#", osshs::sim::Clock::now() / static_cast<double>(modm::clock::fcpu),
+								transmission.id);
+							for (uint8_t i = 0; i < transmission.length; i++)
+								std::fprintf(canLog, "%02X", transmission.data[i]);
+							std::fprintf(canLog, "\n");
+						}
+					}
+
+					if (transmission.id != OSSHS_CAN_RESPONSE_ID(OSSHS_BOOTLOADER_NODE_ID))
+						continue;
+
+					if (transmission.data[0] == OSSHS_CAN_REPORT_RATE_LIMIT)
+					{
+						hostRate = transmission.data[5] | transmission.data[6] << 8;
+						reports++;
+					}
+					else if ((transmission.data[0] & 0xf0) == OSSHS_CAN_TRANSPORT_FIRST)
+					{
+						answered++;
+					}
+				}
+			}
+
+			osshs::sim::Clock::advanceTo(time);
+			std::putchar(osshs::board::StatusLed::read() ? '#' : '.');
+		}
+		std::printf("\n");
+		std::printf("led: %u interrupts in %u s, longest update %u cycles\n", interrupts, seconds,
+			osshs::EventLoop::getStatistics(statusTask).maxCycles);
+
+		const osshs::sim::CanStatistics &after = osshs::sim::CanModel::getStatistics();
+		uint64_t cycles = after.interruptCycles - before.interruptCycles;
+		std::printf("can: %u frames at %u%% background load, %u update requests sent, %u answered, %u lost, "
+			"%u accepted by the filters, %u interrupts, %.3f%% cpu in interrupts\n", after.frames - before.frames,
+			canLoad, sent, answered, osshs::CanBus::getOverruns(), after.accepted - before.accepted,
+			after.interrupts - before.interrupts, cycles * 100.0 / (static_cast<uint64_t>(seconds) * modm::clock::fcpu));
+		std::printf("can: %u errors, rate %u of %u frames/s (%s), %u rate reports, %u update requests queued\n",
+			after.errors - before.errors, osshs::CanBus::getRate(), osshs::CanBus::getRateLimit().rate,
+			canMode == osshs::CanRateMode::ADAPTIVE ? "adaptive" : "fixed", reports,
+			sent - answered - osshs::CanBus::getOverruns());
+#if OSSHS_CAN_LOG
+		std::printf("can: %u log frames, %.3f%% of the bus, %lu log records dropped\n", logFrames,
+			logFrames * OSSHS_SIM_CAN_FRAME_BITS * 100.0 / (static_cast<uint64_t>(seconds) * OSSHS_SIM_CAN_BITRATE),
+			static_cast<unsigned long>(osshs::log::CanLogSink::getDroppedRecords()));
+#endif
+
+		if (canLog)
+			std::fclose(canLog);
+
+		StatusIndicator::disable();
+		osshs::CanBus::deinitialize();
+	}
+}
+
+OSSHS_ENABLE_LOGGER(ConsoleDevice, modm::IOBuffer::DiscardIfFull);
+
+int
+main(int argc, char **argv)
+{
+	const char *flashPath = nullptr;
+	const char *imagePath = nullptr;
+	const char *dumpPath = nullptr;
+	bool wear = false;
+	const char *recordPath = nullptr;
+	const char *replayPath = nullptr;
+	osshs::sim::ResetCause cause = osshs::sim::ResetCause::POWER_ON;
+	uint32_t boots = 1;
+	uint32_t seconds = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		if (!std::strcmp(argv[i], "--quiet"))
+		{
+			quiet = true;
+			continue;
+		}
+
+		if (!std::strcmp(argv[i], "--known-answers"))
+			return osshs::sim::KnownAnswer::run() ? 0 : 1;
+
+		if (!std::strcmp(argv[i], "--log-device"))
+			return osshs::sim::LogDeviceTest::run() ? 0 : 1;
+
+		if (!std::strcmp(argv[i], "--wear"))
+		{
+			wear = true;
+			continue;
+		}
+
+		if (!std::strcmp(argv[i], "--can-adaptive"))
+		{
+			canMode = osshs::CanRateMode::ADAPTIVE;
+			continue;
+		}
+
+		if (!value)
+		{
+			std::fputs(usage, stderr);
+			return 2;
+		}
+
+		if (!std::strcmp(argv[i], "--flash"))
+			flashPath = value;
+		else if (!std::strcmp(argv[i], "--write"))
+			imagePath = value;
+		else if (!std::strcmp(argv[i], "--dump"))
+			dumpPath = value;
+		else if (!std::strcmp(argv[i], "--key") && parseKey(value))
+			keyProvisioned = true;
+		else if (!std::strcmp(argv[i], "--loss") && std::strtoul(value, nullptr, 0) <= 1000)
+			lossRate = std::strtoul(value, nullptr, 0);
+		else if (!std::strcmp(argv[i], "--record"))
+			recordPath = value;
+		else if (!std::strcmp(argv[i], "--replay"))
+			replayPath = value;
+		else if (!std::strcmp(argv[i], "--stay"))
+			stayPeriod = std::strtoul(value, nullptr, 0);
+		else if (!std::strcmp(argv[i], "--boots"))
+			boots = std::strtoul(value, nullptr, 0);
+		else if (!std::strcmp(argv[i], "--seconds"))
+			seconds = std::strtoul(value, nullptr, 0);
+		else if (!std::strcmp(argv[i], "--can-load") && std::strtoul(value, nullptr, 0) <= 100 - OSSHS_SIM_CAN_UPDATE_LOAD)
+			canLoad = std::strtoul(value, nullptr, 0);
+		else if (!std::strcmp(argv[i], "--can-errors") && std::strtoul(value, nullptr, 0) <= 1000)
+			canErrors = std::strtoul(value, nullptr, 0);
+		else if (!std::strcmp(argv[i], "--can-rate") && std::strtoul(value, nullptr, 0) <= 0xffff)
+			canRate = std::strtoul(value, nullptr, 0);
+		else if (!std::strcmp(argv[i], "--can-log"))
+			canLogPath = value;
+		else if (!std::strcmp(argv[i], "--reset") && !std::strcmp(value, "power"))
+			cause = osshs::sim::ResetCause::POWER_ON;
+		else if (!std::strcmp(argv[i], "--reset") && !std::strcmp(value, "pin"))
+			cause = osshs::sim::ResetCause::PIN;
+		else if (!std::strcmp(argv[i], "--reset") && !std::strcmp(value, "software"))
+			cause = osshs::sim::ResetCause::SOFTWARE;
+		else if (!std::strcmp(argv[i], "--reset") && !std::strcmp(value, "watchdog"))
+			cause = osshs::sim::ResetCause::WATCHDOG;
+		else
+		{
+			std::fputs(usage, stderr);
+			return 2;
+		}
+		i++;
+	}
+
+	if (!osshs::sim::Memory::initialize())
+		return 1;
+
+	osshs::sim::Peripherals::initialize();
+	osshs::sim::FlashModel::initialize();
+	osshs::sim::CanModel::initialize();
+
+	if (flashPath && !osshs::sim::FlashModel::load(flashPath))
+		std::fprintf(stderr, "Loading flash failed, starting erased(path = `%s`).\n", flashPath);
+
+	if (keyProvisioned)
+		provisionKey();
+
+	osshs::sim::Memory::randomizeRam(1);
+
+	if (recordPath && !osshs::sim::SessionTrace::open(recordPath, calculateFlashCrc()))
+	{
+		std::fprintf(stderr, "Creating session trace failed(path = `%s`).\n", recordPath);
+		return 1;
+	}
+
+	bool succeeded = (!imagePath || writeImage(imagePath)) && (!dumpPath || dumpFlash(dumpPath)) && (!wear || printWear());
+
+	if (recordPath && !osshs::sim::SessionTrace::close())
+	{
+		std::fprintf(stderr, "Saving session trace failed(path = `%s`).\n", recordPath);
+		return 1;
+	}
+
+	if (recordPath || lossRate)
+		std::printf("link: %u retransmissions at %u per mille loss\n", retransmissions, lossRate);
+
+	if (!succeeded || (replayPath && !replaySession(replayPath)))
+		return 1;
+
+	bool failed = false;
+	for (uint32_t i = 0; i < boots; i++)
+	{
+		osshs::sim::Peripherals::reset(i ? osshs::sim::ResetCause::SOFTWARE : cause);
+		osshs::sim::FlashModel::reset();
+		osshs::sim::CanModel::reset();
+
+		// The host keeps sending while the node resets, a single frame (STAY, sequence, node)
+		const uint8_t stay[] = {OSSHS_CAN_TRANSPORT_SINGLE | 3, static_cast<uint8_t>(osshs::UpdateCommand::STAY), 0,
+			OSSHS_BOOTLOADER_NODE_ID};
+		if (stayPeriod)
+			osshs::sim::CanModel::repeat(OSSHS_CAN_REQUEST_ID(OSSHS_BOOTLOADER_NODE_ID), stay, sizeof(stay),
+				osshs::sim::Clock::fromNanoseconds(stayPeriod * 1000ull));
+
+		uint64_t start = osshs::sim::Clock::now();
+		uint32_t entryPoint;
+		bool jumped = osshs::sim::Memory::run(boot, entryPoint);
+		osshs::sim::CanModel::repeat(0, nullptr, 0, 0);
+
+		if (stayPeriod)
+			printStay(start);
+
+		if (jumped)
+		{
+			std::printf("boot %u: jumped to 0x%08x, msp 0x%08x\n", i, entryPoint, osshs::sim::mainStackPointer);
+			printHandoff();
+		}
+		else
+		{
+			std::printf("boot %u: bootloader stays active\n", i);
+			if (seconds)
+				runResident(seconds);
+			failed = true;
+		}
+	}
+
+	const osshs::sim::FlashStatistics &statistics = osshs::sim::FlashModel::getStatistics();
+	uint32_t maximumWear = 0;
+	for (uint16_t page = 0; page < OSSHS_SIM_FLASH_PAGE_COUNT; page++)
+		if (osshs::sim::FlashModel::getWear(page) > maximumWear)
+			maximumWear = osshs::sim::FlashModel::getWear(page);
+
+	std::printf("flash: %u erases, %u programs, %u program errors, %u protection errors, %u bus errors, "
+		"%.3f ms busy, max wear %u\n", statistics.erases, statistics.programs, statistics.programErrors,
+		statistics.protectionErrors, statistics.busErrors, statistics.busyCycles * 1000.0 / modm::clock::fcpu, maximumWear);
+#if OSSHS_BOOTLOADER_DECRYPT
+	std::printf("key: %s, read protection %s\n", osshs::KeyStore::getKey() ? "provisioned" : "missing",
+		osshs::Flash::isReadProtected() ? "active" : "inactive");
+#endif
+	std::printf("time: %.3f ms\n", osshs::sim::Clock::now() * 1000.0 / modm::clock::fcpu);
+
+	if (flashPath && !osshs::sim::FlashModel::save(flashPath))
+	{
+		std::fprintf(stderr, "Saving flash failed(path = `%s`).\n", flashPath);
+		return 1;
+	}
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,187 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <sim/flash_model.hpp>
+#include <sim/memory.hpp>
+#include <csetjmp>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <sys/mman.h>
+#include <ucontext.h>
+
+// Trap flag of the x86 EFLAGS register, raises SIGTRAP after the next instruction
+#define OSSHS_SIM_TRAP_FLAG 0x100
+
+// Largest store a single instruction is expected to make
+#define OSSHS_SIM_STORE_WINDOW 16
+
+namespace osshs
+{
+	namespace sim
+	{
+		static uint8_t * const flash = reinterpret_cast<uint8_t *>(OSSHS_SIM_FLASH_ORIGIN);
+		static uint8_t * const ram = reinterpret_cast<uint8_t *>(OSSHS_SIM_RAM_ORIGIN);
+
+		static uint32_t storeOffset;
+		static uint32_t storeLength;
+		static uint8_t storeWindow[OSSHS_SIM_STORE_WINDOW];
+		static bool storePending = false;
+
+		static sigjmp_buf jumpBuffer;
+		static bool jumpArmed = false;
+		static uint32_t jumpAddress;
+
+		static void
+		handleFault(int, siginfo_t *info, void *context)
+		{
+			ucontext_t *ucontext = static_cast<ucontext_t *>(context);
+			uintptr_t address = reinterpret_cast<uintptr_t>(info->si_addr);
+
+			if (address - OSSHS_SIM_FLASH_ORIGIN < OSSHS_SIM_FLASH_LENGTH && !storePending)
+			{
+				// Executing from flash means the bootloader jumped to the application
+				if (static_cast<uintptr_t>(ucontext->uc_mcontext.gregs[REG_RIP]) == address)
+				{
+					if (jumpArmed)
+					{
+						jumpArmed = false;
+						jumpAddress = address;
+						siglongjmp(jumpBuffer, 1);
+					}
+				}
+				else
+				{
+					// Let the store complete, then compare and revert it in handleTrap()
+					storeOffset = address - OSSHS_SIM_FLASH_ORIGIN;
+					storeLength = OSSHS_SIM_FLASH_LENGTH - storeOffset;
+					if (storeLength > OSSHS_SIM_STORE_WINDOW)
+						storeLength = OSSHS_SIM_STORE_WINDOW;
+
+					std::memcpy(storeWindow, flash + storeOffset, storeLength);
+					storePending = true;
+
+					Memory::setFlashWritable(true);
+					ucontext->uc_mcontext.gregs[REG_EFL] |= OSSHS_SIM_TRAP_FLAG;
+					return;
+				}
+			}
+
+			// A real fault, let it crash the process
+			std::signal(SIGSEGV, SIG_DFL);
+		}
+
+		static void
+		handleTrap(int, siginfo_t *, void *context)
+		{
+			ucontext_t *ucontext = static_cast<ucontext_t *>(context);
+
+			if (!storePending)
+			{
+				std::signal(SIGTRAP, SIG_DFL);
+				return;
+			}
+
+			ucontext->uc_mcontext.gregs[REG_EFL] &= ~OSSHS_SIM_TRAP_FLAG;
+			storePending = false;
+
+			// Find out what the instruction stored and undo it, the flash model decides what is programmed
+			uint16_t value;
+			std::memcpy(&value, flash + storeOffset, sizeof(value));
+
+			bool wide = false;
+			for (uint32_t i = sizeof(value); i < storeLength; i++)
+				wide |= flash[storeOffset + i] != storeWindow[i];
+
+			std::memcpy(flash + storeOffset, storeWindow, storeLength);
+			Memory::setFlashWritable(false);
+
+			if (wide || storeOffset & 0b1)
+				FlashModel::busError(OSSHS_SIM_FLASH_ORIGIN + storeOffset);
+			else
+				FlashModel::program(OSSHS_SIM_FLASH_ORIGIN + storeOffset, value);
+		}
+
+		bool
+		Memory::initialize()
+		{
+			void *flashMapping = mmap(flash, OSSHS_SIM_FLASH_LENGTH, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+			void *ramMapping = mmap(ram, OSSHS_SIM_RAM_LENGTH, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+			if (flashMapping != flash || ramMapping != ram)
+			{
+				std::fprintf(stderr, "Mapping memory failed. Address range already in use.\n");
+				return false;
+			}
+
+			struct sigaction action = {};
+			action.sa_flags = SA_SIGINFO | SA_NODEFER;
+			sigemptyset(&action.sa_mask);
+
+			action.sa_sigaction = handleFault;
+			sigaction(SIGSEGV, &action, nullptr);
+
+			action.sa_sigaction = handleTrap;
+			sigaction(SIGTRAP, &action, nullptr);
+
+			return true;
+		}
+
+		void
+		Memory::setFlashWritable(bool writable)
+		{
+			mprotect(flash, OSSHS_SIM_FLASH_LENGTH, writable ? PROT_READ | PROT_WRITE : PROT_READ);
+		}
+
+		void
+		Memory::randomizeRam(uint32_t seed)
+		{
+			// xorshift32, so the contents are the same on every host
+			uint32_t state = seed ? seed : 1;
+			for (uint32_t i = 0; i < OSSHS_SIM_RAM_LENGTH; i += 4)
+			{
+				state ^= state << 13;
+				state ^= state >> 17;
+				state ^= state << 5;
+				std::memcpy(ram + i, &state, sizeof(state));
+			}
+		}
+
+		bool
+		Memory::run(void (*function)(), uint32_t &entryPoint)
+		{
+			if (sigsetjmp(jumpBuffer, 1))
+			{
+				entryPoint = jumpAddress;
+				return true;
+			}
+
+			jumpArmed = true;
+			function();
+			jumpArmed = false;
+
+			return false;
+		}
+	}
+}
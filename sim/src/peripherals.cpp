@@ -0,0 +1,188 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <sim/clock.hpp>
+#include <sim/peripherals.hpp>
+#include <initializer_list>
+
+#define OSSHS_SIM_CRC_POLYNOMIAL 0x04c11db7
+
+// Bounds of the main stack, which the linker script defines on the target. The bootloader runs on the host stack,
+// so this one stays painted and StackMonitor reports no usage.
+asm(".pushsection .bss\n"
+	".balign 8\n"
+	".globl __main_stack_bottom\n"
+	"__main_stack_bottom:\n"
+	".space 0x800\n"
+	".globl __main_stack_top\n"
+	"__main_stack_top:\n"
+	".popsection");
+
+namespace osshs
+{
+	namespace sim
+	{
+		FLASH_TypeDef flashRegisters;
+		OB_TypeDef optionBytes;
+		CRC_TypeDef crcRegisters;
+		BKP_TypeDef bkpRegisters;
+		PWR_TypeDef pwrRegisters;
+		RCC_TypeDef rccRegisters;
+		SCB_Type scbRegisters;
+		DWT_Type dwtRegisters;
+		CoreDebug_Type coreDebugRegisters;
+		DMA_TypeDef dmaRegisters;
+		DMA_Channel_TypeDef dmaChannel4Registers;
+		USART_TypeDef usartRegisters;
+
+		uint32_t mainStackPointer;
+
+		uint64_t Peripherals::cycleCounterBase = 0;
+
+		void
+		Peripherals::initialize()
+		{
+			RCC->CSR.attach(nullptr, writeResetFlags);
+
+			for (Register *reg : {&BKP->DR1, &BKP->DR2, &BKP->DR3, &BKP->DR4, &BKP->DR5,
+				&BKP->DR6, &BKP->DR7, &BKP->DR8, &BKP->DR9, &BKP->DR10})
+				reg->attach(nullptr, writeBackup);
+
+			CRC->DR.attach(nullptr, writeCrcData);
+			CRC->CR.attach(nullptr, writeCrcControl);
+
+			DWT->CYCCNT.attach(readCycleCounter, writeCycleCounter);
+
+			reset(ResetCause::POWER_ON);
+		}
+
+		void
+		Peripherals::reset(ResetCause cause)
+		{
+			// The bootloader clears the flags on every boot, so only the latest cause is set. Every reset also
+			// asserts the reset pin.
+			switch (cause)
+			{
+				case ResetCause::POWER_ON:
+					RCC->CSR.value = RCC_CSR_PORRSTF | RCC_CSR_PINRSTF;
+					break;
+				case ResetCause::PIN:
+					RCC->CSR.value = RCC_CSR_PINRSTF;
+					break;
+				case ResetCause::SOFTWARE:
+					RCC->CSR.value = RCC_CSR_SFTRSTF | RCC_CSR_PINRSTF;
+					break;
+				case ResetCause::WATCHDOG:
+					RCC->CSR.value = RCC_CSR_IWDGRSTF | RCC_CSR_PINRSTF;
+					break;
+			}
+
+			// Running from HSI with all prescalers at 1
+			RCC->CR.value = RCC_CR_HSION | RCC_CR_HSIRDY;
+			RCC->CFGR.value = 0;
+			RCC->AHBENR.value = 0x00000014;
+			RCC->APB1ENR.value = 0;
+			RCC->APB2ENR.value = 0;
+
+			PWR->CR.value = 0;
+
+			// The backup domain is only reset by power-on, as there is no battery
+			if (cause == ResetCause::POWER_ON)
+				for (Register *reg : {&BKP->DR1, &BKP->DR2, &BKP->DR3, &BKP->DR4, &BKP->DR5,
+					&BKP->DR6, &BKP->DR7, &BKP->DR8, &BKP->DR9, &BKP->DR10})
+					reg->value = 0;
+
+			CRC->DR.value = 0xffffffff;
+			CRC->IDR.value = 0;
+			CRC->CR.value = 0;
+
+			SCB->VTOR.value = 0;
+
+			CoreDebug->DEMCR.value = 0;
+			DWT->CTRL.value = 0;
+			DWT->CYCCNT.value = 0;
+		}
+
+		void
+		Peripherals::writeResetFlags(Register &reg, uint32_t value)
+		{
+			if (value & RCC_CSR_RMVF)
+				reg.value &= 0x00ffffff;
+
+			// Only the LSI bits are writable
+			reg.value = (reg.value & ~0x1) | (value & 0x1);
+		}
+
+		void
+		Peripherals::writeBackup(Register &reg, uint32_t value)
+		{
+			uint32_t clocks = RCC_APB1ENR_PWREN | RCC_APB1ENR_BKPEN;
+
+			if ((RCC->APB1ENR.value & clocks) != clocks || !(PWR->CR.value & PWR_CR_DBP))
+				return;
+
+			reg.value = value & 0xffff;
+		}
+
+		void
+		Peripherals::writeCrcData(Register &reg, uint32_t value)
+		{
+			if (!(RCC->AHBENR.value & RCC_AHBENR_CRCEN))
+				return;
+
+			// Most significant bit first, as the CRC unit does
+			uint32_t crc = reg.value ^ value;
+			for (uint8_t i = 0; i < 32; i++)
+				crc = crc & 0x80000000 ? (crc << 1) ^ OSSHS_SIM_CRC_POLYNOMIAL : crc << 1;
+
+			reg.value = crc;
+		}
+
+		void
+		Peripherals::writeCrcControl(Register &, uint32_t value)
+		{
+			if (!(RCC->AHBENR.value & RCC_AHBENR_CRCEN))
+				return;
+
+			if (value & CRC_CR_RESET)
+				CRC->DR.value = 0xffffffff;
+		}
+
+		uint32_t
+		Peripherals::readCycleCounter(Register &reg)
+		{
+			if ((CoreDebug->DEMCR.value & CoreDebug_DEMCR_TRCENA_Msk) && (DWT->CTRL.value & DWT_CTRL_CYCCNTENA_Msk))
+				reg.value = Clock::now() - cycleCounterBase;
+
+			return reg.value;
+		}
+
+		void
+		Peripherals::writeCycleCounter(Register &reg, uint32_t value)
+		{
+			cycleCounterBase = Clock::now() - value;
+			reg.value = value;
+		}
+	}
+}
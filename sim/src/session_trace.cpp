@@ -0,0 +1,158 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <sim/clock.hpp>
+#include <sim/session_trace.hpp>
+#include <modm/platform.hpp>
+
+// time, event, attempt, length, flashCycles, erases, programs
+#define OSSHS_SIM_SESSION_RECORD_HEADER_SIZE 20
+
+namespace osshs
+{
+	namespace sim
+	{
+		std::FILE *SessionTrace::file = nullptr;
+		uint64_t SessionTrace::start = 0;
+		bool SessionTrace::failed = false;
+
+		bool
+		SessionTrace::open(const char *path, uint32_t flashCrc)
+		{
+			file = std::fopen(path, "wb");
+			if (!file)
+				return false;
+
+			start = Clock::now();
+			failed = false;
+
+			write(OSSHS_SIM_SESSION_MAGIC, 4);
+			write(OSSHS_SIM_SESSION_VERSION, 2);
+			write(0, 2);
+			write(modm::clock::fcpu, 4);
+			write(flashCrc, 4);
+			return true;
+		}
+
+		void
+		SessionTrace::record(SessionRecord &record)
+		{
+			if (!file)
+				return;
+
+			record.time = Clock::now() - start;
+
+			write(record.time, 8);
+			write(static_cast<uint8_t>(record.event), 1);
+			write(record.attempt, 1);
+			write(record.message.size(), 2);
+			write(record.flashCycles, 4);
+			write(record.erases, 2);
+			write(record.programs, 2);
+
+			if (std::fwrite(record.message.data(), 1, record.message.size(), file) != record.message.size())
+				failed = true;
+		}
+
+		bool
+		SessionTrace::close()
+		{
+			if (!file)
+				return true;
+
+			bool succeeded = std::fclose(file) == 0 && !failed;
+			file = nullptr;
+			return succeeded;
+		}
+
+		bool
+		SessionTrace::load(const char *path, uint32_t &flashCrc, std::vector<SessionRecord> &records)
+		{
+			std::FILE *input = std::fopen(path, "rb");
+			if (!input)
+				return false;
+
+			std::vector<uint8_t> contents;
+			uint8_t buffer[4096];
+			std::size_t count;
+			while ((count = std::fread(buffer, 1, sizeof(buffer), input)))
+				contents.insert(contents.end(), buffer, buffer + count);
+			std::fclose(input);
+
+			const uint8_t *data = contents.data();
+			const uint8_t *end = data + contents.size();
+			if (contents.size() < 16 || read(data, 4) != OSSHS_SIM_SESSION_MAGIC || read(data, 2) != OSSHS_SIM_SESSION_VERSION)
+				return false;
+
+			// A trace of another core clock would replay at the wrong speed
+			read(data, 2);
+			if (read(data, 4) != modm::clock::fcpu)
+				return false;
+
+			flashCrc = read(data, 4);
+
+			records.clear();
+			while (end - data >= OSSHS_SIM_SESSION_RECORD_HEADER_SIZE)
+			{
+				SessionRecord record;
+				record.time = read(data, 8);
+				record.event = static_cast<SessionEvent>(read(data, 1));
+				record.attempt = read(data, 1);
+				std::size_t length = read(data, 2);
+				record.flashCycles = read(data, 4);
+				record.erases = read(data, 2);
+				record.programs = read(data, 2);
+
+				if (static_cast<std::size_t>(end - data) < length || record.event > SessionEvent::RESPONSE_LOST)
+					return false;
+
+				record.message.assign(data, data + length);
+				data += length;
+				records.push_back(record);
+			}
+
+			return data == end;
+		}
+
+		void
+		SessionTrace::write(uint64_t value, std::size_t size)
+		{
+			uint8_t bytes[8];
+			for (std::size_t i = 0; i < size; i++)
+				bytes[i] = value >> (i * 8);
+
+			if (std::fwrite(bytes, 1, size, file) != size)
+				failed = true;
+		}
+
+		uint64_t
+		SessionTrace::read(const uint8_t *&data, std::size_t size)
+		{
+			uint64_t value = 0;
+			for (std::size_t i = 0; i < size; i++)
+				value |= static_cast<uint64_t>(*data++) << (i * 8);
+
+			return value;
+		}
+	}
+}
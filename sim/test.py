@@ -0,0 +1,186 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019, Linas Nikiperavicius
+#
+# Regression tests of the update pipeline on the simulator, run by `scons target=host test`. Writes raw, sparse,
+# container and encrypted images through the update protocol, reads them back and boots them, and fails on any
+# mismatch between what was sent, what the bootloader reports and what ends up in flash.
+#
+#   sim/test.py build/host/osshs-sim build/host-decrypt/osshs-sim
+
+import argparse
+import hashlib
+import os
+import random
+import re
+import struct
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+PACK = os.path.join(ROOT, "tools", "osshs-pack.py")
+
+APPLICATION_ORIGIN = 0x08004000
+# The application region up to the wear journal in the last page, as --dump reads it
+APPLICATION_LENGTH = 0x1bc00
+PAGE_SIZE = 0x400
+
+MANIFEST_MAGIC = 0x4e414d4f
+MANIFEST_OFFSET = 0x200
+MANIFEST = struct.Struct("<IHHIIII")
+
+KEY = "000102030405060708090a0b0c0d0e0f"
+
+def make_image(length, gaps, seed):
+    """An application with a vector table and a manifest, random code and erased runs of gaps pages."""
+    generator = random.Random(seed)
+    image = bytearray(generator.getrandbits(8) for _ in range(length))
+    for page in gaps:
+        image[page * PAGE_SIZE:(page + 1) * PAGE_SIZE] = b"\xff" * PAGE_SIZE
+    struct.pack_into("<II", image, 0, 0x20004000, APPLICATION_ORIGIN + 0x301)
+    MANIFEST.pack_into(image, MANIFEST_OFFSET, MANIFEST_MAGIC, 1, MANIFEST.size, seed, 0, 0, 0)
+    return image
+
+class Runner:
+    def __init__(self, directory):
+        self.directory = directory
+        self.failures = 0
+        self.passed = 0
+        self.tests = 0
+
+    def path(self, name):
+        return os.path.join(self.directory, name)
+
+    def pack(self, image, name, *options):
+        """Packs image with osshs-pack.py, returns the image with its manifest filled in and the container."""
+        source = self.path(name + ".in")
+        with open(source, "wb") as file:
+            file.write(image)
+        subprocess.run([sys.executable, PACK, "--origin", hex(APPLICATION_ORIGIN), "--binary", self.path(name + ".bin")]
+            + list(options) + [source, self.path(name + ".ocon")], check=True, stdout=subprocess.DEVNULL)
+        with open(self.path(name + ".bin"), "rb") as file:
+            image = file.read()
+        with open(self.path(name + ".ocon"), "rb") as file:
+            return image, file.read()
+
+    def check(self, name, condition, message):
+        if not condition:
+            print("  {}: {}".format(name, message))
+            self.failures += 1
+        return condition
+
+    def run(self, name, simulator, image, written, digested, options, boots=1):
+        """
+        Writes the file written with the simulator and checks that FINISH reports the SHA-256 of digested, then reads
+        the application region back, compares it with image and checks that every boot jumps to it.
+        """
+        self.tests += 1
+        failures = self.failures
+        dump = self.path(name + ".dump")
+        if os.path.exists(dump):
+            os.remove(dump)
+
+        arguments = [simulator, "--quiet", "--dump", dump, "--wear", "--boots", str(boots)] + options
+        if written:
+            arguments += ["--write", written]
+        result = subprocess.run(arguments, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+        output = result.stdout.decode(errors="replace")
+
+        if written:
+            match = re.search(r"^sha256: ([0-9a-f]{64})$", output, re.M)
+            self.check(name, re.search(r"^write: ok,", output, re.M), "write failed")
+            self.check(name, match and match.group(1) == hashlib.sha256(digested).hexdigest(), "FINISH digest mismatch")
+
+        self.check(name, re.search(r"^dump: ok,", output, re.M), "read back failed")
+        self.check(name, re.search(r"^wear: ok,", output, re.M), "wear mismatch")
+        if os.path.exists(dump):
+            with open(dump, "rb") as file:
+                flash = file.read()
+            expected = image + b"\xff" * (APPLICATION_LENGTH - len(image))
+            if self.check(name, len(flash) == len(expected), "read back {} bytes, expected {}".format(len(flash),
+                    len(expected))):
+                mismatch = next((offset for offset in range(len(flash)) if flash[offset] != expected[offset]), None)
+                self.check(name, mismatch is None, "read back differs at 0x{:08x}".format(
+                    APPLICATION_ORIGIN + (mismatch or 0)))
+        else:
+            self.check(name, False, "no read back")
+
+        jumped = len(re.findall(r"^boot \d+: jumped to 0x{:08x},".format(APPLICATION_ORIGIN + 0x301), output, re.M))
+        self.check(name, jumped == boots and result.returncode == 0, "{} of {} boots jumped to the application".format(
+            jumped, boots))
+
+        if self.failures != failures:
+            print(output)
+        else:
+            self.passed += 1
+        print("{}: {}".format(name, "ok" if self.failures == failures else "FAILED"))
+
+    def refuse(self, name, simulator, written, options):
+        """Writes the file written with the simulator, which must refuse it before erasing anything."""
+        self.tests += 1
+        result = subprocess.run([simulator, "--quiet", "--write", written] + options, stdout=subprocess.PIPE,
+            stderr=subprocess.STDOUT)
+        output = result.stdout.decode(errors="replace")
+        failures = self.failures
+        self.check(name, re.search(r"^write: failed, .* 0 erases,", output, re.M), "write not refused")
+
+        if self.failures != failures:
+            print(output)
+        else:
+            self.passed += 1
+        print("{}: {}".format(name, "ok" if self.failures == failures else "FAILED"))
+
+    def self_test(self, name, simulator, option):
+        """Runs a test the simulator carries itself, which exits with 1 on failure."""
+        self.tests += 1
+        result = subprocess.run([simulator, option], stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+        if self.check(name, result.returncode == 0, result.stdout.decode(errors="replace")):
+            self.passed += 1
+        print("{}: {}".format(name, "ok" if result.returncode == 0 else "FAILED"))
+
+def main():
+    parser = argparse.ArgumentParser(description="Run the update pipeline regression tests on the simulator.")
+    parser.add_argument("simulator", help="osshs-sim built with decrypt=0")
+    parser.add_argument("decrypt_simulator", nargs="?", help="osshs-sim built with decrypt=1, for the encrypted tests")
+    arguments = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as directory:
+        runner = Runner(directory)
+        plain = os.path.abspath(arguments.simulator)
+
+        runner.self_test("known answers", plain, "--known-answers")
+        runner.self_test("log device", plain, "--log-device")
+
+        # FINISH hashes the plaintext it received, the image of a raw write and the container of a container write
+        image, container = runner.pack(make_image(20000, [], 1), "dense")
+        runner.run("raw", plain, image, runner.path("dense.bin"), image, [])
+        runner.run("container", plain, image, runner.path("dense.ocon"), container, [])
+        runner.run("lossy container", plain, image, runner.path("dense.ocon"), container, ["--loss", "50"])
+
+        # Erased pages in the middle and at the end, left out of raw writes and stored as blank in containers
+        image, container = runner.pack(make_image(24 * PAGE_SIZE, [3, 4, 5, 6, 7, 8, 12, 20, 21, 22], 2), "sparse")
+        runner.run("sparse raw", plain, image, runner.path("sparse.bin"), image, [])
+        runner.run("sparse container", plain, image, runner.path("sparse.ocon"), container, [])
+
+        # The flash survives the run, the next one boots it without writing
+        flash = ["--flash", runner.path("sparse.flash")]
+        runner.run("persisted write", plain, image, runner.path("sparse.bin"), image, flash)
+        runner.run("persisted boot", plain, image, None, None, flash, boots=3)
+
+        # The envelope decrypts to the container osshs-pack.py writes without --key
+        if arguments.decrypt_simulator:
+            encrypted = os.path.abspath(arguments.decrypt_simulator)
+            image, container = runner.pack(make_image(20000, [4, 5], 3), "plain")
+            runner.pack(image, "encrypted", "--key", KEY)
+            runner.run("encrypted raw", encrypted, image, runner.path("encrypted.bin"), image, ["--key", KEY])
+            runner.run("encrypted container", encrypted, image, runner.path("encrypted.ocon"), container,
+                ["--key", KEY])
+            runner.refuse("plain container", encrypted, runner.path("plain.ocon"), [])
+        else:
+            print("warning: no decrypt=1 simulator, skipping the encrypted tests", file=sys.stderr)
+
+        print("{} of {} tests passed".format(runner.passed, runner.tests))
+        sys.exit(0 if runner.passed == runner.tests else 1)
+
+if __name__ == "__main__":
+    main()
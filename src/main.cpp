@@ -24,55 +24,233 @@
 
 #include <board.hpp>
 #include <osshs/bootloader.hpp>
+#include <osshs/can_bus.hpp>
+#include <osshs/cycle_counter.hpp>
+#include <osshs/event_loop.hpp>
+#include <osshs/key_store.hpp>
+#include <osshs/stack_monitor.hpp>
 #include <osshs/status_led_controller.hpp>
+#include <osshs/update_protocol.hpp>
+#include <osshs/wear_journal.hpp>
+#include <osshs/transport/can_transport.hpp>
+#include <osshs/transport/uart_transport.hpp>
 #include <osshs/log/logger.hpp>
+#include <osshs/log/dma_usart_device.hpp>
 #include <modm/architecture/interface/interrupt.hpp>
 
 using namespace modm::literals;
 using StatusIndicator = osshs::StatusLedController<modm::platform::Timer2, osshs::board::StatusLed, osshs::board::SystemClock>;
 
-OSSHS_ENABLE_LOGGER(modm::platform::Usart1, modm::IOBuffer::BlockIfFull);
+#ifndef DISABLE_LOGGING
+using LogDevice = osshs::log::DmaUsartDevice<1024, osshs::log::OverflowPolicy::DROP_OLDEST>;
+
+OSSHS_ENABLE_LOGGER(LogDevice, modm::IOBuffer::DiscardIfFull);
+#endif
+
+#if OSSHS_BOOTLOADER_UPDATE
+using CanTransport = osshs::transport::CanTransport<OSSHS_CAN_TRANSPORT_MTU>;
+#ifndef DISABLE_LOGGING
+// The log shares USART1 and is paused while a frame is sent
+using UartTransport = osshs::transport::UartTransport<OSSHS_UART_TRANSPORT_MTU, LogDevice>;
+#else
+using UartTransport = osshs::transport::UartTransport<OSSHS_UART_TRANSPORT_MTU>;
+#endif
+using CanUpdate = osshs::UpdateProtocol<CanTransport>;
+using UartUpdate = osshs::UpdateProtocol<UartTransport>;
+#endif
+
+namespace
+{
+	uint8_t statusTask = OSSHS_EVENT_LOOP_INVALID_TASK;
+	StatusIndicator::Status idleStatus = StatusIndicator::Status::BOOTLOADER_ACTIVE;
+#if OSSHS_BOOTLOADER_UPDATE
+	uint8_t canTask = OSSHS_EVENT_LOOP_INVALID_TASK;
+	uint8_t uartTask = OSSHS_EVENT_LOOP_INVALID_TASK;
+	bool updating = false;
+#endif
+#if OSSHS_CAN_LOG
+	uint8_t logTask = OSSHS_EVENT_LOOP_INVALID_TASK;
+#endif
+
+#if OSSHS_BOOTLOADER_UPDATE
+	/**
+	 * Reset once the response to a BOOT request left, the next boot loads the application.
+	 */
+	void
+	restart()
+	{
+		OSSHS_LOG_INFO("Resetting to load the application(stackUsage = `%lu`, stackSize = `%lu`).",
+			osshs::StackMonitor::getHighWaterMark(), osshs::StackMonitor::getSize());
+		OSSHS_LOG_FLUSH();
+
+		CanTransport::flush();
+		UartTransport::flush();
+		NVIC_SystemReset();
+	}
+
+	/**
+	 * Blink fast while either link writes an image, BEGIN starts it and FINISH or ABORT ends it.
+	 */
+	void
+	updateStatus()
+	{
+		bool inProgress = CanUpdate::isUpdateInProgress() || UartUpdate::isUpdateInProgress();
+		if (inProgress == updating)
+			return;
+
+		updating = inProgress;
+		StatusIndicator::setStatus(updating ? StatusIndicator::Status::UPDATE_IN_PROGRESS : idleStatus);
+	}
+
+	/**
+	 * Poll both links once for a STAY request, before the event loop runs.
+	 */
+	bool
+	pollLinks()
+	{
+		return CanUpdate::poll() || UartUpdate::poll();
+	}
+
+	void
+	handleCan()
+	{
+		CanUpdate::handle();
+		updateStatus();
+		if (CanUpdate::isBootRequested())
+			restart();
+	}
+
+	void
+	handleUart()
+	{
+		UartUpdate::handle();
+		updateStatus();
+		if (UartUpdate::isBootRequested())
+			restart();
+	}
+#endif
+}
 
 int
 main()
 {
+	// Before anything runs on the stack below main(), including interrupts
+	osshs::StackMonitor::paint();
+
+	osshs::CycleCounter::initialize();
 	osshs::board::initialize();
+#ifndef DISABLE_LOGGING
+	LogDevice::initialize();
+#endif
 
 	OSSHS_LOG_SET_LEVEL(osshs::log::Level::DEBUG);
 
 	osshs::Bootloader::initialize();
-	
-	if(osshs::Bootloader::shouldLoadApplication())
-		if(osshs::Bootloader::checkApplication())
+#if OSSHS_BOOTLOADER_UPDATE
+	// Logs the wear of the pages on every boot, including those that jump to the application
+	osshs::WearJournal::initialize();
+#endif
+
+#if OSSHS_BOOTLOADER_UPDATE && OSSHS_BOOTLOADER_LISTEN_WINDOW_MS
+	// The links receive into their FIFO and data register while the application is checked
+	osshs::board::initializeCan();
+	osshs::CanBus::initializePolling(OSSHS_BOOTLOADER_NODE_ID);
+#endif
+
+	bool stayRequested = false;
+	if(osshs::Bootloader::shouldLoadApplication() && osshs::Bootloader::checkApplication())
+	{
+#if OSSHS_BOOTLOADER_UPDATE
+		stayRequested = osshs::Bootloader::listen(&pollLinks);
+#endif
+		if(!stayRequested)
 		{
+#if OSSHS_BOOTLOADER_UPDATE
+			osshs::CanBus::deinitialize();
+#endif
 			osshs::Bootloader::deinitialize();
 
 			OSSHS_LOG_FLUSH();
+#ifndef DISABLE_LOGGING
+			LogDevice::deinitialize();
+#endif
 
 			osshs::board::deinitialize();
 			osshs::Bootloader::loadApplication();
 			return 0;
 		}
+	}
+
+#if OSSHS_BOOTLOADER_DECRYPT
+	osshs::KeyStore::initialize();
+#endif
+
+	// Tasks added first run first
+#if OSSHS_BOOTLOADER_UPDATE
+	canTask = osshs::EventLoop::addTask("can", &handleCan);
+	uartTask = osshs::EventLoop::addTask("uart", &handleUart);
+#endif
+	statusTask = osshs::EventLoop::addTask("status", &StatusIndicator::update);
+#if OSSHS_CAN_LOG
+	logTask = osshs::EventLoop::addTask("log", &osshs::log::CanLogSink::update);
+#endif
+
+#if OSSHS_BOOTLOADER_UPDATE
+	osshs::board::initializeCan();
+	osshs::CanBus::initialize(OSSHS_BOOTLOADER_NODE_ID, canTask);
+	CanUpdate::initialize(canTask);
+#if OSSHS_CAN_LOG
+	osshs::log::CanLogSink::initialize(logTask);
+#endif
+
+	UartTransport::initialize(uartTask);
+	UartUpdate::initialize(uartTask);
+#endif
 
 	StatusIndicator::enable();
 
-	if(osshs::Bootloader::shouldLoadApplication())
+	if(osshs::Bootloader::shouldLoadApplication() && !stayRequested)
 	{
 		OSSHS_LOG_ERROR("Loading application failed. Application is invalid.");
-		StatusIndicator::setStatus(StatusIndicator::Status::APPLICATION_ERROR);
-	}
-	else
-	{
-		StatusIndicator::setStatus(StatusIndicator::Status::BOOTLOADER_ACTIVE);
+		idleStatus = StatusIndicator::Status::APPLICATION_ERROR;
 	}
 
-	while(true);
+	StatusIndicator::setStatus(idleStatus);
 
-	return 0;
+	osshs::EventLoop::run();
 }
 
 MODM_ISR(TIM2)
 {
 	modm::platform::Timer2::acknowledgeInterruptFlags(modm::platform::GeneralPurposeTimer::InterruptFlag::Update);
-	StatusIndicator::update();
+	osshs::EventLoop::post(statusTask);
+}
+
+#if OSSHS_BOOTLOADER_UPDATE
+MODM_ISR(USB_LP_CAN1_RX0)
+{
+	osshs::CanBus::handleInterrupt(0);
+}
+
+MODM_ISR(CAN1_RX1)
+{
+	osshs::CanBus::handleInterrupt(1);
+}
+
+MODM_ISR(CAN1_SCE)
+{
+	osshs::CanBus::handleErrorInterrupt();
+}
+
+MODM_ISR(USART1)
+{
+	UartTransport::handleInterrupt();
+}
+#endif
+
+#ifndef DISABLE_LOGGING
+MODM_ISR(DMA1_Channel4)
+{
+	LogDevice::handleInterrupt();
 }
+#endif
@@ -24,19 +24,52 @@
 
 #include <osshs/log/logger.hpp>
 #include <osshs/bootloader.hpp>
+#include <osshs/cycle_counter.hpp>
+#include <osshs/flash.hpp>
+#include <osshs/handoff.hpp>
+#include <osshs/manifest.hpp>
+#include <osshs/stack_monitor.hpp>
+#include <osshs/trace.hpp>
+#include <osshs/verification_cache.hpp>
+#include <osshs/crypto/ed25519.hpp>
+#include <magic_enum.hpp>
 #include <modm/platform.hpp>
 
 namespace osshs
 {
+	uint32_t Bootloader::resetFlags = 0;
+	uint32_t Bootloader::validationCycles = 0;
+	uint32_t Bootloader::listenCycles = 0;
+	uint8_t Bootloader::verification = 0;
+
 	void
 	Bootloader::initialize()
 	{
 		// Enable the power and backup interface clocks.
 		RCC->APB1ENR |= RCC_APB1ENR_PWREN | RCC_APB1ENR_BKPEN;
 
+		// Enable CRC peripheral clock for application validation.
+		RCC->AHBENR |= RCC_AHBENR_CRCEN;
+
+		// Remember and clear the reset cause.
+		resetFlags = RCC->CSR;
+		RCC->CSR |= RCC_CSR_RMVF;
+
+		// A handoff record left over from a previous boot must not reach the application.
+		reinterpret_cast<BootHandoff *>(OSSHS_BOOTLOADER_HANDOFF_ORIGIN)->magic = 0;
+
+		Trace::initialize(resetFlags, modm::clock::fcpu);
+		Trace::record(TraceEvent::BOOT, 0, resetFlags >> 16);
+
 		OSSHS_LOG_INFO("Initializing bootloader succeeded.");
 	}
 
+	uint32_t
+	Bootloader::getResetFlags()
+	{
+		return resetFlags;
+	}
+
 	bool
 	Bootloader::shouldLoadApplication()
 	{
@@ -66,21 +99,161 @@ namespace osshs
 	bool
 	Bootloader::checkApplication()
 	{
-		uint32_t stackPointer = *reinterpret_cast<uint32_t *>(OSSHS_BOOTLOADER_APPLICATION_ORIGIN);
-		return (stackPointer - OSSHS_BOOTLOADER_RAM_ORIGIN) < OSSHS_BOOTLOADER_RAM_LENGTH;
+		uint32_t cycles = CycleCounter::now();
+		ApplicationCheck result = validateApplication();
+		validationCycles = CycleCounter::now() - cycles;
+
+		Trace::record(TraceEvent::APPLICATION_CHECK, static_cast<uint8_t>(result));
+
+		if (result != ApplicationCheck::VALID)
+		{
+			OSSHS_LOG_ERROR("Checking application failed(result = `%s`).", std::string(magic_enum::enum_name(result)).c_str());
+			return false;
+		}
+
+		OSSHS_LOG_INFO("Checking application succeeded.");
+		return true;
+	}
+
+	Bootloader::ApplicationCheck
+	Bootloader::validateApplication()
+	{
+		constexpr uint32_t signatureSize = OSSHS_BOOTLOADER_VERIFY_SIGNATURE ? OSSHS_ED25519_SIGNATURE_SIZE : 0;
+
+		const uint32_t *vectorTable = reinterpret_cast<const uint32_t *>(OSSHS_BOOTLOADER_APPLICATION_ORIGIN);
+		const ApplicationManifest *manifest =
+			reinterpret_cast<const ApplicationManifest *>(OSSHS_BOOTLOADER_APPLICATION_ORIGIN + OSSHS_MANIFEST_OFFSET);
+
+		if ((vectorTable[0] - OSSHS_BOOTLOADER_RAM_ORIGIN) >= OSSHS_BOOTLOADER_RAM_LENGTH)
+			return ApplicationCheck::INVALID_STACK_POINTER;
+
+		if (manifest->magic != OSSHS_MANIFEST_MAGIC || manifest->version != OSSHS_MANIFEST_VERSION ||
+			manifest->size != sizeof(ApplicationManifest))
+			return ApplicationCheck::INVALID_MANIFEST;
+
+		// The image must contain the whole manifest and fit the application region along with its signature
+		if (manifest->imageLength < OSSHS_MANIFEST_OFFSET + sizeof(ApplicationManifest) ||
+			manifest->imageLength > OSSHS_BOOTLOADER_APPLICATION_LENGTH - signatureSize || manifest->imageLength & 0b11)
+			return ApplicationCheck::INVALID_LENGTH;
+
+		// The entry point must be the reset handler and lie within the image
+		if (manifest->entryPoint != vectorTable[1] ||
+			((manifest->entryPoint & ~0b1) - OSSHS_BOOTLOADER_APPLICATION_ORIGIN) >= manifest->imageLength)
+			return ApplicationCheck::INVALID_ENTRY_POINT;
+
+		// Skip the CRC pass on warm boots of an image that was already verified. The token lives in backup
+		// registers the application can write, so it never stands in for the signature.
+		bool cached = VerificationCache::check(manifest->crc);
+		Trace::record(TraceEvent::VERIFICATION_CACHE, !cached);
+
+		if (cached)
+		{
+			verification = OSSHS_HANDOFF_VERIFIED_CACHED;
+		}
+		else
+		{
+			// Only the bytes in use are covered, skipping the crc field itself
+			uint32_t crcAddress = reinterpret_cast<uintptr_t>(&manifest->crc);
+
+			Flash::resetCRC();
+			Flash::updateCRC(OSSHS_BOOTLOADER_APPLICATION_ORIGIN, crcAddress - OSSHS_BOOTLOADER_APPLICATION_ORIGIN);
+			Flash::updateCRC(crcAddress + 4, OSSHS_BOOTLOADER_APPLICATION_ORIGIN + manifest->imageLength - crcAddress - 4);
+
+			if (Flash::getCRC() != manifest->crc)
+				return ApplicationCheck::INVALID_CRC;
+		}
+
+#if OSSHS_BOOTLOADER_VERIFY_SIGNATURE
+		// The signature trailer directly follows the bytes it covers
+		static const uint8_t publicKey[OSSHS_ED25519_PUBLIC_KEY_SIZE] = OSSHS_BOOTLOADER_PUBLIC_KEY;
+		const uint8_t *image = reinterpret_cast<const uint8_t *>(OSSHS_BOOTLOADER_APPLICATION_ORIGIN);
+
+		uint32_t cycles = CycleCounter::now();
+		bool signatureValid = crypto::Ed25519::verify(image + manifest->imageLength, publicKey, image, manifest->imageLength);
+		cycles = CycleCounter::now() - cycles;
+
+		Trace::record(TraceEvent::SIGNATURE_CHECK, !signatureValid, cycles >> 10);
+		OSSHS_LOG_INFO("Verifying application signature finished(valid = `%d`, cycles = `%lu`).", signatureValid, cycles);
+
+		if (!signatureValid)
+			return ApplicationCheck::INVALID_SIGNATURE;
+
+		verification |= OSSHS_HANDOFF_VERIFIED_SIGNATURE;
+#endif
+
+		if (!cached)
+			VerificationCache::store(manifest->crc);
+
+		return ApplicationCheck::VALID;
+	}
+
+	bool
+	Bootloader::listen(bool (*poll)())
+	{
+		const uint32_t window = modm::clock::fcpu / 1000 * OSSHS_BOOTLOADER_LISTEN_WINDOW_MS;
+		uint32_t start = CycleCounter::now();
+		bool requested;
+
+		if (!OSSHS_BOOTLOADER_LISTEN_WINDOW_MS)
+			return false;
+
+		// The cycle counter starts with main(), requests that arrived while validating wait in the peripherals
+		do
+			requested = poll();
+		while (!requested && CycleCounter::now() < window);
+
+		listenCycles = CycleCounter::now() - start;
+		Trace::record(TraceEvent::LISTEN_WINDOW, requested, listenCycles / (modm::clock::fcpu / 1000000));
+
+		if (requested)
+			OSSHS_LOG_INFO("Staying in bootloader. Requested in listen window(cycles = `%lu`).", listenCycles);
+
+		return requested;
 	}
 
 	void
 	Bootloader::loadApplication()
 	{
+		writeHandoff();
+
+		uint32_t stackUsage = StackMonitor::getHighWaterMark();
+		Trace::record(TraceEvent::APPLICATION_JUMP, 0, stackUsage < 0xffff ? stackUsage : 0xffff);
+
 		// Use the application's vector table.
 		SCB->VTOR = OSSHS_BOOTLOADER_APPLICATION_ORIGIN;
 
 		// Use the application's stack pointer as the Main Stack Pointer (MSP).
-		__asm__ volatile ("MSR msp, %0" : : "r" (*reinterpret_cast<uint32_t *>(OSSHS_BOOTLOADER_APPLICATION_ORIGIN)) : );
+		__set_MSP(*reinterpret_cast<uint32_t *>(OSSHS_BOOTLOADER_APPLICATION_ORIGIN));
 
 		// Call the application's entry point.
-		(*reinterpret_cast<void(**)()>(OSSHS_BOOTLOADER_APPLICATION_ORIGIN + 4))();
+		reinterpret_cast<void(*)()>(*reinterpret_cast<uint32_t *>(OSSHS_BOOTLOADER_APPLICATION_ORIGIN + 4))();
+	}
+
+	void
+	Bootloader::writeHandoff()
+	{
+		BootHandoff *handoff = reinterpret_cast<BootHandoff *>(OSSHS_BOOTLOADER_HANDOFF_ORIGIN);
+		const ApplicationManifest *manifest =
+			reinterpret_cast<const ApplicationManifest *>(OSSHS_BOOTLOADER_APPLICATION_ORIGIN + OSSHS_MANIFEST_OFFSET);
+
+		handoff->version = OSSHS_HANDOFF_VERSION;
+		handoff->size = sizeof(BootHandoff);
+		handoff->coreFrequency = modm::clock::fcpu;
+		handoff->rccCr = RCC->CR;
+		handoff->rccCfgr = RCC->CFGR;
+		handoff->resetFlags = resetFlags;
+		handoff->validationCycles = validationCycles;
+		handoff->listenCycles = listenCycles;
+		handoff->nodeId = OSSHS_BOOTLOADER_NODE_ID;
+		handoff->imageVersion = manifest->imageVersion;
+		handoff->imageLength = manifest->imageLength;
+		handoff->imageCrc = manifest->crc;
+		handoff->verification = verification;
+		handoff->reserved[0] = handoff->reserved[1] = handoff->reserved[2] = 0;
+		handoff->bootCycles = CycleCounter::now();
+
+		// Only mark the record valid once it is complete.
+		handoff->magic = OSSHS_HANDOFF_MAGIC;
 	}
 
 	void
@@ -89,6 +262,10 @@ namespace osshs
 		// Disable the power and backup interface clocks.
 		RCC->APB1ENR &= ~(RCC_APB1ENR_PWREN | RCC_APB1ENR_BKPEN);
 
-		OSSHS_LOG_INFO("Deinitializing bootloader succeeded.");
+		// Disable CRC peripheral clock.
+		RCC->AHBENR &= ~RCC_AHBENR_CRCEN;
+
+		OSSHS_LOG_INFO("Deinitializing bootloader succeeded(stackUsage = `%lu`, stackSize = `%lu`).",
+			StackMonitor::getHighWaterMark(), StackMonitor::getSize());
 	}
 }
@@ -0,0 +1,405 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <osshs/log/logger.hpp>
+#include <osshs/can_bus.hpp>
+#include <osshs/cycle_counter.hpp>
+#include <osshs/event_loop.hpp>
+#include <modm/platform.hpp>
+
+namespace osshs
+{
+	SpscQueue<CanFrame, OSSHS_CAN_QUEUE_SIZE> CanBus::queue;
+	uint32_t CanBus::overruns = 0;
+	uint8_t CanBus::nodeId = OSSHS_CAN_BROADCAST_NODE_ID;
+	uint8_t CanBus::task = OSSHS_EVENT_LOOP_INVALID_TASK;
+
+	TokenBucket CanBus::bucket;
+	CanRateLimit CanBus::limit = {OSSHS_CAN_RATE_LIMIT, OSSHS_CAN_RATE_BURST, CanRateMode::FIXED};
+	std::atomic<uint32_t> CanBus::errors{0};
+	uint32_t CanBus::period = 0;
+	uint8_t CanBus::events = 0;
+	uint32_t CanBus::background = 0;
+
+	namespace
+	{
+		/**
+		 * @brief Get the 16 bit filter value of a standard identifier data frame.
+		 */
+		constexpr uint32_t
+		getFilterValue(uint32_t id)
+		{
+			// STID[10:0] in bits 15:5, RTR and IDE clear
+			return (id & 0x7ff) << 5;
+		}
+	}
+
+	void
+	CanBus::initialize(uint8_t nodeId, uint8_t task)
+	{
+		CanBus::nodeId = nodeId;
+		CanBus::task = task;
+		overruns = 0;
+
+		// Every session starts with the default limit, until the host requests another one
+		limit = {OSSHS_CAN_RATE_LIMIT, OSSHS_CAN_RATE_BURST, CanRateMode::FIXED};
+		bucket.configure(limit.rate, limit.burst);
+		errors.store(0, std::memory_order_relaxed);
+		period = CycleCounter::now();
+		events = 0;
+
+		configureFilters();
+
+		// Interrupt on pending messages and overruns of both FIFOs, and on every error the hardware detects
+		CAN1->IER |= CAN_IER_FMPIE0 | CAN_IER_FOVIE0 | CAN_IER_FMPIE1 | CAN_IER_FOVIE1 | CAN_IER_ERRIE |
+			CAN_IER_LECIE;
+
+		NVIC_SetPriority(USB_LP_CAN1_RX0_IRQn, OSSHS_CAN_INTERRUPT_PRIORITY);
+		NVIC_SetPriority(CAN1_RX1_IRQn, OSSHS_CAN_INTERRUPT_PRIORITY);
+		NVIC_SetPriority(CAN1_SCE_IRQn, OSSHS_CAN_INTERRUPT_PRIORITY);
+		NVIC_EnableIRQ(USB_LP_CAN1_RX0_IRQn);
+		NVIC_EnableIRQ(CAN1_RX1_IRQn);
+		NVIC_EnableIRQ(CAN1_SCE_IRQn);
+
+		OSSHS_LOG_INFO("Initializing CAN bus succeeded(node = `0x%03x`, broadcast = `0x%03x`).",
+			OSSHS_CAN_REQUEST_ID(nodeId), OSSHS_CAN_REQUEST_ID(OSSHS_CAN_BROADCAST_NODE_ID));
+	}
+
+	void
+	CanBus::initializePolling(uint8_t nodeId)
+	{
+		CanBus::nodeId = nodeId;
+		task = OSSHS_EVENT_LOOP_INVALID_TASK;
+
+		// Nothing is logged, the listen window only lasts a few milliseconds
+		CAN1->IER = 0;
+		configureFilters();
+	}
+
+	void
+	CanBus::deinitialize()
+	{
+		NVIC_DisableIRQ(USB_LP_CAN1_RX0_IRQn);
+		NVIC_DisableIRQ(CAN1_RX1_IRQn);
+		NVIC_DisableIRQ(CAN1_SCE_IRQn);
+
+		// Reset CAN1, which also clears its filters
+		RCC->APB1RSTR |= RCC_APB1RSTR_CAN1RST;
+		RCC->APB1RSTR &= ~RCC_APB1RSTR_CAN1RST;
+
+		task = OSSHS_EVENT_LOOP_INVALID_TASK;
+
+		OSSHS_LOG_INFO("Deinitializing CAN bus succeeded(overruns = `%lu`).", overruns);
+	}
+
+	uint8_t
+	CanBus::getNodeId()
+	{
+		return nodeId;
+	}
+
+	bool
+	CanBus::isPending()
+	{
+		return !queue.isEmpty();
+	}
+
+	bool
+	CanBus::receive(CanFrame &frame)
+	{
+		return queue.pop(frame);
+	}
+
+	bool
+	CanBus::poll(CanFrame &frame)
+	{
+		for (uint8_t fifo = 0; fifo < 2; fifo++)
+			if ((fifo ? CAN1->RF1R : CAN1->RF0R) & CAN_RF0R_FMP0)
+			{
+				read(fifo, frame);
+				return true;
+			}
+
+		return false;
+	}
+
+	bool
+	CanBus::send(const CanFrame &frame)
+	{
+		uint32_t status = CAN1->TSR;
+		uint8_t mailbox;
+
+		if (status & CAN_TSR_TME0)
+			mailbox = 0;
+		else if (status & CAN_TSR_TME1)
+			mailbox = 1;
+		else if (status & CAN_TSR_TME2)
+			mailbox = 2;
+		else
+			return false;
+
+		uint32_t data[2] = {0, 0};
+		for (uint8_t i = 0; i < frame.length && i < 8; i++)
+			data[i / 4] |= static_cast<uint32_t>(frame.data[i]) << (i % 4 * 8);
+
+		CAN1->sTxMailBox[mailbox].TDTR = frame.length;
+		CAN1->sTxMailBox[mailbox].TDLR = data[0];
+		CAN1->sTxMailBox[mailbox].TDHR = data[1];
+
+		// STID[10:0] in bits 31:21, request transmission
+		CAN1->sTxMailBox[mailbox].TIR = static_cast<uint32_t>(frame.id & 0x7ff) << 21 | CAN_TI0R_TXRQ;
+		return true;
+	}
+
+	bool
+	CanBus::sendBackground(const CanFrame &frame)
+	{
+		if ((CAN1->TSR & (CAN_TSR_TME0 | CAN_TSR_TME1 | CAN_TSR_TME2)) != (CAN_TSR_TME0 | CAN_TSR_TME1 | CAN_TSR_TME2))
+			return false;
+
+		// send() takes mailbox 0 when all are empty
+		background |= CAN_TSR_ALST0;
+		return send(frame);
+	}
+
+	void
+	CanBus::setRateLimit(const CanRateLimit &limit)
+	{
+		CanBus::limit = limit;
+		CanBus::limit.burst = limit.burst ? limit.burst : 1;
+		bucket.configure(CanBus::limit.rate, CanBus::limit.burst);
+
+		// Adaptive mode starts from the requested rate and events of earlier periods do not count
+		errors.store(0, std::memory_order_relaxed);
+		period = CycleCounter::now();
+		events = 0;
+
+		OSSHS_LOG_INFO("Setting CAN rate limit succeeded(rate = `%u`, burst = `%u`, mode = `%u`).",
+			CanBus::limit.rate, CanBus::limit.burst, static_cast<uint8_t>(CanBus::limit.mode));
+
+		reportRateLimit();
+	}
+
+	const CanRateLimit &
+	CanBus::getRateLimit()
+	{
+		return limit;
+	}
+
+	uint16_t
+	CanBus::getRate()
+	{
+		return bucket.getRate();
+	}
+
+	bool
+	CanBus::acquire(uint8_t frames)
+	{
+		adapt();
+		return bucket.take(frames);
+	}
+
+	uint32_t
+	CanBus::getAcquireDelay(uint8_t frames)
+	{
+		return bucket.getDelay(frames);
+	}
+
+	bool
+	CanBus::handleRateLimitRequest(const CanFrame &frame)
+	{
+		if (frame.length < 5 || frame.data[0] != OSSHS_CAN_COMMAND_RATE_LIMIT)
+			return false;
+
+		if (frame.data[4] > static_cast<uint8_t>(CanRateMode::ADAPTIVE))
+		{
+			OSSHS_LOG_ERROR("Setting CAN rate limit failed. Unknown mode(mode = `%u`).", frame.data[4]);
+			reportRateLimit();
+			return true;
+		}
+
+		setRateLimit({static_cast<uint16_t>(frame.data[1] | frame.data[2] << 8), frame.data[3],
+			static_cast<CanRateMode>(frame.data[4])});
+		return true;
+	}
+
+	bool
+	CanBus::reportRateLimit()
+	{
+		uint16_t rate = bucket.getRate();
+
+		CanFrame frame;
+		frame.id = OSSHS_CAN_RESPONSE_ID(nodeId);
+		frame.length = 8;
+		frame.fifo = 0;
+		frame.data[0] = OSSHS_CAN_REPORT_RATE_LIMIT;
+		frame.data[1] = limit.rate;
+		frame.data[2] = limit.rate >> 8;
+		frame.data[3] = limit.burst;
+		frame.data[4] = static_cast<uint8_t>(limit.mode);
+		frame.data[5] = rate;
+		frame.data[6] = rate >> 8;
+		frame.data[7] = events;
+
+		return send(frame);
+	}
+
+	uint32_t
+	CanBus::getOverruns()
+	{
+		return overruns;
+	}
+
+	void
+	CanBus::handleInterrupt(uint8_t fifo)
+	{
+		// RF0R and RF1R have the same layout
+		auto &status = fifo ? CAN1->RF1R : CAN1->RF0R;
+
+		// At most 3 frames, unless more arrive while draining
+		while (status & CAN_RF0R_FMP0)
+		{
+			CanFrame frame;
+			read(fifo, frame);
+
+			if (!queue.push(frame))
+				overruns++;
+		}
+
+		if (status & CAN_RF0R_FOVR0)
+		{
+			status = CAN_RF0R_FOVR0;
+			overruns++;
+		}
+
+		if (task != OSSHS_EVENT_LOOP_INVALID_TASK)
+			EventLoop::post(task);
+	}
+
+	void
+	CanBus::handleErrorInterrupt()
+	{
+		// With LECIE, ERRI is set whenever the hardware writes an error code to LEC
+		CAN1->MSR = CAN_MSR_ERRI;
+		errors.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void
+	CanBus::configureFilters()
+	{
+		uint32_t node = getFilterValue(OSSHS_CAN_REQUEST_ID(nodeId));
+		uint32_t broadcast = getFilterValue(OSSHS_CAN_REQUEST_ID(OSSHS_CAN_BROADCAST_NODE_ID));
+
+		// Transmit mailboxes in the order they were requested instead of by identifier, so the frames of a
+		// segmented message with one identifier can not overtake each other
+		CAN1->MCR |= CAN_MCR_TXFP;
+
+		// Enter filter initialization mode and deactivate all banks
+		CAN1->FMR |= CAN_FMR_FINIT;
+		CAN1->FA1R = 0;
+
+		// Banks 0 and 1 in 16 bit identifier list mode, bank 0 into FIFO0 and bank 1 into FIFO1
+		CAN1->FM1R = 0b11;
+		CAN1->FS1R = 0;
+		CAN1->FFA1R = 0b10;
+
+		// Each bank holds 4 identifiers, repeat the single one
+		CAN1->sFilterRegister[0].FR1 = node | node << 16;
+		CAN1->sFilterRegister[0].FR2 = node | node << 16;
+		CAN1->sFilterRegister[1].FR1 = broadcast | broadcast << 16;
+		CAN1->sFilterRegister[1].FR2 = broadcast | broadcast << 16;
+
+		CAN1->FA1R = 0b11;
+		CAN1->FMR &= ~CAN_FMR_FINIT;
+	}
+
+	void
+	CanBus::read(uint8_t fifo, CanFrame &frame)
+	{
+		auto &mailbox = CAN1->sFIFOMailBox[fifo];
+		auto &status = fifo ? CAN1->RF1R : CAN1->RF0R;
+
+		frame.id = mailbox.RIR >> 21;
+		frame.length = mailbox.RDTR & 0xf;
+		frame.fifo = fifo;
+
+		uint32_t data[2] = {mailbox.RDLR, mailbox.RDHR};
+		for (uint8_t i = 0; i < 8; i++)
+			frame.data[i] = data[i / 4] >> (i % 4 * 8);
+
+		if (frame.length > 8)
+			frame.length = 8;
+
+		// Release the mailbox and wait until the next frame moved in
+		status = CAN_RF0R_RFOM0;
+		while (status & CAN_RF0R_RFOM0);
+	}
+
+	void
+	CanBus::adapt()
+	{
+		uint32_t now = CycleCounter::now();
+		if (now - period < modm::clock::fcpu / 1000 * OSSHS_CAN_RATE_ADAPT_PERIOD_MS)
+			return;
+
+		period = now;
+
+		// Completed transmit requests tell whether arbitration was lost, clearing RQCP also clears ALST
+		uint32_t status = CAN1->TSR;
+		uint32_t lost = status & ~background;
+		uint32_t losses = !!(lost & CAN_TSR_ALST0) + !!(lost & CAN_TSR_ALST1) + !!(lost & CAN_TSR_ALST2);
+		CAN1->TSR = status & (CAN_TSR_RQCP0 | CAN_TSR_RQCP1 | CAN_TSR_RQCP2);
+
+		// Background frames that completed no longer hold their mailbox, RQCPx is two bits below ALSTx
+		background &= ~((status & (CAN_TSR_RQCP0 | CAN_TSR_RQCP1 | CAN_TSR_RQCP2)) << 2);
+
+		uint32_t count = errors.exchange(0, std::memory_order_relaxed) + losses;
+		events = count > 0xff ? 0xff : count;
+
+		if (limit.mode != CanRateMode::ADAPTIVE || !limit.rate)
+			return;
+
+		uint16_t rate = bucket.getRate();
+		uint16_t minimum = limit.rate >> OSSHS_CAN_RATE_MINIMUM_SHIFT;
+		uint16_t step = limit.rate / 16;
+
+		if (count)
+			rate = rate / 2 > minimum ? rate / 2 : minimum;
+		else
+			rate = rate + (step ? step : 1) < limit.rate ? rate + (step ? step : 1) : limit.rate;
+
+		if (!rate)
+			rate = 1;
+
+		if (rate == bucket.getRate())
+			return;
+
+		if (count)
+			OSSHS_LOG_WARNING("Lowering CAN rate. Bus errors or lost arbitration(rate = `%u`, events = `%lu`).",
+				rate, count);
+
+		bucket.setRate(rate);
+		reportRateLimit();
+	}
+}
@@ -0,0 +1,379 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <osshs/log/logger.hpp>
+#include <osshs/bootloader.hpp>
+#include <osshs/container_writer.hpp>
+#include <osshs/cycle_counter.hpp>
+#include <osshs/flash.hpp>
+#include <cstring>
+
+namespace osshs
+{
+	std::unique_ptr<uint8_t[]> ContainerWriter::page;
+	crypto::Sha256 ContainerWriter::digest;
+	ContainerWriter::State ContainerWriter::state;
+
+	ContainerHeader ContainerWriter::header;
+	ContainerRecord ContainerWriter::record;
+
+	uint8_t ContainerWriter::staging[sizeof(ContainerHeader)];
+	uint8_t ContainerWriter::staged;
+
+	uint32_t ContainerWriter::origin;
+	uint32_t ContainerWriter::length;
+	uint32_t ContainerWriter::written;
+	uint16_t ContainerWriter::records;
+	uint16_t ContainerWriter::remaining;
+	uint16_t ContainerWriter::filled;
+
+	uint8_t ContainerWriter::count;
+	bool ContainerWriter::repeat;
+
+	uint16_t ContainerWriter::skipped;
+	uint16_t ContainerWriter::erased;
+	uint16_t ContainerWriter::programmed;
+	uint32_t ContainerWriter::flashCycles;
+
+	bool
+	ContainerWriter::begin(uint32_t address, uint32_t length)
+	{
+		if (!Flash::MemoryMap::isPageOrigin(address))
+		{
+			OSSHS_LOG_ERROR("Beginning container failed. Address not a page origin in flash(address = `0x%08x`).", address);
+			return false;
+		}
+
+		if (length < sizeof(ContainerHeader))
+		{
+			OSSHS_LOG_ERROR("Beginning container failed. Container too short(length = `0x%08x`).", length);
+			return false;
+		}
+
+		if (!page)
+			page = std::make_unique<uint8_t[]>(Flash::pageSize);
+
+		origin = address;
+		ContainerWriter::length = length;
+		written = 0;
+		state = State::HEADER;
+		staged = 0;
+		records = 0;
+		skipped = 0;
+		erased = 0;
+		programmed = 0;
+		flashCycles = 0;
+
+		digest.reset();
+
+		OSSHS_LOG_INFO("Beginning container succeeded(address = `0x%08x`, length = `0x%08x`).", address, length);
+		return true;
+	}
+
+	bool
+	ContainerWriter::write(const uint8_t *data, std::size_t length)
+	{
+		if (!page)
+		{
+			OSSHS_LOG_ERROR("Writing container failed. No container begun.");
+			return false;
+		}
+
+		if (length > ContainerWriter::length - written)
+		{
+			OSSHS_LOG_ERROR("Writing container failed. Container too long(written = `0x%08x`, length = `0x%08x`).",
+				written, length);
+			page.reset();
+			return false;
+		}
+
+		digest.update(data, length);
+		written += length;
+
+		while (length)
+		{
+			std::size_t used;
+			bool succeeded = true;
+
+			switch (state)
+			{
+				case State::HEADER:
+				case State::RECORD:
+				{
+					std::size_t size = state == State::HEADER ? sizeof(ContainerHeader) : sizeof(ContainerRecord);
+					used = size - staged < length ? size - staged : length;
+					std::memcpy(staging + staged, data, used);
+					staged += used;
+
+					if (staged == size)
+					{
+						staged = 0;
+						succeeded = state == State::HEADER ? parseHeader() : parseRecord();
+					}
+					break;
+				}
+
+				case State::PAYLOAD:
+					used = remaining < length ? remaining : length;
+					if (record.flags & OSSHS_CONTAINER_FLAG_COMPRESSED)
+					{
+						for (std::size_t i = 0; succeeded && i < used; i++)
+							succeeded = decode(data[i]);
+
+						if (!succeeded)
+							OSSHS_LOG_ERROR("Decoding container page failed. Invalid payload(address = `0x%08x`).",
+								record.address);
+					}
+					else
+					{
+						std::memcpy(page.get() + filled, data, used);
+						filled += used;
+					}
+
+					remaining -= used;
+					if (succeeded && !remaining)
+						succeeded = commitRecord();
+					break;
+
+				default:
+					OSSHS_LOG_ERROR("Writing container failed. Data behind the last record(written = `0x%08x`).", written);
+					used = length;
+					succeeded = false;
+					break;
+			}
+
+			if (!succeeded)
+			{
+				page.reset();
+				return false;
+			}
+
+			data += used;
+			length -= used;
+		}
+
+		return true;
+	}
+
+	bool
+	ContainerWriter::finish(uint8_t *digest)
+	{
+		if (!page)
+		{
+			OSSHS_LOG_ERROR("Finishing container failed. No container begun.");
+			return false;
+		}
+
+		page.reset();
+
+		if (state != State::DONE || written != length)
+		{
+			OSSHS_LOG_ERROR("Finishing container failed. Container incomplete(written = `0x%08x`, records = `%u`).",
+				written, records);
+			return false;
+		}
+
+		// Pages skipped or written, the image as a whole must match
+		Flash::resetCRC();
+		Flash::updateCRC(origin, header.imageLength);
+		uint32_t crc = Flash::getCRC();
+
+		if (crc != header.imageCrc)
+		{
+			OSSHS_LOG_ERROR("Finishing container failed. Image does not match its CRC(crc = `0x%08x`, expected = `0x%08x`).",
+				crc, header.imageCrc);
+			return false;
+		}
+
+		ContainerWriter::digest.finish(digest);
+
+		OSSHS_LOG_INFO("Finishing container succeeded(address = `0x%08x`, imageLength = `0x%08x`, imageVersion = `0x%08x`).",
+			origin, header.imageLength, header.imageVersion);
+		OSSHS_LOG_INFO("Container pages: `%u` skipped, `%u` erased, `%u` written in `%lu` cycles.",
+			skipped, erased, programmed, flashCycles);
+		return true;
+	}
+
+	void
+	ContainerWriter::abort()
+	{
+		page.reset();
+
+		OSSHS_LOG_WARNING("Aborting container(address = `0x%08x`, written = `0x%08x`, records = `%u`).",
+			origin, written, records);
+	}
+
+	uint32_t
+	ContainerWriter::getWritten()
+	{
+		return written;
+	}
+
+	bool
+	ContainerWriter::parseHeader()
+	{
+		std::memcpy(&header, staging, sizeof(ContainerHeader));
+
+		if (header.magic != OSSHS_CONTAINER_MAGIC || header.version != OSSHS_CONTAINER_VERSION ||
+			header.size != sizeof(ContainerHeader) || header.pageSize != Flash::pageSize)
+		{
+			OSSHS_LOG_ERROR("Parsing container header failed. Unsupported container(magic = `0x%08x`, version = `%u`, pageSize = `0x%04x`).",
+				header.magic, header.version, header.pageSize);
+			return false;
+		}
+
+		uint32_t pages = (header.imageLength + Flash::pageSize - 1) >> Flash::MemoryMap::pageShift;
+
+		// The image must fit the application region and every page of it must have a record
+		if (header.origin != origin || !header.imageLength || header.imageLength & 0b11 ||
+			header.imageLength > OSSHS_BOOTLOADER_APPLICATION_ORIGIN + OSSHS_BOOTLOADER_APPLICATION_LENGTH - origin ||
+			header.recordCount != pages || header.size + header.dataLength != length)
+		{
+			OSSHS_LOG_ERROR("Parsing container header failed. Invalid image(origin = `0x%08x`, imageLength = `0x%08x`, recordCount = `%u`).",
+				header.origin, header.imageLength, header.recordCount);
+			return false;
+		}
+
+		state = State::RECORD;
+
+		OSSHS_LOG_DEBUG("Parsing container header succeeded(imageLength = `0x%08x`, imageVersion = `0x%08x`, recordCount = `%u`).",
+			header.imageLength, header.imageVersion, header.recordCount);
+		return true;
+	}
+
+	bool
+	ContainerWriter::parseRecord()
+	{
+		std::memcpy(&record, staging, sizeof(ContainerRecord));
+
+		bool blank = record.flags & OSSHS_CONTAINER_FLAG_BLANK;
+		bool compressed = record.flags & OSSHS_CONTAINER_FLAG_COMPRESSED;
+
+		// Records come in the order of their pages
+		if (record.address != origin + (static_cast<uint32_t>(records) << Flash::MemoryMap::pageShift) ||
+			record.flags & ~(OSSHS_CONTAINER_FLAG_BLANK | OSSHS_CONTAINER_FLAG_COMPRESSED) || (blank && compressed) ||
+			(compressed ? !record.length || record.length >= Flash::pageSize : record.length != (blank ? 0 : Flash::pageSize)))
+		{
+			OSSHS_LOG_ERROR("Parsing container record failed(record = `%u`, address = `0x%08x`, flags = `0x%04x`, length = `%u`).",
+				records, record.address, record.flags, record.length);
+			return false;
+		}
+
+		remaining = record.length;
+		filled = 0;
+		count = 0;
+		state = State::PAYLOAD;
+
+		return blank ? commitRecord() : true;
+	}
+
+	bool
+	ContainerWriter::decode(uint8_t data)
+	{
+		if (!count)
+		{
+			if (data == 0x80)
+				return false;
+
+			// Literal runs are followed by their bytes, repeated runs by a single byte
+			repeat = data > 0x80;
+			count = repeat ? 257 - data : data + 1;
+			return true;
+		}
+
+		if (repeat)
+		{
+			if (count > Flash::pageSize - filled)
+				return false;
+
+			std::memset(page.get() + filled, data, count);
+			filled += count;
+			count = 0;
+			return true;
+		}
+
+		if (filled == Flash::pageSize)
+			return false;
+
+		page[filled++] = data;
+		count--;
+		return true;
+	}
+
+	bool
+	ContainerWriter::commitRecord()
+	{
+		bool blank = record.flags & OSSHS_CONTAINER_FLAG_BLANK;
+		if (!blank && (filled != Flash::pageSize || count))
+		{
+			OSSHS_LOG_ERROR("Committing container page failed. Payload does not fill the page(address = `0x%08x`, filled = `%u`).",
+				record.address, filled);
+			return false;
+		}
+
+		uint32_t cycles = CycleCounter::now();
+		bool succeeded = true;
+
+		// A page that already holds the data, e.g. from an earlier attempt, costs neither an erase nor its endurance
+		if (getPageCrc(record.address) == record.crc)
+		{
+			skipped++;
+		}
+		else
+		{
+			if (blank)
+			{
+				succeeded = Flash::erasePage(record.address);
+				erased++;
+			}
+			else
+			{
+				succeeded = Flash::writePage(record.address, page);
+				programmed++;
+			}
+
+			succeeded = succeeded && getPageCrc(record.address) == record.crc;
+		}
+
+		flashCycles += CycleCounter::now() - cycles;
+
+		if (!succeeded)
+		{
+			OSSHS_LOG_ERROR("Committing container page failed. Page does not match its CRC(address = `0x%08x`, crc = `0x%08x`).",
+				record.address, record.crc);
+			return false;
+		}
+
+		records++;
+		state = records == header.recordCount ? State::DONE : State::RECORD;
+		return true;
+	}
+
+	uint32_t
+	ContainerWriter::getPageCrc(uint32_t address)
+	{
+		Flash::resetCRC();
+		Flash::updateCRC(address, Flash::pageSize);
+		return Flash::getCRC();
+	}
+}
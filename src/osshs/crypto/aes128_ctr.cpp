@@ -0,0 +1,216 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <osshs/crypto/aes128_ctr.hpp>
+#include <cstring>
+
+namespace osshs
+{
+	namespace crypto
+	{
+		uint32_t Aes128Ctr::table[256];
+		bool Aes128Ctr::tableReady = false;
+
+		static inline uint32_t
+		rotateLeft(uint32_t value, uint8_t count)
+		{
+			return (value << count) | (value >> (32 - count));
+		}
+
+		static inline uint32_t
+		loadLittleEndian(const uint8_t *data)
+		{
+			// Compiles to an unaligned LDR on the Cortex-M3
+			uint32_t value;
+			std::memcpy(&value, data, sizeof(value));
+			return value;
+		}
+
+		static inline uint8_t
+		multiplyByTwo(uint8_t value)
+		{
+			return (value << 1) ^ ((value >> 7) * 0x1b);
+		}
+
+		// Words hold columns with row 0 in the lowest byte, as they are loaded on a little endian core
+		static inline uint32_t
+		substitute(const uint32_t *table, uint32_t value)
+		{
+			return ((table[value & 0xff] >> 8) & 0xff) | (table[(value >> 8) & 0xff] & 0xff00) |
+				(table[(value >> 16) & 0xff] & 0xff0000) | ((table[value >> 24] << 16) & 0xff000000);
+		}
+
+		void
+		Aes128Ctr::begin(const uint8_t *key, const uint8_t *counter)
+		{
+			initializeTable();
+
+			for (uint8_t i = 0; i < 4; i++)
+			{
+				roundKeys[i] = loadLittleEndian(key + i * 4);
+				this->counter[i] = loadLittleEndian(counter + i * 4);
+			}
+
+			// RotWord is a rotation by one byte towards row 0, the round constant goes into row 0
+			uint8_t roundConstant = 0x01;
+			for (uint8_t i = 4; i < 44; i++)
+			{
+				uint32_t word = roundKeys[i - 1];
+				if (!(i % 4))
+				{
+					word = substitute(table, rotateLeft(word, 24)) ^ roundConstant;
+					roundConstant = multiplyByTwo(roundConstant);
+				}
+
+				roundKeys[i] = roundKeys[i - 4] ^ word;
+			}
+
+			keystreamValid = false;
+		}
+
+		void
+		Aes128Ctr::apply(uint8_t *data, std::size_t length, uint32_t offset)
+		{
+			while (length)
+			{
+				uint32_t block = offset / OSSHS_AES128_BLOCK_SIZE;
+				uint32_t used = offset % OSSHS_AES128_BLOCK_SIZE;
+				if (!keystreamValid || block != keystreamBlock)
+					encryptCounter(block);
+
+				std::size_t count = OSSHS_AES128_BLOCK_SIZE - used;
+				if (count > length)
+					count = length;
+
+				if (count == OSSHS_AES128_BLOCK_SIZE)
+				{
+					// Whole blocks a word at a time, the data may not be word aligned
+					for (uint8_t i = 0; i < 4; i++)
+					{
+						uint32_t word = loadLittleEndian(data + i * 4) ^ keystream[i];
+						std::memcpy(data + i * 4, &word, sizeof(word));
+					}
+				}
+				else
+				{
+					const uint8_t *stream = reinterpret_cast<const uint8_t *>(keystream) + used;
+					for (std::size_t i = 0; i < count; i++)
+						data[i] ^= stream[i];
+				}
+
+				data += count;
+				length -= count;
+				offset += count;
+			}
+		}
+
+		void
+		Aes128Ctr::clear()
+		{
+			// Volatile, so the stores are not dropped as dead
+			volatile uint32_t *words = roundKeys;
+			for (uint8_t i = 0; i < 44; i++)
+				words[i] = 0;
+
+			words = keystream;
+			for (uint8_t i = 0; i < 4; i++)
+				words[i] = 0;
+
+			keystreamValid = false;
+		}
+
+		void
+		Aes128Ctr::initializeTable()
+		{
+			if (tableReady)
+				return;
+
+			// Walk the multiplicative group with p = 3^n and q = 3^-n, the S-box of p is the affine transform of q
+			uint8_t p = 1;
+			uint8_t q = 1;
+			do
+			{
+				p ^= multiplyByTwo(p);
+				q ^= q << 1;
+				q ^= q << 2;
+				q ^= q << 4;
+				if (q & 0x80)
+					q ^= 0x09;
+
+				uint8_t s = q ^ (q << 1 | q >> 7) ^ (q << 2 | q >> 6) ^ (q << 3 | q >> 5) ^ (q << 4 | q >> 4) ^ 0x63;
+				uint8_t doubled = multiplyByTwo(s);
+
+				// MixColumns column (2, 1, 1, 3) of the byte in row 0, S(x) itself is row 1
+				table[p] = doubled | s << 8 | s << 16 | static_cast<uint32_t>(doubled ^ s) << 24;
+			}
+			while (p != 1);
+
+			table[0] = 0xc6 | 0x63 << 8 | 0x63 << 16 | static_cast<uint32_t>(0xa5) << 24;
+			tableReady = true;
+		}
+
+		void
+		Aes128Ctr::encryptCounter(uint32_t block)
+		{
+			const uint32_t *t = table;
+			const uint32_t *key = roundKeys;
+
+			uint32_t s0 = counter[0] ^ key[0];
+			uint32_t s1 = counter[1] ^ key[1];
+			uint32_t s2 = counter[2] ^ key[2];
+			uint32_t s3 = __builtin_bswap32(__builtin_bswap32(counter[3]) + block) ^ key[3];
+
+			// Column j of a round takes row r from column j + r (ShiftRows), the table of row r is rotated by r bytes
+			for (uint8_t round = 1; round < 10; round++)
+			{
+				key += 4;
+
+				uint32_t t0 = t[s0 & 0xff] ^ rotateLeft(t[(s1 >> 8) & 0xff], 8) ^
+					rotateLeft(t[(s2 >> 16) & 0xff], 16) ^ rotateLeft(t[s3 >> 24], 24) ^ key[0];
+				uint32_t t1 = t[s1 & 0xff] ^ rotateLeft(t[(s2 >> 8) & 0xff], 8) ^
+					rotateLeft(t[(s3 >> 16) & 0xff], 16) ^ rotateLeft(t[s0 >> 24], 24) ^ key[1];
+				uint32_t t2 = t[s2 & 0xff] ^ rotateLeft(t[(s3 >> 8) & 0xff], 8) ^
+					rotateLeft(t[(s0 >> 16) & 0xff], 16) ^ rotateLeft(t[s1 >> 24], 24) ^ key[2];
+				uint32_t t3 = t[s3 & 0xff] ^ rotateLeft(t[(s0 >> 8) & 0xff], 8) ^
+					rotateLeft(t[(s1 >> 16) & 0xff], 16) ^ rotateLeft(t[s2 >> 24], 24) ^ key[3];
+
+				s0 = t0;
+				s1 = t1;
+				s2 = t2;
+				s3 = t3;
+			}
+
+			// The last round has no MixColumns, row 1 of the table is the S-box
+			key += 4;
+			keystream[0] = substitute(t, (s0 & 0xff) | (s1 & 0xff00) | (s2 & 0xff0000) | (s3 & 0xff000000)) ^ key[0];
+			keystream[1] = substitute(t, (s1 & 0xff) | (s2 & 0xff00) | (s3 & 0xff0000) | (s0 & 0xff000000)) ^ key[1];
+			keystream[2] = substitute(t, (s2 & 0xff) | (s3 & 0xff00) | (s0 & 0xff0000) | (s1 & 0xff000000)) ^ key[2];
+			keystream[3] = substitute(t, (s3 & 0xff) | (s0 & 0xff00) | (s1 & 0xff0000) | (s2 & 0xff000000)) ^ key[3];
+
+			keystreamBlock = block;
+			keystreamValid = true;
+		}
+	}
+}
@@ -0,0 +1,536 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <osshs/crypto/ed25519.hpp>
+#include <osshs/crypto/sha512.hpp>
+
+namespace osshs
+{
+	namespace crypto
+	{
+		namespace
+		{
+			/**
+			 * Element of GF(2^255 - 19) in radix 2^25.5: ten limbs alternating between 26 and 25 bits, so all
+			 * limb products fit a 32x32->64 bit multiply-accumulate (UMULL/SMLAL on Cortex-M3).
+			 */
+			struct FieldElement
+			{
+				int32_t limb[10];
+			};
+
+			/**
+			 * Point on the twisted Edwards curve in extended coordinates, x = X/Z, y = Y/Z, x * y = T/Z.
+			 */
+			struct Point
+			{
+				FieldElement x;
+				FieldElement y;
+				FieldElement z;
+				FieldElement t;
+			};
+
+			const FieldElement zero = {{0}};
+			const FieldElement one = {{1}};
+
+			const FieldElement d2 = {{
+				45281625, 27714825, 36363642, 13898781, 229458, 15978800, 54557047, 27058993, 29715967, 9444199
+			}};
+
+			const FieldElement d = {{
+				56195235, 13857412, 51736253, 6949390, 114729, 24766616, 60832955, 30306712, 48412415, 21499315
+			}};
+
+			const FieldElement sqrtMinusOne = {{
+				34513072, 25610706, 9377949, 3500415, 12389472, 33281959, 41962654, 31548777, 326685, 11406482
+			}};
+
+			const Point basePoint = {
+				{{52811034, 25909283, 16144682, 17082669, 27570973, 30858332, 40966398, 8378388, 20764389, 8758491}},
+				{{40265304, 26843545, 13421772, 20132659, 26843545, 6710886, 53687091, 13421772, 40265318, 26843545}},
+				{{1}},
+				{{28827043, 27438313, 39759291, 244362, 8635006, 11264893, 19351346, 13413597, 16611511, 27139452}}
+			};
+
+			// Group order L = 2^252 + 27742317777372353535851937790883648493, little endian
+			const uint8_t order[32] = {
+				0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+				0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10
+			};
+
+			constexpr uint8_t
+			limbWidth(uint8_t i)
+			{
+				return (i & 1) ? 25 : 26;
+			}
+
+			/**
+			 * Propagate carries so every limb is back within its width (plus a small excess on limb 1).
+			 */
+			void
+			carry(FieldElement &h, int64_t *t)
+			{
+				for (uint8_t i = 0; i < 10; i++)
+				{
+					int64_t c = t[i] >> limbWidth(i);
+					t[i] -= c * (int64_t(1) << limbWidth(i));
+
+					// 2^255 = 19 modulo p
+					if (i < 9)
+						t[i + 1] += c;
+					else
+						t[0] += 19 * c;
+				}
+
+				int64_t c = t[0] >> 26;
+				t[0] -= c * (int64_t(1) << 26);
+				t[1] += c;
+
+				for (uint8_t i = 0; i < 10; i++)
+					h.limb[i] = t[i];
+			}
+
+			void
+			add(FieldElement &h, const FieldElement &f, const FieldElement &g)
+			{
+				int64_t t[10];
+				for (uint8_t i = 0; i < 10; i++)
+					t[i] = int64_t(f.limb[i]) + g.limb[i];
+				carry(h, t);
+			}
+
+			void
+			subtract(FieldElement &h, const FieldElement &f, const FieldElement &g)
+			{
+				int64_t t[10];
+				for (uint8_t i = 0; i < 10; i++)
+					t[i] = int64_t(f.limb[i]) - g.limb[i];
+				carry(h, t);
+			}
+
+			void
+			multiply(FieldElement &h, const FieldElement &f, const FieldElement &g)
+			{
+				// Products of two odd limbs carry an extra factor of 2, wrapped products a factor of 19
+				int32_t f2[10];
+				int32_t g19[10];
+				for (uint8_t i = 0; i < 10; i++)
+				{
+					f2[i] = (i & 1) ? 2 * f.limb[i] : f.limb[i];
+					g19[i] = 19 * g.limb[i];
+				}
+
+				// Fully unrolled, so the factor selection above resolves at compile time
+				int64_t t[10] = {0};
+#pragma GCC unroll 10
+				for (uint8_t i = 0; i < 10; i++)
+#pragma GCC unroll 10
+					for (uint8_t j = 0; j < 10; j++)
+						t[(i + j) % 10] += int64_t((i & j & 1) ? f2[i] : f.limb[i]) * (i + j >= 10 ? g19[j] : g.limb[j]);
+
+				carry(h, t);
+			}
+
+			void
+			square(FieldElement &h, const FieldElement &f, uint16_t count = 1)
+			{
+				multiply(h, f, f);
+				while (--count)
+					multiply(h, h, h);
+			}
+
+			void
+			fromBytes(FieldElement &h, const uint8_t *s)
+			{
+				// Bit offset of every limb, the top bit of s is ignored
+				static constexpr uint8_t offsets[10] = {0, 26, 51, 77, 102, 128, 153, 179, 204, 230};
+
+				for (uint8_t i = 0; i < 10; i++)
+				{
+					const uint8_t *p = s + offsets[i] / 8;
+					uint32_t value = p[0] | p[1] << 8 | p[2] << 16 | uint32_t(p[3]) << 24;
+					h.limb[i] = (value >> (offsets[i] % 8)) & ((1 << limbWidth(i)) - 1);
+				}
+			}
+
+			void
+			toBytes(uint8_t *s, const FieldElement &h)
+			{
+				int64_t t[10];
+				for (uint8_t i = 0; i < 10; i++)
+					t[i] = h.limb[i];
+
+				// Carry until every limb is within its width, so 0 <= h < 2^255
+				int64_t c;
+				do
+				{
+					for (uint8_t i = 0; i < 10; i++)
+					{
+						c = t[i] >> limbWidth(i);
+						t[i] -= c * (int64_t(1) << limbWidth(i));
+
+						if (i < 9)
+							t[i + 1] += c;
+						else
+							t[0] += 19 * c;
+					}
+				}
+				while (c);
+
+				// Subtract p if h >= p, i.e. if h + 19 overflows 2^255
+				c = (t[0] + 19) >> 26;
+				for (uint8_t i = 1; i < 10; i++)
+					c = (t[i] + c) >> limbWidth(i);
+
+				t[0] += 19 * c;
+				for (uint8_t i = 0; i < 9; i++)
+				{
+					int64_t c = t[i] >> limbWidth(i);
+					t[i] -= c * (int64_t(1) << limbWidth(i));
+					t[i + 1] += c;
+				}
+				t[9] &= (1 << 25) - 1;
+
+				// Pack 255 bits, little endian
+				uint64_t accumulator = 0;
+				uint8_t bits = 0;
+				uint8_t index = 0;
+				for (uint8_t i = 0; i < 10; i++)
+				{
+					accumulator |= uint64_t(t[i]) << bits;
+					bits += limbWidth(i);
+
+					for (; bits >= 8; bits -= 8, accumulator >>= 8)
+						s[index++] = accumulator;
+				}
+				s[index] = accumulator;
+			}
+
+			bool
+			isZero(const FieldElement &f)
+			{
+				uint8_t s[32];
+				toBytes(s, f);
+
+				uint8_t result = 0;
+				for (uint8_t i = 0; i < 32; i++)
+					result |= s[i];
+				return result == 0;
+			}
+
+			bool
+			isNegative(const FieldElement &f)
+			{
+				uint8_t s[32];
+				toBytes(s, f);
+				return s[0] & 1;
+			}
+
+			/**
+			 * Raise z to 2^250 - 1 and return z^11 as well, the common part of inversion and square roots.
+			 */
+			void
+			power2250(FieldElement &h, FieldElement &z11, const FieldElement &z)
+			{
+				FieldElement z2, z9, t, z2_5, z2_10, z2_20, z2_50, z2_100;
+
+				square(z2, z);
+				square(t, z2, 2);
+				multiply(z9, t, z);
+				multiply(z11, z9, z2);
+				square(t, z11);
+				multiply(z2_5, t, z9);          // z^(2^5 - 1)
+				square(t, z2_5, 5);
+				multiply(z2_10, t, z2_5);       // z^(2^10 - 1)
+				square(t, z2_10, 10);
+				multiply(z2_20, t, z2_10);      // z^(2^20 - 1)
+				square(t, z2_20, 20);
+				multiply(t, t, z2_20);          // z^(2^40 - 1)
+				square(t, t, 10);
+				multiply(z2_50, t, z2_10);      // z^(2^50 - 1)
+				square(t, z2_50, 50);
+				multiply(z2_100, t, z2_50);     // z^(2^100 - 1)
+				square(t, z2_100, 100);
+				multiply(t, t, z2_100);         // z^(2^200 - 1)
+				square(t, t, 50);
+				multiply(h, t, z2_50);          // z^(2^250 - 1)
+			}
+
+			void
+			invert(FieldElement &h, const FieldElement &z)
+			{
+				FieldElement t, z11;
+
+				// z^(p - 2) = z^(2^255 - 21)
+				power2250(t, z11, z);
+				square(t, t, 5);
+				multiply(h, t, z11);
+			}
+
+			void
+			power22523(FieldElement &h, const FieldElement &z)
+			{
+				FieldElement t, z11;
+
+				// z^((p - 5) / 8) = z^(2^252 - 3)
+				power2250(t, z11, z);
+				square(t, t, 2);
+				multiply(h, t, z);
+			}
+
+			void
+			pointAdd(Point &r, const Point &p, const Point &q)
+			{
+				FieldElement a, b, c, d, e, f, g, h;
+
+				subtract(a, p.y, p.x);
+				subtract(e, q.y, q.x);
+				multiply(a, a, e);
+				add(b, p.y, p.x);
+				add(e, q.y, q.x);
+				multiply(b, b, e);
+				multiply(c, p.t, q.t);
+				multiply(c, c, d2);
+				multiply(d, p.z, q.z);
+				add(d, d, d);
+
+				subtract(e, b, a);
+				subtract(f, d, c);
+				add(g, d, c);
+				add(h, b, a);
+
+				multiply(r.x, e, f);
+				multiply(r.y, g, h);
+				multiply(r.t, e, h);
+				multiply(r.z, f, g);
+			}
+
+			void
+			pointDouble(Point &r, const Point &p)
+			{
+				FieldElement a, b, c, e, f, g, h;
+
+				square(a, p.x);
+				square(b, p.y);
+				square(c, p.z);
+				add(c, c, c);
+				add(e, p.x, p.y);
+				square(e, e);
+				subtract(e, e, a);
+				subtract(e, e, b);
+				subtract(g, b, a);
+				subtract(f, g, c);
+				subtract(h, zero, a);
+				subtract(h, h, b);
+
+				multiply(r.x, e, f);
+				multiply(r.y, g, h);
+				multiply(r.t, e, h);
+				multiply(r.z, f, g);
+			}
+
+			bool
+			decompress(Point &p, const uint8_t *s)
+			{
+				FieldElement u, v, v3, check;
+				uint8_t sign = s[31] >> 7;
+
+				fromBytes(p.y, s);
+
+				// Reject non-canonical encodings of y
+				uint8_t canonical[32];
+				toBytes(canonical, p.y);
+				for (uint8_t i = 0; i < 32; i++)
+					if (canonical[i] != (i == 31 ? s[i] & 0x7f : s[i]))
+						return false;
+
+				// x^2 = u / v = (y^2 - 1) / (d * y^2 + 1)
+				square(u, p.y);
+				multiply(v, u, d);
+				subtract(u, u, one);
+				add(v, v, one);
+
+				// x = u * v^3 * (u * v^7)^((p - 5) / 8)
+				square(v3, v);
+				multiply(v3, v3, v);
+				square(p.x, v3);
+				multiply(p.x, p.x, v);
+				multiply(p.x, p.x, u);
+				power22523(p.x, p.x);
+				multiply(p.x, p.x, v3);
+				multiply(p.x, p.x, u);
+
+				// Either v * x^2 = u, v * x^2 = -u (x needs a factor of sqrt(-1)), or there is no square root
+				square(check, p.x);
+				multiply(check, check, v);
+				subtract(v, check, u);
+				if (!isZero(v))
+				{
+					add(v, check, u);
+					if (!isZero(v))
+						return false;
+
+					multiply(p.x, p.x, sqrtMinusOne);
+				}
+
+				if (sign && isZero(p.x))
+					return false;
+
+				if (isNegative(p.x) != sign)
+					subtract(p.x, zero, p.x);
+
+				p.z = one;
+				multiply(p.t, p.x, p.y);
+				return true;
+			}
+
+			void
+			compress(uint8_t *s, const Point &p)
+			{
+				FieldElement inverse, x, y;
+
+				invert(inverse, p.z);
+				multiply(x, p.x, inverse);
+				multiply(y, p.y, inverse);
+
+				toBytes(s, y);
+				s[31] ^= isNegative(x) << 7;
+			}
+
+			bool
+			isCanonicalScalar(const uint8_t *s)
+			{
+				for (int8_t i = 31; i >= 0; i--)
+				{
+					if (s[i] < order[i])
+						return true;
+					if (s[i] > order[i])
+						return false;
+				}
+
+				return false;
+			}
+
+			/**
+			 * Reduce a 512 bit little endian number modulo the group order.
+			 */
+			void
+			reduceScalar(uint8_t *r, const uint8_t *s)
+			{
+				int64_t x[64];
+				for (uint8_t i = 0; i < 64; i++)
+					x[i] = s[i];
+
+				// Fold the top 32 bytes down using 2^256 = -16 * (L - 2^252) modulo L
+				for (uint8_t i = 63; i >= 32; i--)
+				{
+					int64_t carry = 0;
+					uint8_t j;
+					for (j = i - 32; j < i - 12; j++)
+					{
+						x[j] += carry - 16 * x[i] * order[j - (i - 32)];
+						carry = (x[j] + 128) >> 8;
+						x[j] -= carry * 256;
+					}
+					x[j] += carry;
+					x[i] = 0;
+				}
+
+				int64_t carry = 0;
+				for (uint8_t j = 0; j < 32; j++)
+				{
+					x[j] += carry - (x[31] >> 4) * order[j];
+					carry = x[j] >> 8;
+					x[j] &= 255;
+				}
+
+				for (uint8_t j = 0; j < 32; j++)
+					x[j] -= carry * order[j];
+
+				for (uint8_t i = 0; i < 32; i++)
+				{
+					x[i + 1] += x[i] >> 8;
+					r[i] = x[i] & 255;
+				}
+			}
+		}
+
+		bool
+		Ed25519::verify(const uint8_t *signature, const uint8_t *publicKey, const uint8_t *message, std::size_t length)
+		{
+			const uint8_t *s = signature + 32;
+
+			if (!isCanonicalScalar(s))
+				return false;
+
+			Point a;
+			if (!decompress(a, publicKey))
+				return false;
+
+			// Use -A, so R' = [s]B + [h](-A) must equal R
+			subtract(a.x, zero, a.x);
+			subtract(a.t, zero, a.t);
+
+			// h = SHA-512(R || A || M) mod L
+			uint8_t digest[OSSHS_SHA512_DIGEST_SIZE];
+			Sha512 sha;
+			sha.reset();
+			sha.update(signature, 32);
+			sha.update(publicKey, OSSHS_ED25519_PUBLIC_KEY_SIZE);
+			sha.update(message, length);
+			sha.finish(digest);
+
+			uint8_t h[32];
+			reduceScalar(h, digest);
+
+			// Joint double-and-add over the bits of s and h
+			Point sum;
+			pointAdd(sum, basePoint, a);
+
+			Point r = {zero, one, one, zero};
+			for (int16_t i = 252; i >= 0; i--)
+			{
+				pointDouble(r, r);
+
+				bool sBit = (s[i / 8] >> (i % 8)) & 1;
+				bool hBit = (h[i / 8] >> (i % 8)) & 1;
+
+				if (sBit && hBit)
+					pointAdd(r, r, sum);
+				else if (sBit)
+					pointAdd(r, r, basePoint);
+				else if (hBit)
+					pointAdd(r, r, a);
+			}
+
+			uint8_t encoded[32];
+			compress(encoded, r);
+
+			uint8_t difference = 0;
+			for (uint8_t i = 0; i < 32; i++)
+				difference |= encoded[i] ^ signature[i];
+			return difference == 0;
+		}
+	}
+}
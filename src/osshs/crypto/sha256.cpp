@@ -0,0 +1,200 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <osshs/crypto/sha256.hpp>
+#include <cstring>
+
+namespace osshs
+{
+	namespace crypto
+	{
+		static const uint32_t roundConstants[64] = {
+			0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+			0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+			0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+			0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+			0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+			0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+			0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+			0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+		};
+
+		static inline uint32_t
+		rotateRight(uint32_t value, uint8_t count)
+		{
+			return (value >> count) | (value << (32 - count));
+		}
+
+		static inline uint32_t
+		loadBigEndian(const uint8_t *data)
+		{
+			// Compiles to an unaligned LDR followed by REV on the Cortex-M3
+			uint32_t value;
+			std::memcpy(&value, data, sizeof(value));
+			return __builtin_bswap32(value);
+		}
+
+		void
+		Sha256::reset()
+		{
+			state[0] = 0x6a09e667;
+			state[1] = 0xbb67ae85;
+			state[2] = 0x3c6ef372;
+			state[3] = 0xa54ff53a;
+			state[4] = 0x510e527f;
+			state[5] = 0x9b05688c;
+			state[6] = 0x1f83d9ab;
+			state[7] = 0x5be0cd19;
+			length = 0;
+		}
+
+		void
+		Sha256::update(const uint8_t *data, std::size_t length)
+		{
+			if (!length)
+				return;
+
+			std::size_t used = this->length % OSSHS_SHA256_BLOCK_SIZE;
+			this->length += length;
+
+			// Complete a partially filled block first
+			if (used)
+			{
+				std::size_t count = OSSHS_SHA256_BLOCK_SIZE - used;
+				if (count > length)
+					count = length;
+
+				std::memcpy(buffer + used, data, count);
+				data += count;
+				length -= count;
+
+				if (used + count < OSSHS_SHA256_BLOCK_SIZE)
+					return;
+
+				compress(buffer);
+			}
+
+			// Hash whole blocks straight from the input
+			for (; length >= OSSHS_SHA256_BLOCK_SIZE; data += OSSHS_SHA256_BLOCK_SIZE, length -= OSSHS_SHA256_BLOCK_SIZE)
+				compress(data);
+
+			std::memcpy(buffer, data, length);
+		}
+
+		void
+		Sha256::finish(uint8_t *digest)
+		{
+			uint64_t bits = length * 8;
+			std::size_t used = length % OSSHS_SHA256_BLOCK_SIZE;
+
+			// Pad with a single 1 bit, zeros and the 64 bit message length
+			buffer[used++] = 0x80;
+			if (used > OSSHS_SHA256_BLOCK_SIZE - 8)
+			{
+				std::memset(buffer + used, 0, OSSHS_SHA256_BLOCK_SIZE - used);
+				compress(buffer);
+				used = 0;
+			}
+
+			std::memset(buffer + used, 0, OSSHS_SHA256_BLOCK_SIZE - 8 - used);
+			for (uint8_t i = 0; i < 8; i++)
+				buffer[OSSHS_SHA256_BLOCK_SIZE - 1 - i] = bits >> (8 * i);
+			compress(buffer);
+
+			for (uint8_t i = 0; i < OSSHS_SHA256_DIGEST_SIZE; i++)
+				digest[i] = state[i / 4] >> (24 - 8 * (i % 4));
+		}
+
+		// One round. Instead of shifting the working variables after every round, the roles of the
+		// variables rotate through eight consecutive rounds, so they stay in registers without moves.
+#define OSSHS_SHA256_ROUND(a, b, c, d, e, f, g, h, i) \
+		do \
+		{ \
+			uint32_t t1 = h + (rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25)) + \
+				(g ^ (e & (f ^ g))) + roundConstants[i] + w[(i) & 15]; \
+			d += t1; \
+			h = t1 + (rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22)) + ((a & b) | (c & (a | b))); \
+		} \
+		while (0)
+
+		// Extend the rolling message schedule by one word.
+#define OSSHS_SHA256_SCHEDULE(i) \
+		do \
+		{ \
+			uint32_t w15 = w[((i) - 15) & 15]; \
+			uint32_t w2 = w[((i) - 2) & 15]; \
+			w[(i) & 15] += (rotateRight(w15, 7) ^ rotateRight(w15, 18) ^ (w15 >> 3)) + w[((i) - 7) & 15] + \
+				(rotateRight(w2, 17) ^ rotateRight(w2, 19) ^ (w2 >> 10)); \
+		} \
+		while (0)
+
+		void
+		Sha256::compress(const uint8_t *block)
+		{
+			// The message schedule is kept as a rolling window of 16 words to save stack
+			uint32_t w[16];
+			uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+			uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+			for (uint8_t i = 0; i < 16; i++)
+				w[i] = loadBigEndian(block + 4 * i);
+
+			for (uint8_t i = 0; i < 64; i += 8)
+			{
+				if (i >= 16)
+				{
+					OSSHS_SHA256_SCHEDULE(i + 0);
+					OSSHS_SHA256_SCHEDULE(i + 1);
+					OSSHS_SHA256_SCHEDULE(i + 2);
+					OSSHS_SHA256_SCHEDULE(i + 3);
+					OSSHS_SHA256_SCHEDULE(i + 4);
+					OSSHS_SHA256_SCHEDULE(i + 5);
+					OSSHS_SHA256_SCHEDULE(i + 6);
+					OSSHS_SHA256_SCHEDULE(i + 7);
+				}
+
+				OSSHS_SHA256_ROUND(a, b, c, d, e, f, g, h, i + 0);
+				OSSHS_SHA256_ROUND(h, a, b, c, d, e, f, g, i + 1);
+				OSSHS_SHA256_ROUND(g, h, a, b, c, d, e, f, i + 2);
+				OSSHS_SHA256_ROUND(f, g, h, a, b, c, d, e, i + 3);
+				OSSHS_SHA256_ROUND(e, f, g, h, a, b, c, d, i + 4);
+				OSSHS_SHA256_ROUND(d, e, f, g, h, a, b, c, i + 5);
+				OSSHS_SHA256_ROUND(c, d, e, f, g, h, a, b, i + 6);
+				OSSHS_SHA256_ROUND(b, c, d, e, f, g, h, a, i + 7);
+			}
+
+			state[0] += a;
+			state[1] += b;
+			state[2] += c;
+			state[3] += d;
+			state[4] += e;
+			state[5] += f;
+			state[6] += g;
+			state[7] += h;
+		}
+
+#undef OSSHS_SHA256_ROUND
+#undef OSSHS_SHA256_SCHEDULE
+	}
+}
@@ -0,0 +1,188 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <osshs/crypto/sha512.hpp>
+#include <cstring>
+
+namespace osshs
+{
+	namespace crypto
+	{
+		static const uint64_t roundConstants[80] = {
+			0x428a2f98d728ae22, 0x7137449123ef65cd, 0xb5c0fbcfec4d3b2f, 0xe9b5dba58189dbbc,
+			0x3956c25bf348b538, 0x59f111f1b605d019, 0x923f82a4af194f9b, 0xab1c5ed5da6d8118,
+			0xd807aa98a3030242, 0x12835b0145706fbe, 0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2,
+			0x72be5d74f27b896f, 0x80deb1fe3b1696b1, 0x9bdc06a725c71235, 0xc19bf174cf692694,
+			0xe49b69c19ef14ad2, 0xefbe4786384f25e3, 0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65,
+			0x2de92c6f592b0275, 0x4a7484aa6ea6e483, 0x5cb0a9dcbd41fbd4, 0x76f988da831153b5,
+			0x983e5152ee66dfab, 0xa831c66d2db43210, 0xb00327c898fb213f, 0xbf597fc7beef0ee4,
+			0xc6e00bf33da88fc2, 0xd5a79147930aa725, 0x06ca6351e003826f, 0x142929670a0e6e70,
+			0x27b70a8546d22ffc, 0x2e1b21385c26c926, 0x4d2c6dfc5ac42aed, 0x53380d139d95b3df,
+			0x650a73548baf63de, 0x766a0abb3c77b2a8, 0x81c2c92e47edaee6, 0x92722c851482353b,
+			0xa2bfe8a14cf10364, 0xa81a664bbc423001, 0xc24b8b70d0f89791, 0xc76c51a30654be30,
+			0xd192e819d6ef5218, 0xd69906245565a910, 0xf40e35855771202a, 0x106aa07032bbd1b8,
+			0x19a4c116b8d2d0c8, 0x1e376c085141ab53, 0x2748774cdf8eeb99, 0x34b0bcb5e19b48a8,
+			0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb, 0x5b9cca4f7763e373, 0x682e6ff3d6b2b8a3,
+			0x748f82ee5defb2fc, 0x78a5636f43172f60, 0x84c87814a1f0ab72, 0x8cc702081a6439ec,
+			0x90befffa23631e28, 0xa4506cebde82bde9, 0xbef9a3f7b2c67915, 0xc67178f2e372532b,
+			0xca273eceea26619c, 0xd186b8c721c0c207, 0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178,
+			0x06f067aa72176fba, 0x0a637dc5a2c898a6, 0x113f9804bef90dae, 0x1b710b35131c471b,
+			0x28db77f523047d84, 0x32caab7b40c72493, 0x3c9ebe0a15c9bebc, 0x431d67c49c100d4c,
+			0x4cc5d4becb3e42b6, 0x597f299cfc657e2a, 0x5fcb6fab3ad6faec, 0x6c44198c4a475817
+		};
+
+		static inline uint64_t
+		rotateRight(uint64_t value, uint8_t count)
+		{
+			return (value >> count) | (value << (64 - count));
+		}
+
+		static inline uint64_t
+		loadBigEndian(const uint8_t *data)
+		{
+			uint64_t value = 0;
+			for (uint8_t i = 0; i < 8; i++)
+				value = (value << 8) | data[i];
+			return value;
+		}
+
+		void
+		Sha512::reset()
+		{
+			state[0] = 0x6a09e667f3bcc908;
+			state[1] = 0xbb67ae8584caa73b;
+			state[2] = 0x3c6ef372fe94f82b;
+			state[3] = 0xa54ff53a5f1d36f1;
+			state[4] = 0x510e527fade682d1;
+			state[5] = 0x9b05688c2b3e6c1f;
+			state[6] = 0x1f83d9abfb41bd6b;
+			state[7] = 0x5be0cd19137e2179;
+			length = 0;
+		}
+
+		void
+		Sha512::update(const uint8_t *data, std::size_t length)
+		{
+			if (!length)
+				return;
+
+			std::size_t used = this->length % OSSHS_SHA512_BLOCK_SIZE;
+			this->length += length;
+
+			// Complete a partially filled block first
+			if (used)
+			{
+				std::size_t count = OSSHS_SHA512_BLOCK_SIZE - used;
+				if (count > length)
+					count = length;
+
+				std::memcpy(buffer + used, data, count);
+				data += count;
+				length -= count;
+
+				if (used + count < OSSHS_SHA512_BLOCK_SIZE)
+					return;
+
+				compress(buffer);
+			}
+
+			// Hash whole blocks straight from the input
+			for (; length >= OSSHS_SHA512_BLOCK_SIZE; data += OSSHS_SHA512_BLOCK_SIZE, length -= OSSHS_SHA512_BLOCK_SIZE)
+				compress(data);
+
+			std::memcpy(buffer, data, length);
+		}
+
+		void
+		Sha512::finish(uint8_t *digest)
+		{
+			uint64_t bits = length * 8;
+			std::size_t used = length % OSSHS_SHA512_BLOCK_SIZE;
+
+			// Pad with a single 1 bit, zeros and the 128 bit message length
+			buffer[used++] = 0x80;
+			if (used > OSSHS_SHA512_BLOCK_SIZE - 16)
+			{
+				std::memset(buffer + used, 0, OSSHS_SHA512_BLOCK_SIZE - used);
+				compress(buffer);
+				used = 0;
+			}
+
+			std::memset(buffer + used, 0, OSSHS_SHA512_BLOCK_SIZE - 8 - used);
+			for (uint8_t i = 0; i < 8; i++)
+				buffer[OSSHS_SHA512_BLOCK_SIZE - 1 - i] = bits >> (8 * i);
+			compress(buffer);
+
+			for (uint8_t i = 0; i < OSSHS_SHA512_DIGEST_SIZE; i++)
+				digest[i] = state[i / 8] >> (56 - 8 * (i % 8));
+		}
+
+		void
+		Sha512::compress(const uint8_t *block)
+		{
+			// The message schedule is kept as a rolling window of 16 words to save stack
+			uint64_t w[16];
+			uint64_t a = state[0], b = state[1], c = state[2], d = state[3];
+			uint64_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+			for (uint8_t i = 0; i < 80; i++)
+			{
+				if (i < 16)
+				{
+					w[i] = loadBigEndian(block + 8 * i);
+				}
+				else
+				{
+					uint64_t w15 = w[(i - 15) & 15];
+					uint64_t w2 = w[(i - 2) & 15];
+					w[i & 15] += (rotateRight(w15, 1) ^ rotateRight(w15, 8) ^ (w15 >> 7)) + w[(i - 7) & 15] +
+						(rotateRight(w2, 19) ^ rotateRight(w2, 61) ^ (w2 >> 6));
+				}
+
+				uint64_t t1 = h + (rotateRight(e, 14) ^ rotateRight(e, 18) ^ rotateRight(e, 41)) +
+					((e & f) ^ (~e & g)) + roundConstants[i] + w[i & 15];
+				uint64_t t2 = (rotateRight(a, 28) ^ rotateRight(a, 34) ^ rotateRight(a, 39)) +
+					((a & b) ^ (a & c) ^ (b & c));
+
+				h = g;
+				g = f;
+				f = e;
+				e = d + t1;
+				d = c;
+				c = b;
+				b = a;
+				a = t1 + t2;
+			}
+
+			state[0] += a;
+			state[1] += b;
+			state[2] += c;
+			state[3] += d;
+			state[4] += e;
+			state[5] += f;
+			state[6] += g;
+			state[7] += h;
+		}
+	}
+}
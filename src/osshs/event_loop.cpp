@@ -0,0 +1,134 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <osshs/log/logger.hpp>
+#include <osshs/cycle_counter.hpp>
+#include <osshs/event_loop.hpp>
+#include <modm/platform.hpp>
+
+namespace osshs
+{
+	std::atomic<uint32_t> EventLoop::pending{0};
+	uint32_t EventLoop::delayed = 0;
+	uint32_t EventLoop::deadlines[OSSHS_EVENT_LOOP_MAX_TASKS];
+	EventLoop::Task EventLoop::tasks[OSSHS_EVENT_LOOP_MAX_TASKS];
+	uint8_t EventLoop::taskCount = 0;
+
+	uint8_t
+	EventLoop::addTask(const char *name, EventHandler handler)
+	{
+		if (taskCount >= OSSHS_EVENT_LOOP_MAX_TASKS)
+		{
+			OSSHS_LOG_ERROR("Adding task failed. Too many tasks(name = `%s`).", name);
+			return OSSHS_EVENT_LOOP_INVALID_TASK;
+		}
+
+		tasks[taskCount] = {name, handler, {0, 0}};
+
+		OSSHS_LOG_DEBUG("Adding task succeeded(name = `%s`, task = `%u`).", name, taskCount);
+		return taskCount++;
+	}
+
+	void
+	EventLoop::postAfter(uint8_t task, uint32_t cycles)
+	{
+		deadlines[task] = CycleCounter::now() + cycles;
+		delayed |= 1ul << task;
+	}
+
+	bool
+	EventLoop::poll()
+	{
+		if (delayed)
+			releaseDelayed();
+
+		// Take all pending tasks at once, tasks posted from now on run in the next pass
+		uint32_t mask = pending.exchange(0, std::memory_order_acquire);
+		if (!mask)
+			return false;
+
+		for (uint8_t i = 0; i < taskCount && mask; i++, mask >>= 1)
+		{
+			if (!(mask & 1))
+				continue;
+
+			Task &task = tasks[i];
+			uint32_t start = CycleCounter::now();
+
+			task.handler();
+
+			uint32_t cycles = CycleCounter::now() - start;
+			task.statistics.runs++;
+			if (cycles > task.statistics.maxCycles)
+				task.statistics.maxCycles = cycles;
+		}
+
+		return true;
+	}
+
+	void
+	EventLoop::run()
+	{
+		OSSHS_LOG_INFO("Running event loop(tasks = `%u`).", taskCount);
+
+		while (true)
+			if (!poll())
+				sleep();
+	}
+
+	const EventTaskStatistics &
+	EventLoop::getStatistics(uint8_t task)
+	{
+		return tasks[task].statistics;
+	}
+
+	void
+	EventLoop::releaseDelayed()
+	{
+		uint32_t now = CycleCounter::now();
+
+		for (uint8_t i = 0; i < taskCount; i++)
+			if ((delayed & 1ul << i) && static_cast<int32_t>(now - deadlines[i]) >= 0)
+			{
+				delayed &= ~(1ul << i);
+				post(i);
+			}
+	}
+
+	void
+	EventLoop::sleep()
+	{
+		// With interrupts masked, a post between the check and WFI still wakes the core, it is just handled
+		// after interrupts are enabled again
+		__disable_irq();
+
+		if (!pending.load(std::memory_order_relaxed))
+		{
+			__DSB();
+			__WFI();
+		}
+
+		__enable_irq();
+	}
+}
@@ -0,0 +1,276 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <osshs/log/logger.hpp>
+#include <osshs/cycle_counter.hpp>
+#include <osshs/flash.hpp>
+#include <osshs/image_writer.hpp>
+#include <cstring>
+
+namespace osshs
+{
+	std::unique_ptr<uint8_t[]> ImageWriter::page;
+	crypto::Sha256 ImageWriter::digest;
+	crypto::Sha256 ImageWriter::readBackDigest;
+	ImageWriterMode ImageWriter::mode;
+
+	uint32_t ImageWriter::origin;
+	uint32_t ImageWriter::length;
+	uint32_t ImageWriter::written;
+	uint32_t ImageWriter::hashCycles;
+	uint32_t ImageWriter::flashCycles;
+
+	bool
+	ImageWriter::begin(uint32_t address, uint32_t length, ImageWriterMode mode)
+	{
+		if (!Flash::MemoryMap::isPageOrigin(address))
+		{
+			OSSHS_LOG_ERROR("Beginning image failed. Address not a page origin in flash(address = `0x%08x`).", address);
+			return false;
+		}
+
+		if (!page)
+			page = std::make_unique<uint8_t[]>(Flash::pageSize);
+
+		origin = address;
+		ImageWriter::length = length;
+		ImageWriter::mode = mode;
+		written = 0;
+		hashCycles = 0;
+		flashCycles = 0;
+
+		digest.reset();
+		readBackDigest.reset();
+
+		OSSHS_LOG_INFO("Beginning image succeeded(address = `0x%08x`, length = `0x%08x`, mode = `%d`).",
+			address, length, static_cast<uint8_t>(mode));
+		return true;
+	}
+
+	bool
+	ImageWriter::write(const uint8_t *data, std::size_t length)
+	{
+		if (!page)
+		{
+			OSSHS_LOG_ERROR("Writing image failed. No image begun.");
+			return false;
+		}
+
+		if (length > ImageWriter::length - written)
+		{
+			OSSHS_LOG_ERROR("Writing image failed. Image too long(written = `0x%08x`, length = `0x%08x`).", written, length);
+			return false;
+		}
+
+		// Hash the chunk while it is still hot, before it is committed
+		uint32_t cycles = CycleCounter::now();
+		digest.update(data, length);
+		hashCycles += CycleCounter::now() - cycles;
+
+		while (length)
+		{
+			uint32_t used = written % Flash::pageSize;
+			uint32_t count = Flash::pageSize - used;
+			if (count > length)
+				count = length;
+
+			std::memcpy(page.get() + used, data, count);
+			data += count;
+			length -= count;
+			written += count;
+
+			if (!(written % Flash::pageSize) && !commitPage())
+				return false;
+		}
+
+		return true;
+	}
+
+	bool
+	ImageWriter::skip(uint32_t length)
+	{
+		if (!page)
+		{
+			OSSHS_LOG_ERROR("Skipping image gap failed. No image begun.");
+			return false;
+		}
+
+		if (length > ImageWriter::length - written)
+		{
+			OSSHS_LOG_ERROR("Skipping image gap failed. Image too long(written = `0x%08x`, length = `0x%08x`).", written, length);
+			return false;
+		}
+
+		while (length)
+		{
+			uint32_t used = written % Flash::pageSize;
+			if (!used && length >= Flash::pageSize)
+			{
+				if (!skipPage())
+					return false;
+
+				length -= Flash::pageSize;
+				continue;
+			}
+
+			// The gap ends or starts within a page that also holds data
+			uint32_t count = Flash::pageSize - used;
+			if (count > length)
+				count = length;
+
+			std::memset(page.get() + used, 0xff, count);
+
+			uint32_t cycles = CycleCounter::now();
+			digest.update(page.get() + used, count);
+			hashCycles += CycleCounter::now() - cycles;
+
+			length -= count;
+			written += count;
+
+			if (!(written % Flash::pageSize) && !commitPage())
+				return false;
+		}
+
+		return true;
+	}
+
+	bool
+	ImageWriter::finish(uint8_t *digest)
+	{
+		if (!page)
+		{
+			OSSHS_LOG_ERROR("Finishing image failed. No image begun.");
+			return false;
+		}
+
+		// Fill and commit the last partial page
+		uint32_t used = written % Flash::pageSize;
+		if (used)
+		{
+			std::memset(page.get() + used, 0xff, Flash::pageSize - used);
+			if (!commitPage())
+				return false;
+		}
+
+		uint32_t cycles = CycleCounter::now();
+		ImageWriter::digest.finish(digest);
+		hashCycles += CycleCounter::now() - cycles;
+
+		if (mode == ImageWriterMode::READ_BACK)
+		{
+			uint8_t readBack[OSSHS_SHA256_DIGEST_SIZE];
+			readBackDigest.finish(readBack);
+
+			if (std::memcmp(digest, readBack, OSSHS_SHA256_DIGEST_SIZE))
+			{
+				page.reset();
+
+				OSSHS_LOG_ERROR("Finishing image failed. Flash does not match the digest(address = `0x%08x`, written = `0x%08x`).",
+					origin, written);
+				return false;
+			}
+		}
+
+		page.reset();
+
+		OSSHS_LOG_INFO("Finishing image succeeded(address = `0x%08x`, written = `0x%08x`, hashCycles = `%lu`, flashCycles = `%lu`).",
+			origin, written, hashCycles, flashCycles);
+		OSSHS_LOG_INFO("Hashing image took `%lu.%02lu` cycles per byte.",
+			written ? hashCycles / written : 0, written ? (hashCycles % written) * 100 / written : 0);
+		return true;
+	}
+
+	void
+	ImageWriter::abort()
+	{
+		page.reset();
+
+		OSSHS_LOG_WARNING("Aborting image(address = `0x%08x`, written = `0x%08x`).", origin, written);
+	}
+
+	uint32_t
+	ImageWriter::getWritten()
+	{
+		return written;
+	}
+
+	bool
+	ImageWriter::commitPage()
+	{
+		// The page being committed is the one the last written byte belongs to
+		uint32_t offset = (written - 1) / Flash::pageSize * Flash::pageSize;
+
+		uint32_t cycles = CycleCounter::now();
+		bool succeeded = Flash::writePage(origin + offset, page);
+		flashCycles += CycleCounter::now() - cycles;
+
+		if (!succeeded)
+		{
+			page.reset();
+
+			OSSHS_LOG_ERROR("Committing image page failed(address = `0x%08x`).", origin + offset);
+			return false;
+		}
+
+		if (mode == ImageWriterMode::READ_BACK)
+		{
+			// Hash what actually landed in flash, excluding the padding of the last page
+			cycles = CycleCounter::now();
+			readBackDigest.update(reinterpret_cast<const uint8_t *>(origin + offset), written - offset);
+			hashCycles += CycleCounter::now() - cycles;
+		}
+
+		return true;
+	}
+
+	bool
+	ImageWriter::skipPage()
+	{
+		uint32_t address = origin + written;
+
+		uint32_t cycles = CycleCounter::now();
+		bool succeeded = Flash::isPageErased(address) || Flash::erasePage(address);
+		flashCycles += CycleCounter::now() - cycles;
+
+		if (!succeeded)
+		{
+			page.reset();
+
+			OSSHS_LOG_ERROR("Skipping image page failed(address = `0x%08x`).", address);
+			return false;
+		}
+
+		// The buffer is free between pages and serves as a source of 0xff for the digests
+		std::memset(page.get(), 0xff, Flash::pageSize);
+
+		cycles = CycleCounter::now();
+		digest.update(page.get(), Flash::pageSize);
+		if (mode == ImageWriterMode::READ_BACK)
+			readBackDigest.update(reinterpret_cast<const uint8_t *>(address), Flash::pageSize);
+		hashCycles += CycleCounter::now() - cycles;
+
+		written += Flash::pageSize;
+		return true;
+	}
+}
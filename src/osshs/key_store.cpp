@@ -0,0 +1,73 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <osshs/log/logger.hpp>
+#include <osshs/flash.hpp>
+#include <osshs/key_store.hpp>
+#include <modm/platform.hpp>
+
+namespace osshs
+{
+	bool KeyStore::valid = false;
+
+	void
+	KeyStore::initialize()
+	{
+		const uint16_t *header = reinterpret_cast<const uint16_t *>(TargetMemoryMap::keyOrigin);
+		uint32_t crc = *reinterpret_cast<const uint32_t *>(TargetMemoryMap::keyOrigin + OSSHS_KEY_STORE_CRC_OFFSET);
+
+		// Flash turns the CRC peripheral off when a session ends
+		RCC->AHBENR |= RCC_AHBENR_CRCEN;
+		Flash::resetCRC();
+		Flash::updateCRC(TargetMemoryMap::keyOrigin, OSSHS_KEY_STORE_CRC_OFFSET);
+
+		valid = header[0] == OSSHS_KEY_STORE_MAGIC && header[1] == OSSHS_KEY_STORE_VERSION && Flash::getCRC() == crc;
+		if (!valid)
+		{
+			OSSHS_LOG_WARNING("Initializing key store failed. No key provisioned(address = `0x%08x`).",
+				TargetMemoryMap::keyOrigin);
+			return;
+		}
+
+#if OSSHS_KEY_STORE_PROTECT
+		// Takes effect at the next reset, until then OBR still reports the device as unprotected
+		if (!Flash::isReadProtected() && Flash::initialize())
+		{
+			Flash::enableReadProtection();
+			Flash::deinitialize();
+			Flash::lock();
+		}
+#endif
+
+		OSSHS_LOG_INFO("Initializing key store succeeded(address = `0x%08x`, readProtected = `%d`).",
+			TargetMemoryMap::keyOrigin, Flash::isReadProtected());
+	}
+
+	const uint8_t *
+	KeyStore::getKey()
+	{
+		return valid ? reinterpret_cast<const uint8_t *>(TargetMemoryMap::keyOrigin + OSSHS_KEY_STORE_KEY_OFFSET) : nullptr;
+	}
+}
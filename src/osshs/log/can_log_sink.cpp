@@ -0,0 +1,190 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <osshs/log/can_log_sink.hpp>
+#include <osshs/can_bus.hpp>
+#include <osshs/event_loop.hpp>
+#include <modm/platform.hpp>
+
+namespace osshs
+{
+	namespace log
+	{
+		SpscQueue<uint8_t, OSSHS_CAN_LOG_BUFFER_SIZE> CanLogSink::buffer;
+		TokenBucket CanLogSink::bucket;
+		uint8_t CanLogSink::frame[8];
+		uint8_t CanLogSink::frameLength = 0;
+		uint8_t CanLogSink::remaining = 0;
+		uint8_t CanLogSink::sequence = 0;
+		uint8_t CanLogSink::task = OSSHS_EVENT_LOOP_INVALID_TASK;
+		uint32_t CanLogSink::dropped = 0;
+		uint32_t CanLogSink::reported = 0;
+
+		void
+		CanLogSink::initialize(uint8_t task)
+		{
+			CanLogSink::task = task;
+			bucket.configure(OSSHS_CAN_LOG_RATE, OSSHS_CAN_LOG_BURST);
+
+			// Records of the boot are already waiting
+			EventLoop::post(task);
+		}
+
+		void
+		CanLogSink::update()
+		{
+			if (!frameLength && !fill())
+				return;
+
+			if (!bucket.getDelay(1))
+			{
+				CanFrame canFrame = {static_cast<uint16_t>(OSSHS_CAN_LOG_ID(CanBus::getNodeId())), frameLength, 0, {}};
+				for (uint8_t i = 0; i < frameLength; i++)
+					canFrame.data[i] = frame[i];
+
+				if (CanBus::sendBackground(canFrame))
+				{
+					bucket.take(1);
+					frameLength = 0;
+
+					if (!remaining && buffer.isEmpty())
+						return;
+				}
+			}
+
+			// Check again once the next token is due, or after about a frame at 125 kbps while the transmitter is busy
+			uint32_t delay = bucket.getDelay(1);
+			uint32_t frameTime = modm::clock::fcpu / 1000;
+			EventLoop::postAfter(task, delay > frameTime ? delay : frameTime);
+		}
+
+		uint32_t
+		CanLogSink::getDroppedRecords()
+		{
+			return dropped;
+		}
+
+		void
+		CanLogSink::encodeInteger(uint8_t *record, std::size_t &length, uint64_t value, std::size_t size)
+		{
+			// Arguments that do not fit are left out, the collector shows them as missing
+			if (length + size > OSSHS_CAN_LOG_RECORD_SIZE)
+				return;
+
+			for (std::size_t i = 0; i < size; i++)
+				record[length++] = value >> (i * 8);
+		}
+
+		void
+		CanLogSink::encodeString(uint8_t *record, std::size_t &length, const char *string)
+		{
+			if (length >= OSSHS_CAN_LOG_RECORD_SIZE)
+				return;
+
+			std::size_t end = length + OSSHS_CAN_LOG_STRING_MAX < OSSHS_CAN_LOG_RECORD_SIZE - 1 ?
+				length + OSSHS_CAN_LOG_STRING_MAX : OSSHS_CAN_LOG_RECORD_SIZE - 1;
+			while (length < end && *string)
+				record[length++] = *string++;
+
+			record[length++] = 0;
+		}
+
+		std::size_t
+		CanLogSink::encodeHeader(uint8_t *record, Level level, const char *file, uint32_t line, const char *format)
+		{
+			std::size_t length = 0;
+
+			encodeInteger(record, length, modm::Clock::now().getTime(), 4);
+			encodeInteger(record, length, static_cast<uint32_t>(level) << 13 | (line < 0x1fff ? line : 0x1fff), 2);
+			encodeInteger(record, length, reinterpret_cast<uintptr_t>(file), 4);
+			encodeInteger(record, length, reinterpret_cast<uintptr_t>(format), 4);
+
+			return length;
+		}
+
+		void
+		CanLogSink::enqueue(const uint8_t *record, std::size_t length)
+		{
+			// Records dropped while the buffer was full are reported once there is space again
+			if (dropped != reported &&
+				OSSHS_CAN_LOG_BUFFER_SIZE - buffer.getSize() >= 1 + OSSHS_CAN_LOG_HEADER_SIZE + 4 + 1 + length)
+			{
+				uint8_t report[OSSHS_CAN_LOG_HEADER_SIZE + 4];
+				std::size_t reportLength = encodeHeader(report, Level::WARNING, nullptr, 0, nullptr);
+				encodeInteger(report, reportLength, dropped - reported, 4);
+				reported = dropped;
+
+				buffer.push(reportLength);
+				for (std::size_t i = 0; i < reportLength; i++)
+					buffer.push(report[i]);
+			}
+
+			if (dropped != reported || OSSHS_CAN_LOG_BUFFER_SIZE - buffer.getSize() < 1 + length)
+			{
+				dropped++;
+				return;
+			}
+
+			buffer.push(length);
+			for (std::size_t i = 0; i < length; i++)
+				buffer.push(record[i]);
+
+			if (task != OSSHS_EVENT_LOOP_INVALID_TASK)
+				EventLoop::post(task);
+		}
+
+		bool
+		CanLogSink::fill()
+		{
+			uint8_t data;
+
+			if (!remaining)
+			{
+				if (!buffer.pop(data))
+					return false;
+
+				remaining = data;
+				frame[0] = OSSHS_CAN_LOG_FIRST | sequence;
+				frame[1] = data;
+				frameLength = 2;
+			}
+			else
+			{
+				frame[0] = sequence;
+				frameLength = 1;
+			}
+
+			sequence = (sequence + 1) & ~OSSHS_CAN_LOG_FIRST;
+
+			while (remaining && frameLength < 8 && buffer.pop(data))
+			{
+				frame[frameLength++] = data;
+				remaining--;
+			}
+
+			return true;
+		}
+	}
+}
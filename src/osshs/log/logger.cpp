@@ -31,6 +31,14 @@
 		{
 			Level Logger::level = Level::DEBUG;
 
+			const char *const Logger::levelNames[] = {
+				"DISABLED",
+				"ERROR",
+				"WARNING",
+				"INFO",
+				"DEBUG"
+			};
+
 			void
 			Logger::setLevel(Level level)
 			{
@@ -0,0 +1,63 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <osshs/stack_monitor.hpp>
+
+// Defined by the linker script
+extern "C" uint32_t __main_stack_bottom[];
+extern "C" uint32_t __main_stack_top[];
+
+namespace osshs
+{
+	__attribute__((noinline)) void
+	StackMonitor::paint()
+	{
+		uintptr_t frame = reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+		uint32_t *top = __main_stack_top;
+
+		// Paint all of the stack when running on another one, as in the simulation
+		if (frame - reinterpret_cast<uintptr_t>(__main_stack_bottom) <= getSize())
+			top = reinterpret_cast<uint32_t *>(frame - OSSHS_STACK_MONITOR_MARGIN);
+
+		for (uint32_t *word = __main_stack_bottom; word < top; word++)
+			*word = OSSHS_STACK_MONITOR_PAINT;
+	}
+
+	uint32_t
+	StackMonitor::getHighWaterMark()
+	{
+		uint32_t *word = __main_stack_bottom;
+		while (word < __main_stack_top && *word == OSSHS_STACK_MONITOR_PAINT)
+			word++;
+
+		return (__main_stack_top - word) * sizeof(uint32_t);
+	}
+
+	uint32_t
+	StackMonitor::getSize()
+	{
+		return (__main_stack_top - __main_stack_bottom) * sizeof(uint32_t);
+	}
+}
@@ -0,0 +1,93 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <osshs/cycle_counter.hpp>
+#include <osshs/token_bucket.hpp>
+#include <modm/platform.hpp>
+
+namespace osshs
+{
+	void
+	TokenBucket::configure(uint16_t rate, uint8_t burst)
+	{
+		this->rate = rate;
+		this->burst = burst ? burst : 1;
+
+		credit = static_cast<uint64_t>(this->burst) * modm::clock::fcpu;
+		last = CycleCounter::now();
+	}
+
+	void
+	TokenBucket::setRate(uint16_t rate)
+	{
+		// Tokens earned at the old rate are kept
+		refill();
+		this->rate = rate;
+	}
+
+	bool
+	TokenBucket::take(uint8_t tokens)
+	{
+		if (!rate)
+			return true;
+
+		refill();
+
+		uint64_t cost = static_cast<uint64_t>(tokens) * modm::clock::fcpu;
+		if (credit < cost)
+			return false;
+
+		credit -= cost;
+		return true;
+	}
+
+	uint32_t
+	TokenBucket::getDelay(uint8_t tokens)
+	{
+		if (!rate)
+			return 0;
+
+		refill();
+
+		uint64_t cost = static_cast<uint64_t>(tokens) * modm::clock::fcpu;
+		if (credit >= cost)
+			return 0;
+
+		return (cost - credit + rate - 1) / rate;
+	}
+
+	void
+	TokenBucket::refill()
+	{
+		uint32_t now = CycleCounter::now();
+		uint64_t capacity = static_cast<uint64_t>(burst) * modm::clock::fcpu;
+
+		// Every elapsed cycle earns rate/fcpu tokens
+		credit += static_cast<uint64_t>(now - last) * rate;
+		if (credit > capacity)
+			credit = capacity;
+
+		last = now;
+	}
+}
@@ -0,0 +1,52 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <osshs/log/logger.hpp>
+#include <osshs/trace.hpp>
+
+namespace osshs
+{
+	void
+	Trace::initialize(uint32_t resetFlags, uint32_t frequency)
+	{
+		TraceBuffer *trace = reinterpret_cast<TraceBuffer *>(OSSHS_BOOTLOADER_TRACE_ORIGIN);
+
+		// RAM contents are random after power-up, start over unless the trace is intact
+		if (trace->magic != OSSHS_TRACE_MAGIC || trace->version != OSSHS_TRACE_VERSION ||
+			trace->capacity != OSSHS_TRACE_CAPACITY)
+		{
+			trace->magic = OSSHS_TRACE_MAGIC;
+			trace->version = OSSHS_TRACE_VERSION;
+			trace->capacity = OSSHS_TRACE_CAPACITY;
+			trace->head = 0;
+			trace->bootCount = 0;
+		}
+
+		trace->bootCount++;
+		trace->resetFlags = resetFlags;
+		trace->frequency = frequency;
+
+		OSSHS_LOG_INFO("Initializing trace succeeded(bootCount = `%lu`, head = `%lu`).", trace->bootCount, trace->head);
+	}
+}
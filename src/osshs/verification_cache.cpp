@@ -0,0 +1,90 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <osshs/log/logger.hpp>
+#include <osshs/bootloader.hpp>
+#include <osshs/verification_cache.hpp>
+#include <modm/platform.hpp>
+
+#define OSSHS_VERIFICATION_CACHE_VALID 0x2
+
+namespace osshs
+{
+	bool
+	VerificationCache::check(uint32_t crc)
+	{
+		// Always verify fully after power-up
+		if (Bootloader::getResetFlags() & RCC_CSR_PORRSTF)
+			return false;
+
+		if (!(BKP->DR1 & OSSHS_VERIFICATION_CACHE_VALID) || (BKP->DR5 & 0xffff) != (BKP->DR4 & 0xffff))
+			return false;
+
+		if (((BKP->DR2 & 0xffff) | (BKP->DR3 & 0xffff) << 16) != crc)
+			return false;
+
+		uint16_t warmBoots = BKP->DR6 & 0xffff;
+		if (warmBoots >= OSSHS_VERIFICATION_CACHE_MAX_WARM_BOOTS)
+			return false;
+
+		PWR->CR |= PWR_CR_DBP;
+		BKP->DR6 = warmBoots + 1;
+		PWR->CR &= ~PWR_CR_DBP;
+
+		OSSHS_LOG_INFO("Checking verification cache succeeded(crc = `0x%08x`, warmBoots = `%d`).", crc, warmBoots + 1);
+		return true;
+	}
+
+	void
+	VerificationCache::store(uint32_t crc)
+	{
+		PWR->CR |= PWR_CR_DBP;
+
+		BKP->DR2 = crc & 0xffff;
+		BKP->DR3 = crc >> 16;
+		BKP->DR5 = BKP->DR4 & 0xffff;
+		BKP->DR6 = 0;
+		BKP->DR1 |= OSSHS_VERIFICATION_CACHE_VALID;
+
+		PWR->CR &= ~PWR_CR_DBP;
+
+		OSSHS_LOG_INFO("Storing verification token succeeded(crc = `0x%08x`).", crc);
+	}
+
+	void
+	VerificationCache::invalidate()
+	{
+		if (!(BKP->DR1 & OSSHS_VERIFICATION_CACHE_VALID))
+			return;
+
+		PWR->CR |= PWR_CR_DBP;
+
+		BKP->DR4 = (BKP->DR4 + 1) & 0xffff;
+		BKP->DR1 &= ~OSSHS_VERIFICATION_CACHE_VALID;
+
+		PWR->CR &= ~PWR_CR_DBP;
+
+		OSSHS_LOG_INFO("Invalidating verification token succeeded.");
+	}
+}
@@ -0,0 +1,208 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2019 Linas Nikiperavicius
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <osshs/log/logger.hpp>
+#include <osshs/flash.hpp>
+#include <osshs/wear_journal.hpp>
+#include <memory>
+
+namespace osshs
+{
+	// A compacted journal holds one entry per page and the erase of its own compaction
+	static_assert(OSSHS_WEAR_JOURNAL_PAGES + 1 <= (TargetMemoryMap::configSize - 4) / 4,
+		"The wear journal cannot hold one entry per page.");
+
+	uint8_t WearJournal::pending[OSSHS_WEAR_JOURNAL_PAGES];
+	bool WearJournal::dirty = false;
+	uint32_t WearJournal::end = 0;
+
+	void
+	WearJournal::initialize()
+	{
+		const uint32_t origin = TargetMemoryMap::configOrigin;
+		const uint16_t *header = reinterpret_cast<const uint16_t *>(origin);
+
+		end = 0;
+		if (header[0] == OSSHS_WEAR_JOURNAL_MAGIC && header[1] == OSSHS_WEAR_JOURNAL_VERSION)
+		{
+			end = origin + 4;
+			while (end < origin + TargetMemoryMap::configSize && *reinterpret_cast<const uint16_t *>(end) != 0xffff)
+				end += 4;
+		}
+		else if (!Flash::isPageErased(origin))
+		{
+			OSSHS_LOG_WARNING("Initializing wear journal failed. Journal is not valid, erases are not counted.");
+			return;
+		}
+
+#ifndef DISABLE_LOGGING
+		// The most worn page is what limits the life of the device
+		uint32_t total = 0;
+		uint32_t worstPage = OSSHS_WEAR_JOURNAL_FIRST_PAGE;
+		uint32_t worstCount = 0;
+		for (uint32_t page = OSSHS_WEAR_JOURNAL_FIRST_PAGE; page < TargetMemoryMap::pageCount; page++)
+		{
+			uint32_t count = getEraseCount(page);
+			if (count)
+				OSSHS_LOG_DEBUG("Page wear(page = `%lu`, erases = `%lu`).", page, count);
+
+			total += count;
+			if (count > worstCount)
+			{
+				worstPage = page;
+				worstCount = count;
+			}
+		}
+
+		OSSHS_LOG_INFO("Initializing wear journal succeeded(entries = `%lu`, erases = `%lu`, worstPage = `%lu`, worstErases = `%lu`).",
+			end ? (end - origin - 4) / 4 : 0, total, worstPage, worstCount);
+#endif
+	}
+
+	void
+	WearJournal::record(uint32_t page)
+	{
+		if (page < OSSHS_WEAR_JOURNAL_FIRST_PAGE || page >= TargetMemoryMap::pageCount)
+			return;
+
+		// A session erases a page only a few times, counts beyond 255 are dropped
+		uint8_t &count = pending[page - OSSHS_WEAR_JOURNAL_FIRST_PAGE];
+		if (count != 0xff)
+			count++;
+
+		dirty = true;
+	}
+
+	bool
+	WearJournal::flush()
+	{
+		if (!dirty)
+			return true;
+
+		uint32_t entries = 0;
+		for (uint8_t count : pending)
+			entries += count != 0;
+
+		// A journal that is not valid is left alone rather than erased
+		if (!end && !start())
+			return false;
+
+		// Erasing the full journal counts as an erase of the configuration page, which is appended below
+		if (end + entries * 4 > TargetMemoryMap::configOrigin + TargetMemoryMap::configSize && !compact())
+			return false;
+
+		for (uint32_t i = 0; i < OSSHS_WEAR_JOURNAL_PAGES; i++)
+		{
+			if (!pending[i])
+				continue;
+
+			if (!append(OSSHS_WEAR_JOURNAL_FIRST_PAGE + i, pending[i]))
+				return false;
+
+			pending[i] = 0;
+		}
+
+		dirty = false;
+
+		OSSHS_LOG_INFO("Flushing wear journal succeeded(end = `0x%08x`).", end);
+		return true;
+	}
+
+	uint32_t
+	WearJournal::getEraseCount(uint32_t page)
+	{
+		if (page < OSSHS_WEAR_JOURNAL_FIRST_PAGE || page >= TargetMemoryMap::pageCount)
+			return 0;
+
+		uint32_t count = pending[page - OSSHS_WEAR_JOURNAL_FIRST_PAGE];
+		for (uint32_t entry = TargetMemoryMap::configOrigin + 4; entry < end; entry += 4)
+		{
+			const uint16_t *fields = reinterpret_cast<const uint16_t *>(entry);
+			if (fields[0] == page && fields[1] != 0xffff)
+				count += fields[1];
+		}
+
+		return count;
+	}
+
+	bool
+	WearJournal::start()
+	{
+		// A new device starts with an erased configuration page
+		if (!Flash::isPageErased(TargetMemoryMap::configOrigin))
+		{
+			OSSHS_LOG_ERROR("Starting wear journal failed. Configuration page is not erased.");
+			return false;
+		}
+
+		if (!Flash::writeHalfWord(TargetMemoryMap::configOrigin, OSSHS_WEAR_JOURNAL_MAGIC) ||
+			!Flash::writeHalfWord(TargetMemoryMap::configOrigin + 2, OSSHS_WEAR_JOURNAL_VERSION))
+		{
+			OSSHS_LOG_ERROR("Starting wear journal failed. Header could not be written.");
+			return false;
+		}
+
+		end = TargetMemoryMap::configOrigin + 4;
+		return true;
+	}
+
+	bool
+	WearJournal::compact()
+	{
+		std::unique_ptr<uint16_t[]> totals = std::make_unique<uint16_t[]>(OSSHS_WEAR_JOURNAL_PAGES);
+		for (uint32_t i = 0; i < OSSHS_WEAR_JOURNAL_PAGES; i++)
+		{
+			uint32_t count = getEraseCount(OSSHS_WEAR_JOURNAL_FIRST_PAGE + i);
+			totals[i] = count < 0xfffe ? count : 0xfffe;
+			pending[i] = 0;
+		}
+
+		end = 0;
+		if (!Flash::erasePage(TargetMemoryMap::configOrigin) || !start())
+		{
+			OSSHS_LOG_ERROR("Compacting wear journal failed. Journal could not be erased.");
+			return false;
+		}
+
+		for (uint32_t i = 0; i < OSSHS_WEAR_JOURNAL_PAGES; i++)
+			if (totals[i] && !append(OSSHS_WEAR_JOURNAL_FIRST_PAGE + i, totals[i]))
+				return false;
+
+		OSSHS_LOG_INFO("Compacting wear journal succeeded(entries = `%lu`).", (end - TargetMemoryMap::configOrigin - 4) / 4);
+		return true;
+	}
+
+	bool
+	WearJournal::append(uint32_t page, uint32_t erases)
+	{
+		// The page goes first, an entry interrupted before its erases are written counts nothing
+		if (!Flash::writeHalfWord(end, page) || !Flash::writeHalfWord(end + 2, erases))
+		{
+			OSSHS_LOG_ERROR("Appending wear journal entry failed(page = `%lu`, erases = `%lu`).", page, erases);
+			return false;
+		}
+
+		end += 4;
+		return true;
+	}
+}
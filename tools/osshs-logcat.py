@@ -0,0 +1,198 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019, Linas Nikiperavicius
+#
+# Collects the binary log records nodes send on CAN (see include/osshs/log/can_log_sink.hpp), puts them back together
+# per node and prints them like the text log. Format strings and file names are looked up in the ELF file of the
+# bootloader. Reads candump -L files (or stdin) or a SocketCAN interface.
+#
+#   candump -L can0 | tools/osshs-logcat.py build/osshs-bootloader/osshs-bootloader.elf
+#   tools/osshs-logcat.py --interface can0 build/osshs-bootloader/osshs-bootloader.elf
+
+import argparse
+import re
+import socket
+import struct
+import sys
+
+LOG_ID = 0x680
+FIRST = 0x80
+
+HEADER = struct.Struct("<IHII")
+LEVELS = ["DISABLED", "ERROR", "WARNING", "INFO", "DEBUG", "?", "?", "?"]
+
+# printf conversions, integers are sent in 4 bytes unless they are 64 bit
+CONVERSION = re.compile(r"%([-+ #0]*[0-9]*(?:\.[0-9]+)?)(hh|h|ll|l|j|z|t)?([diuxXocsp%])")
+
+def read_elf(path):
+    with open(path, "rb") as elf:
+        data = elf.read()
+
+    if data[:4] != b"\x7fELF" or data[4] != 1 or data[5] != 1:
+        sys.exit("Only little endian ELF32 files are supported.")
+
+    phoff, = struct.unpack_from("<I", data, 0x1c)
+    phentsize, phnum = struct.unpack_from("<HH", data, 0x2a)
+
+    # Strings are read from flash, so segments are placed at their load address
+    segments = []
+    for i in range(phnum):
+        kind, offset, _, paddr, filesz = struct.unpack_from("<IIIII", data, phoff + i * phentsize)
+        if kind == 1 and filesz:
+            segments.append((paddr, data[offset:offset + filesz]))
+    return segments
+
+def read_string(segments, address):
+    for origin, content in segments:
+        if origin <= address < origin + len(content):
+            end = content.find(b"\0", address - origin)
+            return content[address - origin:end if end >= 0 else len(content)].decode(errors="replace")
+    return None
+
+def format_message(format, args):
+    output = ""
+    position = 0
+    offset = 0
+
+    for match in CONVERSION.finditer(format):
+        output += format[position:match.start()]
+        position = match.end()
+        flags, length, conversion = match.groups()
+
+        if conversion == "%":
+            output += "%"
+            continue
+
+        if conversion == "s":
+            end = args.find(b"\0", offset)
+            if end < 0:
+                output += "<missing>"
+                break
+            output += ("%" + flags + "s") % args[offset:end].decode(errors="replace")
+            offset = end + 1
+            continue
+
+        size = 8 if length in ("ll", "j") else 4
+        if offset + size > len(args):
+            output += "<missing>"
+            break
+        value = int.from_bytes(args[offset:offset + size], "little")
+        offset += size
+
+        bits = {"hh": 8, "h": 16}.get(length, size * 8)
+        value &= (1 << bits) - 1
+        if conversion in "di" and value >= 1 << (bits - 1):
+            value -= 1 << bits
+
+        if conversion == "p":
+            output += "0x{:08x}".format(value)
+        elif conversion == "c":
+            output += chr(value & 0xff)
+        else:
+            output += ("%" + flags + {"u": "d", "i": "d"}.get(conversion, conversion)) % value
+
+    return output + format[position:]
+
+class Node:
+    def __init__(self, node):
+        self.node = node
+        self.sequence = None
+        self.record = None
+        self.length = 0
+        self.lost = 0
+
+    def receive(self, data):
+        """Add a frame, returns a complete record or None."""
+        if not data:
+            return None
+
+        sequence = data[0] & ~FIRST
+        if self.sequence is not None and sequence != self.sequence:
+            self.lost += (sequence - self.sequence) % 128
+            self.record = None
+        self.sequence = (sequence + 1) % 128
+
+        if data[0] & FIRST:
+            if len(data) < 2:
+                return None
+            self.length = data[1]
+            self.record = bytearray(data[2:])
+        elif self.record is not None:
+            self.record += data[1:]
+        else:
+            return None
+
+        if len(self.record) < self.length:
+            return None
+
+        record, self.record = bytes(self.record[:self.length]), None
+        return record
+
+def decode(node, record, segments):
+    if len(record) < HEADER.size:
+        return "[node {}] Short record: {}".format(node, record.hex())
+
+    time, line, file, format_address = HEADER.unpack_from(record)
+    args = record[HEADER.size:]
+    prefix = "[node {}][{}.{:03}][{}]".format(node, time // 1000, time % 1000, LEVELS[line >> 13])
+
+    if not format_address:
+        return "{} {} log records dropped".format(prefix, int.from_bytes(args[:4], "little"))
+
+    file_name = read_string(segments, file) if segments else None
+    format_string = read_string(segments, format_address) if segments else None
+    location = "[{}:{}]".format(file_name or "0x{:08x}".format(file), line & 0x1fff)
+
+    if format_string is None:
+        return "{}{} format 0x{:08x}, args {}".format(prefix, location, format_address, args.hex())
+    return "{}{} {}".format(prefix, location, format_message(format_string, args))
+
+def read_candump(paths):
+    # (timestamp) interface id#data
+    frame = re.compile(r"\([0-9.]+\)\s+\S+\s+([0-9A-Fa-f]{3})#([0-9A-Fa-f]*)")
+    for path in paths:
+        with (sys.stdin if path == "-" else open(path)) as lines:
+            for line in lines:
+                match = frame.match(line.strip())
+                if match:
+                    yield int(match.group(1), 16), bytes.fromhex(match.group(2))
+
+def read_socketcan(interface):
+    can = socket.socket(socket.AF_CAN, socket.SOCK_RAW, socket.CAN_RAW)
+    can.bind((interface,))
+
+    # Only log frames, in struct can_frame the identifier is followed by the length and 3 padding bytes
+    can.setsockopt(socket.SOL_CAN_RAW, socket.CAN_RAW_FILTER, struct.pack("=II", LOG_ID, 0x780))
+    while True:
+        identifier, length, data = struct.unpack("=IB3x8s", can.recv(16))
+        yield identifier & socket.CAN_SFF_MASK, data[:length]
+
+def main():
+    parser = argparse.ArgumentParser(description="Print the log records nodes send on CAN.")
+    parser.add_argument("elf", nargs="?", help="ELF file of the bootloader, addresses are printed without it")
+    parser.add_argument("--interface", help="SocketCAN interface to receive from, e.g. can0")
+    parser.add_argument("--candump", nargs="*", default=["-"], help="candump -L files to read (default: stdin)")
+    parser.add_argument("--node", type=lambda value: int(value, 0), help="Only print records of this node")
+    args = parser.parse_args()
+
+    segments = read_elf(args.elf) if args.elf else None
+    frames = read_socketcan(args.interface) if args.interface else read_candump(args.candump)
+    nodes = {}
+
+    try:
+        for identifier, data in frames:
+            node = identifier - LOG_ID
+            if not 0 < node < 0x80 or (args.node is not None and node != args.node):
+                continue
+
+            state = nodes.setdefault(node, Node(node))
+            lost = state.lost
+            record = state.receive(data)
+            if state.lost != lost:
+                print("[node {}] {} frames lost".format(node, state.lost - lost), file=sys.stderr)
+            if record is not None:
+                print(decode(node, record, segments), flush=True)
+    except KeyboardInterrupt:
+        pass
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,356 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019, Linas Nikiperavicius
+#
+# Packs an application into the firmware container of include/osshs/container.hpp, which the bootloader writes with
+# BEGIN mode CONTAINER of the update protocol. Reads an ELF file by its loadable segments or a raw binary at --origin.
+# Fills in imageLength and crc of the application manifest (include/osshs/manifest.hpp) first, --binary writes the
+# image with them for raw writes. --sign appends an Ed25519 signature of the image.
+#
+#   tools/osshs-pack.py build/application.elf application.ocon
+#
+# With --key the container is encrypted with AES-128-CTR and put in an envelope that names its origin and initial
+# counter block, for bootloaders built with decrypt=1. --key-page writes the key page to flash next to the bootloader.
+#
+#   tools/osshs-pack.py --key 000102030405060708090a0b0c0d0e0f --key-page key.bin build/application.elf application.oenc
+
+import argparse
+import hashlib
+import os
+import struct
+import sys
+import zlib
+
+CONTAINER_MAGIC = 0x4e4f434f
+CONTAINER_VERSION = 1
+FLAG_BLANK = 0x0001
+FLAG_COMPRESSED = 0x0002
+
+HEADER = struct.Struct("<IHHHHIIIII")
+RECORD = struct.Struct("<IIHH")
+
+MANIFEST_MAGIC = 0x4e414d4f
+MANIFEST_VERSION = 1
+MANIFEST_OFFSET = 0x200
+MANIFEST = struct.Struct("<IHHIIII")
+
+ENVELOPE_MAGIC = 0x434e454f
+ENVELOPE = struct.Struct("<II16s")
+
+KEY_STORE_MAGIC = 0x594b
+KEY_STORE_VERSION = 1
+
+def make_sbox():
+    rotate = lambda value, count: ((value << count) | (value >> (8 - count))) & 0xff
+    sbox = [0x63] * 256
+    p = q = 1
+    while True:
+        # p walks the multiplicative group by 3, q by its inverse
+        p = (p ^ (p << 1) ^ (0x1b if p & 0x80 else 0)) & 0xff
+        q ^= q << 1
+        q ^= q << 2
+        q ^= q << 4
+        q &= 0xff
+        if q & 0x80:
+            q ^= 0x09
+        sbox[p] = q ^ rotate(q, 1) ^ rotate(q, 2) ^ rotate(q, 3) ^ rotate(q, 4) ^ 0x63
+        if p == 1:
+            return sbox
+
+SBOX = make_sbox()
+
+def double(value):
+    return ((value << 1) ^ (0x1b if value & 0x80 else 0)) & 0xff
+
+def expand_key(key):
+    words = [list(key[i:i + 4]) for i in range(0, 16, 4)]
+    constant = 1
+    for i in range(4, 44):
+        word = list(words[i - 1])
+        if i % 4 == 0:
+            word = [SBOX[value] for value in word[1:] + word[:1]]
+            word[0] ^= constant
+            constant = double(constant)
+        words.append([a ^ b for a, b in zip(words[i - 4], word)])
+    return [sum(words[round * 4:round * 4 + 4], []) for round in range(11)]
+
+def encrypt_block(round_keys, block):
+    state = [a ^ b for a, b in zip(block, round_keys[0])]
+    for round in range(1, 11):
+        # SubBytes and ShiftRows, byte r of column c comes from column c + r
+        state = [SBOX[state[(column + row) % 4 * 4 + row]] for column in range(4) for row in range(4)]
+        if round < 10:
+            mixed = []
+            for column in range(4):
+                a = state[column * 4:column * 4 + 4]
+                mixed += [double(a[row]) ^ double(a[(row + 1) % 4]) ^ a[(row + 1) % 4] ^ a[(row + 2) % 4] ^
+                    a[(row + 3) % 4] for row in range(4)]
+            state = mixed
+        state = [a ^ b for a, b in zip(state, round_keys[round])]
+    return bytes(state)
+
+def encrypt(data, key, counter):
+    """AES-128-CTR, the last 4 bytes of the counter block count blocks as a big endian number."""
+    round_keys = expand_key(key)
+    prefix, initial = counter[:12], int.from_bytes(counter[12:], "big")
+    output = bytearray(data)
+    for block in range(0, len(data), 16):
+        stream = encrypt_block(round_keys, prefix + ((initial + block // 16) & 0xffffffff).to_bytes(4, "big"))
+        for i in range(block, min(block + 16, len(data))):
+            output[i] ^= stream[i - block]
+    return bytes(output)
+
+def key_page(key):
+    page = struct.pack("<HH16s", KEY_STORE_MAGIC, KEY_STORE_VERSION, key)
+    return page + struct.pack("<I", zlib.crc32(page))
+
+# Ed25519 as specified by RFC 8032, in extended coordinates (X, Y, Z, T) with x = X / Z, y = Y / Z and xy = T / Z
+P = 2 ** 255 - 19
+L = 2 ** 252 + 27742317777372353535851937790883648493
+D = -121665 * pow(121666, P - 2, P) % P
+
+def point_add(a, b):
+    A = (a[1] - a[0]) * (b[1] - b[0]) % P
+    B = (a[1] + a[0]) * (b[1] + b[0]) % P
+    C = 2 * a[3] * b[3] * D % P
+    E = 2 * a[2] * b[2] % P
+    E, F, G, H = B - A, E - C, E + C, B + A
+    return (E * F % P, G * H % P, F * G % P, E * H % P)
+
+def point_multiply(scalar, point):
+    result = (0, 1, 1, 0)
+    while scalar:
+        if scalar & 1:
+            result = point_add(result, point)
+        point = point_add(point, point)
+        scalar >>= 1
+    return result
+
+def point_compress(point):
+    inverse = pow(point[2], P - 2, P)
+    x, y = point[0] * inverse % P, point[1] * inverse % P
+    return (y | (x & 1) << 255).to_bytes(32, "little")
+
+BASE_Y = 4 * pow(5, P - 2, P) % P
+BASE_X = pow((BASE_Y * BASE_Y - 1) * pow(D * BASE_Y * BASE_Y + 1, P - 2, P), (P + 3) // 8, P)
+if (BASE_X * BASE_X - (BASE_Y * BASE_Y - 1) * pow(D * BASE_Y * BASE_Y + 1, P - 2, P)) % P:
+    BASE_X = BASE_X * pow(2, (P - 1) // 4, P) % P
+BASE_X = P - BASE_X if BASE_X & 1 else BASE_X
+BASE = (BASE_X, BASE_Y, 1, BASE_X * BASE_Y % P)
+
+def expand_secret(secret):
+    digest = hashlib.sha512(secret).digest()
+    scalar = int.from_bytes(digest[:32], "little") & ((1 << 254) - 8) | 1 << 254
+    return scalar, digest[32:]
+
+def public_key(secret):
+    return point_compress(point_multiply(expand_secret(secret)[0], BASE))
+
+def sign(secret, message):
+    scalar, prefix = expand_secret(secret)
+    key = point_compress(point_multiply(scalar, BASE))
+    r = int.from_bytes(hashlib.sha512(prefix + message).digest(), "little") % L
+    R = point_compress(point_multiply(r, BASE))
+    h = int.from_bytes(hashlib.sha512(R + key + message).digest(), "little") % L
+    return R + ((r + h * scalar) % L).to_bytes(32, "little")
+
+def read_elf(data):
+    if data[:4] != b"\x7fELF" or data[4] != 1 or data[5] != 1:
+        sys.exit("Only little endian ELF32 files are supported.")
+
+    phoff, = struct.unpack_from("<I", data, 0x1c)
+    phentsize, phnum = struct.unpack_from("<HH", data, 0x2a)
+
+    # Loadable segments at their load address, .data is stored behind .text
+    segments = []
+    for i in range(phnum):
+        kind, offset, _, paddr, filesz = struct.unpack_from("<IIIII", data, phoff + i * phentsize)
+        if kind == 1 and filesz:
+            segments.append((paddr, data[offset:offset + filesz]))
+
+    if not segments:
+        sys.exit("The ELF file has no loadable segments.")
+    return segments
+
+def flatten(segments, origin):
+    end = max(address + len(content) for address, content in segments)
+    image = bytearray(b"\xff" * (end - origin))
+    for address, content in segments:
+        if address < origin:
+            sys.exit("Segment at 0x{:08x} lies below the origin 0x{:08x}.".format(address, origin))
+        image[address - origin:address - origin + len(content)] = content
+
+    # The bootloader checks images in words
+    image += b"\xff" * (-len(image) % 4)
+    return image
+
+def fill_manifest(image, origin):
+    """Fill in imageLength, entryPoint if 0 and crc of the manifest as Bootloader::validateApplication() checks them."""
+    if len(image) < MANIFEST_OFFSET + MANIFEST.size:
+        return None
+
+    magic, version, size, image_version, _, entry_point, _ = MANIFEST.unpack_from(image, MANIFEST_OFFSET)
+    if magic != MANIFEST_MAGIC:
+        return None
+    if version != MANIFEST_VERSION or size != MANIFEST.size:
+        sys.exit("The manifest has version {} and size {}, expected {} and {}.".format(version, size,
+            MANIFEST_VERSION, MANIFEST.size))
+
+    reset_handler, = struct.unpack_from("<I", image, 4)
+    if not entry_point:
+        entry_point = reset_handler
+        struct.pack_into("<I", image, MANIFEST_OFFSET + 0x10, entry_point)
+    if entry_point != reset_handler or not 0 <= (entry_point & ~1) - origin < len(image):
+        sys.exit("The manifest entry point 0x{:08x} is not the reset handler 0x{:08x} of the vector table.".format(
+            entry_point, reset_handler))
+
+    # The image is word padded by flatten(), the CRC covers all of it except the crc field itself
+    crc_offset = MANIFEST_OFFSET + MANIFEST.size - 4
+    struct.pack_into("<I", image, MANIFEST_OFFSET + 0x0c, len(image))
+    crc = zlib.crc32(image[crc_offset + 4:], zlib.crc32(image[:crc_offset]))
+    struct.pack_into("<I", image, crc_offset, crc)
+    return image_version
+
+def packbits(data):
+    packed = bytearray()
+    i = 0
+    while i < len(data):
+        run = 1
+        while i + run < len(data) and run < 128 and data[i + run] == data[i]:
+            run += 1
+
+        if run > 1:
+            packed += bytes([257 - run, data[i]])
+            i += run
+            continue
+
+        # Literals up to the next run of three, shorter runs are cheaper as literals
+        start = i
+        while i < len(data) and i - start < 128 and not (i + 2 < len(data) and data[i] == data[i + 1] == data[i + 2]):
+            i += 1
+        packed += bytes([i - start - 1]) + data[start:i]
+
+    return bytes(packed)
+
+def pack(image, origin, page_size, compress):
+    records = bytearray()
+    counts = {"plain": 0, "blank": 0, "compressed": 0}
+
+    for offset in range(0, len(image), page_size):
+        page = bytes(image[offset:offset + page_size]).ljust(page_size, b"\xff")
+        crc = zlib.crc32(page)
+
+        if page == b"\xff" * page_size:
+            flags, payload, kind = FLAG_BLANK, b"", "blank"
+        else:
+            flags, payload, kind = 0, page, "plain"
+            packed = packbits(page) if compress else page
+            if len(packed) < page_size:
+                flags, payload, kind = FLAG_COMPRESSED, packed, "compressed"
+
+        records += RECORD.pack(origin + offset, crc, flags, len(payload)) + payload
+        counts[kind] += 1
+
+    # Version number of the application manifest, if there is one
+    version = 0
+    if len(image) >= MANIFEST_OFFSET + 12:
+        magic, _, _, version = struct.unpack_from("<IHHI", image, MANIFEST_OFFSET)
+        if magic != MANIFEST_MAGIC:
+            version = 0
+
+    header = HEADER.pack(CONTAINER_MAGIC, CONTAINER_VERSION, HEADER.size, page_size, len(image) // page_size +
+        (len(image) % page_size > 0), origin, len(image), version, zlib.crc32(image), len(records))
+    return header + records, counts
+
+def main():
+    parser = argparse.ArgumentParser(description="Pack an application into an osshs firmware container.")
+    parser.add_argument("input", help="ELF file, or raw binary with --origin")
+    parser.add_argument("output", help="Container file to write")
+    parser.add_argument("--origin", type=lambda value: int(value, 0),
+        help="Load address of a raw binary, the lowest segment address rounded down to a page for ELF files")
+    parser.add_argument("--page-size", type=lambda value: int(value, 0), default=0x400,
+        help="Flash page size of the target, 0x400 or 0x800 (default: 0x400)")
+    parser.add_argument("--no-compress", action="store_true", help="Store every page that is not blank as is")
+    parser.add_argument("--binary", help="Also write the image with its manifest filled in, for raw writes")
+    parser.add_argument("--sign", help="File with a 32 byte Ed25519 secret key, raw or in hex, appends the signature "
+        "for bootloaders built with OSSHS_BOOTLOADER_VERIFY_SIGNATURE")
+    parser.add_argument("--key", type=bytes.fromhex, help="128 bit key in hex, encrypts the container in an envelope")
+    parser.add_argument("--key-page", help="File to write the key page to, flashed at the last page of the bootloader")
+    parser.add_argument("--bootloader-size", type=lambda value: int(value, 0), default=0x4000,
+        help="Flash reserved for the bootloader, to print the address of the key page (default: 0x4000)")
+    arguments = parser.parse_args()
+
+    if arguments.page_size not in (0x400, 0x800):
+        sys.exit("STM32F1 flash pages are 1 KiB or 2 KiB.")
+
+    if arguments.key is not None and len(arguments.key) != 16:
+        sys.exit("The key must be 16 bytes.")
+
+    if arguments.key_page and arguments.key is None:
+        sys.exit("--key-page needs --key.")
+
+    with open(arguments.input, "rb") as file:
+        data = file.read()
+
+    if data[:4] == b"\x7fELF":
+        segments = read_elf(data)
+        origin = arguments.origin
+        if origin is None:
+            origin = min(address for address, _ in segments) & ~(arguments.page_size - 1)
+    elif arguments.origin is not None:
+        segments = [(arguments.origin, data)]
+        origin = arguments.origin
+    else:
+        sys.exit("A raw binary needs --origin.")
+
+    if origin % arguments.page_size:
+        sys.exit("The origin 0x{:08x} is not a page origin.".format(origin))
+
+    image = flatten(segments, origin)
+    manifest = fill_manifest(image, origin) is not None
+    if not manifest:
+        print("warning: no manifest at 0x{:08x}, the bootloader will not start this image".format(
+            origin + MANIFEST_OFFSET), file=sys.stderr)
+
+    # The signature trailer directly follows the imageLength bytes it covers, the manifest crc included
+    if arguments.sign:
+        if not manifest:
+            sys.exit("Signing needs a manifest, the bootloader finds the signature by its imageLength.")
+        with open(arguments.sign, "rb") as file:
+            secret = file.read().strip()
+        if len(secret) == 64:
+            secret = bytes.fromhex(secret.decode())
+        if len(secret) != 32:
+            sys.exit("The secret key must be 32 bytes.")
+        image += sign(secret, bytes(image))
+
+    if arguments.binary:
+        with open(arguments.binary, "wb") as file:
+            file.write(image)
+
+    container, counts = pack(image, origin, arguments.page_size, not arguments.no_compress)
+
+    # A fresh counter block per container, counting from 0 so no image wraps its low word
+    if arguments.key is not None:
+        counter = os.urandom(12) + bytes(4)
+        container = ENVELOPE.pack(ENVELOPE_MAGIC, origin, counter) + encrypt(container, arguments.key, counter)
+
+    with open(arguments.output, "wb") as file:
+        file.write(container)
+
+    print("{}: {} bytes at 0x{:08x} in {} bytes{}, {} plain, {} compressed and {} blank pages".format(arguments.output,
+        len(image), origin, len(container), " encrypted" if arguments.key is not None else "", counts["plain"],
+        counts["compressed"], counts["blank"]))
+
+    if arguments.sign:
+        print("signed, OSSHS_BOOTLOADER_PUBLIC_KEY {{{}}}".format(", ".join("0x{:02x}".format(byte)
+            for byte in public_key(secret))))
+
+    if arguments.key_page:
+        with open(arguments.key_page, "wb") as file:
+            file.write(key_page(arguments.key))
+
+        print("{}: key page, flash it at 0x{:08x}".format(arguments.key_page,
+            0x08000000 + arguments.bootloader_size - arguments.page_size))
+
+if __name__ == "__main__":
+    main()